@@ -196,19 +196,21 @@ function GetFolderList(list) {
     nm.doGet("https://www.googleapis.com/drive/v2/files");
 
     if (nm.responseCode() == 200) {
-        local t = ParseJSON(nm.responseBody());
+        // The file list can be large, only a few fields of each item are needed
+        local t = ParseJSONLazy(nm.responseBody());
         if ( t != null ) {
-            local count = t.items.len();
+            local items = t.get("items");
+            local count = items == null ? 0 : items.size();
             for ( local i = 0; i < count; i++ ) {
-                local item = t.items[i];
-                if ( item.mimeType != "application/vnd.google-apps.folder" ) {
+                local item = items.get("[" + i + "]");
+                if ( item.get("mimeType") != "application/vnd.google-apps.folder" ) {
                     continue;
                 }
                 local folder = CFolderItem();
-                folder.setId(item.id);
-                folder.setTitle(item.title);
+                folder.setId(item.get("id"));
+                folder.setTitle(item.get("title"));
                 //folder.setSummary(summary);
-                folder.setViewUrl(item.alternateLink);
+                folder.setViewUrl(item.get("alternateLink"));
                 list.AddFolderItem(folder);
             }
             return 1;
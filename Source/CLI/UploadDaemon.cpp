@@ -0,0 +1,379 @@
+#include "UploadDaemon.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <json/json.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Core/3rdpart/SimpleWebServer/server_http.hpp"
+#include "Core/Logging.h"
+#include "Core/Upload/UploadManager.h"
+#include "Core/Upload/UploadSession.h"
+#include "Core/Upload/FileUploadTask.h"
+#include "Core/Upload/ServerProfile.h"
+#include "Core/Utils/CoreUtils.h"
+
+using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
+
+namespace {
+
+/**
+ * Streams JSON lines of one job to the client. Events may be emitted from any thread,
+ * the socket is written only in the server thread.
+ */
+class JobStream: public std::enable_shared_from_this<JobStream> {
+public:
+    JobStream(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<SimpleWeb::asio::io_service> ioService) :
+        response_(std::move(response)), ioService_(std::move(ioService)), finished_(false), sending_(false) {
+        writerBuilder_["indentation"] = "";
+    }
+
+    void emit(const Json::Value& event) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        pending_ += Json::writeString(writerBuilder_, event);
+        pending_ += "\n";
+    }
+
+    /**
+     * Sends pending events
+     */
+    void post() {
+        auto self = shared_from_this();
+        ioService_->post([self] { self->flush(); });
+    }
+
+    /**
+     * Sends pending events and closes the connection
+     */
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            finished_ = true;
+        }
+        post();
+    }
+
+    void setOnDisconnected(std::function<void()> callback) {
+        onDisconnected_ = std::move(callback);
+    }
+
+private:
+    void flush() {
+        if (sending_ || !response_) {
+            return;
+        }
+        std::string data;
+        bool finished;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            data.swap(pending_);
+            finished = finished_;
+        }
+        if (!data.empty() || response_->size()) {
+            *response_ << data;
+            sending_ = true;
+            auto self = shared_from_this();
+            response_->send([self](const SimpleWeb::error_code& ec) {
+                self->sending_ = false;
+                if (ec) {
+                    self->response_.reset();
+                    if (self->onDisconnected_) {
+                        self->onDisconnected_();
+                    }
+                    return;
+                }
+                self->flush();
+            });
+        } else if (finished) {
+            // Connection is closed when the last reference to the response is released
+            response_.reset();
+        }
+    }
+
+    std::shared_ptr<HttpServer::Response> response_;
+    std::shared_ptr<SimpleWeb::asio::io_service> ioService_;
+    Json::StreamWriterBuilder writerBuilder_;
+    std::mutex mutex_;
+    std::string pending_;
+    bool finished_;
+    bool sending_; // accessed only in the server thread
+    std::function<void()> onDisconnected_;
+};
+
+Json::Value fileEvent(const char* name, UploadTask* task) {
+    Json::Value event;
+    event["event"] = name;
+    auto* fileTask = dynamic_cast<FileUploadTask*>(task);
+    if (fileTask) {
+        event["file"] = fileTask->getFileName();
+    }
+    return event;
+}
+
+bool tokensEqual(const std::string& a, const std::string& b) {
+    // Comparison time does not depend on the position of the first mismatch
+    unsigned char diff = a.size() != b.size();
+    for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return !diff;
+}
+
+}
+
+class UploadDaemonPrivate {
+public:
+    UploadDaemonPrivate(UploadManager* uploadManager, UploadDaemon::ProfileResolver resolver) :
+        uploadManager_(uploadManager), resolver_(std::move(resolver)), shutdownRequested_(false) {
+    }
+
+    void handleUpload(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+    void writeError(const std::shared_ptr<HttpServer::Response>& response, const std::string& message,
+        SimpleWeb::StatusCode statusCode = SimpleWeb::StatusCode::client_error_bad_request);
+
+    /**
+     * Writes an error response and returns false if the request is not allowed
+     */
+    bool checkAccess(const std::shared_ptr<HttpServer::Response>& response, const std::shared_ptr<HttpServer::Request>& request);
+
+    HttpServer server_;
+    std::thread thread_;
+    UploadManager* uploadManager_;
+    UploadDaemon::ProfileResolver resolver_;
+    std::string accessToken_;
+    std::mutex shutdownMutex_;
+    std::condition_variable shutdownCondition_;
+    bool shutdownRequested_;
+};
+
+void UploadDaemonPrivate::writeError(const std::shared_ptr<HttpServer::Response>& response, const std::string& message,
+        SimpleWeb::StatusCode statusCode) {
+    Json::Value error;
+    error["event"] = "error";
+    error["error"] = message;
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    SimpleWeb::CaseInsensitiveMultimap header;
+    header.emplace("Content-Type", "application/json");
+    response->write(statusCode, Json::writeString(builder, error) + "\n", header);
+}
+
+bool UploadDaemonPrivate::checkAccess(const std::shared_ptr<HttpServer::Response>& response, const std::shared_ptr<HttpServer::Request>& request) {
+    // Browsers add Origin to cross-site requests, a page must not be able to start uploads
+    if (request->header.find("Origin") != request->header.end()) {
+        writeError(response, "Requests from web pages are not allowed", SimpleWeb::StatusCode::client_error_forbidden);
+        return false;
+    }
+    auto it = request->header.find("Authorization");
+    if (accessToken_.empty() || it == request->header.end() || !tokensEqual(it->second, "Bearer " + accessToken_)) {
+        writeError(response, "Invalid access token", SimpleWeb::StatusCode::client_error_forbidden);
+        return false;
+    }
+    return true;
+}
+
+void UploadDaemonPrivate::handleUpload(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+    Json::Value job;
+    Json::Reader reader;
+    if (!reader.parse(request->content.string(), job, false) || !job.isObject() || !job["files"].isArray()) {
+        writeError(response, "Invalid job description");
+        return;
+    }
+    UploadDaemonJobOptions options;
+    options.serverName = job.get("server", "").asString();
+    options.login = job.get("login", "").asString();
+    options.password = job.get("password", "").asString();
+    options.folderId = job.get("folder", "").asString();
+
+    ServerProfile serverProfile;
+    std::string errorMessage;
+    if (!resolver_(options, serverProfile, errorMessage)) {
+        writeError(response, errorMessage);
+        return;
+    }
+
+    auto session = std::make_shared<UploadSession>(false);
+    std::vector<std::string> missingFiles;
+    for (const auto& file : job["files"]) {
+        std::string fileName = file.asString();
+        if (!IuCoreUtils::FileExists(fileName)) {
+            missingFiles.push_back(fileName);
+            continue;
+        }
+        auto task = std::make_shared<FileUploadTask>(fileName, IuCoreUtils::ExtractFileName(fileName));
+        task->setServerProfile(serverProfile);
+        session->addTask(task);
+    }
+
+    SimpleWeb::CaseInsensitiveMultimap header;
+    header.emplace("Content-Type", "application/x-ndjson");
+    response->close_connection_after_response = true;
+    response->write(header);
+    auto stream = std::make_shared<JobStream>(response, server_.io_service);
+
+    for (const auto& fileName : missingFiles) {
+        Json::Value event;
+        event["event"] = "result";
+        event["file"] = fileName;
+        event["success"] = false;
+        event["error"] = "File doesn't exist";
+        stream->emit(event);
+    }
+    int failedCount = static_cast<int>(missingFiles.size());
+
+    if (!session->taskCount()) {
+        Json::Value event;
+        event["event"] = "finished";
+        event["uploaded"] = 0;
+        event["failed"] = failedCount;
+        stream->emit(event);
+        stream->finish();
+        return;
+    }
+
+    for (const auto& task : *session) {
+        task->setOnUploadProgressCallback([stream](UploadTask* t) {
+            Json::Value event = fileEvent("progress", t);
+            event["uploaded"] = Json::Int64(t->progress()->uploaded);
+            event["total"] = Json::Int64(t->progress()->totalUpload);
+            stream->emit(event);
+            stream->post();
+        });
+        task->setOnStatusChangedCallback([stream](UploadTask* t) {
+            Json::Value event = fileEvent("status", t);
+            event["status"] = t->progress()->statusText;
+            stream->emit(event);
+            stream->post();
+        });
+    }
+
+    UploadManager* uploadManager = uploadManager_;
+    session->addSessionFinishedCallback([stream, uploadManager, failedCount](UploadSession* s) {
+        int uploaded = 0, failed = failedCount;
+        for (const auto& task : *s) {
+            Json::Value event = fileEvent("result", task.get());
+            bool success = task->uploadSuccess();
+            event["success"] = success;
+            if (success) {
+                UploadResult* result = task->uploadResult();
+                event["directUrl"] = result->directUrl;
+                event["thumbUrl"] = result->thumbUrl;
+                event["viewUrl"] = result->downloadUrl;
+                event["server"] = task->serverName();
+                event["size"] = Json::Int64(task->getDataLength());
+                uploaded++;
+            } else {
+                failed++;
+            }
+            stream->emit(event);
+        }
+        Json::Value event;
+        event["event"] = "finished";
+        event["uploaded"] = uploaded;
+        event["failed"] = failed;
+        stream->emit(event);
+        stream->finish();
+        // Upload thread keeps a reference to the session until it finishes processing the task
+        uploadManager->removeSession(s->shared_from_this());
+    });
+
+    std::weak_ptr<UploadSession> weakSession = session;
+    stream->setOnDisconnected([weakSession] {
+        if (auto s = weakSession.lock()) {
+            s->stop();
+        }
+    });
+    stream->post();
+    uploadManager_->addSession(session);
+}
+
+UploadDaemon::UploadDaemon(UploadManager* uploadManager, ProfileResolver resolver) :
+    d_(std::make_unique<UploadDaemonPrivate>(uploadManager, std::move(resolver))) {
+    d_->server_.resource["^/upload$"]["POST"] = [this](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+        if (d_->checkAccess(response, request)) {
+            d_->handleUpload(response, request);
+        }
+    };
+    d_->server_.resource["^/shutdown$"]["POST"] = [this](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+        if (!d_->checkAccess(response, request)) {
+            return;
+        }
+        response->write(SimpleWeb::StatusCode::success_ok, "{}\n");
+        {
+            std::lock_guard<std::mutex> lk(d_->shutdownMutex_);
+            d_->shutdownRequested_ = true;
+        }
+        d_->shutdownCondition_.notify_all();
+    };
+}
+
+UploadDaemon::~UploadDaemon() {
+    stop();
+}
+
+unsigned short UploadDaemon::start(const std::string& address, unsigned short port) {
+    d_->server_.config.address = address;
+    d_->server_.config.port = port;
+    unsigned short assignedPort = 0;
+    try {
+        assignedPort = d_->server_.bind();
+    } catch (const std::exception& ex) {
+        LOG(ERROR) << "Cannot start upload daemon: " << ex.what();
+        return 0;
+    }
+    d_->thread_ = std::thread([this] {
+        d_->server_.accept_and_run();
+    });
+    return assignedPort;
+}
+
+void UploadDaemon::waitForShutdown() {
+    std::unique_lock<std::mutex> lk(d_->shutdownMutex_);
+    d_->shutdownCondition_.wait(lk, [this] { return d_->shutdownRequested_; });
+}
+
+void UploadDaemon::stop() {
+    if (d_->thread_.joinable()) {
+        d_->server_.stop();
+        d_->thread_.join();
+    }
+}
+
+void UploadDaemon::setAccessToken(const std::string& token) {
+    d_->accessToken_ = token;
+}
+
+std::string UploadDaemon::createAccessTokenFile(const std::string& fileName) {
+    std::random_device randomDevice;
+    std::string token;
+    for (int i = 0; i < 8; i++) {
+        char buffer[9];
+        snprintf(buffer, sizeof(buffer), "%08x", static_cast<unsigned int>(randomDevice()));
+        token += buffer;
+    }
+#ifdef _WIN32
+    // Settings directory is in the user profile which is not accessible by other users
+    if (!IuCoreUtils::PutFileContents(fileName, token)) {
+        return std::string();
+    }
+#else
+    // The file left from a previous run may have been opened by someone else, so a new file is created
+    unlink(fileName.c_str());
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return std::string();
+    }
+    bool ok = write(fd, token.data(), token.size()) == static_cast<ssize_t>(token.size());
+    close(fd);
+    if (!ok) {
+        return std::string();
+    }
+#endif
+    return token;
+}
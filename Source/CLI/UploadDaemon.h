@@ -0,0 +1,72 @@
+#ifndef IU_CLI_UPLOADDAEMON_H
+#define IU_CLI_UPLOADDAEMON_H
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Core/Utils/CoreTypes.h"
+
+class UploadManager;
+class ServerProfile;
+class UploadDaemonPrivate;
+
+struct UploadDaemonJobOptions {
+    std::string serverName;
+    std::string login;
+    std::string password;
+    std::string folderId;
+};
+
+/**
+@brief UploadDaemon keeps one warm UploadManager (loaded server list, script VMs, connections and
+authorization state) and accepts upload jobs over HTTP on localhost.
+
+POST /upload with JSON body {"files": [...], "server": "...", "login": "...", "password": "...", "folder": "..."}
+starts uploading and streams JSON lines back: "progress", "status" and "result" events for each file
+and a final "finished" event. POST /shutdown stops the daemon.
+
+Every request must carry "Authorization: Bearer <token>" with the token written by createAccessTokenFile(),
+so only processes of the same user can submit jobs. Requests with an Origin header come from web pages
+and are always rejected.
+*/
+class UploadDaemon {
+public:
+    /**
+     * Fills server profile for the job, returns false and error message if the job cannot be uploaded.
+     * Called in the server thread.
+     */
+    typedef std::function<bool(const UploadDaemonJobOptions&, ServerProfile&, std::string&)> ProfileResolver;
+
+    UploadDaemon(UploadManager* uploadManager, ProfileResolver resolver);
+    ~UploadDaemon();
+
+    /**
+     * @return assigned port or 0 on error
+     */
+    unsigned short start(const std::string& address, unsigned short port);
+
+    /**
+     * Blocks until shutdown is requested by a client
+     */
+    void waitForShutdown();
+    void stop();
+
+    /**
+     * Requests without this token are rejected; must be set before start()
+     */
+    void setAccessToken(const std::string& token);
+
+    /**
+     * Generates a random access token and writes it to the file readable only by the owner.
+     * @return empty string on error
+     */
+    static std::string createAccessTokenFile(const std::string& fileName);
+private:
+    std::unique_ptr<UploadDaemonPrivate> d_;
+    DISALLOW_COPY_AND_ASSIGN(UploadDaemon);
+};
+
+#endif
@@ -20,21 +20,32 @@
 
 #include <cmath>
 #include <iostream>
+#include <fstream>
+#include <functional>
+#include <algorithm>
 #include <condition_variable>
+#include <future>
+#include <set>
 #include <boost/format.hpp>
+#include <boost/filesystem.hpp>
+#include <json/json.h>
 
 #include <curl/curl.h>
 #include <csignal>
 
 #include "Core/Upload/Uploader.h"
 #include "Core/Utils/CoreUtils.h"
+#include "Core/Network/NetworkClient.h"
 #include "Core/Network/NetworkClientFactory.h"
 #include "Core/UploadEngineList.h"
 #include "Core/Upload/UploadManager.h"
 #include "Core/Upload/FileUploadTask.h"
 #include "Core/Upload/UploadSession.h"
+#include "Core/Upload/UploadJournal.h"
+#include "Core/Upload/UploadProgressSampler.h"
 #include "Core/Upload/ConsoleUploadErrorHandler.h"
 #include "Core/Upload/UploadEngineManager.h"
+#include "Core/Upload/AuthTokenCache.h"
 #include "Core/OutputCodeGenerator.h"
 #include "Core/Upload/ScriptUploadEngine.h"
 #include "Core/ServiceLocator.h"
@@ -44,10 +55,18 @@
 #include "Core/Logging.h"
 #include "Core/Logging/MyLogSink.h"
 #include "Core/Logging/ConsoleLogger.h"
+#include "Core/Logging/TraceRecorder.h"
+#include "Core/Logging/StartupProfiler.h"
+#include "Core/Metrics/MetricsRegistry.h"
+#include "Core/Metrics/MetricsServer.h"
 #include "Core/i18n/Translator.h"
 #include "ConsoleScriptDialogProvider.h"
+#include "UploadDaemon.h"
 #include "Core/Utils/ConsoleUtils.h"
+#include "Core/Utils/AsyncOutputWriter.h"
+#include "Core/Utils/FolderWatcher.h"
 #include "Core/Scripting/ScriptsManager.h"
+#include "Core/TaskDispatcher.h"
 
 #ifdef _WIN32
     #include <windows.h>
@@ -63,6 +82,7 @@
 #else
     #include <sys/stat.h>
     #include <sys/time.h>
+    #include "Core/Upload/Filters/ImageConverterFilter.h"
 #endif
 #include "versioninfo.h"
 
@@ -87,6 +107,32 @@ std::string proxyUser;
 std::string proxyPassword;
 
 bool useSystemProxy = false;
+bool useJournal = false;
+bool resumeUploads = false;
+bool useTokenCache = true;
+std::string traceFileName;
+bool startupProfile = false;
+std::string metricsFileName;
+int metricsPort = -1;
+int threadCount = 1;
+#ifndef _WIN32
+// Images are processed before upload with --resize, --image-format and --thumb options
+std::string resizeWidth, resizeHeight;
+int imageFormat = 0; // value of ImageConvertingParams::Format, 0 - keep format
+int imageQuality = 85;
+int thumbWidth = 0;
+#endif
+bool batchMode = false;
+std::string filesFromFileName; // "-" means standard input
+std::string watchDirectory;
+volatile std::sig_atomic_t stopWatching = 0;
+
+const int kDefaultDaemonPort = 17384;
+bool daemonMode = false;
+bool remoteMode = false;
+int daemonPort = kDefaultDaemonPort;
+bool jsonOutput = false;
+std::unique_ptr<AsyncOutputWriter> jsonWriter;
 
 std::unique_ptr<CUploadEngineList> list;
 
@@ -97,7 +143,15 @@ std::shared_ptr<UploadSession> session;
 
 std::mutex finishSignalMutex;
 std::condition_variable finishSignal;
-bool finished = false;
+int pendingSessions = 0;
+
+// Batch mode: each file is uploaded in its own session, which is removed as soon as its result is printed.
+// Number of queued and running files is limited, so the file list is never loaded into memory entirely.
+std::mutex batchMutex;
+std::condition_variable batchSignal;
+int batchLiveTasks = 0;
+int batchFinishedCount = 0;
+int batchFailedCount = 0;
 
 struct TaskUserData {
     int index;
@@ -138,8 +192,6 @@ Translator translator; // dummy translator
 void DoUpdates(bool force = false);
 #endif
 
-int64_t lastProgressTime = 0;
-
 void PrintUsage(bool help = false) {
    std::cerr<<"USAGE:  "<<"imgupload [OPTIONS] filename1 filename2 ..."<<std::endl;
    if ( !help ) {
@@ -166,6 +218,35 @@ void PrintHelp() {
    std::cerr<<" -pt <http|socks4|socks4a|socks5|socks5dns> Proxy type  (default http)"<<std::endl;
    std::cerr<<" -pu <username> Proxy username"<<std::endl;
    std::cerr<<" -pp <password> Proxy password"<<std::endl;
+   std::cerr<<" -t, --threads <count> Number of parallel uploads (default 1)"<<std::endl;
+   std::cerr<<" --batch Print result of each file as soon as it is uploaded\r\n"
+       << "     (directories are uploaded recursively in batch mode)"<<std::endl;
+   std::cerr<<" --files-from <file> Read NUL-delimited list of files, e.g. produced by 'find -print0'\r\n"
+       << "     ('-' means standard input). Implies --batch"<<std::endl;
+   std::cerr<<" --daemon Keep running and accept upload jobs at http://127.0.0.1:<port>/upload"<<std::endl;
+   std::cerr<<" --remote Send files to the running daemon instead of uploading them in this process"<<std::endl;
+   std::cerr<<"          (authorized by the token which the daemon writes to its settings directory)"<<std::endl;
+   std::cerr<<" --daemon-port <port> Port of the daemon (default "<<kDefaultDaemonPort<<")"<<std::endl;
+   std::cerr<<" --output <text|jsonl> Output format (default text). 'jsonl' writes one JSON event per line to stdout:\r\n"
+       << "     task status changes, progress samples and final results"<<std::endl;
+   std::cerr<<" --watch <directory> Upload files as soon as they are written to the directory,\r\n"
+       << "     until interrupted with Ctrl+C. Implies --batch"<<std::endl;
+   std::cerr<<" --journal Record upload queue in journal, so it can be resumed after crash"<<std::endl;
+   std::cerr<<" --resume Resume unfinished uploads from the journal (implies --journal)"<<std::endl;
+   std::cerr<<" --no-token-cache Log in to servers again instead of reusing sessions saved by previous runs"<<std::endl;
+   std::cerr<<" --trace <file> Write timeline of the upload in Chrome trace format (chrome://tracing)"<<std::endl;
+   std::cerr<<" --profile-scripts <directory> Write time profiles of upload scripts to the directory"<<std::endl
+       << "     in collapsed stack format (can be rendered with flamegraph.pl)"<<std::endl;
+   std::cerr<<" --metrics-file <file> Periodically write metrics in Prometheus text format to the file"<<std::endl;
+   std::cerr<<" --metrics-port <port> Serve metrics at http://127.0.0.1:<port>/metrics"<<std::endl;
+   std::cerr<<" --startup-profile Print durations of startup phases"<<std::endl;
+#ifndef _WIN32
+   std::cerr<<" --resize <width>x<height> Reduce images to fit into the size before upload,\r\n"
+       << "     one of the sides may be omitted, sizes may be in percents (e.g. 50%x50%)"<<std::endl;
+   std::cerr<<" --image-format <jpeg|png|webp> Convert images to the format before upload"<<std::endl;
+   std::cerr<<" --quality <0-100> Quality of JPEG and WebP images and thumbnails (default 85)"<<std::endl;
+   std::cerr<<" --thumb <width> Create thumbnails of the width and upload them with images"<<std::endl;
+#endif
 #ifdef _WIN32
     std::cerr << " -ps Use system proxy settings (this option supported only on Windows)" << std::endl;
     //std::cerr<<" --disable-update Disable auto-updating servers.xml"<<std::endl;
@@ -203,6 +284,204 @@ bool parseCommandLine(int argc, char *argv[])
             i++;
             continue;
         }
+        else if(!IuStringUtils::stricmp(opt, "-t") || !IuStringUtils::stricmp(opt, "--threads"))
+        {
+            if(i+1 == argc)
+                return false;
+            threadCount = atoi(argv[++i]);
+            if (threadCount < 1) {
+                std::cerr << "Invalid number of threads" << std::endl;
+                return false;
+            }
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--batch"))
+        {
+            batchMode = true;
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--files-from"))
+        {
+            if(i+1 == argc)
+                return false;
+            filesFromFileName =
+#ifndef _WIN32
+                IuCoreUtils::SystemLocaleToUtf8(argv[++i]);
+#else
+                argv[++i];
+#endif
+            batchMode = true;
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--output"))
+        {
+            if(i+1 == argc)
+                return false;
+            char* format = argv[++i];
+            if (!IuStringUtils::stricmp(format, "jsonl")) {
+                jsonOutput = true;
+            } else if (!IuStringUtils::stricmp(format, "text")) {
+                jsonOutput = false;
+            } else {
+                std::cerr << "Invalid output format" << std::endl;
+                return false;
+            }
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--watch"))
+        {
+            if(i+1 == argc)
+                return false;
+            watchDirectory =
+#ifndef _WIN32
+                IuCoreUtils::SystemLocaleToUtf8(argv[++i]);
+#else
+                argv[++i];
+#endif
+            if (!IuCoreUtils::DirectoryExists(watchDirectory)) {
+                ConsoleUtils::instance()->PrintUnicode(stderr, str(boost::format("Directory '%s' doesn't exist!\n") % watchDirectory));
+                return false;
+            }
+            batchMode = true;
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--daemon"))
+        {
+            daemonMode = true;
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--remote"))
+        {
+            remoteMode = true;
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--daemon-port"))
+        {
+            if(i+1 == argc)
+                return false;
+            daemonPort = atoi(argv[++i]);
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--journal"))
+        {
+            useJournal = true;
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--resume"))
+        {
+            useJournal = true;
+            resumeUploads = true;
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--no-token-cache"))
+        {
+            useTokenCache = false;
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--trace"))
+        {
+            if(i+1 == argc)
+                return false;
+            traceFileName = argv[++i];
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--profile-scripts"))
+        {
+            if(i+1 == argc)
+                return false;
+            Settings.ScriptProfilingFolder = argv[++i];
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--metrics-file"))
+        {
+            if(i+1 == argc)
+                return false;
+            metricsFileName = argv[++i];
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--startup-profile"))
+        {
+            startupProfile = true;
+            i++;
+            continue;
+        }
+#ifndef _WIN32
+        else if(!IuStringUtils::stricmp(opt, "--resize"))
+        {
+            if(i+1 == argc)
+                return false;
+            std::string size = argv[++i];
+            size_t pos = size.find_first_of("xX");
+            resizeWidth = size.substr(0, pos);
+            resizeHeight = pos == std::string::npos ? std::string() : size.substr(pos + 1);
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--image-format"))
+        {
+            if(i+1 == argc)
+                return false;
+            const char* format = argv[++i];
+            // Formats are numbered as ImageUtils::SaveImageFormat plus one
+            if (!IuStringUtils::stricmp(format, "jpeg") || !IuStringUtils::stricmp(format, "jpg")) {
+                imageFormat = 1;
+            } else if (!IuStringUtils::stricmp(format, "png")) {
+                imageFormat = 2;
+            } else if (!IuStringUtils::stricmp(format, "webp")) {
+                imageFormat = 4;
+            } else {
+                std::cerr << "Unsupported image format '" << format << "'" << std::endl;
+                return false;
+            }
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--quality"))
+        {
+            if(i+1 == argc)
+                return false;
+            const char* quality = argv[++i];
+            char* end = nullptr;
+            long value = strtol(quality, &end, 10);
+            if (end == quality || *end || value < 0 || value > 100) {
+                std::cerr << "Invalid image quality '" << quality << "', expected a number from 0 to 100" << std::endl;
+                return false;
+            }
+            imageQuality = static_cast<int>(value);
+            i++;
+            continue;
+        }
+        else if(!IuStringUtils::stricmp(opt, "--thumb"))
+        {
+            if(i+1 == argc)
+                return false;
+            thumbWidth = atoi(argv[++i]);
+            i++;
+            continue;
+        }
+#endif
+        else if(!IuStringUtils::stricmp(opt, "--metrics-port"))
+        {
+            if(i+1 == argc)
+                return false;
+            metricsPort = atoi(argv[++i]);
+            i++;
+            continue;
+        }
         else if(!IuStringUtils::stricmp(opt, "-s"))
         {
             if(i+1 == argc)
@@ -357,6 +636,9 @@ bool parseCommandLine(int argc, char *argv[])
             ConsoleUtils::instance()->PrintUnicode(stderr, errorMessage);
             return false;
         }
+        if (IuCoreUtils::DirectoryExists(fileName)) {
+            batchMode = true;
+        }
         filesToUpload.push_back(fileName);
         i++;
     }
@@ -365,7 +647,7 @@ bool parseCommandLine(int argc, char *argv[])
 }
 
 CUploadEngineData* getServerByName(const std::string& name) {
-    CUploadEngineData* uploadEngineData = list->byName(serverName);
+    CUploadEngineData* uploadEngineData = list->byName(name);
     if(!uploadEngineData) {
         for(int i=0; i<list->count(); i++)
         {
@@ -376,7 +658,7 @@ CUploadEngineData* getServerByName(const std::string& name) {
     return uploadEngineData;
 }
 
-void OnUploadSessionFinished(UploadSession* session) {
+std::vector<UploadObject> collectUploadedObjects(UploadSession* session) {
     int taskCount = session->taskCount();
     std::vector<UploadObject> uploadedList;
     for (int i = 0; i < taskCount; i++) {
@@ -397,11 +679,142 @@ void OnUploadSessionFinished(UploadSession* session) {
             uploadedList.push_back(uo);
         }
     }
+    return uploadedList;
+}
+
+// JSON lines output (--output jsonl). Events are passed to AsyncOutputWriter,
+// so upload threads never wait for stdout.
+
+struct TaskTimes {
+    int64_t queued = 0;
+    int64_t started = 0;
+};
+
+std::mutex taskTimesMutex;
+std::map<UploadTask*, TaskTimes> taskTimes;
+
+int64_t currentTimeMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void EmitJsonEvent(const Json::Value& event, bool droppable = false) {
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    jsonWriter->write(Json::writeString(builder, event) + "\n", droppable);
+}
+
+const char* TaskStatusToString(UploadTask::Status status) {
+    switch (status) {
+        case UploadTask::StatusInQueue:
+            return "queued";
+        case UploadTask::StatusRunning:
+            return "running";
+        case UploadTask::StatusStopped:
+            return "stopped";
+        case UploadTask::StatusFinished:
+            return "finished";
+        case UploadTask::StatusFailure:
+            return "failed";
+        case UploadTask::StatusPostponed:
+            return "postponed";
+        case UploadTask::StatusWaitingChildren:
+            return "waiting_children";
+    }
+    return "";
+}
+
+Json::Value TaskJsonEvent(const char* name, UploadTask* task) {
+    Json::Value event;
+    event["event"] = name;
+    auto* fileTask = dynamic_cast<FileUploadTask*>(task);
+    event["file"] = fileTask ? fileTask->getFileName() : task->title();
+    event["server"] = task->serverName();
+    return event;
+}
+
+/**
+ * Writes upload errors as JSON events (and to stderr), remembers the last error of each file for its result
+ */
+class JsonUploadErrorHandler : public ConsoleUploadErrorHandler {
+public:
+    void ErrorMessage(const ErrorInfo& errorInfo) override {
+        ConsoleUploadErrorHandler::ErrorMessage(errorInfo);
+        std::string message = errorInfo.error;
+        if (message.empty()) {
+            message = errorInfo.errorType == etRetriesLimitReached ? "Upload failed! (retry limit reached)" : "Upload failed";
+        }
+        Json::Value event;
+        event["event"] = errorInfo.messageType == ErrorInfo::mtWarning ? "warning" : "error";
+        event["file"] = errorInfo.TopLevelFileName;
+        event["server"] = errorInfo.ServerName;
+        event["error"] = message;
+        if (errorInfo.RetryIndex != -1) {
+            event["retry"] = errorInfo.RetryIndex;
+        }
+        EmitJsonEvent(event);
+        if (errorInfo.messageType == ErrorInfo::mtError && !errorInfo.TopLevelFileName.empty()) {
+            std::lock_guard<std::mutex> lk(mutex_);
+            lastErrors_[errorInfo.TopLevelFileName] = message;
+        }
+    }
+
+    std::string takeLastError(const std::string& fileName) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        auto it = lastErrors_.find(fileName);
+        if (it == lastErrors_.end()) {
+            return std::string();
+        }
+        std::string result = it->second;
+        lastErrors_.erase(it);
+        return result;
+    }
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::string> lastErrors_;
+};
+
+std::shared_ptr<JsonUploadErrorHandler> jsonErrorHandler;
+
+void OnJsonTaskFinished(UploadTask* task, bool success) {
+    if (task->parentTask()) {
+        return;
+    }
+    Json::Value event = TaskJsonEvent("result", task);
+    event["success"] = success;
+    if (success) {
+        UploadResult* result = task->uploadResult();
+        event["directUrl"] = result->directUrl;
+        event["thumbUrl"] = result->thumbUrl;
+        event["viewUrl"] = result->downloadUrl;
+        event["size"] = Json::Int64(task->getDataLength());
+    }
+    std::string error = jsonErrorHandler ? jsonErrorHandler->takeLastError(event["file"].asString()) : std::string();
+    if (!success) {
+        event["error"] = error;
+    }
+    int64_t now = currentTimeMs();
+    {
+        std::lock_guard<std::mutex> lk(taskTimesMutex);
+        auto it = taskTimes.find(task);
+        if (it != taskTimes.end()) {
+            if (it->second.started) {
+                event["queueMs"] = Json::Int64(it->second.started - it->second.queued);
+                event["uploadMs"] = Json::Int64(now - it->second.started);
+            }
+            taskTimes.erase(it);
+        }
+    }
+    EmitJsonEvent(event);
+}
+
+void OnUploadSessionFinished(UploadSession* session) {
+    std::vector<UploadObject> uploadedList = collectUploadedObjects(session);
     OutputCodeGenerator generator;
     generator.setLang(codeLang);
     generator.setType(codeType);
     //ConsoleUtils::instance()->SetCursorPos(0, taskCount + 2);
-    if ( !uploadedList.empty() ) {
+    // In JSON mode results have been written as each task finished
+    if ( !uploadedList.empty() && !jsonOutput ) {
         std::cerr<<std::endl<<"Result:"<<std::endl;
         std::cout<<generator.generate(uploadedList);
         std::cerr<<std::endl;
@@ -409,32 +822,30 @@ void OnUploadSessionFinished(UploadSession* session) {
     {
         // LOG(ERROR) << "Sending finish signal" << std::endl;
         std::lock_guard<std::mutex> lk(finishSignalMutex);
-        finished = true;
+        pendingSessions--;
     }
 
     finishSignal.notify_one();
 }
 
-void UploadTaskProgress(UploadTask* task) {
-    std::lock_guard<std::mutex> guard(ConsoleUtils::instance()->getOutputMutex());
-    UploadProgress* progress = task->progress();
-    auto* userData = static_cast<TaskUserData*>(task->userData());
-
-    timeval tp;
-    gettimeofday(&tp, NULL);
-    int64_t ms = tp.tv_sec * 1000 + tp.tv_usec / 1000;
-
-    if ( progress->totalUpload != progress->uploaded && ms - lastProgressTime < 500 ) { // Windows console output is too slow
+void UploadTaskProgress(const TaskProgressSnapshot& progress) {
+    if (jsonOutput) {
+        Json::Value event = TaskJsonEvent("progress", progress.task);
+        event["uploaded"] = Json::Int64(progress.uploaded);
+        event["total"] = Json::Int64(progress.total);
+        event["bytesPerSecond"] = Json::Int64(progress.bytesPerSecond);
+        EmitJsonEvent(event, true);
         return;
     }
-    lastProgressTime = ms;
+    std::lock_guard<std::mutex> guard(ConsoleUtils::instance()->getOutputMutex());
+
     int totaldotz=30;
-    if (progress->totalUpload == 0) {
+    if (progress.total == 0) {
         return;
     }
 
     //ConsoleUtils::instance()->SetCursorPos(0, 2 + userData->index);
-    double fractiondownloaded = static_cast<double>(progress->uploaded) / progress->totalUpload;
+    double fractiondownloaded = static_cast<double>(progress.uploaded) / progress.total;
     if(fractiondownloaded > 100)
         fractiondownloaded = 0;
     // part of the progressmeter that's already "full"
@@ -453,13 +864,58 @@ void UploadTaskProgress(UploadTask* task) {
     }
     // and back to line begin - do not forget the fflush to avoid output buffering problems!
     fprintf(stderr,"]");
-    fprintf(stderr," %s/%s", IuCoreUtils::FileSizeToString(progress->uploaded).c_str(),
-            IuCoreUtils::FileSizeToString(progress->totalUpload).c_str());
+    fprintf(stderr," %s/%s", IuCoreUtils::FileSizeToString(progress.uploaded).c_str(),
+            IuCoreUtils::FileSizeToString(progress.total).c_str());
     fprintf(stderr,"\r");
     fflush(stderr);
 }
 
+// Tasks whose progress is shown, child tasks (thumbnails, url shortening) are not added
+std::mutex progressTasksMutex;
+std::set<UploadTask*> progressTasks;
+
+/**
+ * Receives progress of all tasks changed since the previous sampler pass
+ */
+void OnUploadProgress(const UploadProgressBatch& batch) {
+    for (const auto& progress : batch.tasks) {
+        {
+            std::lock_guard<std::mutex> lk(progressTasksMutex);
+            if (!progressTasks.count(progress.task)) {
+                continue;
+            }
+        }
+        UploadTaskProgress(progress);
+    }
+}
+
+void ShowTaskProgress(UploadTask* task) {
+    {
+        std::lock_guard<std::mutex> lk(progressTasksMutex);
+        progressTasks.insert(task);
+    }
+    task->onTaskFinished.connect([](UploadTask* t, bool) {
+        std::lock_guard<std::mutex> lk(progressTasksMutex);
+        progressTasks.erase(t);
+    });
+}
+
 void OnUploadTaskStatusChanged(UploadTask* task) {
+    if (jsonOutput) {
+        UploadTask::Status status = task->status();
+        if (status == UploadTask::StatusRunning) {
+            std::lock_guard<std::mutex> lk(taskTimesMutex);
+            auto it = taskTimes.find(task);
+            if (it != taskTimes.end() && !it->second.started) {
+                it->second.started = currentTimeMs();
+            }
+        }
+        Json::Value event = TaskJsonEvent("status", task);
+        event["status"] = TaskStatusToString(status);
+        event["text"] = task->progress()->statusText;
+        EmitJsonEvent(event);
+        return;
+    }
     std::lock_guard<std::mutex> guard(ConsoleUtils::instance()->getOutputMutex());
     UploadProgress* progress = task->progress();
     auto* userData = static_cast<TaskUserData*>(task->userData());
@@ -468,21 +924,73 @@ void OnUploadTaskStatusChanged(UploadTask* task) {
     fprintf(stderr, "\r");
 }
 
+/**
+ * Subscribes task to JSON events
+ */
+void TrackJsonTask(UploadTask* task) {
+    {
+        std::lock_guard<std::mutex> lk(taskTimesMutex);
+        taskTimes[task].queued = currentTimeMs();
+    }
+    ShowTaskProgress(task);
+    task->setOnStatusChangedCallback(OnUploadTaskStatusChanged);
+    task->onTaskFinished.connect(OnJsonTaskFinished);
+}
+
 void OnQueueFinished(CFileQueueUploader*) {
     {
         // LOG(ERROR) << "Sending finish signal" << std::endl;
         std::lock_guard<std::mutex> lk(finishSignalMutex);
-        finished = true;
+        pendingSessions = 0;
     }
 
     finishSignal.notify_one();
 }
+
+void OnSessionRestored(UploadSession* restoredSession) {
+    int taskCount = restoredSession->taskCount();
+    for (int i = 0; i < taskCount; i++) {
+        auto task = restoredSession->getTask(i);
+        ShowTaskProgress(task.get());
+        task->setOnStatusChangedCallback(OnUploadTaskStatusChanged);
+        if (jsonOutput) {
+            TrackJsonTask(task.get());
+        }
+    }
+    restoredSession->addSessionFinishedCallback(UploadSession::SessionFinishedCallback(OnUploadSessionFinished));
+    std::cerr << "Resuming " << taskCount << " unfinished upload(s)" << std::endl;
+    std::lock_guard<std::mutex> lk(finishSignalMutex);
+    pendingSessions++;
+}
+
+int addFilesSession(UploadManager* uploadManager);
+int runBatch(UploadManager* uploadManager);
+#ifndef _WIN32
+bool imageProcessingEnabled() {
+    return !resizeWidth.empty() || !resizeHeight.empty() || imageFormat > 0;
+}
+#endif
+bool resolveServerProfile(const UploadDaemonJobOptions& options, ServerProfile& serverProfile, std::string& error);
+
+/**
+ * File with the access token of the daemon listening on daemonPort, shared by the daemon and --remote clients
+ */
+std::string daemonTokenFileName() {
+    return AppParams::instance()->settingsDirectory() + "daemon_" + std::to_string(daemonPort) + ".token";
+}
+
 int func() {
 #ifdef _WIN32
     GdiPlusInitializer gdiPlusInitializer;
 #endif
 	int res = 0;
-    auto uploadErrorHandler = std::make_shared<ConsoleUploadErrorHandler>();
+    std::shared_ptr<ConsoleUploadErrorHandler> uploadErrorHandler;
+    if (jsonOutput) {
+        jsonErrorHandler = std::make_shared<JsonUploadErrorHandler>();
+        uploadErrorHandler = jsonErrorHandler;
+    } else {
+        uploadErrorHandler = std::make_shared<ConsoleUploadErrorHandler>();
+    }
     ServiceLocator* serviceLocator = ServiceLocator::instance();
     serviceLocator->setUploadErrorHandler(uploadErrorHandler);
     serviceLocator->setNetworkClientFactory(std::make_shared<NetworkClientFactory>());
@@ -494,12 +1002,25 @@ int func() {
     Settings.setEngineList(list.get());
     ServiceLocator::instance()->setEngineList(list.get());
     auto networkClientFactory = std::make_shared<NetworkClientFactory>();
+    // Scripts are loaded on first use
     auto scriptsManager = std::make_unique<ScriptsManager>(networkClientFactory);
     std::unique_ptr<UploadEngineManager> uploadEngineManager;
-    uploadEngineManager = std::make_unique<UploadEngineManager>(list.get(), uploadErrorHandler, networkClientFactory);
-    std::string scriptsDirectory = AppParams::instance()->dataDirectory() + "/Scripts/";
-    uploadEngineManager->setScriptsDirectory(scriptsDirectory);
-    std::shared_ptr<UploadManager> uploadManager = std::make_shared<UploadManager>(uploadEngineManager.get(), list.get(), scriptsManager.get(), uploadErrorHandler, networkClientFactory, 1);
+#ifndef _WIN32
+    ImageConverterFilter imageConverterFilter;
+#endif
+    std::shared_ptr<UploadManager> uploadManager;
+    {
+        StartupPhase phase("Create upload manager");
+        uploadEngineManager = std::make_unique<UploadEngineManager>(list.get(), uploadErrorHandler, networkClientFactory);
+        std::string scriptsDirectory = AppParams::instance()->dataDirectory() + "/Scripts/";
+        uploadEngineManager->setScriptsDirectory(scriptsDirectory);
+        if (useTokenCache) {
+            std::string settingsDirectory = AppParams::instance()->settingsDirectory();
+            uploadEngineManager->setAuthTokenCache(std::make_shared<AuthTokenCache>(settingsDirectory + "AuthTokens.dat",
+                settingsDirectory + "AuthTokens.key"));
+        }
+        uploadManager = std::make_shared<UploadManager>(uploadEngineManager.get(), list.get(), scriptsManager.get(), uploadErrorHandler, networkClientFactory, threadCount);
+    }
 
 
     if (useSystemProxy) {
@@ -516,40 +1037,193 @@ int func() {
         }
     }
 
+#ifndef _WIN32
+    if (imageProcessingEnabled() || thumbWidth > 0) {
+        ImageConvertingParams params;
+        params.strNewWidth = resizeWidth;
+        params.strNewHeight = resizeHeight;
+        params.Format = imageFormat;
+        params.Quality = imageQuality;
+        params.ResizeMode = ImageConvertingParams::irmFit;
+        imageConverterFilter.setImageConvertingParams(params);
+        uploadManager->addUploadFilter(&imageConverterFilter);
+    }
+#endif
+    uploadManager->setOnQueueFinishedCallback(OnQueueFinished);
+    uploadManager->setProgressUpdateInterval(500); // Windows console output is too slow
+    if (!daemonMode) {
+        // Jobs of the daemon report progress to their own clients
+        uploadManager->progressSampler()->onProgress.connect(OnUploadProgress);
+    }
+
+    std::shared_ptr<UploadJournal> journal;
+    if (useJournal) {
+        StartupPhase phase("Open upload journal");
+        journal = std::make_shared<UploadJournal>(AppParams::instance()->settingsDirectory() + "upload_journal.db");
+        if (journal->open()) {
+            uploadManager->setJournal(journal);
+            if (resumeUploads) {
+                uploadManager->restoreSessionsFromJournal(OnSessionRestored);
+            }
+        } else {
+            std::cerr << "Cannot open upload journal" << std::endl;
+            journal.reset();
+        }
+    }
+
+    MetricsServer metricsServer;
+    if (metricsPort >= 0) {
+        unsigned short port = metricsServer.start("127.0.0.1", static_cast<unsigned short>(metricsPort));
+        if (port) {
+            std::cerr << "Metrics are available at http://127.0.0.1:" << port << "/metrics" << std::endl;
+        }
+    }
+
+    if (startupProfile) {
+        std::cerr << StartupProfiler::instance()->report();
+    }
+
+    if (daemonMode) {
+        UploadDaemon daemon(uploadManager.get(), resolveServerProfile);
+        std::string tokenFileName = daemonTokenFileName();
+        std::string token = UploadDaemon::createAccessTokenFile(tokenFileName);
+        if (token.empty()) {
+            std::cerr << "Cannot write daemon access token to '" << tokenFileName << "'" << std::endl;
+            return -1;
+        }
+        daemon.setAccessToken(token);
+        unsigned short port = daemon.start("127.0.0.1", static_cast<unsigned short>(daemonPort));
+        if (!port) {
+            std::cerr << "Cannot start daemon on port " << daemonPort << std::endl;
+            return -1;
+        }
+        std::cerr << "Daemon is listening at http://127.0.0.1:" << port << "/upload" << std::endl;
+        daemon.waitForShutdown();
+        daemon.stop();
+        IuCoreUtils::RemoveFile(tokenFileName);
+    } else if (batchMode) {
+        res = runBatch(uploadManager.get());
+        if (res < 0) {
+            return res;
+        }
+    } else if (!filesToUpload.empty()) {
+        res = addFilesSession(uploadManager.get());
+        if (res < 0) {
+            return res;
+        }
+    }
+
+    // Wait until all upload sessions are finished
+    {
+        std::unique_lock<std::mutex> lk(finishSignalMutex);
+        while (pendingSessions > 0) {
+            if (finishSignal.wait_for(lk, std::chrono::seconds(10)) == std::cv_status::timeout && !metricsFileName.empty()) {
+                MetricsRegistry::instance()->writeToFile(metricsFileName);
+            }
+        }
+    }
+    if (!metricsFileName.empty() && !MetricsRegistry::instance()->writeToFile(metricsFileName)) {
+        std::cerr << "Cannot write metrics file '" << metricsFileName << "'" << std::endl;
+    }
+
+    if (journal) {
+        journal->removeFinishedSessions();
+        journal->close();
+    }
+    return res;
+}
+
+/**
+ * Fills server profile for the upload. Returns false and error message if the server cannot be used.
+ */
+bool resolveServerProfile(const UploadDaemonJobOptions& options, ServerProfile& serverProfile, std::string& error) {
     CUploadEngineData* uploadEngineData = nullptr;
-    if(!serverName.empty()) {
-        uploadEngineData = getServerByName(serverName);
+    if(!options.serverName.empty()) {
+        uploadEngineData = getServerByName(options.serverName);
         if(!uploadEngineData) {
-            std::cerr<<"No such server '"<<serverName<<"'!"<<std::endl;
-            return 0;
+            error = "No such server '" + options.serverName + "'!";
+            return false;
         }
     } else {
-        std::cerr << "Server not set " << std::endl;
-        return -1;
+        error = "Server not set";
+        return false;
         //int index = list.getRandomImageServer();
         //uploadEngineData = list.byIndex(index);
     }
 
-    if (uploadEngineData->NeedAuthorization == CUploadEngineData::naObligatory && login.empty())
+    if (uploadEngineData->NeedAuthorization == CUploadEngineData::naObligatory && options.login.empty())
 	{
-		std::cerr<<"Server '"<<uploadEngineData->Name<<"' requires authentication! Use -u and -p options."<<std::endl;
-		return -1;
+		error = "Server '" + uploadEngineData->Name + "' requires authentication! Use -u and -p options.";
+		return false;
 	}
 
-    ServerProfile serverProfile(uploadEngineData->Name);
-    serverProfile.setProfileName(login);
+    serverProfile = ServerProfile(uploadEngineData->Name);
+    serverProfile.setProfileName(options.login);
     serverProfile.setShortenLinks(false);
 
-    ServerSettingsStruct& s = Settings.ServersSettings[uploadEngineData->Name][login];
+    // Daemon resolves jobs while other jobs are uploading, so the shared account is looked up
+    // under the settings lock. Settings are keyed by server and login, so once a job has set the password,
+    // a job with another password would change it under the running uploads and is rejected.
+    // The folder belongs to the job and is kept in its profile only.
+    static std::mutex accountsMutex;
+    static std::set<std::pair<std::string, std::string>> accountsInUse;
+    ServerSettingsStruct* s = Settings.getServerSettings(serverProfile, true);
+    {
+        std::lock_guard<std::mutex> lock(*s->paramsMutex_);
+        std::lock_guard<std::mutex> accountsLock(accountsMutex);
+        auto account = std::make_pair(uploadEngineData->Name, options.login);
+        if (s->authData.Login != options.login || s->authData.Password != options.password) {
+            if (accountsInUse.count(account)) {
+                error = "Account '" + options.login + "' on server '" + uploadEngineData->Name + "' is already used with another password";
+                return false;
+            }
+            s->authData.Login = options.login;
+            s->authData.Password = options.password;
+        }
+        accountsInUse.insert(account);
+        if (!options.login.empty() && !s->authData.DoAuth) {
+            s->authData.DoAuth = true;
+        }
+    }
+    serverProfile.setFolderId(options.folderId);
+#ifndef _WIN32
+    ImageUploadParams& imageUploadParams = serverProfile.getImageUploadParamsRef();
+    imageUploadParams.ProcessImages = imageProcessingEnabled();
+    imageUploadParams.CreateThumbs = thumbWidth > 0;
+    imageUploadParams.UseServerThumbs = false;
+    ThumbCreatingParams& thumb = imageUploadParams.getThumbRef();
+    thumb.Width = thumbWidth;
+    thumb.ResizeMode = ThumbCreatingParams::trByWidth;
+    thumb.Format = ThumbCreatingParams::tfSameAsImageFormat;
+    thumb.Quality = imageQuality;
+#endif
+    return true;
+}
 
-    s.authData.Password = password;
-    s.authData.Login = login;
-    if(!login.empty()) {
-        s.authData.DoAuth = true;
+/**
+ * Fills server profile from the command line options. Returns false (and exit code in res) on error.
+ */
+bool prepareServerProfile(ServerProfile& serverProfile, int& res) {
+    UploadDaemonJobOptions options;
+    options.serverName = serverName;
+    options.login = login;
+    options.password = password;
+    options.folderId = folderId;
+    std::string error;
+    if (!resolveServerProfile(options, serverProfile, error)) {
+        std::cerr << error << std::endl;
+        res = (serverName.empty() || getServerByName(serverName)) ? -1 : 0;
+        return false;
     }
+    return true;
+}
 
-    s.setParam("FolderID", folderId);
-    serverProfile.setFolderId(folderId);
+int addFilesSession(UploadManager* uploadManager) {
+    int res = 0;
+    ServerProfile serverProfile;
+    if (!prepareServerProfile(serverProfile, res)) {
+        return res;
+    }
 
     session = std::make_shared<UploadSession>(false);
     for(size_t i=0; i<filesToUpload.size(); i++) {
@@ -563,27 +1237,380 @@ int func() {
 
         std::shared_ptr<FileUploadTask> task = std::make_shared<FileUploadTask>(filesToUpload[i], IuCoreUtils::ExtractFileName(filesToUpload[i]));
         task->setServerProfile(serverProfile);
-        task->setOnUploadProgressCallback(UploadTaskProgress);
+        ShowTaskProgress(task.get());
         task->setOnStatusChangedCallback(OnUploadTaskStatusChanged);
         TaskUserData *userData = new TaskUserData;
         userData->index = i;
         task->setUserData(userData);
         userDataArray.emplace_back(userData);
+        if (jsonOutput) {
+            TrackJsonTask(task.get());
+        }
         session->addTask(task);
     }
     session->addSessionFinishedCallback(UploadSession::SessionFinishedCallback(OnUploadSessionFinished));
     //ConsoleUtils::instance()->InitScreen();
     //ConsoleUtils::instance()->Clear();
     //PrintWelcomeMessage();
-    uploadManager->setOnQueueFinishedCallback(OnQueueFinished);
+    {
+        std::lock_guard<std::mutex> lk(finishSignalMutex);
+        pendingSessions++;
+    }
     uploadManager->addSession(session);
+    return res;
+}
+
+void OnBatchSessionFinished(UploadManager* uploadManager, UploadSession* fileSession) {
+    std::vector<UploadObject> uploadedList = collectUploadedObjects(fileSession);
+    bool success = !uploadedList.empty();
+    // In JSON mode the result has been written when the task finished
+    if (!jsonOutput) {
+        std::lock_guard<std::mutex> guard(ConsoleUtils::instance()->getOutputMutex());
+        if (success) {
+            OutputCodeGenerator generator;
+            generator.setLang(codeLang);
+            generator.setType(codeType);
+            std::cout << generator.generate(uploadedList) << std::endl;
+        } else if (fileSession->taskCount()) {
+            auto* fileTask = dynamic_cast<FileUploadTask*>(fileSession->getTask(0).get());
+            if (fileTask) {
+                ConsoleUtils::instance()->PrintUnicode(stderr, str(boost::format("Failed to upload '%s'\n") % fileTask->getFileName()));
+            }
+        }
+    }
 
-    // Wait until upload session is finished
-    std::unique_lock<std::mutex> lk(finishSignalMutex);
-    while (!finished) {
-        finishSignal.wait(lk/*, [] {return finished;}*/);
+    // Result has been written, the session is not needed anymore.
+    // Upload thread keeps a reference to the session until it finishes processing the task.
+    uploadManager->removeSession(fileSession->shared_from_this());
+    {
+        std::lock_guard<std::mutex> lk(batchMutex);
+        batchLiveTasks--;
+        batchFinishedCount++;
+        if (!success) {
+            batchFailedCount++;
+        }
     }
-	return res;	
+    batchSignal.notify_all();
+}
+
+/**
+ * Calls callback for each regular file in the directory and its subdirectories, as soon as it is found
+ */
+void enumerateDirectory(const std::string& directory, const std::function<void(const std::string&)>& callback) {
+    namespace fs = boost::filesystem;
+    boost::system::error_code ec;
+#ifdef _WIN32
+    fs::path root(IuCoreUtils::Utf8ToWstring(directory));
+#else
+    fs::path root(directory);
+#endif
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+        boost::system::error_code statusError;
+        if (!fs::is_regular_file(it->status(statusError))) {
+            continue;
+        }
+#ifdef _WIN32
+        callback(IuCoreUtils::WstringToUtf8(it->path().wstring()));
+#else
+        callback(it->path().string());
+#endif
+    }
+    if (ec) {
+        ConsoleUtils::instance()->PrintUnicode(stderr, str(boost::format("Cannot read directory '%s': %s\n") % directory % ec.message()));
+    }
+}
+
+/**
+ * Reads NUL-delimited list of file names and calls callback for each of them
+ */
+void readFileList(std::istream& in, const std::function<void(const std::string&)>& callback) {
+    std::string fileName;
+    while (std::getline(in, fileName, '\0')) {
+        if (fileName.empty()) {
+            continue;
+        }
+#ifndef _WIN32
+        fileName = IuCoreUtils::SystemLocaleToUtf8(fileName);
+#endif
+        callback(fileName);
+    }
+}
+
+/**
+ * Adds file to the queue in its own session. Blocks while too many files are queued or being uploaded.
+ */
+bool addBatchFile(UploadManager* uploadManager, const ServerProfile& serverProfile, const std::string& fileName) {
+    if (!IuCoreUtils::FileExists(fileName)) {
+        ConsoleUtils::instance()->PrintUnicode(stderr, str(boost::format("File '%s' doesn't exist!\n") % fileName));
+        return false;
+    }
+    // Enough queued files to keep all threads busy
+    const int maxLiveTasks = std::max(16, threadCount * 4);
+    {
+        std::unique_lock<std::mutex> lk(batchMutex);
+        batchSignal.wait(lk, [&] { return batchLiveTasks < maxLiveTasks; });
+        batchLiveTasks++;
+    }
+    auto fileSession = std::make_shared<UploadSession>(false);
+    auto task = std::make_shared<FileUploadTask>(fileName, IuCoreUtils::ExtractFileName(fileName));
+    task->setServerProfile(serverProfile);
+    if (jsonOutput) {
+        TrackJsonTask(task.get());
+    }
+    fileSession->addTask(task);
+    fileSession->addSessionFinishedCallback([uploadManager](UploadSession* s) {
+        OnBatchSessionFinished(uploadManager, s);
+    });
+    uploadManager->addSession(fileSession);
+    return true;
+}
+
+void WatchSignalHandler(int) {
+    stopWatching = 1;
+    // Second Ctrl+C terminates immediately
+    signal(SIGINT, SIG_DFL);
+}
+
+int runBatch(UploadManager* uploadManager) {
+    int res = 0;
+    ServerProfile serverProfile;
+    if (!prepareServerProfile(serverProfile, res)) {
+        return res;
+    }
+
+    auto addFile = [&](const std::string& fileName) {
+        if (!addBatchFile(uploadManager, serverProfile, fileName)) {
+            res++;
+        }
+    };
+
+    auto addPath = [&](const std::string& path) {
+        if (IuCoreUtils::DirectoryExists(path)) {
+            enumerateDirectory(path, addFile);
+        } else {
+            addFile(path);
+        }
+    };
+
+    for (const auto& path : filesToUpload) {
+        addPath(path);
+    }
+
+    if (filesFromFileName == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        readFileList(std::cin, addPath);
+    } else if (!filesFromFileName.empty()) {
+#ifdef _WIN32
+        std::ifstream in(IuCoreUtils::Utf8ToWstring(filesFromFileName), std::ios::binary);
+#else
+        std::ifstream in(filesFromFileName, std::ios::binary);
+#endif
+        if (in) {
+            readFileList(in, addPath);
+        } else {
+            ConsoleUtils::instance()->PrintUnicode(stderr, str(boost::format("Cannot open file '%s'\n") % filesFromFileName));
+            res++;
+        }
+    }
+
+    if (!watchDirectory.empty()) {
+        FolderWatcher watcher;
+        if (!watcher.start(watchDirectory, addFile)) {
+            ConsoleUtils::instance()->PrintUnicode(stderr, str(boost::format("Cannot watch directory '%s'\n") % watchDirectory));
+            return -1;
+        }
+        signal(SIGINT, WatchSignalHandler);
+        ConsoleUtils::instance()->PrintUnicode(stderr, str(boost::format("Watching directory '%s', press Ctrl+C to stop\n") % watchDirectory));
+        auto lastMetricsWrite = std::chrono::steady_clock::now();
+        while (!stopWatching) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            if (!metricsFileName.empty() && std::chrono::steady_clock::now() - lastMetricsWrite > std::chrono::seconds(10)) {
+                MetricsRegistry::instance()->writeToFile(metricsFileName);
+                lastMetricsWrite = std::chrono::steady_clock::now();
+            }
+        }
+        // Files which are already in the queue are uploaded before exit
+        watcher.stop();
+    }
+
+    std::unique_lock<std::mutex> lk(batchMutex);
+    while (batchLiveTasks > 0) {
+        if (batchSignal.wait_for(lk, std::chrono::seconds(10)) == std::cv_status::timeout && !metricsFileName.empty()) {
+            MetricsRegistry::instance()->writeToFile(metricsFileName);
+        }
+    }
+    std::cerr << "Uploaded " << batchFinishedCount - batchFailedCount << " of " << batchFinishedCount << " file(s)" << std::endl;
+    return res + batchFailedCount;
+}
+
+struct RemoteClientState {
+    std::string buffer;
+    std::vector<UploadObject> uploadedList;
+    int failedCount = 0;
+    bool finished = false;
+    bool rejected = false;
+};
+
+void handleRemoteEvent(const std::string& line, RemoteClientState& state) {
+    Json::Value event;
+    Json::Reader reader;
+    if (!reader.parse(line, event, false) || !event.isObject()) {
+        return;
+    }
+    std::string type = event["event"].asString();
+    std::string fileName = event["file"].asString();
+    if (type == "progress") {
+        int64_t total = event["total"].asInt64();
+        if (total > 0) {
+            fprintf(stderr, "%3.0f%% %s\r", event["uploaded"].asInt64() * 100.0 / total, IuCoreUtils::ExtractFileName(fileName).c_str());
+            fflush(stderr);
+        }
+    } else if (type == "result") {
+        if (event["success"].asBool()) {
+            UploadObject uo;
+            uo.directUrl = event["directUrl"].asString();
+            uo.thumbUrl = event["thumbUrl"].asString();
+            uo.viewUrl = event["viewUrl"].asString();
+            uo.serverName = event["server"].asString();
+            uo.localFilePath = fileName;
+            uo.displayFileName = IuCoreUtils::ExtractFileName(fileName);
+            uo.uploadFileSize = event["size"].asInt64();
+            state.uploadedList.push_back(uo);
+        } else {
+            state.failedCount++;
+            ConsoleUtils::instance()->PrintUnicode(stderr, str(boost::format("Failed to upload '%s' %s\n") % fileName % event["error"].asString()));
+        }
+    } else if (type == "finished") {
+        state.finished = true;
+    } else if (type == "error") {
+        std::cerr << event["error"].asString() << std::endl;
+        state.rejected = true;
+    }
+}
+
+size_t remoteClientWriteCallback(char* data, size_t size, size_t count, void* userData) {
+    auto* state = static_cast<RemoteClientState*>(userData);
+    state->buffer.append(data, size * count);
+    size_t pos;
+    while ((pos = state->buffer.find('\n')) != std::string::npos) {
+        handleRemoteEvent(state->buffer.substr(0, pos), *state);
+        state->buffer.erase(0, pos + 1);
+    }
+    return size * count;
+}
+
+/**
+ * Sends files to the daemon started with --daemon option and prints results streamed back
+ */
+int runRemoteClient() {
+    std::string tokenFileName = daemonTokenFileName();
+    std::string token = IuStringUtils::Trim(IuCoreUtils::GetFileContents(tokenFileName));
+    if (token.empty()) {
+        std::cerr << "Cannot read daemon access token from '" << tokenFileName << "', is the daemon running?" << std::endl;
+        return -1;
+    }
+    Json::Value job;
+    job["server"] = serverName;
+    job["login"] = login;
+    job["password"] = password;
+    job["folder"] = folderId;
+    Json::Value& files = job["files"];
+    files = Json::Value(Json::arrayValue);
+    // Daemon may have another working directory
+    auto addFile = [&](const std::string& fileName) {
+#ifdef _WIN32
+        files.append(IuCoreUtils::WstringToUtf8(boost::filesystem::absolute(IuCoreUtils::Utf8ToWstring(fileName)).wstring()));
+#else
+        files.append(boost::filesystem::absolute(fileName).string());
+#endif
+    };
+    auto addPath = [&](const std::string& path) {
+        if (IuCoreUtils::DirectoryExists(path)) {
+            enumerateDirectory(path, addFile);
+        } else {
+            addFile(path);
+        }
+    };
+    for (const auto& path : filesToUpload) {
+        addPath(path);
+    }
+    if (filesFromFileName == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        readFileList(std::cin, addPath);
+    } else if (!filesFromFileName.empty()) {
+#ifdef _WIN32
+        std::ifstream in(IuCoreUtils::Utf8ToWstring(filesFromFileName), std::ios::binary);
+#else
+        std::ifstream in(filesFromFileName, std::ios::binary);
+#endif
+        readFileList(in, addPath);
+    }
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    std::string body = Json::writeString(builder, job);
+    std::string url = "http://127.0.0.1:" + std::to_string(daemonPort) + "/upload";
+
+    RemoteClientState state;
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        return -1;
+    }
+    curl_slist* headers = curl_slist_append(nullptr, "Content-Type: application/json");
+    headers = curl_slist_append(headers, ("Authorization: Bearer " + token).c_str());
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_NOPROXY, "*");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, remoteClientWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &state);
+    CURLcode code = curl_easy_perform(curl);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    if (code != CURLE_OK) {
+        std::cerr << "Cannot connect to daemon at " << url << ": " << curl_easy_strerror(code) << std::endl;
+        return -1;
+    }
+    if (!state.buffer.empty()) {
+        handleRemoteEvent(state.buffer, state);
+    }
+
+    if (!state.uploadedList.empty()) {
+        OutputCodeGenerator generator;
+        generator.setLang(codeLang);
+        generator.setType(codeType);
+        std::cerr << std::endl << "Result:" << std::endl;
+        std::cout << generator.generate(state.uploadedList);
+        std::cerr << std::endl;
+    }
+    if (state.rejected) {
+        return -1;
+    }
+    if (!state.finished) {
+        std::cerr << "Connection to daemon was interrupted" << std::endl;
+        return -1;
+    }
+    return state.failedCount;
+}
+
+/**
+ * Runs the function in the dispatcher's thread and records it as a startup phase
+ */
+template<typename Func> std::future<void> postStartupTask(TaskDispatcher& dispatcher, const char* name, Func&& func) {
+    auto task = std::make_shared<std::packaged_task<void()>>([name, func = std::forward<Func>(func)] {
+        StartupPhase phase(name);
+        func();
+    });
+    std::future<void> result = task->get_future();
+    dispatcher.post([task] { (*task)(); });
+    return result;
 }
 
 #ifdef _WIN32
@@ -663,6 +1690,7 @@ int _tmain(int argc, _TCHAR* argvW[]) {
 #else
 int main(int argc, char *argv[]){
 #endif
+    StartupProfiler::instance(); // Origin of the startup timeline
     google::InitGoogleLogging(argv[0]);
 
     AppParams::AppVersionInfo appVersion;
@@ -711,6 +1739,17 @@ int main(int argc, char *argv[]){
     params->setDataDirectory(dataFolder);
     params->setSettingsDirectory(settingsFolder);
     params->setIsGui(false);
+
+    // Thin client does not need the server list and settings, the daemon has them loaded already
+    for (int i = 1; i < argc; i++) {
+        if (!IuStringUtils::stricmp(argv[i], "--remote")) {
+            if (!parseCommandLine(argc, argv)) {
+                return 0;
+            }
+            return runRemoteClient();
+        }
+    }
+
 #ifdef _WIN32
     TCHAR ShortPath[1024];
     GetTempPath(ARRAY_SIZE(ShortPath), ShortPath);
@@ -723,20 +1762,43 @@ int main(int argc, char *argv[]){
     params->setTempDirectory("/var/tmp/");
 #endif
     PrintWelcomeMessage();
-    if(! list->loadFromFile(dataFolder + "servers.xml", Settings.ServersSettings)) {
-        std::cerr<<"Cannot load server list!"<<std::endl;
+    if (!settingsFolder.empty()) {
+        list->setCacheDirectory(settingsFolder + "Cache/");
+    }
+    {
+        // curl_global_init() is not thread-safe, it must be called before any other thread is started
+        StartupPhase phase("Network init");
+        NetworkClient::curl_init();
     }
+    {
+        // Server list and settings do not depend on each other
+        TaskDispatcher startupDispatcher(1);
+        std::vector<std::future<void>> startupTasks;
+        startupTasks.push_back(postStartupTask(startupDispatcher, "Load server list", [] {
+            // Server list has always been loaded before settings, so servers are filtered without them
+            ServerSettingsMap serversSettings;
+            if(! list->loadFromFile(dataFolder + "servers.xml", serversSettings)) {
+                std::cerr<<"Cannot load server list!"<<std::endl;
+            }
 
-    if( IuCoreUtils::FileExists(dataFolder + "userservers.xml") && !list->loadFromFile(dataFolder + "userservers.xml", Settings.ServersSettings)) {
-        std::cerr<<"Cannot load server list userservers.xml!"<<std::endl;
+            if( IuCoreUtils::FileExists(dataFolder + "userservers.xml") && !list->loadFromFile(dataFolder + "userservers.xml", serversSettings)) {
+                std::cerr<<"Cannot load server list userservers.xml!"<<std::endl;
+            }
+        }));
+        {
+            StartupPhase phase("Load settings");
+            Settings.LoadSettings(settingsFolder,"settings_cli.xml");
+        }
+        for (auto& task : startupTasks) {
+            task.get();
+        }
     }
-    Settings.LoadSettings(settingsFolder,"settings_cli.xml");
 
     if(!parseCommandLine(argc, argv)) {
         return 0;
     }
 	
-    if (filesToUpload.empty()) {
+    if (filesToUpload.empty() && filesFromFileName.empty() && watchDirectory.empty() && !resumeUploads && !daemonMode) {
         return 0;
     }
 
@@ -746,8 +1808,27 @@ int main(int argc, char *argv[]){
     }
 #endif
 
+    if (!traceFileName.empty()) {
+        TraceRecorder::instance()->start();
+    }
+
+    if (jsonOutput) {
+        jsonWriter = std::make_unique<AsyncOutputWriter>(stdout);
+    }
+
     res = func();
 
+    if (jsonWriter) {
+        jsonWriter->close();
+    }
+
+    if (!traceFileName.empty()) {
+        TraceRecorder::instance()->stop();
+        if (!TraceRecorder::instance()->writeToFile(traceFileName)) {
+            std::cerr << "Cannot write trace file '" << traceFileName << "'" << std::endl;
+        }
+    }
+
     if ( !Settings.SaveSettings() ) {
         std::cerr<<"Cannot save settings!"<<std::endl;
     }
@@ -20,6 +20,9 @@
 #include <string>
 #include "Selection.h"
 
+class CNodeIndex;
+class CSelector;
+
 class CDocument: public CObject
 {
 	public:
@@ -32,6 +35,11 @@ class CDocument: public CObject
 
 		CSelection find(std::string aSelector);
 
+		/**
+		 * Searches the whole document, using the tag/id/class index when the selector allows it
+		 */
+		CSelection find(CSelector* apSelector);
+
         virtual void retain();
 
 
@@ -39,9 +47,14 @@ class CDocument: public CObject
 
 		void reset();
 
+		// The index is built on the first query
+		CNodeIndex& index();
+
 	private:
 
 		GumboOutput* mpOutput;
+
+		CNodeIndex* mpIndex;
 };
 
 #endif /* DOCUMENT_H_ */
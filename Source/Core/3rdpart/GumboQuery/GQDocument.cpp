@@ -14,10 +14,14 @@
  **/
 
 #include "Document.h"
+#include "NodeIndex.h"
+#include "SelectorCache.h"
+#include <stdexcept>
 
 CDocument::CDocument()
 {
 	mpOutput = NULL;
+	mpIndex = NULL;
 }
 
 void CDocument::parse(const std::string& aInput)
@@ -38,8 +42,35 @@ CSelection CDocument::find(std::string aSelector)
 		throw std::runtime_error("CDocument::find: document not initialized");
 	}
 
-	CSelection sel(mpOutput->root);
-	return sel.find(aSelector);
+	CSelector* sel = CSelectorCache::instance().compile(aSelector);
+	CSelection ret = find(sel);
+	sel->release();
+	return ret;
+}
+
+CSelection CDocument::find(CSelector* apSelector)
+{
+	if (mpOutput == NULL)
+	{
+		throw std::runtime_error("CDocument::find: document not initialized");
+	}
+
+	const std::vector<GumboNode*>* candidates = index().nodes(apSelector->indexKey());
+	if (candidates == NULL)
+	{
+		CSelection sel(mpOutput->root);
+		return sel.find(apSelector);
+	}
+	return CSelection(apSelector->filter(*candidates));
+}
+
+CNodeIndex& CDocument::index()
+{
+	if (mpIndex == NULL)
+	{
+		mpIndex = new CNodeIndex(mpOutput->root);
+	}
+	return *mpIndex;
 }
 
 void CDocument::retain() {
@@ -48,6 +79,8 @@ void CDocument::retain() {
 
 void CDocument::reset()
 {
+	delete mpIndex;
+	mpIndex = NULL;
 	if (mpOutput != NULL)
 	{
 		gumbo_destroy_output(&kGumboDefaultOptions, mpOutput);
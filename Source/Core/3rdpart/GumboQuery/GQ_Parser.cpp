@@ -46,8 +46,11 @@ CSelector* CParser::parseSelectorGroup()
 
 		mOffset++;
 
+		CSelector* oldRet = ret;
 		CSelector* sel = parseSelector();
 		ret = new CBinarySelector(CBinarySelector::EUnion, ret, sel);
+		oldRet->release();
+		sel->release();
 	}
 
 	return ret;
@@ -168,7 +171,10 @@ CSelector* CParser::parseSimpleSelectorSequence()
 		}
 		else
 		{
+			CSelector* oldRet = ret;
 			ret = new CBinarySelector(CBinarySelector::EIntersection, ret, sel);
+			oldRet->release();
+			sel->release();
 		}
 	}
 
@@ -408,7 +414,9 @@ CSelector* CParser::parsePseudoclassSelector()
 		{
             throw std::runtime_error(error("impossbile"));
 		}
-		return new CUnarySelector(op, sel);
+		CSelector* ret = new CUnarySelector(op, sel);
+		sel->release();
+		return ret;
 	}
 	else if (name == "contains" || name == "containsown")
 	{
@@ -0,0 +1,101 @@
+#include "NodeIndex.h"
+#include <cstring>
+
+CNodeIndex::CNodeIndex(GumboNode* apRoot)
+{
+	mTags.resize(GUMBO_TAG_LAST + 1);
+
+	// Pre-order traversal without recursion, deep documents should not overflow the stack
+	std::vector<GumboNode*> stack;
+	stack.push_back(apRoot);
+	while (!stack.empty())
+	{
+		GumboNode* pNode = stack.back();
+		stack.pop_back();
+		if (pNode->type != GUMBO_NODE_ELEMENT)
+		{
+			continue;
+		}
+
+		add(pNode);
+		GumboVector children = pNode->v.element.children;
+		for (unsigned int i = children.length; i > 0; i--)
+		{
+			stack.push_back((GumboNode*) children.data[i - 1]);
+		}
+	}
+}
+
+CNodeIndex::~CNodeIndex()
+{
+}
+
+const std::vector<GumboNode*>* CNodeIndex::nodes(const CSelector::TIndexKey& aKey) const
+{
+	switch (aKey.mType)
+	{
+		case CSelector::EKeyTag:
+			if ((unsigned int) aKey.mTag >= mTags.size())
+			{
+				return &mEmpty;
+			}
+			return &mTags[aKey.mTag];
+		case CSelector::EKeyId:
+			return find(mIds, aKey.mValue);
+		case CSelector::EKeyClass:
+			return find(mClasses, aKey.mValue);
+		default:
+			return NULL;
+	}
+}
+
+void CNodeIndex::add(GumboNode* apNode)
+{
+	mTags[apNode->v.element.tag].push_back(apNode);
+
+	GumboVector attributes = apNode->v.element.attributes;
+	for (unsigned int i = 0; i < attributes.length; i++)
+	{
+		GumboAttribute* attr = (GumboAttribute*) attributes.data[i];
+		if (strcmp(attr->name, "id") == 0)
+		{
+			mIds[attr->value].push_back(apNode);
+		}
+		else if (strcmp(attr->name, "class") == 0)
+		{
+			const char* p = attr->value;
+			while (*p)
+			{
+				size_t length = strcspn(p, " \t\r\n\f");
+				if (length > 0)
+				{
+					std::vector<GumboNode*>& list = mClasses[std::string(p, length)];
+					// "a b a" lists the node once
+					if (list.empty() || list.back() != apNode)
+					{
+						list.push_back(apNode);
+					}
+					p += length;
+				}
+				else
+				{
+					p++;
+				}
+			}
+		}
+	}
+}
+
+const std::vector<GumboNode*>* CNodeIndex::find(
+		const std::unordered_map<std::string, std::vector<GumboNode*> >& aMap,
+		const std::string& aValue) const
+{
+	std::unordered_map<std::string, std::vector<GumboNode*> >::const_iterator it = aMap.find(aValue);
+	if (it == aMap.end())
+	{
+		return &mEmpty;
+	}
+	return &it->second;
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 noet: */
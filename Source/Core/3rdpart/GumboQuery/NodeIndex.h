@@ -0,0 +1,52 @@
+#ifndef NODEINDEX_H_
+#define NODEINDEX_H_
+
+#include <gumbo.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Selector.h"
+
+/**
+ * @brief Element lists of a parsed document grouped by tag, id and class name.
+ *
+ * Each list is in document order, the same order in which CSelector::matchAll()
+ * visits the tree, so filtering a list gives the same result as a full scan.
+ */
+class CNodeIndex
+{
+	public:
+
+		CNodeIndex(GumboNode* apRoot);
+
+		virtual ~CNodeIndex();
+
+	public:
+
+		/**
+		 * Returns all elements which have the key, or NULL if the key is EKeyNone
+		 */
+		const std::vector<GumboNode*>* nodes(const CSelector::TIndexKey& aKey) const;
+
+	private:
+
+		void add(GumboNode* apNode);
+
+		const std::vector<GumboNode*>* find(
+				const std::unordered_map<std::string, std::vector<GumboNode*> >& aMap,
+				const std::string& aValue) const;
+
+	private:
+
+		std::vector<std::vector<GumboNode*> > mTags;
+
+		std::unordered_map<std::string, std::vector<GumboNode*> > mIds;
+
+		std::unordered_map<std::string, std::vector<GumboNode*> > mClasses;
+
+		std::vector<GumboNode*> mEmpty;
+};
+
+#endif /* NODEINDEX_H_ */
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 noet: */
@@ -30,26 +30,31 @@ std::string CQueryUtil::tolower(std::string s)
 	return s;
 }
 
-std::vector<GumboNode*> CQueryUtil::unionNodes(std::vector<GumboNode*> aNodes1,
-		std::vector<GumboNode*> aNodes2)
+std::vector<GumboNode*> CQueryUtil::unionNodes(const std::vector<GumboNode*>& aNodes1,
+		const std::vector<GumboNode*>& aNodes2)
 {
-	for (std::vector<GumboNode*>::iterator it = aNodes2.begin(); it != aNodes2.end(); it++)
+	std::vector<GumboNode*> ret(aNodes1);
+	std::unordered_set<GumboNode*> seen(aNodes1.begin(), aNodes1.end());
+	appendUniqueNodes(ret, seen, aNodes2);
+	return ret;
+}
+
+void CQueryUtil::appendUniqueNodes(std::vector<GumboNode*>& aNodes,
+		std::unordered_set<GumboNode*>& aSeen, const std::vector<GumboNode*>& aNew)
+{
+	for (std::vector<GumboNode*>::const_iterator it = aNew.begin(); it != aNew.end(); it++)
 	{
 		GumboNode* pNode = *it;
-		if (nodeExists(aNodes1, pNode))
+		if (aSeen.insert(pNode).second)
 		{
-			continue;
+			aNodes.push_back(pNode);
 		}
-
-		aNodes1.push_back(pNode);
 	}
-
-	return aNodes1;
 }
 
-bool CQueryUtil::nodeExists(std::vector<GumboNode*> aNodes, GumboNode* apNode)
+bool CQueryUtil::nodeExists(const std::vector<GumboNode*>& aNodes, GumboNode* apNode)
 {
-	for (std::vector<GumboNode*>::iterator it = aNodes.begin(); it != aNodes.end(); it++)
+	for (std::vector<GumboNode*>::const_iterator it = aNodes.begin(); it != aNodes.end(); it++)
 	{
 		GumboNode* pNode = *it;
 		if (pNode == apNode)
@@ -18,6 +18,7 @@
 
 #include <gumbo.h>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 class CQueryUtil
@@ -26,10 +27,16 @@ class CQueryUtil
 
 		static std::string tolower(std::string s);
 
-		static std::vector<GumboNode*> unionNodes(std::vector<GumboNode*> aNodes1,
-				std::vector<GumboNode*> aNode2);
+		static std::vector<GumboNode*> unionNodes(const std::vector<GumboNode*>& aNodes1,
+				const std::vector<GumboNode*>& aNode2);
 
-		static bool nodeExists(std::vector<GumboNode*> aNodes, GumboNode* apNode);
+		/**
+		 * Appends nodes which are not in aSeen yet, aSeen has to contain all nodes of aNodes
+		 */
+		static void appendUniqueNodes(std::vector<GumboNode*>& aNodes,
+				std::unordered_set<GumboNode*>& aSeen, const std::vector<GumboNode*>& aNew);
+
+		static bool nodeExists(const std::vector<GumboNode*>& aNodes, GumboNode* apNode);
 
 		static std::string nodeText(GumboNode* apNode);
 
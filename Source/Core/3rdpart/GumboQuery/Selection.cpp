@@ -14,7 +14,7 @@
  **/
 
 #include "Selection.h"
-#include "Parser.h"
+#include "SelectorCache.h"
 #include "QueryUtil.h"
 #include "Node.h"
 
@@ -86,15 +86,26 @@ CSelection& CSelection::squirrelEach(Sqrat::Function callback) {
 
 CSelection CSelection::find(std::string aSelector)
 {
-	CSelector* sel = CParser::create(aSelector);
+	CSelector* sel = CSelectorCache::instance().compile(aSelector);
+	CSelection ret = find(sel);
+	sel->release();
+	return ret;
+}
+
+CSelection CSelection::find(CSelector* apSelector)
+{
+	if (mNodes.size() == 1)
+	{
+		return CSelection(apSelector->matchAll(mNodes[0]));
+	}
+
 	std::vector<GumboNode*> ret;
+	std::unordered_set<GumboNode*> seen;
 	for (std::vector<GumboNode*>::iterator it = mNodes.begin(); it != mNodes.end(); it++)
 	{
 		GumboNode* pNode = *it;
-		std::vector<GumboNode*> matched = sel->matchAll(pNode);
-		ret = CQueryUtil::unionNodes(ret, matched);
+		CQueryUtil::appendUniqueNodes(ret, seen, apSelector->matchAll(pNode));
 	}
-	sel->release();
 	return CSelection(ret);
 }
 
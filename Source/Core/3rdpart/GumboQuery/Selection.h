@@ -9,6 +9,7 @@
 #include "Core/Scripting/Squirrelnc.h"
 
 class CNode;
+class CSelector;
 
 /**
  * @brief (gumbo-query) Selection returned by Document's find function()
@@ -40,6 +41,10 @@ class CSelection: public CObject
 
 		CSelection find(std::string aSelector);
 
+		/* @cond PRIVATE */
+		CSelection find(CSelector* apSelector);
+		/* @endcond */
+
 		CNode nodeAt(unsigned int i);
 
 		unsigned int nodeNum();
@@ -122,10 +122,19 @@ bool CSelector::match(GumboNode* apNode)
 	}
 }
 
-std::vector<GumboNode*> CSelector::filter(std::vector<GumboNode*> nodes)
+CSelector::TIndexKey CSelector::indexKey()
+{
+	if (mOp == ETag)
+	{
+		return TIndexKey(EKeyTag, mTag);
+	}
+	return TIndexKey();
+}
+
+std::vector<GumboNode*> CSelector::filter(const std::vector<GumboNode*>& nodes)
 {
 	std::vector<GumboNode*> ret;
-	for (std::vector<GumboNode*>::iterator it = nodes.begin(); it != nodes.end(); it++)
+	for (std::vector<GumboNode*>::const_iterator it = nodes.begin(); it != nodes.end(); it++)
 	{
 		GumboNode* n = *it;
 		if (match(n))
@@ -267,6 +276,27 @@ bool CBinarySelector::match(GumboNode* apNode)
 	}
 }
 
+CSelector::TIndexKey CBinarySelector::indexKey()
+{
+	switch (mOp)
+	{
+		case EIntersection:
+		{
+			// Both selectors have to match, the more selective index is enough
+			TIndexKey key1 = mpS1->indexKey();
+			TIndexKey key2 = mpS2->indexKey();
+			return key1.mType >= key2.mType ? key1 : key2;
+		}
+		case EChild:
+		case EDescendant:
+		case EAdjacent:
+			// The node itself is matched by the right-hand selector
+			return mpS2->indexKey();
+		default:
+			return TIndexKey();
+	}
+}
+
 CAttributeSelector::CAttributeSelector(TOperator aOp, std::string aKey, std::string aValue)
 {
 	mKey = aKey;
@@ -341,6 +371,24 @@ bool CAttributeSelector::match(GumboNode* apNode)
 	return false;
 }
 
+CSelector::TIndexKey CAttributeSelector::indexKey()
+{
+	// The index splits class names by whitespace, so such values can't be looked up
+	if (mValue.empty() || mValue.find_first_of(" \t\r\n\f") != std::string::npos)
+	{
+		return TIndexKey();
+	}
+	if (mOp == EEquals && mKey == "id")
+	{
+		return TIndexKey(EKeyId, GUMBO_TAG_UNKNOWN, mValue);
+	}
+	if (mOp == EIncludes && mKey == "class")
+	{
+		return TIndexKey(EKeyClass, GUMBO_TAG_UNKNOWN, mValue);
+	}
+	return TIndexKey();
+}
+
 CUnarySelector::CUnarySelector(TOperator aOp, CSelector* apS)
 {
 	mpS = apS;
@@ -74,11 +74,44 @@ class CSelector: public CObject
 		{
 		}
 
+		/**
+		 * Kind of document index (see CNodeIndex) which can provide candidates for the selector,
+		 * ordered by selectivity
+		 */
+		typedef enum
+		{
+			EKeyNone,
+			EKeyTag,
+			EKeyClass,
+			EKeyId,
+		} TIndexKeyType;
+
+		struct TIndexKey
+		{
+			TIndexKeyType mType;
+
+			GumboTag mTag;
+
+			std::string mValue;
+
+			TIndexKey(TIndexKeyType aType = EKeyNone, GumboTag aTag = GUMBO_TAG_UNKNOWN,
+					const std::string& aValue = std::string())
+				: mType(aType), mTag(aTag), mValue(aValue)
+			{
+			}
+		};
+
 	public:
 
 		virtual bool match(GumboNode* apNode);
 
-		std::vector<GumboNode*> filter(std::vector<GumboNode*> nodes);
+		/**
+		 * Returns the key of the index containing every node the selector can match,
+		 * or EKeyNone if the whole tree has to be scanned
+		 */
+		virtual TIndexKey indexKey();
+
+		std::vector<GumboNode*> filter(const std::vector<GumboNode*>& nodes);
 
 		std::vector<GumboNode*> matchAll(GumboNode* apNode);
 
@@ -175,6 +208,8 @@ class CBinarySelector: public CSelector
 
 		virtual bool match(GumboNode* apNode);
 
+		virtual TIndexKey indexKey();
+
 	private:
 
 		CSelector* mpS1;
@@ -229,6 +264,8 @@ class CAttributeSelector: public CSelector
 
 		virtual bool match(GumboNode* apNode);
 
+		virtual TIndexKey indexKey();
+
 	private:
 
 		std::string mKey;
@@ -0,0 +1,65 @@
+#include "SelectorCache.h"
+#include "Parser.h"
+
+CSelectorCache::CSelectorCache(size_t aCapacity)
+{
+	mCapacity = aCapacity;
+}
+
+CSelectorCache::~CSelectorCache()
+{
+	clear();
+}
+
+CSelectorCache& CSelectorCache::instance()
+{
+	static thread_local CSelectorCache cache;
+	return cache;
+}
+
+CSelector* CSelectorCache::compile(const std::string& aSelector)
+{
+	std::unordered_map<std::string, TItemList::iterator>::iterator found = mIndex.find(aSelector);
+	if (found != mIndex.end())
+	{
+		mItems.splice(mItems.begin(), mItems, found->second);
+		CSelector* sel = found->second->second;
+		sel->retain();
+		return sel;
+	}
+
+	CSelector* sel = CParser::create(aSelector);
+	if (mCapacity == 0)
+	{
+		return sel;
+	}
+
+	if (mItems.size() >= mCapacity)
+	{
+		mIndex.erase(mItems.back().first);
+		mItems.back().second->release();
+		mItems.pop_back();
+	}
+
+	mItems.push_front(std::make_pair(aSelector, sel));
+	mIndex[aSelector] = mItems.begin();
+	sel->retain();
+	return sel;
+}
+
+size_t CSelectorCache::size()
+{
+	return mItems.size();
+}
+
+void CSelectorCache::clear()
+{
+	for (TItemList::iterator it = mItems.begin(); it != mItems.end(); it++)
+	{
+		it->second->release();
+	}
+	mItems.clear();
+	mIndex.clear();
+}
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 noet: */
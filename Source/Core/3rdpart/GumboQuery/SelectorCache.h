@@ -0,0 +1,59 @@
+#ifndef SELECTORCACHE_H_
+#define SELECTORCACHE_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "Selector.h"
+
+/**
+ * @brief Keeps recently used selectors compiled, so repeated queries with the same
+ * selector text do not parse it again.
+ *
+ * Selectors are reference counted without synchronization, therefore each thread
+ * has its own cache.
+ */
+class CSelectorCache
+{
+	public:
+
+		static const size_t kDefaultCapacity = 64;
+
+		explicit CSelectorCache(size_t aCapacity = kDefaultCapacity);
+
+		virtual ~CSelectorCache();
+
+	public:
+
+		static CSelectorCache& instance();
+
+		/**
+		 * Returns the compiled selector, the caller has to release it.
+		 * Throws std::runtime_error if the selector is invalid.
+		 */
+		CSelector* compile(const std::string& aSelector);
+
+		size_t size();
+
+		void clear();
+
+	private:
+
+		CSelectorCache(const CSelectorCache&);
+
+		CSelectorCache& operator=(const CSelectorCache&);
+
+		typedef std::list<std::pair<std::string, CSelector*> > TItemList;
+
+		// Most recently used selectors are at the front
+		TItemList mItems;
+
+		std::unordered_map<std::string, TItemList::iterator> mIndex;
+
+		size_t mCapacity;
+};
+
+#endif /* SELECTORCACHE_H_ */
+
+/* vim: set ts=4 sw=4 sts=4 tw=100 noet: */
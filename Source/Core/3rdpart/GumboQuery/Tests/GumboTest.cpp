@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
+#include <chrono>
 #include "../Document.h"
 #include "../Node.h"
+#include "../Parser.h"
+#include "../SelectorCache.h"
 #include <gumbo.h>
 #include "Core/Utils/CoreUtils.h"
 #include "Tests/TestHelpers.h"
@@ -8,6 +11,57 @@
 class GumboTest : public ::testing::Test {
 
 };
+
+namespace {
+
+std::string generateGallery(int count) {
+    std::string page = "<html><head></head><body><div class=\"gallery\">";
+    for (int i = 0; i < count; i++) {
+        std::string n = std::to_string(i);
+        page += "<div class=\"item" + std::string(i % 3 ? " photo" : " video") + "\" id=\"item" + n + "\" data-n=\"" + n + "\">"
+            "<a class=\"thumb\" href=\"/p/" + n + "\" data-n=\"a" + n + "\"><img class=\"preview\" src=\"/t/" + n + ".jpg\" data-n=\"i" + n + "\"></a>"
+            "<span class=\"title\" data-n=\"s" + n + "\">Photo " + n + "</span></div>";
+    }
+    page += "</div></body></html>";
+    return page;
+}
+
+std::string signature(CSelection sel) {
+    std::string res;
+    sel.each([&](int, CNode node) {
+        res += node.tag() + ":" + node.attribute("data-n") + " ";
+    });
+    return res;
+}
+
+// Query the way it was done before selectors were cached and results were merged in linear time
+std::vector<GumboNode*> legacyUnion(std::vector<GumboNode*> aNodes1, std::vector<GumboNode*> aNodes2) {
+    for (GumboNode* node : aNodes2) {
+        bool exists = false;
+        for (GumboNode* existing : aNodes1) {
+            if (existing == node) {
+                exists = true;
+                break;
+            }
+        }
+        if (!exists) {
+            aNodes1.push_back(node);
+        }
+    }
+    return aNodes1;
+}
+
+std::vector<GumboNode*> legacyFind(const std::vector<GumboNode*>& nodes, const std::string& selector) {
+    CSelector* sel = CParser::create(selector);
+    std::vector<GumboNode*> ret;
+    for (GumboNode* node : nodes) {
+        ret = legacyUnion(ret, sel->matchAll(node));
+    }
+    sel->release();
+    return ret;
+}
+
+}
 /*
 TEST_F(GumboTest, Simple)
 {
@@ -47,3 +101,93 @@ TEST_F(GumboTest, Simple2)
 }
 */
 
+
+TEST_F(GumboTest, IndexedFindMatchesFullScan)
+{
+    CDocument doc;
+    doc.parse(generateGallery(50));
+    // Searching from the root element does not use the document index
+    CSelection root = doc.find("html");
+    ASSERT_EQ(1u, root.nodeNum());
+
+    const char* selectors[] = { "#item7", "#missing", ".title", ".photo", "div.item.video", "div.item > a.thumb",
+        "div img", "span.title, a.thumb", "[data-n]", "div:not(.photo)", "li" };
+    for (const char* selector : selectors) {
+        EXPECT_EQ(signature(root.find(selector)), signature(doc.find(selector))) << selector;
+    }
+    EXPECT_EQ(1u, doc.find("#item7").nodeNum());
+    EXPECT_EQ(50u, doc.find(".title").nodeNum());
+    EXPECT_EQ(17u, doc.find("div.item.video").nodeNum());
+    EXPECT_EQ(100u, doc.find("span.title, a.thumb").nodeNum());
+
+    CSelection items = doc.find("div.item");
+    EXPECT_EQ(50u, items.nodeNum());
+    EXPECT_EQ(50u, items.find("img").nodeNum());
+    // Overlapping results are merged without duplicates
+    EXPECT_EQ(51u, doc.find("div").find("div").nodeNum());
+}
+
+TEST_F(GumboTest, SelectorCache)
+{
+    CSelectorCache cache(2);
+    CSelector* sel1 = cache.compile("div a");
+    CSelector* sel2 = cache.compile("div a");
+    EXPECT_EQ(sel1, sel2);
+    sel2->release();
+    CSelector* sel3 = cache.compile(".title");
+    CSelector* sel4 = cache.compile("#logo");
+    EXPECT_EQ(2u, cache.size());
+    // The selector is still valid after eviction, the caller holds a reference
+    EXPECT_EQ(CSelector::EKeyTag, sel1->indexKey().mType);
+    EXPECT_EQ(CSelector::EKeyClass, sel3->indexKey().mType);
+    EXPECT_EQ(CSelector::EKeyId, sel4->indexKey().mType);
+    sel1->release();
+    sel3->release();
+    sel4->release();
+    EXPECT_THROW(cache.compile("div["), std::runtime_error);
+    EXPECT_EQ(2u, cache.size());
+    cache.clear();
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST_F(GumboTest, DISABLED_Benchmark)
+{
+    const char* selectors[] = { "#item4000", ".title", "div.item a.thumb", "img", "span.title, a.thumb" };
+    const int iterations = 10;
+    std::string page = generateGallery(5000);
+
+    GumboOutput* output = gumbo_parse(page.c_str());
+    CDocument doc;
+    doc.parse(page);
+
+    using std::chrono::microseconds;
+    for (const char* selector : selectors) {
+        size_t count1 = 0, count2 = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            count1 += legacyFind({ output->root }, selector).size();
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            count2 += doc.find(selector).nodeNum();
+        }
+        auto end = std::chrono::steady_clock::now();
+        EXPECT_EQ(count1, count2);
+        printf("%-24s old %10.1f us, new %10.1f us\n", selector,
+            std::chrono::duration_cast<microseconds>(middle - start).count() / double(iterations),
+            std::chrono::duration_cast<microseconds>(end - middle).count() / double(iterations));
+    }
+
+    // Searching inside a large selection merges the results of every node
+    auto start = std::chrono::steady_clock::now();
+    size_t count1 = legacyFind(legacyFind({ output->root }, "div.item"), "img").size();
+    auto middle = std::chrono::steady_clock::now();
+    size_t count2 = doc.find("div.item").find("img").nodeNum();
+    auto end = std::chrono::steady_clock::now();
+    EXPECT_EQ(count1, count2);
+    printf("%-24s old %10.1f us, new %10.1f us\n", "div.item -> img",
+        double(std::chrono::duration_cast<microseconds>(middle - start).count()),
+        double(std::chrono::duration_cast<microseconds>(end - middle).count()));
+
+    gumbo_destroy_output(&kGumboDefaultOptions, output);
+}
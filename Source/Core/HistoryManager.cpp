@@ -21,6 +21,7 @@
 #include "HistoryManager.h"
 
 #include <ctime>
+#include <chrono>
 #include <algorithm>
 
 #include <boost/format.hpp>
@@ -32,6 +33,7 @@
 #include "Utils/GlobalMutex.h"
 #include "Core/3rdpart/pcreplusplus.h"
 #include "Utils/StringUtils.h"
+#include "Core/Metrics/MetricsRegistry.h"
 
 class CHistoryReader_impl
 {
@@ -44,7 +46,7 @@ class CHistoryReader_impl
 
 const char CHistoryManager::globalMutexName[] = "IuHistoryFileSessionMutex";
 
-CHistoryManager::CHistoryManager() : db_(nullptr), mt_(rd_())
+CHistoryManager::CHistoryManager() : db_(nullptr), databaseOpened_(false), mt_(rd_())
 {
     m_historyFileNamePrefix = "history";
 }
@@ -61,6 +63,23 @@ void CHistoryManager::setHistoryDirectory(const std::string& directory) {
     m_historyFilePath = directory; 
 }
 bool CHistoryManager::openDatabase() {
+    std::lock_guard<std::mutex> lk(databaseMutex_);
+    return databaseOpened_ || initDatabase();
+}
+
+sqlite3* CHistoryManager::database() {
+    std::lock_guard<std::mutex> lk(databaseMutex_);
+    if (!databaseOpened_) {
+        if (m_historyFilePath.empty()) {
+            LOG(ERROR) << "History directory is not set";
+        } else {
+            initDatabase();
+        }
+    }
+    return db_;
+}
+
+bool CHistoryManager::initDatabase() {
     IuCoreUtils::CreateDir(m_historyFilePath);
     if (!db_ && sqlite3_open((m_historyFilePath + "history.db").c_str(), &db_) != SQLITE_OK) {
         LOG(ERROR) << "unable to open database: ";
@@ -83,6 +102,7 @@ bool CHistoryManager::openDatabase() {
         sqlite3_free(err);
         return false;
     }
+    databaseOpened_ = true;
     return true;
 }
 
@@ -94,7 +114,7 @@ bool CHistoryManager::saveSession(CHistorySession* session) {
     const char* sql = "INSERT INTO upload_sessions(id,created_at) VALUES(?,?)";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    if (sqlite3_prepare(database(), sql, -1, &stmt, nullptr) != SQLITE_OK) {
         LOG(ERROR) << "SQL error: Could not prepare statement.";
         return false;
     }
@@ -123,6 +143,11 @@ bool CHistoryManager::saveSession(CHistorySession* session) {
 }
 
 bool CHistoryManager::saveHistoryItem(HistoryItem* ht) {
+    static MetricHistogram* writeLatency = MetricsRegistry::instance()->histogram("iu_history_write_seconds", "Time of writing an item to history database");
+    auto startTime = std::chrono::steady_clock::now();
+    defer<void> recordLatency([&] {
+        writeLatency->observe(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count());
+    });
     saveSession(ht->session);
     IuCoreUtils::ZGlobalMutex mutex(globalMutexName);
 
@@ -130,8 +155,9 @@ bool CHistoryManager::saveHistoryItem(HistoryItem* ht) {
         "view_url,direct_url_shortened,view_url_shortened, edit_url, delete_url, display_name, size, sort_index) VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?); ";
     sqlite3_stmt *stmt;
 
-    if (sqlite3_prepare_v3(db_, sql, -1, 0, &stmt, nullptr) != SQLITE_OK) {
-        LOG(ERROR) << "SQL error: Could not prepare statement." << sqlite3_errmsg(db_);
+    sqlite3* db = database();
+    if (sqlite3_prepare_v3(db, sql, -1, 0, &stmt, nullptr) != SQLITE_OK) {
+        LOG(ERROR) << "SQL error: Could not prepare statement." << sqlite3_errmsg(db);
         return false;
     }
     bindString(stmt, 1, ht->session->sessionId());
@@ -335,7 +361,7 @@ bool CHistoryManager::clearHistory(HistoryClearPeriod period) {
 
     std::string sql = str(boost::format("DELETE from uploads WHERE TRUE %1% ; DELETE from upload_sessions WHERE TRUE  %1%") % condition);
     char *err = nullptr;
-    if (sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+    if (sqlite3_exec(database(), sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
         LOG(ERROR) << "SQL error occured while clearing history: " << std::endl << err;
         sqlite3_free(err);
     }
@@ -433,7 +459,7 @@ bool CHistoryReader::loadFromFile(const std::string& filename)
 }
 
 bool CHistoryReader::loadFromDB(time_t from, time_t to, const std::string& filename, const std::string& url) {
-    sqlite3* db = d_ptr->mgr_->db_;
+    sqlite3* db = d_ptr->mgr_->database();
 
     std::string condition, condition2;
 
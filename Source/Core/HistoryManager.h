@@ -26,6 +26,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <random>
 
 
@@ -103,6 +104,11 @@ class CHistoryManager
 {
     public:
         CHistoryManager();
+
+        /**
+         * Opens the database right now. It is not necessary to call this function:
+         * the database is opened on first use.
+         */
         bool openDatabase();
         virtual ~CHistoryManager();
         void setHistoryDirectory(const std::string& directory);
@@ -122,9 +128,13 @@ class CHistoryManager
         std::string m_historyFilePath;
         std::string m_historyFileNamePrefix;
         sqlite3* db_;
+        bool databaseOpened_;
+        std::mutex databaseMutex_;
         std::random_device rd_;
         std::mt19937 mt_;
         bool bindString(sqlite3_stmt* stmt, int index, const std::string& val);
+        sqlite3* database();
+        bool initDatabase();
         friend class CHistoryReader;
 };
 
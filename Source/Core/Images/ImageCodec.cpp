@@ -0,0 +1,625 @@
+#include "ImageCodec.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+
+#include <jpeglib.h>
+#include <png.h>
+#include <webp/decode.h>
+#include <webp/encode.h>
+
+#include "Core/Logging.h"
+#include "Core/Utils/CoreTypes.h"
+#include "Core/Utils/CoreUtils.h"
+#include "Core/Utils/StringUtils.h"
+
+namespace ImageCodec {
+
+namespace {
+
+/*
+ libjpeg and libpng report errors with longjmp. Functions calling setjmp keep only plain
+ variables, buffers are owned by their callers, because longjmp doesn't run destructors.
+*/
+
+inline int ceilDiv(int value, int divisor) {
+    return (value + divisor - 1) / divisor;
+}
+
+inline size_t pixelBytes(int width, int height) {
+    return static_cast<size_t>(width) * height * 4;
+}
+
+class FileHolder {
+public:
+    explicit FileHolder(FILE* file) : file_(file) {}
+    ~FileHolder() {
+        if (file_) {
+            fclose(file_);
+        }
+    }
+    FILE* get() const {
+        return file_;
+    }
+private:
+    FILE* file_;
+    DISALLOW_COPY_AND_ASSIGN(FileHolder);
+};
+
+inline int readBigEndian31(const uint8_t* p) {
+    return static_cast<int>(((p[0] & 0x7Fu) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+}
+
+Format detectFormat(const uint8_t* data, size_t size) {
+    if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+        return Format::Jpeg;
+    }
+    if (size >= 8 && !memcmp(data, "\x89PNG\r\n\x1a\n", 8)) {
+        return Format::Png;
+    }
+    if (size >= 12 && !memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WEBP", 4)) {
+        return Format::Webp;
+    }
+    return Format::Unknown;
+}
+
+/* JPEG */
+
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+void jpegErrorExit(j_common_ptr cinfo) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    LOG(ERROR) << "JPEG error: " << message;
+    longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump, 1);
+}
+
+void jpegOutputMessage(j_common_ptr cinfo) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    LOG(WARNING) << "JPEG: " << message;
+}
+
+#ifndef JCS_EXTENSIONS
+// Converts RGB or grayscale pixels at the beginning of the row to RGBA, right to left
+void expandRow(uint8_t* row, int width, int components) {
+    for (int x = width - 1; x >= 0; x--) {
+        const uint8_t* s = row + x * components;
+        uint8_t r = s[0], g = s[components > 1 ? 1 : 0], b = s[components > 1 ? 2 : 0];
+        row[x * 4] = r;
+        row[x * 4 + 1] = g;
+        row[x * 4 + 2] = b;
+        row[x * 4 + 3] = 255;
+    }
+}
+#endif
+
+bool readJpegInfo(FILE* file, ImageInfo& info) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    info.width = static_cast<int>(cinfo.image_width);
+    info.height = static_cast<int>(cinfo.image_height);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+bool decodeJpeg(FILE* file, const DecodeOptions& options, Image& image) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    if (options.readExif) {
+        jpeg_save_markers(&cinfo, JPEG_APP0 + 1, 0xFFFF);
+    }
+    jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) {
+        LOG(ERROR) << "CMYK JPEG images are not supported";
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    int scale = decodeScale(static_cast<int>(cinfo.image_width), static_cast<int>(cinfo.image_height), options);
+    if (!scale) {
+        LOG(ERROR) << "Image " << cinfo.image_width << "x" << cinfo.image_height << " exceeds the memory limit";
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale;
+#ifdef JCS_EXTENSIONS
+    cinfo.out_color_space = JCS_EXT_RGBA;
+#else
+    cinfo.out_color_space = cinfo.num_components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+#endif
+    jpeg_start_decompress(&cinfo);
+
+    for (jpeg_saved_marker_ptr marker = cinfo.marker_list; marker; marker = marker->next) {
+        if (marker->marker == JPEG_APP0 + 1 && marker->data_length > 6 && !memcmp(marker->data, "Exif\0\0", 6)) {
+            image.exif.assign(reinterpret_cast<const char*>(marker->data), marker->data_length);
+            break;
+        }
+    }
+    image.width = static_cast<int>(cinfo.output_width);
+    image.height = static_cast<int>(cinfo.output_height);
+    image.hasAlpha = false;
+    image.pixels.resize(pixelBytes(image.width, image.height));
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = image.pixels.data() + pixelBytes(image.width, cinfo.output_scanline);
+        jpeg_read_scanlines(&cinfo, &row, 1);
+#ifndef JCS_EXTENSIONS
+        expandRow(row, image.width, cinfo.output_components);
+#endif
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+// row must hold width * 4 bytes
+bool encodeJpeg(const Image& image, int quality, FILE* file, std::vector<uint8_t>& row) {
+    jpeg_compress_struct cinfo;
+    JpegErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, file);
+    cinfo.image_width = image.width;
+    cinfo.image_height = image.height;
+#ifdef JCS_EXTENSIONS
+    cinfo.input_components = 4;
+    cinfo.in_color_space = JCS_EXT_RGBX;
+#else
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+#endif
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, std::min(std::max(quality, 1), 100), TRUE);
+    cinfo.optimize_coding = TRUE;
+    jpeg_start_compress(&cinfo, TRUE);
+    if (!image.exif.empty()) {
+        jpeg_write_marker(&cinfo, JPEG_APP0 + 1, reinterpret_cast<const JOCTET*>(image.exif.data()),
+            static_cast<unsigned int>(image.exif.size()));
+    }
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const uint8_t* src = image.pixels.data() + pixelBytes(image.width, cinfo.next_scanline);
+        JSAMPROW out = row.data();
+        for (int x = 0; x < image.width; x++) {
+            const uint8_t* p = src + x * 4;
+            // Transparent pixels are put on white background
+            int alpha = image.hasAlpha ? p[3] : 255;
+            for (int c = 0; c < 3; c++) {
+                *out++ = static_cast<uint8_t>((p[c] * alpha + 255 * (255 - alpha) + 127) / 255);
+            }
+#ifdef JCS_EXTENSIONS
+            *out++ = 255;
+#endif
+        }
+        JSAMPROW rowPointer = row.data();
+        jpeg_write_scanlines(&cinfo, &rowPointer, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return true;
+}
+
+/* PNG */
+
+void pngError(png_structp png, png_const_charp message) {
+    LOG(ERROR) << "PNG error: " << message;
+    png_longjmp(png, 1);
+}
+
+void pngWarning(png_structp, png_const_charp message) {
+    LOG(WARNING) << "PNG: " << message;
+}
+
+/*
+ Averages blocks of scale x scale pixels while rows are read. Colors are weighted by alpha,
+ so fully transparent pixels don't darken the edges.
+*/
+struct BoxReducer {
+    int srcWidth = 0;
+    int scale = 1;
+    int rows = 0;
+    std::vector<uint32_t> sums;
+
+    void init(int width, int factor) {
+        srcWidth = width;
+        scale = factor;
+        rows = 0;
+        sums.assign(static_cast<size_t>(ceilDiv(width, factor)) * 4, 0);
+    }
+
+    void addRow(const uint8_t* row) {
+        for (int x = 0; x < srcWidth; x++) {
+            const uint8_t* p = row + x * 4;
+            uint32_t* s = &sums[(x / scale) * 4];
+            s[0] += p[0] * p[3];
+            s[1] += p[1] * p[3];
+            s[2] += p[2] * p[3];
+            s[3] += p[3];
+        }
+        rows++;
+    }
+
+    void writeRow(uint8_t* out) {
+        const int width = ceilDiv(srcWidth, scale);
+        for (int x = 0; x < width; x++) {
+            uint32_t* s = &sums[x * 4];
+            uint32_t count = std::min(scale, srcWidth - x * scale) * rows;
+            uint32_t alpha = s[3];
+            for (int c = 0; c < 3; c++) {
+                out[x * 4 + c] = static_cast<uint8_t>(alpha ? (s[c] + alpha / 2) / alpha : 0);
+            }
+            out[x * 4 + 3] = static_cast<uint8_t>((alpha + count / 2) / count);
+        }
+        std::fill(sums.begin(), sums.end(), 0);
+        rows = 0;
+    }
+};
+
+struct PngBuffers {
+    std::vector<uint8_t> row;
+    std::vector<png_bytep> rowPointers;
+    BoxReducer reducer;
+};
+
+bool decodePng(FILE* file, const DecodeOptions& options, Image& image, PngBuffers& buffers) {
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, pngError, pngWarning);
+    if (!png) {
+        return false;
+    }
+    png_infop info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_read_struct(&png, nullptr, nullptr);
+        return false;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        return false;
+    }
+    png_init_io(png, file);
+    png_read_info(png, info);
+    const int width = static_cast<int>(png_get_image_width(png, info));
+    const int height = static_cast<int>(png_get_image_height(png, info));
+    const int colorType = png_get_color_type(png, info);
+    image.hasAlpha = (colorType & PNG_COLOR_MASK_ALPHA) || png_get_valid(png, info, PNG_INFO_tRNS);
+
+    png_set_expand(png);
+    png_set_strip_16(png);
+    png_set_gray_to_rgb(png);
+    png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+    const bool interlaced = png_set_interlace_handling(png) > 1;
+    png_read_update_info(png, info);
+
+    int scale = decodeScale(width, height, options);
+    // Passes of interlaced images fill the whole image, it can be reduced only after reading
+    if (!scale || (interlaced && pixelBytes(width, height) > options.memoryLimit)) {
+        LOG(ERROR) << "Image " << width << "x" << height << " exceeds the memory limit";
+        png_destroy_read_struct(&png, &info, nullptr);
+        return false;
+    }
+    image.width = ceilDiv(width, scale);
+    image.height = ceilDiv(height, scale);
+    image.pixels.resize(pixelBytes(interlaced ? width : image.width, interlaced ? height : image.height));
+    buffers.reducer.init(width, scale);
+
+    if (interlaced) {
+        buffers.rowPointers.resize(height);
+        for (int y = 0; y < height; y++) {
+            buffers.rowPointers[y] = image.pixels.data() + pixelBytes(width, y);
+        }
+        png_read_image(png, buffers.rowPointers.data());
+        if (scale > 1) {
+            // Reduced rows are written in place, never beyond the rows which are still to be read
+            for (int y = 0; y < height; y++) {
+                buffers.reducer.addRow(buffers.rowPointers[y]);
+                if ((y + 1) % scale == 0 || y == height - 1) {
+                    buffers.reducer.writeRow(image.pixels.data() + pixelBytes(image.width, y / scale));
+                }
+            }
+            image.pixels.resize(pixelBytes(image.width, image.height));
+            image.pixels.shrink_to_fit();
+        }
+    } else if (scale == 1) {
+        for (int y = 0; y < height; y++) {
+            png_read_row(png, image.pixels.data() + pixelBytes(width, y), nullptr);
+        }
+    } else {
+        buffers.row.resize(pixelBytes(width, 1));
+        for (int y = 0; y < height; y++) {
+            png_read_row(png, buffers.row.data(), nullptr);
+            buffers.reducer.addRow(buffers.row.data());
+            if ((y + 1) % scale == 0 || y == height - 1) {
+                buffers.reducer.writeRow(image.pixels.data() + pixelBytes(image.width, y / scale));
+            }
+        }
+    }
+    png_read_end(png, nullptr);
+    png_destroy_read_struct(&png, &info, nullptr);
+    return true;
+}
+
+bool encodePng(const Image& image, FILE* file) {
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, pngError, pngWarning);
+    if (!png) {
+        return false;
+    }
+    png_infop info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_write_struct(&png, nullptr);
+        return false;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        return false;
+    }
+    png_init_io(png, file);
+    png_set_IHDR(png, info, image.width, image.height, 8, image.hasAlpha ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB,
+        PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    if (!image.hasAlpha) {
+        png_set_filler(png, 0, PNG_FILLER_AFTER); // the 4th byte is stripped
+    }
+    for (int y = 0; y < image.height; y++) {
+        png_write_row(png, const_cast<png_bytep>(image.pixels.data() + pixelBytes(image.width, y)));
+    }
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+    return true;
+}
+
+/* WebP */
+
+bool readWebpInfo(const uint8_t* data, size_t size, ImageInfo& info) {
+    return WebPGetInfo(data, size, &info.width, &info.height) != 0;
+}
+
+bool decodeWebp(FILE* file, const DecodeOptions& options, Image& image) {
+    std::vector<uint8_t> data;
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    long size = ftell(file);
+    if (size <= 0 || static_cast<size_t>(size) > options.memoryLimit || fseek(file, 0, SEEK_SET) != 0) {
+        return false;
+    }
+    data.resize(size);
+    if (fread(data.data(), 1, data.size(), file) != data.size()) {
+        return false;
+    }
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config) || WebPGetFeatures(data.data(), data.size(), &config.input) != VP8_STATUS_OK) {
+        LOG(ERROR) << "Invalid WebP image";
+        return false;
+    }
+    if (config.input.has_animation) {
+        LOG(ERROR) << "Animated WebP images are not supported";
+        return false;
+    }
+    int scale = decodeScale(config.input.width, config.input.height, options);
+    if (!scale || data.size() + pixelBytes(ceilDiv(config.input.width, scale), ceilDiv(config.input.height, scale)) > options.memoryLimit) {
+        LOG(ERROR) << "Image " << config.input.width << "x" << config.input.height << " exceeds the memory limit";
+        return false;
+    }
+    image.width = ceilDiv(config.input.width, scale);
+    image.height = ceilDiv(config.input.height, scale);
+    image.hasAlpha = config.input.has_alpha != 0;
+    image.pixels.resize(pixelBytes(image.width, image.height));
+    if (scale > 1) {
+        config.options.use_scaling = 1;
+        config.options.scaled_width = image.width;
+        config.options.scaled_height = image.height;
+    }
+    config.output.colorspace = MODE_RGBA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = image.pixels.data();
+    config.output.u.RGBA.stride = image.width * 4;
+    config.output.u.RGBA.size = image.pixels.size();
+    VP8StatusCode status = WebPDecode(data.data(), data.size(), &config);
+    WebPFreeDecBuffer(&config.output);
+    if (status != VP8_STATUS_OK) {
+        LOG(ERROR) << "WebP decoding failed, status " << status;
+        return false;
+    }
+    return true;
+}
+
+bool encodeWebp(const Image& image, int quality, bool lossless, FILE* file) {
+    uint8_t* output = nullptr;
+    const int stride = image.width * 4;
+    size_t size = lossless ? WebPEncodeLosslessRGBA(image.pixels.data(), image.width, image.height, stride, &output)
+        : WebPEncodeRGBA(image.pixels.data(), image.width, image.height, stride, static_cast<float>(quality), &output);
+    bool success = size && fwrite(output, 1, size, file) == size;
+    WebPFree(output);
+    return success;
+}
+
+void premultiply(Image& image) {
+    uint8_t* p = image.pixels.data();
+    for (size_t i = 0; i < image.pixels.size(); i += 4) {
+        const int alpha = p[i + 3];
+        for (int c = 0; c < 3; c++) {
+            p[i + c] = static_cast<uint8_t>((p[i + c] * alpha + 127) / 255);
+        }
+    }
+}
+
+void unpremultiply(Image& image) {
+    uint8_t* p = image.pixels.data();
+    for (size_t i = 0; i < image.pixels.size(); i += 4) {
+        const int alpha = p[i + 3];
+        for (int c = 0; c < 3; c++) {
+            p[i + c] = static_cast<uint8_t>(alpha ? std::min(255, (p[i + c] * 255 + alpha / 2) / alpha) : 0);
+        }
+    }
+}
+
+}
+
+bool readInfo(const std::string& fileName, ImageInfo& info) {
+    FileHolder file(IuCoreUtils::FopenUtf8(fileName.c_str(), "rb"));
+    if (!file.get()) {
+        LOG(ERROR) << "Cannot open file " << fileName;
+        return false;
+    }
+    uint8_t header[64];
+    size_t size = fread(header, 1, sizeof(header), file.get());
+    info.format = detectFormat(header, size);
+    switch (info.format) {
+        case Format::Jpeg:
+            rewind(file.get());
+            return readJpegInfo(file.get(), info);
+        case Format::Png:
+            // IHDR is always the first chunk
+            if (size < 24) {
+                return false;
+            }
+            info.width = readBigEndian31(header + 16);
+            info.height = readBigEndian31(header + 20);
+            return info.width > 0 && info.height > 0;
+        case Format::Webp:
+            return readWebpInfo(header, size, info);
+        default:
+            return false;
+    }
+}
+
+int decodeScale(int width, int height, const DecodeOptions& options) {
+    int scale = 1;
+    if (options.minWidth > 0 || options.minHeight > 0) {
+        while (scale < 8 && ceilDiv(width, scale * 2) >= options.minWidth && ceilDiv(height, scale * 2) >= options.minHeight) {
+            scale *= 2;
+        }
+    }
+    while (scale <= 8 && pixelBytes(ceilDiv(width, scale), ceilDiv(height, scale)) > options.memoryLimit) {
+        scale *= 2;
+    }
+    return scale <= 8 ? scale : 0;
+}
+
+bool decode(const std::string& fileName, const DecodeOptions& options, Image& image) {
+    FileHolder file(IuCoreUtils::FopenUtf8(fileName.c_str(), "rb"));
+    if (!file.get()) {
+        LOG(ERROR) << "Cannot open file " << fileName;
+        return false;
+    }
+    uint8_t header[16];
+    size_t size = fread(header, 1, sizeof(header), file.get());
+    rewind(file.get());
+    image.exif.clear();
+    bool success = false;
+    switch (detectFormat(header, size)) {
+        case Format::Jpeg:
+            success = decodeJpeg(file.get(), options, image);
+            break;
+        case Format::Png: {
+            PngBuffers buffers;
+            success = decodePng(file.get(), options, image, buffers);
+            break;
+        }
+        case Format::Webp:
+            success = decodeWebp(file.get(), options, image);
+            break;
+        default:
+            LOG(ERROR) << "Unsupported image format: " << fileName;
+    }
+    if (!success) {
+        image.pixels.clear();
+        image.width = image.height = 0;
+    }
+    return success;
+}
+
+void resize(Image& image, int width, int height, TaskDispatcher* dispatcher) {
+    if (width == image.width && height == image.height) {
+        return;
+    }
+    if (image.hasAlpha) {
+        premultiply(image);
+    }
+    Image result;
+    result.width = width;
+    result.height = height;
+    result.hasAlpha = image.hasAlpha;
+    result.pixels.resize(pixelBytes(width, height));
+    ImageKernels::resize(image.view(), result.view(), dispatcher);
+    if (result.hasAlpha) {
+        unpremultiply(result);
+    }
+    image.pixels.swap(result.pixels);
+    image.width = width;
+    image.height = height;
+}
+
+bool encode(const Image& image, Format format, int quality, const std::string& fileName, bool lossless) {
+    bool success = false;
+    {
+        FileHolder file(IuCoreUtils::FopenUtf8(fileName.c_str(), "wb"));
+        if (!file.get()) {
+            LOG(ERROR) << "Cannot create file " << fileName;
+            return false;
+        }
+        switch (format) {
+            case Format::Jpeg: {
+                std::vector<uint8_t> row(pixelBytes(image.width, 1));
+                success = encodeJpeg(image, quality, file.get(), row);
+                break;
+            }
+            case Format::Png:
+                success = encodePng(image, file.get());
+                break;
+            case Format::Webp:
+                success = encodeWebp(image, quality, lossless, file.get());
+                break;
+            default:
+                LOG(ERROR) << "Unsupported output format";
+        }
+    }
+    if (!success) {
+        IuCoreUtils::RemoveFile(fileName);
+    }
+    return success;
+}
+
+Format formatFromExtension(const std::string& fileName) {
+    std::string ext = IuStringUtils::toLower(IuCoreUtils::ExtractFileExt(fileName));
+    if (ext == "jpg" || ext == "jpeg" || ext == "jpe") {
+        return Format::Jpeg;
+    }
+    if (ext == "png") {
+        return Format::Png;
+    }
+    if (ext == "webp") {
+        return Format::Webp;
+    }
+    return Format::Unknown;
+}
+
+}
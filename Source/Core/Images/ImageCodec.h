@@ -0,0 +1,85 @@
+#ifndef IU_CORE_IMAGES_IMAGECODEC_H
+#define IU_CORE_IMAGES_IMAGECODEC_H
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ImageKernels.h"
+
+class TaskDispatcher;
+
+/**
+@brief Reading, resizing and writing of JPEG, PNG and WebP files without GDI+.
+
+Large images are reduced already while they are decoded: JPEG with DCT scaling of libjpeg-turbo,
+WebP with the scaler of libwebp, rows of PNG images are averaged in blocks as soon as they are read.
+The reduction is a power of two (1/2, 1/4 or 1/8) which keeps the image not smaller than the
+requested size, the exact size is produced by resize() with Lanczos filter.
+*/
+namespace ImageCodec {
+
+enum class Format { Unknown, Jpeg, Png, Webp };
+
+// Default limit of the decoded pixel buffer (enough for 64 megapixel images)
+const size_t kDefaultMemoryLimit = 256 * 1024 * 1024;
+
+struct ImageInfo {
+    Format format = Format::Unknown;
+    int width = 0;
+    int height = 0;
+};
+
+struct Image {
+    int width = 0;
+    int height = 0;
+    bool hasAlpha = false;
+    std::vector<uint8_t> pixels; // RGBA, rows without padding
+    std::string exif; // contents of the APP1 segment of a JPEG file
+
+    ImageKernels::ImageView view() {
+        return { pixels.data(), width, height, static_cast<ptrdiff_t>(width) * 4 };
+    }
+};
+
+struct DecodeOptions {
+    // The image is reduced while decoding as long as both sides stay not smaller than these (0 - no reduction)
+    int minWidth = 0;
+    int minHeight = 0;
+    // Images whose decoded pixels would take more memory are reduced further, or rejected if they still don't fit
+    size_t memoryLimit = kDefaultMemoryLimit;
+    bool readExif = false;
+};
+
+/**
+ * Detects format by the signature of the file and reads size of the image from its header.
+ */
+bool readInfo(const std::string& fileName, ImageInfo& info);
+
+/**
+ * Returns the reduction (1, 2, 4 or 8) applied by decode() to an image of the given size.
+ * Returns 0 if the image doesn't fit into the memory limit even when reduced 8 times.
+ */
+int decodeScale(int width, int height, const DecodeOptions& options);
+
+bool decode(const std::string& fileName, const DecodeOptions& options, Image& image);
+
+/**
+ * Resamples the image to the new size. Transparent images are premultiplied by alpha while resampling.
+ */
+void resize(Image& image, int width, int height, TaskDispatcher* dispatcher = nullptr);
+
+/**
+ * Writes the image. Quality (0-100) is used by JPEG and lossy WebP, transparent images are put on
+ * white background when they are saved in JPEG format. EXIF data is written to JPEG files only.
+ */
+bool encode(const Image& image, Format format, int quality, const std::string& fileName, bool lossless = false);
+
+Format formatFromExtension(const std::string& fileName);
+
+}
+
+#endif
@@ -25,13 +25,14 @@
 
 #ifdef _WIN32
     #include "ImageConverterPrivate_gdiplus.h"
+    #include "Func/WinUtils.h"
+#else
+    #include "ImageConverterPrivate_portable.h"
 #endif
 
-#include "Func/WinUtils.h"
-
 ImageConvertingParams::ImageConvertingParams()
 {
-    StrokeColor = RGB(0, 0, 0);
+    StrokeColor = 0;
     SmartConverting = false;
     AddLogo  = false;
     AddText = false;
@@ -41,10 +42,12 @@ ImageConvertingParams::ImageConvertingParams()
     ResizeMode = irmFit;
     LogoPosition = 0;
     LogoBlend = 0;
-    Text = W2U(APPNAME);
+    Text = "Image Uploader";
     TextPosition = 5;
     TextColor = 0x00ffffff;
+#ifdef _WIN32
     WinUtils::StringToFont(_T("Tahoma,8,,204"), &Font);
+#endif
     PreserveExifInformation = true;
     SkipAnimated = true;
 }
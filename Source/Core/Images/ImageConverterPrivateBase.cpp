@@ -4,6 +4,7 @@
 #include "Core/3rdpart/pcreplusplus.h"
 #include "Core/Utils/StringUtils.h"
 #include "Core/3rdpart/parser.h"
+#include "ThumbnailExpression.h"
 
 ImageConverterPrivateBase::ImageConverterPrivateBase()
 {
@@ -21,6 +22,18 @@ uint32_t ImageConverterPrivateBase::EvaluateColor(const std::string& expr)
 }
 
 int ImageConverterPrivateBase::EvaluateExpression(const std::string& expr)
+{
+    if (thumbnailTemplate_) {
+        const ThumbnailExpression* compiled = thumbnailTemplate_->expressions()->get(expr);
+        double result;
+        if (compiled && compiled->evaluate(m_Vars, result)) {
+            return static_cast<int>(static_cast<int64_t>(result));
+        }
+    }
+    return InterpretExpression(expr);
+}
+
+int ImageConverterPrivateBase::InterpretExpression(const std::string& expr)
 {
     std::string processedExpr = ReplaceVars(expr);
     return static_cast<int>(EvaluateSimpleExpression(processedExpr));
@@ -14,7 +14,11 @@ public:
     ImageConverterPrivateBase();
     Thumbnail* thumbnailTemplate_;
     std::map<std::string, std::string> m_Vars;
+    /**
+     * Uses the compiled form of the expression from thumbnailTemplate_ when possible
+     */
     int EvaluateExpression(const std::string& expr);
+    int InterpretExpression(const std::string& expr);
     std::string ReplaceVars(const std::string& expr);
     int64_t EvaluateSimpleExpression(const std::string& expr) const;
     uint32_t EvaluateColor(const std::string& expr);
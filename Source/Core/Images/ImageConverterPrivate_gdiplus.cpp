@@ -11,6 +11,7 @@
 #include "Func/IuCommonFunctions.h"
 #include "Func/WinUtils.h"
 #include "Core/Video/GdiPlusImage.h"
+#include "Core/Logging/TraceRecorder.h"
 
 #ifndef MYRGB
     #define MYRGB(a,color) Color(a,GetRValue(color),GetGValue(color),GetBValue(color))
@@ -302,6 +303,7 @@ bool ImageConverterPrivate::createThumb(Gdiplus::Bitmap* bm, const CString& imag
 
 std::shared_ptr<AbstractImage> ImageConverterPrivate::createThumbnail(AbstractImage* abstractImg, int64_t fileSize, int fileformat)
 {
+    TraceSpan span("filters", "Create thumbnail");
     GdiPlusImage* image = dynamic_cast<GdiPlusImage*>(abstractImg);
     assert(image);
     assert(thumbnailTemplate_);
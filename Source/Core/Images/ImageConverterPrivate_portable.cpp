@@ -0,0 +1,251 @@
+#include "ImageConverterPrivate_portable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "Core/AppParams.h"
+#include "Core/Logging.h"
+#include "Core/ServiceLocator.h"
+#include "Core/Utils/CoreUtils.h"
+#include "Core/Utils/CryptoUtils.h"
+#include "Core/Utils/StringUtils.h"
+
+namespace {
+
+// index is a value of ImageUtils::SaveImageFormat
+ImageCodec::Format saveFormat(int index, bool& lossless) {
+    lossless = false;
+    switch (index) {
+        case 0:
+            return ImageCodec::Format::Jpeg;
+        case 2:
+            LOG(WARNING) << "ImageConverter: GIF format is not supported, saving in PNG format";
+            return ImageCodec::Format::Png;
+        case 3:
+            return ImageCodec::Format::Webp;
+        case 4:
+            lossless = true;
+            return ImageCodec::Format::Webp;
+        default:
+            return ImageCodec::Format::Png;
+    }
+}
+
+const char* formatExtension(ImageCodec::Format format) {
+    switch (format) {
+        case ImageCodec::Format::Png:
+            return "png";
+        case ImageCodec::Format::Webp:
+            return "webp";
+        default:
+            return "jpg";
+    }
+}
+
+// Places the image at the center of width x height area, parts outside of it are cut off,
+// uncovered parts are transparent.
+void cropCentered(ImageCodec::Image& image, int width, int height) {
+    if (width == image.width && height == image.height) {
+        return;
+    }
+    ImageCodec::Image result;
+    result.width = width;
+    result.height = height;
+    result.exif = std::move(image.exif);
+    result.hasAlpha = image.hasAlpha || image.width < width || image.height < height;
+    result.pixels.resize(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < result.pixels.size(); i += 4) {
+        memcpy(&result.pixels[i], "\xFF\xFF\xFF\x00", 4);
+    }
+    const int offsetX = (width - image.width) / 2;
+    const int offsetY = (height - image.height) / 2;
+    const int left = std::max(0, offsetX), right = std::min(width, offsetX + image.width);
+    for (int y = std::max(0, offsetY); y < std::min(height, offsetY + image.height); y++) {
+        if (left < right) {
+            memcpy(&result.pixels[(static_cast<size_t>(y) * width + left) * 4],
+                &image.pixels[(static_cast<size_t>(y - offsetY) * image.width + left - offsetX) * 4], (right - left) * 4);
+        }
+    }
+    image = std::move(result);
+}
+
+}
+
+bool ImageConverterPrivate::convert(const std::string& sourceFile)
+{
+    sourceFile_ = sourceFile;
+    resultFileName_.clear();
+    thumbFileName_.clear();
+
+    ImageCodec::ImageInfo info;
+    if (!ImageCodec::readInfo(sourceFile, info)) {
+        LOG(ERROR) << "ImageConverter: unable to load source file " << sourceFile;
+        return false;
+    }
+    const double imgwidth = info.width;
+    const double imgheight = info.height;
+    double width = atof(m_imageConvertingParams.strNewWidth.c_str());
+    double height = atof(m_imageConvertingParams.strNewHeight.c_str());
+    if (IuStringUtils::Tail(m_imageConvertingParams.strNewWidth, 1) == "%") {
+        width = width * imgwidth / 100;
+    }
+    if (IuStringUtils::Tail(m_imageConvertingParams.strNewHeight, 1) == "%") {
+        height = height * imgheight / 100;
+    }
+
+    bool processing = processingEnabled_;
+    ImageCodec::Format format = info.format;
+    bool lossless = false;
+    if (m_imageConvertingParams.Format >= 1 && processing) {
+        format = saveFormat(m_imageConvertingParams.Format - 1, lossless);
+    }
+    if (m_imageConvertingParams.SmartConverting && format == info.format && imgwidth < width && imgheight < height) {
+        processing = false;
+    }
+
+    double newwidth = imgwidth;
+    double newheight = imgheight;
+    const ImageConvertingParams::ImageResizeMode resizeMode = m_imageConvertingParams.ResizeMode;
+    if (resizeMode == ImageConvertingParams::irmFit) {
+        if (width && height && (imgwidth > width || imgheight > height)) {
+            double s = std::min(width / imgwidth, height / imgheight);
+            newwidth = s * imgwidth;
+            newheight = s * imgheight;
+        } else if (width && imgwidth > width) {
+            newwidth = width;
+            newheight = newwidth / imgwidth * imgheight;
+        } else if (height && imgheight > height) {
+            newheight = height;
+            newwidth = newheight / imgheight * imgwidth;
+        }
+    } else if (imgwidth > width || imgheight > height) {
+        if (width > 0) {
+            newwidth = width;
+        }
+        if (height > 0) {
+            newheight = height;
+        }
+    }
+    const int targetWidth = std::max(1, static_cast<int>(round(newwidth)));
+    const int targetHeight = std::max(1, static_cast<int>(round(newheight)));
+    // Size the source is resampled to, in crop mode it is bigger than the target in one dimension
+    int scaledWidth = targetWidth;
+    int scaledHeight = targetHeight;
+    if (resizeMode == ImageConvertingParams::irmCrop) {
+        double k = newwidth > newheight ? std::min(newwidth, imgwidth) / imgwidth : std::min(newheight, imgheight) / imgheight;
+        scaledWidth = std::max(1, static_cast<int>(imgwidth * k));
+        scaledHeight = std::max(1, static_cast<int>(imgheight * k));
+    }
+
+    if (!processing) {
+        resultFileName_ = sourceFile;
+        if (!generateThumb_) {
+            return true;
+        }
+        format = info.format == ImageCodec::Format::Png ? ImageCodec::Format::Png : ImageCodec::Format::Jpeg;
+        lossless = false;
+    }
+
+    ImageCodec::DecodeOptions options;
+    if (processing) {
+        options.minWidth = scaledWidth;
+        options.minHeight = scaledHeight;
+        // Pixels are not rotated, so the orientation tag stays valid
+        options.readExif = m_imageConvertingParams.PreserveExifInformation && format == ImageCodec::Format::Jpeg;
+    } else {
+        calcThumbSize(info.width, info.height, options.minWidth, options.minHeight);
+    }
+    ImageCodec::Image image;
+    // Animated WebP images are not decoded, they are uploaded unchanged
+    if (!ImageCodec::decode(sourceFile, options, image)) {
+        return false;
+    }
+
+    if (processing) {
+        ImageCodec::resize(image, scaledWidth, scaledHeight, ServiceLocator::instance()->taskDispatcher());
+        if (resizeMode == ImageConvertingParams::irmCrop) {
+            cropCentered(image, targetWidth, targetHeight);
+        }
+        if (m_imageConvertingParams.AddText || m_imageConvertingParams.AddLogo) {
+            LOG(WARNING) << "ImageConverter: adding text and logo is not supported on this platform";
+        }
+        std::string fileName = generateFileName("img", format);
+        if (!ImageCodec::encode(image, format, m_imageConvertingParams.Quality, fileName, lossless)) {
+            LOG(ERROR) << "ImageConverter: unable to save image " << fileName;
+            return false;
+        }
+        resultFileName_ = fileName;
+    }
+
+    if (generateThumb_) {
+        switch (m_thumbCreatingParams.Format) {
+            case ThumbCreatingParams::tfJPEG:
+                format = ImageCodec::Format::Jpeg;
+                break;
+            case ThumbCreatingParams::tfPNG:
+            case ThumbCreatingParams::tfGIF:
+                format = ImageCodec::Format::Png;
+                break;
+            case ThumbCreatingParams::tfWebP:
+                format = ImageCodec::Format::Webp;
+                lossless = false;
+                break;
+            case ThumbCreatingParams::tfWebPLossless:
+                format = ImageCodec::Format::Webp;
+                lossless = true;
+                break;
+            default:
+                break;
+        }
+        createThumb(std::move(image), format, lossless);
+    }
+    return true;
+}
+
+bool ImageConverterPrivate::createThumb(ImageCodec::Image image, ImageCodec::Format format, bool lossless)
+{
+    int thumbWidth = 0, thumbHeight = 0;
+    calcThumbSize(image.width, image.height, thumbWidth, thumbHeight);
+    image.exif.clear();
+    ImageCodec::resize(image, thumbWidth, thumbHeight, ServiceLocator::instance()->taskDispatcher());
+    std::string fileName = generateFileName("thumb", format);
+    if (!ImageCodec::encode(image, format, static_cast<int>(m_thumbCreatingParams.Quality), fileName, lossless)) {
+        LOG(ERROR) << "ImageConverter: unable to save thumbnail " << fileName;
+        return false;
+    }
+    thumbFileName_ = fileName;
+    return true;
+}
+
+void ImageConverterPrivate::calcThumbSize(int width, int height, int& thumbWidth, int& thumbHeight) const
+{
+    thumbWidth = m_thumbCreatingParams.Width > 0 ? m_thumbCreatingParams.Width : ThumbCreatingParams::DEFAULT_THUMB_WIDTH;
+    thumbHeight = m_thumbCreatingParams.Height > 0 ? m_thumbCreatingParams.Height : ThumbCreatingParams::DEFAULT_THUMB_WIDTH;
+    if (m_thumbCreatingParams.ResizeMode == ThumbCreatingParams::trByWidth) {
+        thumbHeight = static_cast<int>(round(static_cast<double>(thumbWidth) / width * height));
+    } else if (m_thumbCreatingParams.ResizeMode == ThumbCreatingParams::trByHeight) {
+        thumbWidth = static_cast<int>(round(static_cast<double>(thumbHeight) / height * width));
+    }
+    thumbWidth = std::max(thumbWidth, 1);
+    thumbHeight = std::max(thumbHeight, 1);
+}
+
+std::shared_ptr<AbstractImage> ImageConverterPrivate::createThumbnail(AbstractImage* image, int64_t fileSize, int fileformat)
+{
+    LOG(ERROR) << "ImageConverter: thumbnail templates are not supported on this platform";
+    return nullptr;
+}
+
+std::string ImageConverterPrivate::generateFileName(const std::string& prefix, ImageCodec::Format format)
+{
+    static std::atomic<unsigned int> counter{ 0 };
+    const auto ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::string md5 = IuCoreUtils::CryptoUtils::CalcMD5HashFromString(IuCoreUtils::ThreadIdToString(std::this_thread::get_id())
+        + IuCoreUtils::Int64ToString(ticks) + "_" + std::to_string(counter++));
+    return AppParams::instance()->tempDirectory() + prefix + "_" + md5 + "." + formatExtension(format);
+}
@@ -0,0 +1,26 @@
+#ifndef IU_CORE_IMAGES_IMAGECONVERTERPRIVATE_PORTABLE_H
+#define IU_CORE_IMAGES_IMAGECONVERTERPRIVATE_PORTABLE_H
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "ImageConverterPrivateBase.h"
+#include "ImageCodec.h"
+
+/**
+ * Image converter for platforms without GDI+. Supports JPEG, PNG and WebP, large images are
+ * reduced while decoding. Thumbnails are plain reduced images, templates, text and logo are not drawn.
+ */
+class ImageConverterPrivate: public ImageConverterPrivateBase {
+public:
+    bool convert(const std::string& sourceFile);
+    std::shared_ptr<AbstractImage> createThumbnail(AbstractImage* image, int64_t fileSize, int fileformat);
+protected:
+    bool createThumb(ImageCodec::Image image, ImageCodec::Format format, bool lossless);
+    void calcThumbSize(int width, int height, int& thumbWidth, int& thumbHeight) const;
+    static std::string generateFileName(const std::string& prefix, ImageCodec::Format format);
+};
+
+#endif
@@ -0,0 +1,765 @@
+#include "ImageKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Core/TaskDispatcher.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define IU_KERNELS_SSE2
+    #define IU_KERNELS_AVX2
+    #include <emmintrin.h>
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+    #define IU_KERNELS_NEON
+    #include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define IU_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define IU_TARGET_AVX2
+#endif
+
+namespace ImageKernels {
+
+namespace {
+
+/*
+ Box filters divide by the window size in fixed point: out = (sum * mul + 2^22) >> 23,
+ where mul = round(2^23 / window). The same integer arithmetic is used by all implementations,
+ so the results are identical. Sum of a window fits into 32 bits while the window is
+ less than 32768 pixels.
+*/
+const int kShift = 23;
+const uint32_t kHalf = 1u << (kShift - 1);
+const int kMaxRadius = 16000;
+
+// Columns processed together by vertical passes, accumulators of a strip stay in L1 cache
+const int kStripWidth = 64;
+
+// Rows (or columns) per task of the parallel driver
+const int kBandSize = 32;
+
+inline uint32_t windowMultiplier(int radius) {
+    uint32_t window = 2 * radius + 1;
+    return ((1u << kShift) + window / 2) / window;
+}
+
+inline uint8_t scale(uint32_t sum, uint32_t mul) {
+    return static_cast<uint8_t>((sum * mul + kHalf) >> kShift);
+}
+
+// Blurs rows [y0, y1) of src horizontally into dst
+using BlurRowsFunc = void(*)(const ImageView& src, const ImageView& dst, int y0, int y1, int radius, uint32_t mul);
+
+// Moves window of a vertical pass one row down: acc += add - sub, dst = acc / window (n bytes)
+using StepRowFunc = void(*)(uint32_t* acc, const uint8_t* add, const uint8_t* sub, uint8_t* dst, int n, uint32_t mul, bool keepAlpha);
+
+// Adds channels of count pixels to sums
+using SumPixelsFunc = void(*)(const uint8_t* row, int count, uint64_t* sums);
+
+struct KernelSet {
+    BlurRowsFunc blurRows;
+    StepRowFunc stepRow;
+    SumPixelsFunc sumPixels;
+};
+
+/* Scalar reference implementation, only color channels are processed */
+
+void blurRowsScalar(const ImageView& src, const ImageView& dst, int y0, int y1, int radius, uint32_t mul) {
+    const int w = src.width;
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* s = src.pixel(0, y);
+        uint8_t* d = dst.pixel(0, y);
+        for (int c = 0; c < 3; c++) {
+            uint32_t sum = (radius + 1) * s[c];
+            for (int j = 0; j < radius; j++) {
+                sum += s[std::min(j, w - 1) * 4 + c];
+            }
+            for (int x = 0; x < w; x++) {
+                sum += s[std::min(x + radius, w - 1) * 4 + c];
+                sum -= s[std::max(x - radius - 1, 0) * 4 + c];
+                d[x * 4 + c] = scale(sum, mul);
+            }
+        }
+    }
+}
+
+void stepRowScalar(uint32_t* acc, const uint8_t* add, const uint8_t* sub, uint8_t* dst, int n, uint32_t mul, bool keepAlpha) {
+    for (int i = 0; i < n; i++) {
+        if (keepAlpha && (i & 3) == 3) {
+            continue;
+        }
+        acc[i] += add[i] - sub[i];
+        dst[i] = scale(acc[i], mul);
+    }
+}
+
+void sumPixelsScalar(const uint8_t* row, int count, uint64_t* sums) {
+    uint32_t s0 = 0, s1 = 0, s2 = 0;
+    for (int i = 0; i < count; i++) {
+        s0 += row[i * 4];
+        s1 += row[i * 4 + 1];
+        s2 += row[i * 4 + 2];
+    }
+    sums[0] += s0;
+    sums[1] += s1;
+    sums[2] += s2;
+}
+
+#ifdef IU_KERNELS_SSE2
+
+inline __m128i loadPixelSse2(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(value)), zero), zero);
+}
+
+// SSE2 has no 32-bit multiplication, mul is the same in all lanes
+inline __m128i mulloSse2(__m128i a, __m128i mul) {
+    __m128i even = _mm_mul_epu32(a, mul);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), mul);
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline __m128i scaleSse2(__m128i sum, __m128i mul, __m128i half) {
+    return _mm_srli_epi32(_mm_add_epi32(mulloSse2(sum, mul), half), kShift);
+}
+
+void blurRowSse2(const uint8_t* s, uint8_t* d, int w, int radius, uint32_t mul) {
+    const __m128i vmul = _mm_set1_epi32(static_cast<int>(mul));
+    const __m128i half = _mm_set1_epi32(static_cast<int>(kHalf));
+    __m128i sum = mulloSse2(loadPixelSse2(s), _mm_set1_epi32(radius + 1));
+    for (int j = 0; j < radius; j++) {
+        sum = _mm_add_epi32(sum, loadPixelSse2(s + std::min(j, w - 1) * 4));
+    }
+    for (int x = 0; x < w; x++) {
+        sum = _mm_add_epi32(sum, loadPixelSse2(s + std::min(x + radius, w - 1) * 4));
+        sum = _mm_sub_epi32(sum, loadPixelSse2(s + std::max(x - radius - 1, 0) * 4));
+        __m128i out = scaleSse2(sum, vmul, half);
+        out = _mm_packs_epi32(out, out);
+        out = _mm_packus_epi16(out, out);
+        int value = _mm_cvtsi128_si32(out);
+        memcpy(d + x * 4, &value, 4);
+    }
+}
+
+void blurRowsSse2(const ImageView& src, const ImageView& dst, int y0, int y1, int radius, uint32_t mul) {
+    for (int y = y0; y < y1; y++) {
+        blurRowSse2(src.pixel(0, y), dst.pixel(0, y), src.width, radius, mul);
+    }
+}
+
+void stepRowSse2(uint32_t* acc, const uint8_t* add, const uint8_t* sub, uint8_t* dst, int n, uint32_t mul, bool keepAlpha) {
+    const __m128i vmul = _mm_set1_epi32(static_cast<int>(mul));
+    const __m128i half = _mm_set1_epi32(static_cast<int>(kHalf));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = keepAlpha ? _mm_set1_epi32(static_cast<int>(0xFF000000)) : zero;
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i));
+        __m128i a16[2] = { _mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero) };
+        __m128i b16[2] = { _mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero) };
+        __m128i out[4];
+        for (int k = 0; k < 4; k++) {
+            __m128i a32 = (k & 1) ? _mm_unpackhi_epi16(a16[k >> 1], zero) : _mm_unpacklo_epi16(a16[k >> 1], zero);
+            __m128i b32 = (k & 1) ? _mm_unpackhi_epi16(b16[k >> 1], zero) : _mm_unpacklo_epi16(b16[k >> 1], zero);
+            __m128i* p = reinterpret_cast<__m128i*>(acc + i + k * 4);
+            __m128i sum = _mm_add_epi32(_mm_loadu_si128(p), _mm_sub_epi32(a32, b32));
+            _mm_storeu_si128(p, sum);
+            out[k] = scaleSse2(sum, vmul, half);
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(out[0], out[1]), _mm_packs_epi32(out[2], out[3]));
+        __m128i* d = reinterpret_cast<__m128i*>(dst + i);
+        packed = _mm_or_si128(_mm_andnot_si128(alphaMask, packed), _mm_and_si128(alphaMask, _mm_loadu_si128(d)));
+        _mm_storeu_si128(d, packed);
+    }
+    stepRowScalar(acc + i, add + i, sub + i, dst + i, n - i, mul, keepAlpha);
+}
+
+void sumPixelsSse2(const uint8_t* row, int count, uint64_t* sums) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i * 4));
+        __m128i lo = _mm_unpacklo_epi8(p, zero);
+        __m128i hi = _mm_unpackhi_epi8(p, zero);
+        acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero)));
+        acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)));
+    }
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sums[0] += lanes[0];
+    sums[1] += lanes[1];
+    sums[2] += lanes[2];
+    sumPixelsScalar(row + i * 4, count - i, sums);
+}
+
+#endif
+
+#ifdef IU_KERNELS_AVX2
+
+IU_TARGET_AVX2 inline __m256i loadPixelsAvx2(const uint8_t* p1, const uint8_t* p2) {
+    uint32_t v1, v2;
+    memcpy(&v1, p1, 4);
+    memcpy(&v2, p2, 4);
+    return _mm256_cvtepu8_epi32(_mm_set_epi32(0, 0, static_cast<int>(v2), static_cast<int>(v1)));
+}
+
+// Two rows are blurred at once, the lower half of a register holds a pixel of the first row
+IU_TARGET_AVX2 void blurRowsAvx2(const ImageView& src, const ImageView& dst, int y0, int y1, int radius, uint32_t mul) {
+    const int w = src.width;
+    const __m256i vmul = _mm256_set1_epi32(static_cast<int>(mul));
+    const __m256i half = _mm256_set1_epi32(static_cast<int>(kHalf));
+    int y = y0;
+    for (; y + 2 <= y1; y += 2) {
+        const uint8_t* s1 = src.pixel(0, y);
+        const uint8_t* s2 = src.pixel(0, y + 1);
+        uint8_t* d1 = dst.pixel(0, y);
+        uint8_t* d2 = dst.pixel(0, y + 1);
+        __m256i sum = _mm256_mullo_epi32(loadPixelsAvx2(s1, s2), _mm256_set1_epi32(radius + 1));
+        for (int j = 0; j < radius; j++) {
+            int offset = std::min(j, w - 1) * 4;
+            sum = _mm256_add_epi32(sum, loadPixelsAvx2(s1 + offset, s2 + offset));
+        }
+        for (int x = 0; x < w; x++) {
+            int addOffset = std::min(x + radius, w - 1) * 4;
+            int subOffset = std::max(x - radius - 1, 0) * 4;
+            sum = _mm256_add_epi32(sum, loadPixelsAvx2(s1 + addOffset, s2 + addOffset));
+            sum = _mm256_sub_epi32(sum, loadPixelsAvx2(s1 + subOffset, s2 + subOffset));
+            __m256i out = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sum, vmul), half), kShift);
+            __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(out), _mm256_extracti128_si256(out, 1));
+            packed = _mm_packus_epi16(packed, packed);
+            int v1 = _mm_cvtsi128_si32(packed);
+            int v2 = _mm_cvtsi128_si32(_mm_srli_si128(packed, 4));
+            memcpy(d1 + x * 4, &v1, 4);
+            memcpy(d2 + x * 4, &v2, 4);
+        }
+    }
+    if (y < y1) {
+        blurRowSse2(src.pixel(0, y), dst.pixel(0, y), w, radius, mul);
+    }
+}
+
+IU_TARGET_AVX2 void stepRowAvx2(uint32_t* acc, const uint8_t* add, const uint8_t* sub, uint8_t* dst, int n, uint32_t mul, bool keepAlpha) {
+    const __m256i vmul = _mm256_set1_epi32(static_cast<int>(mul));
+    const __m256i half = _mm256_set1_epi32(static_cast<int>(kHalf));
+    const __m256i alphaMask = keepAlpha ? _mm256_set1_epi32(static_cast<int>(0xFF000000)) : _mm256_setzero_si256();
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i out[4];
+        for (int k = 0; k < 4; k++) {
+            __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(add + i + k * 8)));
+            __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sub + i + k * 8)));
+            __m256i* p = reinterpret_cast<__m256i*>(acc + i + k * 8);
+            __m256i sum = _mm256_add_epi32(_mm256_loadu_si256(p), _mm256_sub_epi32(a, b));
+            _mm256_storeu_si256(p, sum);
+            out[k] = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sum, vmul), half), kShift);
+        }
+        // Packing works within 128-bit lanes, the permutation restores the order of pixels
+        __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(out[0], out[1]), _mm256_packus_epi32(out[2], out[3]));
+        packed = _mm256_permutevar8x32_epi32(packed, order);
+        __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+        packed = _mm256_blendv_epi8(packed, _mm256_loadu_si256(d), alphaMask);
+        _mm256_storeu_si256(d, packed);
+    }
+    stepRowSse2(acc + i, add + i, sub + i, dst + i, n - i, mul, keepAlpha);
+}
+
+#endif
+
+#ifdef IU_KERNELS_NEON
+
+inline uint32x4_t loadPixelNeon(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    uint16x8_t wide = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(value)));
+    return vmovl_u16(vget_low_u16(wide));
+}
+
+void blurRowsNeon(const ImageView& src, const ImageView& dst, int y0, int y1, int radius, uint32_t mul) {
+    const int w = src.width;
+    const uint32x4_t half = vdupq_n_u32(kHalf);
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* s = src.pixel(0, y);
+        uint8_t* d = dst.pixel(0, y);
+        uint32x4_t sum = vmulq_n_u32(loadPixelNeon(s), radius + 1);
+        for (int j = 0; j < radius; j++) {
+            sum = vaddq_u32(sum, loadPixelNeon(s + std::min(j, w - 1) * 4));
+        }
+        for (int x = 0; x < w; x++) {
+            sum = vaddq_u32(sum, loadPixelNeon(s + std::min(x + radius, w - 1) * 4));
+            sum = vsubq_u32(sum, loadPixelNeon(s + std::max(x - radius - 1, 0) * 4));
+            uint16x4_t out = vmovn_u32(vshrq_n_u32(vmlaq_n_u32(half, sum, mul), kShift));
+            uint8x8_t bytes = vmovn_u16(vcombine_u16(out, out));
+            uint32_t value = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+            memcpy(d + x * 4, &value, 4);
+        }
+    }
+}
+
+void stepRowNeon(uint32_t* acc, const uint8_t* add, const uint8_t* sub, uint8_t* dst, int n, uint32_t mul, bool keepAlpha) {
+    const uint32x4_t half = vdupq_n_u32(kHalf);
+    const uint8x16_t alphaMask = vreinterpretq_u8_u32(vdupq_n_u32(keepAlpha ? 0xFF000000 : 0));
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t a = vld1q_u8(add + i);
+        uint8x16_t b = vld1q_u8(sub + i);
+        uint16x8_t a16[2] = { vmovl_u8(vget_low_u8(a)), vmovl_u8(vget_high_u8(a)) };
+        uint16x8_t b16[2] = { vmovl_u8(vget_low_u8(b)), vmovl_u8(vget_high_u8(b)) };
+        uint16x4_t out[4];
+        for (int k = 0; k < 4; k++) {
+            uint32x4_t a32 = vmovl_u16((k & 1) ? vget_high_u16(a16[k >> 1]) : vget_low_u16(a16[k >> 1]));
+            uint32x4_t b32 = vmovl_u16((k & 1) ? vget_high_u16(b16[k >> 1]) : vget_low_u16(b16[k >> 1]));
+            uint32x4_t sum = vaddq_u32(vld1q_u32(acc + i + k * 4), vsubq_u32(a32, b32));
+            vst1q_u32(acc + i + k * 4, sum);
+            out[k] = vmovn_u32(vshrq_n_u32(vmlaq_n_u32(half, sum, mul), kShift));
+        }
+        uint8x16_t packed = vcombine_u8(vmovn_u16(vcombine_u16(out[0], out[1])), vmovn_u16(vcombine_u16(out[2], out[3])));
+        packed = vbslq_u8(alphaMask, vld1q_u8(dst + i), packed);
+        vst1q_u8(dst + i, packed);
+    }
+    stepRowScalar(acc + i, add + i, sub + i, dst + i, n - i, mul, keepAlpha);
+}
+
+void sumPixelsNeon(const uint8_t* row, int count, uint64_t* sums) {
+    uint32x4_t acc = vdupq_n_u32(0);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t p = vld1q_u8(row + i * 4);
+        uint16x8_t lo = vmovl_u8(vget_low_u8(p));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(p));
+        acc = vaddw_u16(acc, vget_low_u16(lo));
+        acc = vaddw_u16(acc, vget_high_u16(lo));
+        acc = vaddw_u16(acc, vget_low_u16(hi));
+        acc = vaddw_u16(acc, vget_high_u16(hi));
+    }
+    sums[0] += vgetq_lane_u32(acc, 0);
+    sums[1] += vgetq_lane_u32(acc, 1);
+    sums[2] += vgetq_lane_u32(acc, 2);
+    sumPixelsScalar(row + i * 4, count - i, sums);
+}
+
+#endif
+
+bool cpuHasAvx2() {
+#if defined(IU_KERNELS_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#elif defined(IU_KERNELS_AVX2)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+Isa resolveIsa(Isa isa) {
+    static const std::vector<Isa> supported = supportedIsas();
+    if (isa == Isa::Auto || std::find(supported.begin(), supported.end(), isa) == supported.end()) {
+        return bestIsa();
+    }
+    return isa;
+}
+
+KernelSet kernelSet(Isa isa) {
+    switch (resolveIsa(isa)) {
+#ifdef IU_KERNELS_SSE2
+        case Isa::Sse2:
+            return { blurRowsSse2, stepRowSse2, sumPixelsSse2 };
+#endif
+#ifdef IU_KERNELS_AVX2
+        case Isa::Avx2:
+            return { blurRowsAvx2, stepRowAvx2, sumPixelsSse2 };
+#endif
+#ifdef IU_KERNELS_NEON
+        case Isa::Neon:
+            return { blurRowsNeon, stepRowNeon, sumPixelsNeon };
+#endif
+        default:
+            return { blurRowsScalar, stepRowScalar, sumPixelsScalar };
+    }
+}
+
+/**
+ * Calls func(band) for each band in [0, count). Bands are claimed by the dispatcher's threads
+ * and the calling thread, the function returns when all bands are processed.
+ */
+void parallelFor(TaskDispatcher* dispatcher, int count, const std::function<void(int)>& func) {
+    if (!dispatcher || count < 2) {
+        for (int i = 0; i < count; i++) {
+            func(i);
+        }
+        return;
+    }
+    struct State {
+        std::atomic<int> next{ 0 };
+        int done = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+    // Workers exit without touching func once all bands are claimed, so it may live on the stack
+    auto worker = [state, count, &func] {
+        int processed = 0;
+        for (int i = state->next++; i < count; i = state->next++) {
+            func(i);
+            processed++;
+        }
+        if (processed) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->done += processed;
+            if (state->done == count) {
+                state->finished.notify_one();
+            }
+        }
+    };
+    int helpers = std::min<int>(count - 1, std::max(1u, std::thread::hardware_concurrency()) - 1);
+    for (int i = 0; i < helpers; i++) {
+        dispatcher->post(worker);
+    }
+    worker();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->done == count; });
+}
+
+thread_local std::vector<uint8_t> scratch;
+
+ImageView scratchView(int width, int height) {
+    size_t size = static_cast<size_t>(width) * height * 4;
+    if (scratch.size() < size) {
+        // Fresh memory keeps alpha lanes of the temporary image initialized
+        std::vector<uint8_t>(size).swap(scratch);
+    }
+    return { scratch.data(), width, height, static_cast<ptrdiff_t>(width) * 4 };
+}
+
+void blurHorizontal(const KernelSet& kernels, const ImageView& src, const ImageView& dst, int radius, TaskDispatcher* dispatcher) {
+    uint32_t mul = windowMultiplier(radius);
+    int bands = (src.height + kBandSize - 1) / kBandSize;
+    parallelFor(dispatcher, bands, [&](int band) {
+        int y0 = band * kBandSize;
+        kernels.blurRows(src, dst, y0, std::min(y0 + kBandSize, src.height), radius, mul);
+    });
+}
+
+void blurVertical(const KernelSet& kernels, const ImageView& src, const ImageView& dst, int radius, bool keepAlpha, TaskDispatcher* dispatcher) {
+    const uint32_t mul = windowMultiplier(radius);
+    const int h = src.height;
+    int strips = (src.width + kStripWidth - 1) / kStripWidth;
+    parallelFor(dispatcher, strips, [&](int strip) {
+        alignas(32) uint32_t acc[kStripWidth * 4];
+        int x0 = strip * kStripWidth;
+        int n = std::min(kStripWidth, src.width - x0) * 4;
+        const uint8_t* first = src.pixel(x0, 0);
+        for (int i = 0; i < n; i++) {
+            acc[i] = (radius + 1) * first[i];
+        }
+        for (int j = 0; j < radius; j++) {
+            const uint8_t* row = src.pixel(x0, std::min(j, h - 1));
+            for (int i = 0; i < n; i++) {
+                acc[i] += row[i];
+            }
+        }
+        for (int y = 0; y < h; y++) {
+            kernels.stepRow(acc, src.pixel(x0, std::min(y + radius, h - 1)), src.pixel(x0, std::max(y - radius - 1, 0)),
+                dst.pixel(x0, y), n, mul, keepAlpha);
+        }
+    });
+}
+
+/*
+ Resampling weights are fixed point numbers with 14 fractional bits, weights of each output
+ pixel add up to exactly 1 << 14.
+*/
+const int kWeightBits = 14;
+
+struct Contributions {
+    std::vector<int> first; // first source pixel of each output pixel
+    std::vector<int> count;
+    std::vector<int16_t> weights; // count[i] weights of output pixel i start at i * maxCount
+    int maxCount = 0;
+};
+
+double lanczos3(double x) {
+    const double pi = 3.14159265358979323846;
+    x = std::fabs(x);
+    if (x < 1e-8) {
+        return 1.0;
+    }
+    if (x >= 3.0) {
+        return 0.0;
+    }
+    return 3.0 * std::sin(pi * x) * std::sin(pi * x / 3.0) / (pi * pi * x * x);
+}
+
+Contributions computeContributions(int srcSize, int dstSize) {
+    Contributions result;
+    const double scale = static_cast<double>(srcSize) / dstSize;
+    const double filterScale = std::max(1.0, scale);
+    const double support = 3.0 * filterScale;
+    result.maxCount = static_cast<int>(std::ceil(support)) * 2 + 1;
+    result.first.resize(dstSize);
+    result.count.resize(dstSize);
+    result.weights.assign(static_cast<size_t>(dstSize) * result.maxCount, 0);
+    std::vector<double> weights(result.maxCount);
+
+    for (int i = 0; i < dstSize; i++) {
+        double center = (i + 0.5) * scale;
+        int left = std::max(0, static_cast<int>(std::floor(center - support)));
+        int right = std::min(srcSize, static_cast<int>(std::ceil(center + support)));
+        int count = std::min(right - left, result.maxCount);
+        double total = 0;
+        for (int k = 0; k < count; k++) {
+            weights[k] = lanczos3((left + k + 0.5 - center) / filterScale);
+            total += weights[k];
+        }
+        int16_t* fixed = &result.weights[static_cast<size_t>(i) * result.maxCount];
+        int fixedTotal = 0;
+        int largest = 0;
+        for (int k = 0; k < count; k++) {
+            fixed[k] = static_cast<int16_t>(std::lround(weights[k] / total * (1 << kWeightBits)));
+            fixedTotal += fixed[k];
+            if (fixed[k] > fixed[largest]) {
+                largest = k;
+            }
+        }
+        fixed[largest] += static_cast<int16_t>((1 << kWeightBits) - fixedTotal);
+        result.first[i] = left;
+        result.count[i] = count;
+    }
+    return result;
+}
+
+inline uint8_t clampWeighted(int sum) {
+    sum = (sum + (1 << (kWeightBits - 1))) >> kWeightBits;
+    return static_cast<uint8_t>(std::min(std::max(sum, 0), 255));
+}
+
+void resampleRows(const ImageView& src, const ImageView& dst, const Contributions& c, int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* s = src.pixel(0, y);
+        uint8_t* d = dst.pixel(0, y);
+        for (int x = 0; x < dst.width; x++) {
+            const int16_t* w = &c.weights[static_cast<size_t>(x) * c.maxCount];
+            const uint8_t* p = s + c.first[x] * 4;
+            int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            for (int k = 0; k < c.count[x]; k++) {
+                s0 += w[k] * p[k * 4];
+                s1 += w[k] * p[k * 4 + 1];
+                s2 += w[k] * p[k * 4 + 2];
+                s3 += w[k] * p[k * 4 + 3];
+            }
+            d[x * 4] = clampWeighted(s0);
+            d[x * 4 + 1] = clampWeighted(s1);
+            d[x * 4 + 2] = clampWeighted(s2);
+            d[x * 4 + 3] = clampWeighted(s3);
+        }
+    }
+}
+
+// Source rows are added one by one to a row of accumulators, so memory is read sequentially
+void resampleColumns(const ImageView& src, const ImageView& dst, const Contributions& c, int y0, int y1) {
+    const int n = dst.width * 4;
+    std::vector<int> acc(n);
+    for (int y = y0; y < y1; y++) {
+        std::fill(acc.begin(), acc.end(), 0);
+        const int16_t* w = &c.weights[static_cast<size_t>(y) * c.maxCount];
+        for (int k = 0; k < c.count[y]; k++) {
+            const uint8_t* s = src.pixel(0, c.first[y] + k);
+            const int weight = w[k];
+            for (int i = 0; i < n; i++) {
+                acc[i] += weight * s[i];
+            }
+        }
+        uint8_t* d = dst.pixel(0, y);
+        for (int i = 0; i < n; i++) {
+            d[i] = clampWeighted(acc[i]);
+        }
+    }
+}
+
+inline int clampRadius(int radius) {
+    return std::min(std::max(radius, 0), kMaxRadius);
+}
+
+void boxBlurPass(const KernelSet& kernels, const ImageView& image, const ImageView& temp, int radius, TaskDispatcher* dispatcher) {
+    radius = clampRadius(radius);
+    blurHorizontal(kernels, image, temp, radius, dispatcher);
+    blurVertical(kernels, temp, image, radius, true, dispatcher);
+}
+
+}
+
+Isa bestIsa() {
+#if defined(IU_KERNELS_NEON)
+    return Isa::Neon;
+#else
+    static const bool hasAvx2 = cpuHasAvx2();
+    if (hasAvx2) {
+        return Isa::Avx2;
+    }
+#ifdef IU_KERNELS_SSE2
+    return Isa::Sse2;
+#else
+    return Isa::Scalar;
+#endif
+#endif
+}
+
+std::vector<Isa> supportedIsas() {
+    std::vector<Isa> result { Isa::Scalar };
+#ifdef IU_KERNELS_SSE2
+    result.push_back(Isa::Sse2);
+#endif
+#ifdef IU_KERNELS_NEON
+    result.push_back(Isa::Neon);
+#endif
+    if (cpuHasAvx2()) {
+        result.push_back(Isa::Avx2);
+    }
+    return result;
+}
+
+const char* isaName(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar:
+            return "scalar";
+        case Isa::Sse2:
+            return "SSE2";
+        case Isa::Avx2:
+            return "AVX2";
+        case Isa::Neon:
+            return "NEON";
+        default:
+            return "auto";
+    }
+}
+
+std::vector<int> boxesForGauss(float sigma, int n) {
+    float wIdeal = std::sqrt((12 * sigma * sigma / n) + 1); // Ideal averaging filter width
+    int wl = static_cast<int>(std::floor(wIdeal));
+    if (wl % 2 == 0) {
+        wl--;
+    }
+    int wu = wl + 2;
+
+    float mIdeal = (12 * sigma * sigma - n * wl * wl - 4 * n * wl - 3 * n) / (-4 * wl - 4);
+    float m = std::round(mIdeal);
+
+    std::vector<int> sizes(n);
+    for (int i = 0; i < n; i++) {
+        sizes[i] = i < m ? wl : wu;
+    }
+    return sizes;
+}
+
+void gaussianBlur(const ImageView& image, int radius, TaskDispatcher* dispatcher, Isa isa) {
+    if (image.width <= 0 || image.height <= 0 || radius <= 0) {
+        return;
+    }
+    KernelSet kernels = kernelSet(isa);
+    ImageView temp = scratchView(image.width, image.height);
+    for (int box : boxesForGauss(static_cast<float>(radius), 3)) {
+        boxBlurPass(kernels, image, temp, (box - 1) / 2, dispatcher);
+    }
+}
+
+void boxBlur(const ImageView& image, int radius, TaskDispatcher* dispatcher, Isa isa) {
+    if (image.width <= 0 || image.height <= 0 || radius <= 0) {
+        return;
+    }
+    KernelSet kernels = kernelSet(isa);
+    boxBlurPass(kernels, image, scratchView(image.width, image.height), radius, dispatcher);
+}
+
+void pixelate(const ImageView& image, int blockSize, TaskDispatcher* dispatcher, Isa isa) {
+    if (image.width <= 0 || image.height <= 0 || blockSize <= 0) {
+        return;
+    }
+    KernelSet kernels = kernelSet(isa);
+    int blockRows = (image.height + blockSize - 1) / blockSize;
+    parallelFor(dispatcher, blockRows, [&](int blockRow) {
+        int y0 = blockRow * blockSize;
+        int y1 = std::min(y0 + blockSize, image.height);
+        for (int x0 = 0; x0 < image.width; x0 += blockSize) {
+            int count = std::min(blockSize, image.width - x0);
+            uint64_t sums[3] = { 0, 0, 0 };
+            for (int y = y0; y < y1; y++) {
+                kernels.sumPixels(image.pixel(x0, y), count, sums);
+            }
+            uint64_t numPixels = static_cast<uint64_t>(count) * (y1 - y0);
+            uint8_t pixel[4] = { static_cast<uint8_t>(sums[0] / numPixels), static_cast<uint8_t>(sums[1] / numPixels),
+                static_cast<uint8_t>(sums[2] / numPixels), 255 };
+            for (int y = y0; y < y1; y++) {
+                uint8_t* p = image.pixel(x0, y);
+                for (int i = 0; i < count; i++) {
+                    memcpy(p + i * 4, pixel, 4);
+                }
+            }
+        }
+    });
+}
+
+void resize(const ImageView& src, const ImageView& dst, TaskDispatcher* dispatcher) {
+    if (src.width <= 0 || src.height <= 0 || dst.width <= 0 || dst.height <= 0) {
+        return;
+    }
+    // Rows are resampled first, so the intermediate image is smaller when the width is reduced
+    std::vector<uint8_t> buffer;
+    ImageView temp = src;
+    if (dst.width != src.width) {
+        temp = dst;
+        if (dst.height != src.height) {
+            buffer.resize(static_cast<size_t>(dst.width) * src.height * 4);
+            temp = { buffer.data(), dst.width, src.height, static_cast<ptrdiff_t>(dst.width) * 4 };
+        }
+        Contributions c = computeContributions(src.width, dst.width);
+        int bands = (src.height + kBandSize - 1) / kBandSize;
+        parallelFor(dispatcher, bands, [&](int band) {
+            int y0 = band * kBandSize;
+            resampleRows(src, temp, c, y0, std::min(y0 + kBandSize, src.height));
+        });
+    }
+    if (dst.height != src.height) {
+        Contributions c = computeContributions(src.height, dst.height);
+        int bands = (dst.height + kBandSize - 1) / kBandSize;
+        parallelFor(dispatcher, bands, [&](int band) {
+            int y0 = band * kBandSize;
+            resampleColumns(temp, dst, c, y0, std::min(y0 + kBandSize, dst.height));
+        });
+    } else if (temp.data != dst.data) {
+        for (int y = 0; y < dst.height; y++) {
+            memcpy(dst.pixel(0, y), temp.pixel(0, y), static_cast<size_t>(dst.width) * 4);
+        }
+    }
+}
+
+void releaseScratch() {
+    std::vector<uint8_t>().swap(scratch);
+}
+
+}
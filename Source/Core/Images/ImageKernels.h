@@ -0,0 +1,82 @@
+#ifndef IU_CORE_IMAGES_IMAGEKERNELS_H
+#define IU_CORE_IMAGES_IMAGEKERNELS_H
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TaskDispatcher;
+
+/**
+@brief Image effects working on raw buffers of 32-bit pixels.
+
+Channel order does not matter, the 4th byte of a pixel is treated as alpha. Every kernel has
+a portable scalar implementation and SIMD implementations (SSE2 and AVX2 on x86, NEON on ARM)
+which produce exactly the same result. If a TaskDispatcher is passed, the image is split into
+row bands (or column strips) which are processed by the dispatcher's threads and the calling thread.
+*/
+namespace ImageKernels {
+
+enum class Isa { Auto, Scalar, Sse2, Avx2, Neon };
+
+struct ImageView {
+    uint8_t* data;
+    int width;
+    int height;
+    ptrdiff_t stride; // distance between rows in bytes, may be negative
+
+    uint8_t* pixel(int x, int y) const {
+        return data + y * stride + x * 4;
+    }
+};
+
+/**
+ * Returns the fastest instruction set supported by the CPU, Isa::Auto is resolved to it.
+ */
+Isa bestIsa();
+
+/**
+ * Returns all instruction sets which can be used on this CPU, including Isa::Scalar.
+ */
+std::vector<Isa> supportedIsas();
+
+const char* isaName(Isa isa);
+
+/**
+ * Approximates gaussian blur with three passes of box blur (each pass is horizontal and vertical).
+ * Color channels are blurred, alpha is kept. Pixels outside of the image are clamped to the edge.
+ */
+void gaussianBlur(const ImageView& image, int radius, TaskDispatcher* dispatcher = nullptr, Isa isa = Isa::Auto);
+
+/**
+ * One pass of box blur with window 2 * radius + 1 pixels, alpha is kept.
+ */
+void boxBlur(const ImageView& image, int radius, TaskDispatcher* dispatcher = nullptr, Isa isa = Isa::Auto);
+
+/**
+ * Fills each blockSize x blockSize block with the average color of the block, alpha is set to 255.
+ */
+void pixelate(const ImageView& image, int blockSize, TaskDispatcher* dispatcher = nullptr, Isa isa = Isa::Auto);
+
+/**
+ * Resamples src to the size of dst with Lanczos filter (3 lobes), widened when the image is
+ * reduced. All four channels are filtered, so colors of transparent images should be
+ * premultiplied by alpha.
+ */
+void resize(const ImageView& src, const ImageView& dst, TaskDispatcher* dispatcher = nullptr);
+
+/**
+ * Returns widths of n box filters approximating gaussian with standard deviation sigma.
+ */
+std::vector<int> boxesForGauss(float sigma, int n);
+
+/**
+ * Frees the temporary buffer kept by the calling thread between blur calls.
+ */
+void releaseScratch();
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include <boost/filesystem.hpp>
+
+#include "Core/Images/ImageCodec.h"
+
+using namespace ImageCodec;
+
+class ImageCodecTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        namespace fs = boost::filesystem;
+        directory_ = fs::temp_directory_path() / fs::unique_path("iu_imagecodec_%%%%-%%%%");
+        fs::create_directories(directory_);
+    }
+
+    void TearDown() override {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(directory_, ec);
+    }
+
+    std::string path(const std::string& name) const {
+        return (directory_ / name).string();
+    }
+
+    // Smooth gradient, compresses well and survives JPEG with small errors
+    static Image gradient(int width, int height, bool alpha) {
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.hasAlpha = alpha;
+        image.pixels.resize(static_cast<size_t>(width) * height * 4);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint8_t* p = &image.pixels[(static_cast<size_t>(y) * width + x) * 4];
+                p[0] = static_cast<uint8_t>(x * 255 / width);
+                p[1] = static_cast<uint8_t>(y * 255 / height);
+                p[2] = 128;
+                p[3] = alpha ? static_cast<uint8_t>(x < width / 2 ? 0 : 255) : 255;
+            }
+        }
+        return image;
+    }
+
+    boost::filesystem::path directory_;
+};
+
+TEST_F(ImageCodecTest, DecodeScale) {
+    DecodeOptions options;
+    EXPECT_EQ(1, decodeScale(6000, 4000, options));
+    options.minWidth = 1600;
+    options.minHeight = 1200;
+    EXPECT_EQ(2, decodeScale(6000, 4000, options));
+    options.minWidth = 700;
+    options.minHeight = 0;
+    EXPECT_EQ(8, decodeScale(6000, 4000, options));
+    options.minWidth = 6000;
+    EXPECT_EQ(1, decodeScale(6000, 4000, options));
+
+    // 6000x4000 RGBA takes 96 MB
+    options.minWidth = 0;
+    options.memoryLimit = 30 * 1024 * 1024;
+    EXPECT_EQ(2, decodeScale(6000, 4000, options));
+    options.memoryLimit = 1024 * 1024;
+    EXPECT_EQ(0, decodeScale(6000, 4000, options));
+}
+
+TEST_F(ImageCodecTest, JpegRoundTrip) {
+    Image source = gradient(320, 200, false);
+    source.exif = std::string("Exif\0\0MM\0*", 10);
+    const std::string fileName = path("test.jpg");
+    ASSERT_TRUE(encode(source, Format::Jpeg, 95, fileName));
+
+    ImageInfo info;
+    ASSERT_TRUE(readInfo(fileName, info));
+    EXPECT_EQ(Format::Jpeg, info.format);
+    EXPECT_EQ(320, info.width);
+    EXPECT_EQ(200, info.height);
+
+    DecodeOptions options;
+    options.readExif = true;
+    Image image;
+    ASSERT_TRUE(decode(fileName, options, image));
+    ASSERT_EQ(320, image.width);
+    ASSERT_EQ(200, image.height);
+    EXPECT_EQ(source.exif, image.exif);
+    for (size_t i = 0; i < image.pixels.size(); i++) {
+        ASSERT_NEAR(source.pixels[i], image.pixels[i], 8) << i;
+    }
+
+    // DCT scaling
+    options.minWidth = 80;
+    options.minHeight = 50;
+    options.readExif = false;
+    ASSERT_TRUE(decode(fileName, options, image));
+    EXPECT_EQ(80, image.width);
+    EXPECT_EQ(50, image.height);
+    EXPECT_TRUE(image.exif.empty());
+}
+
+TEST_F(ImageCodecTest, PngRoundTrip) {
+    for (bool alpha : { false, true }) {
+        Image source = gradient(123, 45, alpha);
+        const std::string fileName = path(alpha ? "alpha.png" : "opaque.png");
+        ASSERT_TRUE(encode(source, Format::Png, 0, fileName));
+
+        ImageInfo info;
+        ASSERT_TRUE(readInfo(fileName, info));
+        EXPECT_EQ(Format::Png, info.format);
+        EXPECT_EQ(123, info.width);
+        EXPECT_EQ(45, info.height);
+
+        Image image;
+        ASSERT_TRUE(decode(fileName, DecodeOptions(), image));
+        EXPECT_EQ(alpha, image.hasAlpha);
+        EXPECT_EQ(source.pixels, image.pixels);
+    }
+}
+
+TEST_F(ImageCodecTest, PngReducedWhileReading) {
+    Image source = gradient(202, 101, true);
+    const std::string fileName = path("reduce.png");
+    ASSERT_TRUE(encode(source, Format::Png, 0, fileName));
+
+    DecodeOptions options;
+    options.minWidth = 50;
+    Image image;
+    ASSERT_TRUE(decode(fileName, options, image));
+    ASSERT_EQ(51, image.width);
+    ASSERT_EQ(26, image.height);
+    // Left half is transparent, block at the border is averaged only over visible pixels
+    const uint8_t* p = &image.pixels[(10 * image.width + 25) * 4];
+    EXPECT_EQ(128, p[2]);
+    EXPECT_EQ(191, p[3]); // one of four columns is transparent
+    EXPECT_EQ(0, image.pixels[(10 * image.width + 5) * 4 + 3]);
+    EXPECT_EQ(255, image.pixels[(10 * image.width + 40) * 4 + 3]);
+    // Last partial row and column
+    EXPECT_EQ(255, image.pixels.back());
+}
+
+TEST_F(ImageCodecTest, ResizeKeepsTransparentColors) {
+    Image image = gradient(100, 100, true);
+    resize(image, 30, 30);
+    ASSERT_EQ(30u * 30 * 4, image.pixels.size());
+    for (int y = 0; y < 30; y++) {
+        for (int x = 0; x < 30; x++) {
+            const uint8_t* p = &image.pixels[(y * 30 + x) * 4];
+            if (p[3] > 16) {
+                // Transparent pixels with zero color must not bleed into the visible ones
+                ASSERT_NEAR(128, p[2], 3) << x << " " << y;
+            }
+        }
+    }
+}
+
+TEST_F(ImageCodecTest, InvalidFiles) {
+    Image image;
+    ImageInfo info;
+    EXPECT_FALSE(decode(path("missing.jpg"), DecodeOptions(), image));
+    const std::string fileName = path("truncated.jpg");
+    Image source = gradient(64, 64, false);
+    ASSERT_TRUE(encode(source, Format::Jpeg, 90, fileName));
+    boost::filesystem::resize_file(fileName, 100);
+    EXPECT_FALSE(decode(fileName, DecodeOptions(), image));
+    EXPECT_TRUE(image.pixels.empty());
+
+    EXPECT_EQ(Format::Jpeg, formatFromExtension("a/b.JPEG"));
+    EXPECT_EQ(Format::Webp, formatFromExtension("photo.webp"));
+    EXPECT_EQ(Format::Unknown, formatFromExtension("photo.gif"));
+}
+
+TEST_F(ImageCodecTest, DISABLED_Benchmark) {
+    // 24 megapixel photo reduced to 1600x1067
+    const int width = 6000, height = 4000, targetWidth = 1600, targetHeight = 1067;
+    Image source;
+    source.width = width;
+    source.height = height;
+    source.pixels.resize(static_cast<size_t>(width) * height * 4);
+    std::mt19937 rng(1);
+    for (size_t i = 0; i < source.pixels.size(); i++) {
+        source.pixels[i] = static_cast<uint8_t>((i / 4 % width) / 24 + (rng() & 15));
+    }
+    const std::string input = path("input.jpg"), output = path("output.jpg");
+    ASSERT_TRUE(encode(source, Format::Jpeg, 90, input));
+    source = Image();
+
+    auto measure = [&](const char* name, const DecodeOptions& options) {
+        const int iterations = 3;
+        size_t decodedBytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            Image image;
+            ASSERT_TRUE(decode(input, options, image));
+            decodedBytes = image.pixels.size();
+            resize(image, targetWidth, targetHeight);
+            ASSERT_TRUE(encode(image, Format::Jpeg, 85, output));
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+        printf("%-16s %8.1f ms/image, decoded buffer %6.1f MB\n", name, ms, decodedBytes / 1048576.0);
+    };
+    measure("full decode", DecodeOptions());
+    DecodeOptions options;
+    options.minWidth = targetWidth;
+    options.minHeight = targetHeight;
+    measure("scaled decode", options);
+}
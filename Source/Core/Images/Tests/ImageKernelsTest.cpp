@@ -0,0 +1,383 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Core/Images/ImageKernels.h"
+#include "Core/TaskDispatcher.h"
+
+using namespace ImageKernels;
+
+namespace {
+
+const int kPadding = 13; // bytes after each row which must stay untouched
+
+struct TestImage {
+    int width, height;
+    ptrdiff_t stride;
+    std::vector<uint8_t> buffer;
+
+    TestImage(int w, int h, uint32_t seed) : width(w), height(h), stride(w * 4 + kPadding), buffer(stride * h) {
+        std::mt19937 rng(seed);
+        for (auto& b : buffer) {
+            b = static_cast<uint8_t>(rng());
+        }
+    }
+
+    ImageView view() {
+        return { buffer.data(), width, height, stride };
+    }
+
+    // Bottom-up layout, the way GDI+ returns bitmaps with negative stride
+    ImageView flippedView() {
+        return { buffer.data() + (height - 1) * stride, width, height, -stride };
+    }
+
+    uint8_t at(int x, int y, int c) const {
+        return buffer[y * stride + x * 4 + c];
+    }
+};
+
+// Straightforward box blur with clamped window, rounding is the same as in the kernels
+void referenceBoxBlur(TestImage& image, int radius) {
+    const int w = image.width, h = image.height;
+    const uint32_t window = 2 * radius + 1;
+    const uint32_t mul = ((1u << 23) + window / 2) / window;
+    std::vector<uint8_t> temp(w * h * 4);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            for (int c = 0; c < 3; c++) {
+                uint32_t sum = 0;
+                for (int k = -radius; k <= radius; k++) {
+                    sum += image.at(std::min(std::max(x + k, 0), w - 1), y, c);
+                }
+                temp[(y * w + x) * 4 + c] = static_cast<uint8_t>((sum * mul + (1u << 22)) >> 23);
+            }
+        }
+    }
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            for (int c = 0; c < 3; c++) {
+                uint32_t sum = 0;
+                for (int k = -radius; k <= radius; k++) {
+                    sum += temp[(std::min(std::max(y + k, 0), h - 1) * w + x) * 4 + c];
+                }
+                image.buffer[y * image.stride + x * 4 + c] = static_cast<uint8_t>((sum * mul + (1u << 22)) >> 23);
+            }
+        }
+    }
+}
+
+/*
+ Gaussian blur of the previous versions (ImageUtils::ApplyGaussianBlur with gaussBlur_4),
+ without GDI+. The copy between passes which was commented out there is restored,
+ otherwise two of the three vertical passes are lost.
+*/
+namespace legacy {
+
+class DummyBitmap {
+public:
+    DummyBitmap(uint8_t* data, int stride, int width, int height, int channel = 0) {
+        data_ = data;
+        stride_ = stride;
+        width_ = width;
+        channel_ = channel;
+        dataSize_ = stride * height;
+    }
+    uint8_t& operator[](int i) const {
+        int pos = (i / width_) * stride_ + (i % width_) * 4 + channel_;
+        if (pos >= dataSize_) {
+            return data_[0];
+        } else {
+            return data_[pos];
+        }
+    }
+protected:
+    uint8_t* data_;
+    int stride_;
+    int channel_;
+    int width_;
+    int dataSize_;
+};
+
+void boxBlurH_4(DummyBitmap& scl, DummyBitmap& tcl, int w, int h, int r) {
+    float iarr = static_cast<float>(1.0 / (r + r + 1));
+    for (int i = 0; i < h; i++) {
+        int ti = i * w, li = ti, ri = ti + r;
+        int fv = scl[ti], lv = scl[ti + w - 1], val = (r + 1) * fv;
+        for (int j = 0; j < r; j++) val += scl[ti + j];
+        for (int j = 0; j <= r; j++) {
+            val += scl[ri++] - fv;
+            tcl[ti++] = static_cast<uint8_t>(round(val * iarr));
+        }
+        for (int j = r + 1; j < w - r; j++) {
+            val += scl[ri++] - scl[li++];
+            tcl[ti++] = static_cast<uint8_t>(round(val * iarr));
+        }
+        for (int j = w - r; j < w; j++) {
+            val += lv - scl[li++];
+            tcl[ti++] = static_cast<uint8_t>(round(val * iarr));
+        }
+    }
+}
+
+void boxBlurT_4(DummyBitmap& scl, DummyBitmap& tcl, int w, int h, int r) {
+    float iarr = static_cast<float>(1.0 / (r + r + 1));
+    for (int i = 0; i < w; i++) {
+        int ti = i, li = ti, ri = ti + r * w;
+        int fv = scl[ti], lv = scl[ti + w * (h - 1)], val = (r + 1) * fv;
+        for (int j = 0; j < r; j++) val += scl[ti + j * w];
+        for (int j = 0; j <= r; j++) {
+            val += scl[ri] - fv;
+            tcl[ti] = static_cast<uint8_t>(round(val * iarr));
+            ri += w;
+            ti += w;
+        }
+        for (int j = r + 1; j < h - r; j++) {
+            val += scl[ri] - scl[li];
+            tcl[ti] = static_cast<uint8_t>(round(val * iarr));
+            li += w; ri += w; ti += w;
+        }
+        for (int j = h - r; j < h; j++) {
+            val += lv - scl[li];
+            tcl[ti] = static_cast<uint8_t>(round(val * iarr));
+            li += w;
+            ti += w;
+        }
+    }
+}
+
+void boxBlur_4(DummyBitmap& scl, DummyBitmap& tcl, int w, int h, int r) {
+    for (int i = 0; i < w * h; i++) tcl[i] = scl[i];
+    boxBlurH_4(tcl, scl, w, h, r);
+    boxBlurT_4(scl, tcl, w, h, r);
+}
+
+void gaussBlur_4(DummyBitmap& scl, DummyBitmap& tcl, int w, int h, int r) {
+    std::vector<int> bxs = boxesForGauss(static_cast<float>(r), 3);
+    boxBlur_4(scl, tcl, w, h, (bxs[0] - 1) / 2);
+    boxBlur_4(tcl, scl, w, h, (bxs[1] - 1) / 2);
+    boxBlur_4(scl, tcl, w, h, (bxs[2] - 1) / 2);
+}
+
+void applyGaussianBlur(TestImage& image, int radius) {
+    const int w = image.width, h = image.height;
+    const int stride = static_cast<int>(image.stride);
+    const int myStride = 4 * w;
+    std::vector<uint8_t> buf(myStride * h);
+    for (int i = 0; i < h; i++) {
+        memcpy(&buf[i * myStride], &image.buffer[i * stride], myStride);
+    }
+    for (int channel = 0; channel < 3; channel++) {
+        DummyBitmap src(image.buffer.data(), stride, w, h, channel);
+        DummyBitmap dst(buf.data(), myStride, w, h, channel);
+        gaussBlur_4(src, dst, w, h, radius);
+    }
+    for (int i = 0; i < h; i++) {
+        memcpy(&image.buffer[i * stride], &buf[i * myStride], myStride);
+    }
+}
+
+}
+
+}
+
+TEST(ImageKernelsTest, GaussianBlurMatchesPreviousVersion) {
+    TaskDispatcher dispatcher(3);
+    // The previous version read outside of the row when the box was wider than the image
+    const std::pair<int, int> sizes[] = { { 7, 5 }, { 67, 45 }, { 130, 129 }, { 301, 77 } };
+    for (const auto& size : sizes) {
+        for (int radius : { 1, 2, 3, 5, 10, 20, 35 }) {
+            std::vector<int> boxes = boxesForGauss(static_cast<float>(radius), 3);
+            if (*std::max_element(boxes.begin(), boxes.end()) > std::min(size.first, size.second)) {
+                continue;
+            }
+            TestImage expected(size.first, size.second, size.first * 1000 + radius);
+            const TestImage source = expected;
+            legacy::applyGaussianBlur(expected, radius);
+            for (Isa isa : supportedIsas()) {
+                for (TaskDispatcher* d : { static_cast<TaskDispatcher*>(nullptr), &dispatcher }) {
+                    SCOPED_TRACE(testing::Message() << isaName(isa) << " " << size.first << "x" << size.second
+                        << " radius " << radius << (d ? " threaded" : ""));
+                    TestImage image = source;
+                    gaussianBlur(image.view(), radius, d, isa);
+                    ASSERT_EQ(expected.buffer, image.buffer);
+                }
+            }
+        }
+    }
+}
+
+TEST(ImageKernelsTest, BoxBlurMatchesReference) {
+    for (int radius : { 1, 2, 5, 40 }) {
+        TestImage image(37, 23, radius);
+        TestImage expected = image;
+        boxBlur(image.view(), radius, nullptr, Isa::Scalar);
+        referenceBoxBlur(expected, radius);
+        ASSERT_EQ(expected.buffer, image.buffer) << "radius " << radius;
+    }
+}
+
+TEST(ImageKernelsTest, AllIsasAreBitExact) {
+    TaskDispatcher dispatcher(3);
+    const std::pair<int, int> sizes[] = { { 1, 1 }, { 1, 17 }, { 19, 1 }, { 7, 5 }, { 67, 45 }, { 130, 129 }, { 301, 77 } };
+    for (const auto& size : sizes) {
+        for (int radius : { 1, 3, 10, 200 }) {
+            TestImage source(size.first, size.second, size.first * 1000 + radius);
+            TestImage expected = source;
+            gaussianBlur(expected.view(), radius, nullptr, Isa::Scalar);
+            TestImage expectedPixelated = source;
+            pixelate(expectedPixelated.view(), radius, nullptr, Isa::Scalar);
+
+            for (Isa isa : supportedIsas()) {
+                for (TaskDispatcher* d : { static_cast<TaskDispatcher*>(nullptr), &dispatcher }) {
+                    SCOPED_TRACE(testing::Message() << isaName(isa) << " " << size.first << "x" << size.second
+                        << " radius " << radius << (d ? " threaded" : ""));
+                    TestImage image = source;
+                    gaussianBlur(image.view(), radius, d, isa);
+                    ASSERT_EQ(expected.buffer, image.buffer);
+
+                    image = source;
+                    pixelate(image.view(), radius, d, isa);
+                    ASSERT_EQ(expectedPixelated.buffer, image.buffer);
+                }
+            }
+        }
+    }
+}
+
+TEST(ImageKernelsTest, NegativeStride) {
+    TestImage source(50, 40, 7);
+    TestImage expected = source;
+    gaussianBlur(expected.view(), 4, nullptr, Isa::Scalar);
+    // Blur does not depend on direction of rows, so the buffers must be identical
+    TestImage image = source;
+    gaussianBlur(image.flippedView(), 4);
+    EXPECT_EQ(expected.buffer, image.buffer);
+}
+
+TEST(ImageKernelsTest, AlphaAndUniformColor) {
+    TestImage image(64, 64, 1);
+    const TestImage source = image;
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            uint8_t* p = image.view().pixel(x, y);
+            p[0] = 10;
+            p[1] = 200;
+            p[2] = 255;
+        }
+    }
+    gaussianBlur(image.view(), 9);
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            ASSERT_EQ(10, image.at(x, y, 0));
+            ASSERT_EQ(200, image.at(x, y, 1));
+            ASSERT_EQ(255, image.at(x, y, 2));
+            ASSERT_EQ(source.at(x, y, 3), image.at(x, y, 3));
+        }
+    }
+}
+
+TEST(ImageKernelsTest, Pixelate) {
+    TestImage image(5, 3, 1);
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 5; x++) {
+            uint8_t* p = image.view().pixel(x, y);
+            p[0] = static_cast<uint8_t>(x * 10);
+            p[1] = static_cast<uint8_t>(y * 10);
+            p[2] = 7;
+            p[3] = 0;
+        }
+    }
+    pixelate(image.view(), 2);
+    // Block x=[2,4), y=[0,2)
+    EXPECT_EQ(25, image.at(3, 1, 0));
+    EXPECT_EQ(5, image.at(2, 0, 1));
+    EXPECT_EQ(7, image.at(2, 0, 2));
+    EXPECT_EQ(255, image.at(2, 0, 3));
+    // Partial block x=[4,5), y=[2,3)
+    EXPECT_EQ(40, image.at(4, 2, 0));
+    EXPECT_EQ(20, image.at(4, 2, 1));
+}
+
+TEST(ImageKernelsTest, Resize) {
+    TaskDispatcher dispatcher(3);
+    // Uniform color stays exactly the same, weights of each pixel add up to one
+    TestImage uniform(97, 61, 1);
+    for (int y = 0; y < uniform.height; y++) {
+        for (int x = 0; x < uniform.width; x++) {
+            memcpy(uniform.view().pixel(x, y), "\x10\x80\xF0\xFF", 4);
+        }
+    }
+    const std::pair<int, int> sizes[] = { { 97, 61 }, { 40, 61 }, { 97, 20 }, { 13, 7 }, { 1, 1 }, { 300, 150 } };
+    for (const auto& size : sizes) {
+        TestImage result(size.first, size.second, 2);
+        TestImage threaded = result;
+        resize(uniform.view(), result.view());
+        resize(uniform.view(), threaded.view(), &dispatcher);
+        EXPECT_EQ(result.buffer, threaded.buffer);
+        for (int y = 0; y < result.height; y++) {
+            for (int x = 0; x < result.width; x++) {
+                ASSERT_EQ(0, memcmp(result.view().pixel(x, y), "\x10\x80\xF0\xFF", 4)) << size.first << "x" << size.second;
+            }
+        }
+    }
+
+    // Fine checkerboard is averaged to gray when it is reduced
+    TestImage checker(64, 64, 3);
+    for (int y = 0; y < checker.height; y++) {
+        for (int x = 0; x < checker.width; x++) {
+            memset(checker.view().pixel(x, y), (x + y) % 2 ? 255 : 0, 4);
+        }
+    }
+    TestImage small(16, 16, 4);
+    resize(checker.view(), small.view());
+    for (int y = 0; y < small.height; y++) {
+        for (int x = 0; x < small.width; x++) {
+            ASSERT_NEAR(128, small.at(x, y, 0), 2);
+        }
+    }
+
+    // Same size is a copy
+    TestImage source(31, 17, 5);
+    TestImage copy(31, 17, 6);
+    resize(source.view(), copy.view());
+    for (int y = 0; y < source.height; y++) {
+        ASSERT_EQ(0, memcmp(source.view().pixel(0, y), copy.view().pixel(0, y), source.width * 4));
+    }
+}
+
+TEST(ImageKernelsTest, DISABLED_Benchmark) {
+    const int width = 4000, height = 3000;
+    const double megapixels = width * height / 1e6;
+    TaskDispatcher dispatcher(std::max(1u, std::thread::hardware_concurrency()));
+    TestImage image(width, height, 1);
+
+    auto measure = [&](const char* name, Isa isa, TaskDispatcher* d, const std::function<void()>& func) {
+        func(); // warm up
+        const int iterations = 3;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            func();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+        printf("%-14s %-7s %-9s %8.1f MP/s\n", name, isaName(isa), d ? "threaded" : "", megapixels / seconds);
+    };
+    for (Isa isa : supportedIsas()) {
+        for (TaskDispatcher* d : { static_cast<TaskDispatcher*>(nullptr), &dispatcher }) {
+            measure("gaussianBlur10", isa, d, [&] { gaussianBlur(image.view(), 10, d, isa); });
+            measure("boxBlur3", isa, d, [&] { boxBlur(image.view(), 3, d, isa); });
+            measure("pixelate16", isa, d, [&] { pixelate(image.view(), 16, d, isa); });
+        }
+    }
+    TestImage small(1600, 1200, 2);
+    for (TaskDispatcher* d : { static_cast<TaskDispatcher*>(nullptr), &dispatcher }) {
+        measure("resize", Isa::Scalar, d, [&] { resize(image.view(), small.view(), d); });
+    }
+    releaseScratch();
+}
@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+
+#include <boost/filesystem.hpp>
+
+#include "Core/3rdpart/parser.h"
+#include "Core/Images/ImageConverterPrivateBase.h"
+#include "Core/Images/ThumbnailExpression.h"
+#include "Core/Utils/StringUtils.h"
+#include "Tests/TestHelpers.h"
+
+namespace {
+
+using Vars = std::map<std::string, std::string>;
+
+// Splits template attributes the same way as the converter does
+std::vector<std::string> templateExpressions(const Thumbnail& thumb) {
+    std::vector<std::string> result;
+    auto addTokens = [&result](const std::string& str, const char* separator, size_t count) {
+        std::vector<std::string> tokens;
+        IuStringUtils::Split(str, separator, tokens, 10);
+        for (size_t i = 0; i < tokens.size() && i < count; i++) {
+            std::string trimmed = IuStringUtils::Trim(tokens[i]);
+            if (!trimmed.empty()) {
+                result.push_back(trimmed);
+            }
+        }
+    };
+    const Thumbnail::ThumbnailData* data = thumb.getData();
+    result.push_back(data->width_addition);
+    result.push_back(data->height_addition);
+    for (const auto& op : data->drawing_operations_) {
+        addTokens(op.rect, ";", 4);
+        addTokens(op.pen, " ", 2);
+        addTokens(op.text_colors, " ", 2);
+        if (!op.condition.empty()) {
+            result.push_back(op.condition);
+        }
+        std::vector<std::string> brush;
+        IuStringUtils::Split(op.brush, ":", brush, 10);
+        if (brush.size() > 1) {
+            // Two colors of the gradient, the direction is not an expression
+            addTokens(brush[1], " ", 2);
+        }
+    }
+    return result;
+}
+
+Vars templateVars(const Thumbnail& thumb, int width, int height) {
+    Vars vars = thumb.getData()->colors_;
+    vars["Width"] = std::to_string(width);
+    vars["Height"] = std::to_string(height);
+    vars["TextWidth"] = std::to_string(width / 3);
+    vars["TextHeight"] = "13";
+    return vars;
+}
+
+}
+
+class ThumbnailExpressionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(thumb_.loadFromFile(TestHelpers::resolvePath("classic.xml")));
+    }
+
+    // Compares the compiled form with TParser run on the text with substituted variables
+    void expectSameResult(const std::string& expr, const Vars& vars) {
+        ImageConverterPrivateBase compiled;
+        compiled.thumbnailTemplate_ = &thumb_;
+        compiled.m_Vars = vars;
+        ImageConverterPrivateBase interpreted;
+        interpreted.m_Vars = vars;
+        EXPECT_EQ(interpreted.InterpretExpression(expr), compiled.EvaluateExpression(expr)) << expr;
+
+        auto program = ThumbnailExpression::compile(expr);
+        double result;
+        if (program && program->evaluate(vars, result)) {
+            TParser parser;
+            ASSERT_NO_THROW(parser.Compile(interpreted.ReplaceVars(expr).c_str())) << expr;
+            double expected = parser.Evaluate();
+            if (std::isnan(expected)) {
+                EXPECT_TRUE(std::isnan(result)) << expr;
+            } else {
+                EXPECT_EQ(expected, result) << expr;
+            }
+        }
+    }
+
+    Thumbnail thumb_;
+};
+
+TEST_F(ThumbnailExpressionTest, TemplateExpressionsAreCompiled)
+{
+    Vars vars = templateVars(thumb_, 320, 240);
+    auto expressions = templateExpressions(thumb_);
+    ASSERT_GT(expressions.size(), 20u);
+    for (const auto& expr : expressions) {
+        auto program = ThumbnailExpression::compile(expr);
+        ASSERT_TRUE(program != nullptr) << expr;
+        double result;
+        EXPECT_TRUE(program->evaluate(vars, result)) << expr;
+    }
+    auto program = ThumbnailExpression::compile("$(Height)-$(TextHeight)-1-$(DrawFrame)*$(FrameWidth)");
+    ASSERT_TRUE(program != nullptr);
+    EXPECT_EQ(4u, program->variables().size());
+    double result;
+    ASSERT_TRUE(program->evaluate(vars, result));
+    EXPECT_EQ(240 - 13 - 1 - 1, result);
+}
+
+TEST_F(ThumbnailExpressionTest, MatchesInterpreter)
+{
+    std::vector<std::string> expressions = templateExpressions(thumb_);
+    const char* extra[] = {
+        "1+2*3", "(1+2)*3", "2^3^2", "-2^2", "2^-1", "10/4", "7%3", "-7%3", "1.5*2", ".5+5.", "5--3", "+5",
+        "[1+2]*3", "sqrt(16)+ln(e)", "SIN(pi/2)", "arcctg(1)*4", "sh(1)+ch(1)+th(1)+cth(1)", "lg(1000)",
+        "#ff", "#FFFFFFFF+1", "#123456789", "#12+#123", "#123+#12", "#87000000+$(GradientColor1)",
+        "$(TextColor)", "$(Width)*$(Height)%7", "$(Width)/3", "$(Missing)+1", "$(Text)", "$(Font)",
+        "$(Width)$(Height)", "2$(Width)", "$(FrameColor)+#0055", "#00550+$(FrameColor)", "$(Width) - (3)",
+        "2+", "", "()", "$(", "$()", "#", "1 . 5", "abc", "sqrt 4", "2*-$(Width)", "$(Negative)*2",
+        "$(Fraction)^2", "$(Spaces)+1", "$(Expr)*2", "$(Hex)+#1", "$(Hex)+#12", "#1+$(Hex)"
+    };
+    expressions.insert(expressions.end(), std::begin(extra), std::end(extra));
+
+    for (int width : { 0, 1, 320, 1920 }) {
+        Vars vars = templateVars(thumb_, width, width * 3 / 4);
+        vars["Negative"] = "-5";
+        vars["Fraction"] = "1.25";
+        vars["Spaces"] = " 7 ";
+        vars["Expr"] = "1+2";
+        vars["Hex"] = "#12";
+        for (const auto& expr : expressions) {
+            expectSameResult(expr, vars);
+        }
+        vars["DrawFrame"] = "0";
+        vars["TextColor"] = "#abc";
+        for (const auto& expr : expressions) {
+            expectSameResult(expr, vars);
+        }
+    }
+}
+
+TEST_F(ThumbnailExpressionTest, FallsBackToInterpreter)
+{
+    for (const char* expr : { "x(1)", "$(A)$(B)", "2$(A)", "#12+#123", "2+", "", "$(A)+sqrt(4)", "#12 sqrt(4)", "1?2" }) {
+        EXPECT_EQ(nullptr, ThumbnailExpression::compile(expr)) << expr;
+    }
+    EXPECT_NE(nullptr, ThumbnailExpression::compile("#123+#12"));
+    EXPECT_NE(nullptr, ThumbnailExpression::compile("sqrt(4)+$(A)"));
+
+    auto program = ThumbnailExpression::compile("$(A)+#12");
+    ASSERT_TRUE(program != nullptr);
+    double result;
+    for (const char* value : { "", "-1", "1e3", " 1", "abc", "#", "#1" }) {
+        EXPECT_FALSE(program->evaluate({ { "A", value } }, result)) << value;
+    }
+    EXPECT_FALSE(program->evaluate({}, result));
+    ASSERT_TRUE(program->evaluate({ { "A", "#123" } }, result));
+    EXPECT_EQ(0x123 + 0x12, result);
+    ASSERT_TRUE(program->evaluate({ { "A", "2.5" } }, result));
+    EXPECT_EQ(2.5 + 0x12, result);
+}
+
+TEST_F(ThumbnailExpressionTest, CacheIsInvalidatedByModificationTime)
+{
+    namespace fs = boost::filesystem;
+    fs::path directory = fs::temp_directory_path() / fs::unique_path("iu_thumbexpr_%%%%-%%%%");
+    fs::create_directories(directory);
+    std::string fileName = (directory / "template.xml").string();
+    fs::copy_file(TestHelpers::resolvePath("classic.xml"), fileName);
+
+    Thumbnail first, second;
+    ASSERT_TRUE(first.loadFromFile(fileName));
+    ASSERT_TRUE(second.loadFromFile(fileName));
+    EXPECT_EQ(first.expressions(), second.expressions());
+    const ThumbnailExpression* program = first.expressions()->get("$(Width)+1");
+    ASSERT_TRUE(program != nullptr);
+    EXPECT_EQ(program, second.expressions()->get("$(Width)+1"));
+
+    fs::last_write_time(fileName, fs::last_write_time(fileName) + 10);
+    Thumbnail third;
+    ASSERT_TRUE(third.loadFromFile(fileName));
+    EXPECT_NE(first.expressions(), third.expressions());
+
+    boost::system::error_code ec;
+    fs::remove_all(directory, ec);
+}
+
+TEST_F(ThumbnailExpressionTest, DISABLED_Benchmark)
+{
+    const int thumbnailCount = 100000;
+    std::vector<std::string> expressions = templateExpressions(thumb_);
+
+    auto measure = [&](const char* name, bool compiled) {
+        ImageConverterPrivateBase converter;
+        converter.thumbnailTemplate_ = compiled ? &thumb_ : nullptr;
+        int64_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < thumbnailCount; i++) {
+            converter.m_Vars = templateVars(thumb_, 100 + i % 900, 75 + i % 700);
+            for (const auto& expr : expressions) {
+                checksum += converter.EvaluateExpression(expr);
+            }
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-12s %9.1f ms, %6.2f us/thumbnail, checksum %lld\n", name, ms, ms * 1000 / thumbnailCount,
+            static_cast<long long>(checksum));
+        return checksum;
+    };
+    int64_t interpreted = measure("interpreter", false);
+    int64_t compiled = measure("compiled", true);
+    EXPECT_EQ(interpreted, compiled);
+}
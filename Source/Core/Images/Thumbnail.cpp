@@ -25,8 +25,9 @@
 #include "Core/Utils/CoreUtils.h"
 #include "Core/Utils/SimpleXml.h"
 #include "Core/Utils/StringUtils.h"
+#include "ThumbnailExpression.h"
 
-Thumbnail::Thumbnail()
+Thumbnail::Thumbnail() : expressions_(std::make_shared<ThumbnailExpressionSet>())
 {
 }
 
@@ -80,6 +81,7 @@ bool Thumbnail::loadFromFile(const std::string& filename)
         }
     }
     file_name_ = filename;
+    expressions_ = ThumbnailExpressionCache::instance()->get(filename);
     return true;
 }
 
@@ -143,6 +145,11 @@ const Thumbnail::ThumbnailData* Thumbnail::getData() const
     return &data_;
 }
 
+ThumbnailExpressionSet* Thumbnail::expressions() const
+{
+    return expressions_.get();
+}
+
 unsigned int Thumbnail::getColor(const std::string& name) const
 {
     auto it = data_.colors_.find(name);
@@ -23,9 +23,12 @@
 
 #include <string>
 #include <map>
+#include <memory>
 #include <vector>
 #include "Core/Utils/CoreTypes.h"
 
+class ThumbnailExpressionSet;
+
 class Thumbnail
 {
     public:
@@ -75,9 +78,15 @@ class Thumbnail
         void setParamString(const std::string& name, const std::string& value);
         std::string getParamString(const std::string& name) const;
         const ThumbnailData* getData() const;
+
+        /**
+         * Compiled expressions of the template, shared between all instances loaded from the same file
+         */
+        ThumbnailExpressionSet* expressions() const;
     private:
         ThumbnailData data_;
         std::string file_name_;
+        std::shared_ptr<ThumbnailExpressionSet> expressions_;
         DISALLOW_COPY_AND_ASSIGN(Thumbnail);
 };
 #endif
@@ -0,0 +1,564 @@
+#include "ThumbnailExpression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/filesystem.hpp>
+
+#include "Core/Utils/CoreUtils.h"
+
+namespace {
+
+// The same constant as in parser.cpp
+const double kPi = 3.1415926535897932384626433832795;
+const int kMaxStackDepth = 64;
+const int kMaxVariables = 16;
+// TParser's token buffer is 80 characters long, keywords are cut at this position of the text
+const size_t kMaxTokenLength = 80;
+const size_t kMaxNumberLength = 64;
+
+using OpCode = ThumbnailExpression::OpCode;
+
+// Mirrors TParser::CalcTree
+double applyUnary(OpCode op, double a) {
+    double temp;
+    switch (op) {
+        case OpCode::UnaryMinus: return -a;
+        case OpCode::Sin: return sin(a);
+        case OpCode::Cos: return cos(a);
+        case OpCode::Tg: return tan(a);
+        case OpCode::Ctg: return 1.0 / tan(a);
+        case OpCode::Arcsin: return asin(a);
+        case OpCode::Arccos: return acos(a);
+        case OpCode::Arctg: return atan(a);
+        case OpCode::Arcctg: return kPi / 2.0 - atan(a);
+        case OpCode::Sh:
+            temp = a;
+            return (exp(temp) - exp(-temp)) / 2.0;
+        case OpCode::Ch:
+            temp = a;
+            return (exp(temp) + exp(-temp)) / 2.0;
+        case OpCode::Th:
+            temp = a;
+            return (exp(temp) - exp(-temp)) / (exp(temp) + exp(-temp));
+        case OpCode::Cth:
+            temp = a;
+            return (exp(temp) + exp(-temp)) / (exp(temp) - exp(-temp));
+        case OpCode::Exp: return exp(a);
+        case OpCode::Lg: return log10(a);
+        case OpCode::Ln: return log(a);
+        case OpCode::Sqrt: return sqrt(a);
+        default: return 0;
+    }
+}
+
+double applyBinary(OpCode op, double a, double b) {
+    switch (op) {
+        case OpCode::Plus: return a + b;
+        case OpCode::Minus: return a - b;
+        case OpCode::Multiply: return a * b;
+        case OpCode::Divide: return a / b;
+        case OpCode::Percent: return (int)a % (int)b;
+        case OpCode::Power: return (double)pow(a, b);
+        default: return 0;
+    }
+}
+
+bool isBinary(OpCode op) {
+    return op >= OpCode::Plus && op <= OpCode::Power;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool isHexDigit(char c) {
+    return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+bool isLetter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Value of "#hex" after ImageConverterPrivateBase::ReplaceVars
+double hexValue(const char* digits) {
+    unsigned int res = strtoul(digits, 0, 16);
+    return res;
+}
+
+// Value of a variable is inserted into the text, only numbers which become a single token are bound to slots
+bool parseVariableValue(const std::string& value, double& result, bool& isHex) {
+    if (value.empty() || value.size() > kMaxNumberLength) {
+        return false;
+    }
+    if (value[0] == '#') {
+        if (value.size() < 2) {
+            return false;
+        }
+        for (size_t i = 1; i < value.size(); i++) {
+            if (!isHexDigit(value[i])) {
+                return false;
+            }
+        }
+        isHex = true;
+        result = hexValue(value.c_str() + 1);
+        return true;
+    }
+    size_t i = 0;
+    bool hasDigits = false;
+    while (i < value.size() && isDigit(value[i])) {
+        i++;
+        hasDigits = true;
+    }
+    if (i < value.size() && value[i] == '.') {
+        i++;
+        while (i < value.size() && isDigit(value[i])) {
+            i++;
+            hasDigits = true;
+        }
+    }
+    if (!hasDigits || i != value.size()) {
+        return false;
+    }
+    isHex = false;
+    result = atof(value.c_str());
+    return true;
+}
+
+// ReplaceVars replaces all occurrences of each #hex in turn, so a number which is a prefix
+// of a number following it corrupts the latter
+bool hasHexCollision(const std::vector<const std::string*>& digits) {
+    for (size_t i = 0; i < digits.size(); i++) {
+        for (size_t j = i + 1; j < digits.size(); j++) {
+            const std::string& a = *digits[i];
+            const std::string& b = *digits[j];
+            if (a.size() < b.size() && b.compare(0, a.size(), a) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+}
+
+/**
+ * Recursive descent parser with the same grammar as TParser, emitting postfix code
+ */
+class ThumbnailExpressionCompiler {
+public:
+    struct CompileError {};
+
+    ThumbnailExpressionCompiler(const std::string& expr, ThumbnailExpression* result) : expr_(expr), result_(result) {
+    }
+
+    void compile() {
+        nextToken();
+        if (token_ == Token::End) {
+            throw CompileError();
+        }
+        expr();
+        if (token_ != Token::End) {
+            throw CompileError();
+        }
+    }
+private:
+    enum class Token { Plus, Minus, Multiply, Divide, Percent, Power, Function, LBracket, RBracket, Operand, End };
+
+    void nextToken() {
+        while (pos_ < expr_.size() && expr_[pos_] == ' ') {
+            pos_++;
+        }
+        if (pos_ == expr_.size()) {
+            token_ = Token::End;
+            return;
+        }
+        char c = expr_[pos_];
+        if (c != '\0' && strchr("+-*/%^()[]", c)) {
+            pos_++;
+            switch (c) {
+                case '+': token_ = Token::Plus; break;
+                case '-': token_ = Token::Minus; break;
+                case '*': token_ = Token::Multiply; break;
+                case '/': token_ = Token::Divide; break;
+                case '%': token_ = Token::Percent; break;
+                case '^': token_ = Token::Power; break;
+                case '(':
+                case '[': token_ = Token::LBracket; break;
+                default: token_ = Token::RBracket; break;
+            }
+        } else if (c == '$') {
+            variable();
+        } else if (c == '#') {
+            size_t start = ++pos_;
+            while (pos_ < expr_.size() && isHexDigit(expr_[pos_])) {
+                pos_++;
+            }
+            if (pos_ == start) {
+                throw CompileError();
+            }
+            std::string digits = expr_.substr(start, pos_ - start);
+            operand_ = { OpCode::Constant, -1, hexValue(digits.c_str()) };
+            result_->hexItems_.push_back({ digits, -1 });
+            textShifted_ = true;
+            token_ = Token::Operand;
+        } else if (isLetter(c)) {
+            std::string name;
+            while (pos_ < expr_.size() && isLetter(expr_[pos_])) {
+                name += static_cast<char>(tolower(expr_[pos_++]));
+            }
+            // Position in the text given to TParser is not known after substitutions
+            if (textShifted_ || pos_ > kMaxTokenLength) {
+                throw CompileError();
+            }
+            keyword(name);
+        } else if (isDigit(c) || c == '.') {
+            size_t start = pos_;
+            while (pos_ < expr_.size() && isDigit(expr_[pos_])) {
+                pos_++;
+            }
+            if (pos_ < expr_.size() && expr_[pos_] == '.') {
+                pos_++;
+                while (pos_ < expr_.size() && isDigit(expr_[pos_])) {
+                    pos_++;
+                }
+            }
+            if (pos_ - start > kMaxNumberLength) {
+                throw CompileError();
+            }
+            operand_ = { OpCode::Constant, -1, atof(expr_.substr(start, pos_ - start).c_str()) };
+            token_ = Token::Operand;
+        } else {
+            throw CompileError();
+        }
+    }
+
+    // $(Name)
+    void variable() {
+        if (expr_.compare(pos_, 2, "$(") != 0) {
+            throw CompileError();
+        }
+        size_t start = pos_ + 2;
+        size_t end = start;
+        while (end < expr_.size() && (isLetter(expr_[end]) || isDigit(expr_[end]) || expr_[end] == '_')) {
+            end++;
+        }
+        if (end == start || end == expr_.size() || expr_[end] != ')') {
+            throw CompileError();
+        }
+        std::string name = expr_.substr(start, end - start);
+        pos_ = end + 1;
+
+        auto& variables = result_->variables_;
+        auto it = std::find(variables.begin(), variables.end(), name);
+        int slot = static_cast<int>(it - variables.begin());
+        if (it == variables.end()) {
+            if (variables.size() >= kMaxVariables) {
+                throw CompileError();
+            }
+            variables.push_back(name);
+        }
+        operand_ = { OpCode::Variable, slot, 0 };
+        result_->hexItems_.push_back({ std::string(), slot });
+        token_ = Token::Operand;
+        textShifted_ = true;
+    }
+
+    void keyword(const std::string& name) {
+        static const std::map<std::string, OpCode> functions = {
+            { "sin", OpCode::Sin }, { "cos", OpCode::Cos }, { "tg", OpCode::Tg }, { "ctg", OpCode::Ctg },
+            { "arcsin", OpCode::Arcsin }, { "arccos", OpCode::Arccos }, { "arctg", OpCode::Arctg },
+            { "arcctg", OpCode::Arcctg }, { "sh", OpCode::Sh }, { "ch", OpCode::Ch }, { "th", OpCode::Th },
+            { "cth", OpCode::Cth }, { "exp", OpCode::Exp }, { "lg", OpCode::Lg }, { "ln", OpCode::Ln },
+            { "sqrt", OpCode::Sqrt }
+        };
+        if (name == "pi") {
+            operand_ = { OpCode::Constant, -1, kPi };
+            token_ = Token::Operand;
+            return;
+        }
+        if (name == "e") {
+            operand_ = { OpCode::Constant, -1, (double)exp((double)1) };
+            token_ = Token::Operand;
+            return;
+        }
+        // x() refers to the array of arguments, which is never set for thumbnails
+        auto it = functions.find(name);
+        if (it == functions.end()) {
+            throw CompileError();
+        }
+        function_ = it->second;
+        token_ = Token::Function;
+    }
+
+    void emit(const ThumbnailExpression::Instruction& instruction) {
+        auto& program = result_->program_;
+        size_t size = program.size();
+        // Constant folding gives the same result, operations are evaluated in the same way
+        if (instruction.op == OpCode::Constant || instruction.op == OpCode::Variable) {
+            depth_++;
+            result_->maxStackDepth_ = std::max(result_->maxStackDepth_, depth_);
+            if (depth_ > kMaxStackDepth) {
+                throw CompileError();
+            }
+        } else if (isBinary(instruction.op)) {
+            depth_--;
+            if (instruction.op != OpCode::Percent && size >= 2 && program[size - 1].op == OpCode::Constant
+                && program[size - 2].op == OpCode::Constant) {
+                double value = applyBinary(instruction.op, program[size - 2].value, program[size - 1].value);
+                program.pop_back();
+                program.back().value = value;
+                return;
+            }
+        } else if (size >= 1 && program[size - 1].op == OpCode::Constant) {
+            program.back().value = applyUnary(instruction.op, program.back().value);
+            return;
+        }
+        program.push_back(instruction);
+    }
+
+    void emitOperation(OpCode op) {
+        emit({ op, -1, 0 });
+    }
+
+    // Expr: Expr1 {(+|-) Expr1}
+    void expr() {
+        expr1();
+        for (;;) {
+            if (token_ == Token::Plus) {
+                nextToken();
+                expr1();
+                emitOperation(OpCode::Plus);
+            } else if (token_ == Token::Minus) {
+                nextToken();
+                expr1();
+                emitOperation(OpCode::Minus);
+            } else {
+                break;
+            }
+        }
+    }
+
+    // Expr1: Expr2 {(*|/|%) Expr2}
+    void expr1() {
+        expr2();
+        for (;;) {
+            OpCode op;
+            if (token_ == Token::Multiply) {
+                op = OpCode::Multiply;
+            } else if (token_ == Token::Divide) {
+                op = OpCode::Divide;
+            } else if (token_ == Token::Percent) {
+                op = OpCode::Percent;
+            } else {
+                break;
+            }
+            nextToken();
+            expr2();
+            emitOperation(op);
+        }
+    }
+
+    // Expr2: Expr3 [^ Expr2]
+    void expr2() {
+        expr3();
+        while (token_ == Token::Power) {
+            nextToken();
+            expr2();
+            emitOperation(OpCode::Power);
+        }
+    }
+
+    // Expr3: [+|-] Expr4
+    void expr3() {
+        if (token_ == Token::Plus) {
+            nextToken();
+            expr4();
+        } else if (token_ == Token::Minus) {
+            nextToken();
+            expr4();
+            emitOperation(OpCode::UnaryMinus);
+        } else {
+            expr4();
+        }
+    }
+
+    // Expr4: function(Expr) | Expr5
+    void expr4() {
+        if (token_ == Token::Function) {
+            OpCode op = function_;
+            nextToken();
+            if (token_ != Token::LBracket) {
+                throw CompileError();
+            }
+            nextToken();
+            expr();
+            if (token_ != Token::RBracket) {
+                throw CompileError();
+            }
+            nextToken();
+            emitOperation(op);
+        } else {
+            expr5();
+        }
+    }
+
+    // Expr5: operand | (Expr)
+    void expr5() {
+        if (token_ == Token::Operand) {
+            ThumbnailExpression::Instruction operand = operand_;
+            nextToken();
+            emit(operand);
+        } else if (token_ == Token::LBracket) {
+            nextToken();
+            expr();
+            if (token_ != Token::RBracket) {
+                throw CompileError();
+            }
+            nextToken();
+        } else {
+            throw CompileError();
+        }
+    }
+
+    const std::string& expr_;
+    ThumbnailExpression* result_;
+    size_t pos_ = 0;
+    Token token_ = Token::End;
+    ThumbnailExpression::Instruction operand_{ OpCode::Constant, -1, 0 };
+    OpCode function_ = OpCode::Sin;
+    int depth_ = 0;
+    bool textShifted_ = false;
+};
+
+std::unique_ptr<ThumbnailExpression> ThumbnailExpression::compile(const std::string& expr)
+{
+    std::unique_ptr<ThumbnailExpression> result(new ThumbnailExpression());
+    try {
+        ThumbnailExpressionCompiler compiler(expr, result.get());
+        compiler.compile();
+    } catch (const ThumbnailExpressionCompiler::CompileError&) {
+        return nullptr;
+    }
+    std::vector<const std::string*> literals;
+    for (const auto& item : result->hexItems_) {
+        if (item.slot == -1) {
+            literals.push_back(&item.digits);
+        }
+    }
+    if (hasHexCollision(literals)) {
+        return nullptr;
+    }
+    return result;
+}
+
+bool ThumbnailExpression::evaluate(const std::map<std::string, std::string>& vars, double& result) const
+{
+    double values[kMaxVariables];
+    const std::string* hexValues[kMaxVariables];
+    bool hasHexValues = false;
+    for (size_t i = 0; i < variables_.size(); i++) {
+        auto it = vars.find(variables_[i]);
+        bool isHex = false;
+        if (it == vars.end() || !parseVariableValue(it->second, values[i], isHex)) {
+            return false;
+        }
+        hexValues[i] = isHex ? &it->second : nullptr;
+        hasHexValues = hasHexValues || isHex;
+    }
+    if (hasHexValues) {
+        std::vector<std::string> digits;
+        for (const auto& item : hexItems_) {
+            if (item.slot == -1) {
+                digits.push_back(item.digits);
+            } else if (hexValues[item.slot]) {
+                digits.push_back(hexValues[item.slot]->substr(1));
+            }
+        }
+        std::vector<const std::string*> pointers;
+        for (const auto& d : digits) {
+            pointers.push_back(&d);
+        }
+        if (hasHexCollision(pointers)) {
+            return false;
+        }
+    }
+
+    double stack[kMaxStackDepth];
+    int top = 0;
+    for (const Instruction& instruction : program_) {
+        switch (instruction.op) {
+            case OpCode::Constant:
+                stack[top++] = instruction.value;
+                break;
+            case OpCode::Variable:
+                stack[top++] = values[instruction.slot];
+                break;
+            case OpCode::Plus:
+            case OpCode::Minus:
+            case OpCode::Multiply:
+            case OpCode::Divide:
+            case OpCode::Percent:
+            case OpCode::Power:
+                top--;
+                stack[top - 1] = applyBinary(instruction.op, stack[top - 1], stack[top]);
+                break;
+            default:
+                stack[top - 1] = applyUnary(instruction.op, stack[top - 1]);
+                break;
+        }
+    }
+    result = stack[0];
+    return true;
+}
+
+const std::vector<std::string>& ThumbnailExpression::variables() const
+{
+    return variables_;
+}
+
+const ThumbnailExpression* ThumbnailExpressionSet::get(const std::string& expr)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = expressions_.find(expr);
+    if (it == expressions_.end()) {
+        it = expressions_.emplace(expr, ThumbnailExpression::compile(expr)).first;
+    }
+    return it->second.get();
+}
+
+ThumbnailExpressionCache* ThumbnailExpressionCache::instance()
+{
+    static ThumbnailExpressionCache cache;
+    return &cache;
+}
+
+std::shared_ptr<ThumbnailExpressionSet> ThumbnailExpressionCache::get(const std::string& templateFileName)
+{
+    boost::system::error_code ec;
+#ifdef _WIN32
+    boost::filesystem::path path(IuCoreUtils::Utf8ToWstring(templateFileName));
+#else
+    boost::filesystem::path path(templateFileName);
+#endif
+    time_t modificationTime = boost::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return std::make_shared<ThumbnailExpressionSet>();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[templateFileName];
+    if (!entry.expressions || entry.modificationTime != modificationTime) {
+        entry.modificationTime = modificationTime;
+        entry.expressions = std::make_shared<ThumbnailExpressionSet>();
+    }
+    return entry.expressions;
+}
+
+void ThumbnailExpressionCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
@@ -0,0 +1,106 @@
+#ifndef IU_CORE_IMAGES_THUMBNAILEXPRESSION_H
+#define IU_CORE_IMAGES_THUMBNAILEXPRESSION_H
+
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/Utils/CoreTypes.h"
+
+/**
+@brief Expression from a thumbnail template (e.g. "$(Width)-65-7" or "#87000000+$(GradientColor1)")
+compiled into a postfix program.
+
+Variables are bound to slots which are looked up on each evaluation, so the text is tokenized
+only once. The result is exactly the same as substituting variables into the text and running
+TParser (see ImageConverterPrivateBase::InterpretExpression). When that cannot be guaranteed
+(unknown syntax, variable values which are not plain numbers), the expression has to be interpreted.
+*/
+class ThumbnailExpression {
+public:
+    /**
+     * Returns nullptr if the expression should be interpreted instead.
+     */
+    static std::unique_ptr<ThumbnailExpression> compile(const std::string& expr);
+
+    /**
+     * Returns false if a variable is missing or its value is not a decimal
+     * or #hex number (the expression should be interpreted instead).
+     */
+    bool evaluate(const std::map<std::string, std::string>& vars, double& result) const;
+
+    const std::vector<std::string>& variables() const;
+
+    enum class OpCode : uint8_t {
+        Constant, Variable, Plus, Minus, Multiply, Divide, Percent, Power, UnaryMinus,
+        Sin, Cos, Tg, Ctg, Arcsin, Arccos, Arctg, Arcctg, Sh, Ch, Th, Cth, Exp, Lg, Ln, Sqrt
+    };
+
+    struct Instruction {
+        OpCode op;
+        int slot; // OpCode::Variable
+        double value; // OpCode::Constant
+    };
+private:
+    friend class ThumbnailExpressionCompiler;
+    ThumbnailExpression() = default;
+
+    // Hex literal or occurrence of a variable, in the order of the text
+    struct HexItem {
+        std::string digits; // empty for variables
+        int slot;
+    };
+
+    std::vector<Instruction> program_;
+    std::vector<std::string> variables_;
+    std::vector<HexItem> hexItems_;
+    int maxStackDepth_ = 0;
+};
+
+/**
+@brief Compiled expressions of a thumbnail template. Expressions are compiled on first use,
+the set may be used from several threads at once.
+*/
+class ThumbnailExpressionSet {
+public:
+    ThumbnailExpressionSet() = default;
+
+    /**
+     * Returns nullptr if the expression should be interpreted.
+     */
+    const ThumbnailExpression* get(const std::string& expr);
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<ThumbnailExpression>> expressions_;
+    DISALLOW_COPY_AND_ASSIGN(ThumbnailExpressionSet);
+};
+
+/**
+@brief Process-wide cache of compiled expressions, one set per template file.
+The set is dropped when the modification time of the file changes.
+*/
+class ThumbnailExpressionCache {
+public:
+    static ThumbnailExpressionCache* instance();
+
+    std::shared_ptr<ThumbnailExpressionSet> get(const std::string& templateFileName);
+    void clear();
+private:
+    ThumbnailExpressionCache() = default;
+
+    struct Entry {
+        time_t modificationTime;
+        std::shared_ptr<ThumbnailExpressionSet> expressions;
+    };
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    DISALLOW_COPY_AND_ASSIGN(ThumbnailExpressionCache);
+};
+
+#endif
@@ -3,21 +3,23 @@
 #include <mutex>
 
 #include <boost/filesystem.hpp>
+#include "Core/Logging.h"
 #include "Core/Settings/BasicSettings.h"
 #include "HistoryManager.h"
 #include "Core/3rdpart/pcreplusplus.h"
 #include "ServiceLocator.h"
 
 LocalFileCache::LocalFileCache() {
-    historyParsed = false;
 }
 
 bool LocalFileCache::ensureHistoryParsed() {
-    if ( !historyParsed ) {
-        parseHistory();
-        historyParsed = true;
-    }
-
+    std::call_once(historyParsedFlag_, [this] {
+        try {
+            parseHistory();
+        } catch (const std::exception& ex) {
+            LOG(ERROR) << "Unable to parse history: " << ex.what();
+        }
+    });
     return true;
 }
 
@@ -84,6 +86,7 @@ bool LocalFileCache::addFile(const std::string& url, const std::string& localFil
 }
 
 std::string LocalFileCache::get(const std::string& url){
+    ensureHistoryParsed();
     std::lock_guard<std::mutex> guard(cacheMutex_);
     std::map<std::string, std::string>::const_iterator foundItem = cache_.find(url);
 
@@ -105,6 +108,7 @@ bool LocalFileCache::addThumb(const std::string& url, const std::string& localFi
 }
 
 std::string LocalFileCache::getThumb(const std::string& url) {
+    ensureHistoryParsed();
     std::lock_guard<std::mutex> guard(cacheMutex_);
     std::map<std::string, std::string>::const_iterator foundItem = thumbCache_.find(url);
 
@@ -8,6 +8,9 @@
 
 class LocalFileCache : public Singleton<LocalFileCache> {
     public:
+        /**
+         * Called by get() and getThumb(), so history files are parsed on first lookup
+         */
         bool ensureHistoryParsed();
         bool addFile(const std::string& url, const std::string& localFileName);
         bool addThumb(const std::string& url, const std::string& thumb);
@@ -15,7 +18,7 @@ class LocalFileCache : public Singleton<LocalFileCache> {
         std::string getThumb(const std::string& url);
         friend class Singleton<LocalFileCache>;
     protected:
-        bool historyParsed;
+        std::once_flag historyParsedFlag_;
         std::map<std::string, std::string> cache_;
         std::map<std::string, std::string> thumbCache_;
         std::recursive_mutex mutex_;
@@ -0,0 +1,309 @@
+#include "AsyncLogSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+constexpr size_t CALL_SITE_COUNT = 1024; // power of two
+constexpr int CALL_SITE_PROBES = 4;
+
+// The target sink may log itself, such messages are written directly
+thread_local bool inDrainThread = false;
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+int64_t currentSecond() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+AsyncLogSink::AsyncLogSink(google::LogSink* target) : AsyncLogSink(target, Options())
+{
+}
+
+AsyncLogSink::AsyncLogSink(google::LogSink* target, const Options& options) :
+    target_(target),
+    options_(options),
+    enqueuePos_(0),
+    dequeuePos_(0),
+    drainSleeping_(false),
+    stopped_(false),
+    sampleCounter_(0),
+    dropped_(0),
+    sampledOut_(0),
+    rateLimited_(0),
+    blockedWaits_(0),
+    stop_(false)
+{
+    options_.capacity = roundUpToPowerOfTwo(std::max<size_t>(options_.capacity, 2));
+    options_.sampleRate = std::max(1, options_.sampleRate);
+    mask_ = options_.capacity - 1;
+    records_.reset(new Record[options_.capacity]);
+    for (size_t i = 0; i < options_.capacity; i++) {
+        records_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    callSites_.reset(new CallSite[CALL_SITE_COUNT]);
+    thread_ = std::thread(&AsyncLogSink::drainThread, this);
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+    stop();
+}
+
+void AsyncLogSink::send(google::LogSeverity severity, const char* full_filename, const char* base_filename, int line,
+    const struct ::tm* tm_time, const char* message, size_t message_len)
+{
+    if (inDrainThread || stopped_.load(std::memory_order_acquire)) {
+        target_->send(severity, full_filename, base_filename, line, tm_time, message, message_len);
+        return;
+    }
+    if (options_.maxMessagesPerSecond > 0 && severity < google::GLOG_ERROR
+        && !rateLimit(severity, full_filename, base_filename, line, tm_time)) {
+        return;
+    }
+    push(severity, full_filename, base_filename, line, tm_time, message, message_len);
+    if (severity >= google::GLOG_FATAL) {
+        // The process is going to be aborted
+        flush();
+    }
+}
+
+bool AsyncLogSink::rateLimit(google::LogSeverity severity, const char* fullFileName, const char* baseFileName,
+    int line, const struct ::tm* tm_time)
+{
+    // File names come from __FILE__, so the pointer identifies the file
+    uintptr_t key = (reinterpret_cast<uintptr_t>(baseFileName) * 31 + static_cast<uintptr_t>(line)) | 1;
+    size_t index = static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 40);
+    CallSite* site = nullptr;
+    for (int i = 0; i < CALL_SITE_PROBES; i++) {
+        CallSite& candidate = callSites_[(index + i) & (CALL_SITE_COUNT - 1)];
+        uintptr_t current = candidate.key.load(std::memory_order_acquire);
+        if (current == 0 && candidate.key.compare_exchange_strong(current, key)) {
+            current = key;
+        }
+        if (current == key) {
+            site = &candidate;
+            break;
+        }
+    }
+    if (!site) {
+        // The table is full, such call sites are not limited
+        return true;
+    }
+
+    int64_t now = currentSecond();
+    int64_t window = site->window.load(std::memory_order_relaxed);
+    if (window != now && site->window.compare_exchange_strong(window, now)) {
+        site->count.store(0, std::memory_order_relaxed);
+        int suppressed = site->suppressed.exchange(0);
+        if (suppressed > 0) {
+            char summary[128];
+            int length = snprintf(summary, sizeof(summary), "%d similar messages were suppressed by the rate limiter",
+                suppressed);
+            push(std::max<google::LogSeverity>(severity, google::GLOG_WARNING), fullFileName, baseFileName, line,
+                tm_time, summary, static_cast<size_t>(length));
+        }
+    }
+    if (site->count.fetch_add(1, std::memory_order_relaxed) < options_.maxMessagesPerSecond) {
+        return true;
+    }
+    site->suppressed.fetch_add(1, std::memory_order_relaxed);
+    rateLimited_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+AsyncLogSink::PushResult AsyncLogSink::tryPush(google::LogSeverity severity, const char* fullFileName,
+    const char* baseFileName, int line, const struct ::tm* tm_time, const char* message, size_t length, bool important)
+{
+    size_t dequeued = dequeuePos_.load(std::memory_order_relaxed);
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    if (options_.overflowPolicy == OverflowPolicy::Sample && !important) {
+        size_t depth = pos > dequeued ? pos - dequeued : 0;
+        if (depth >= options_.capacity * 3 / 4
+            && sampleCounter_.fetch_add(1, std::memory_order_relaxed) % options_.sampleRate != 0) {
+            return PushResult::SampledOut;
+        }
+    }
+
+    // Bounded MPMC queue by Dmitry Vyukov: the slot sequence tells whether it is free for this position
+    Record* record;
+    for (;;) {
+        record = &records_[pos & mask_];
+        size_t sequence = record->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return PushResult::Full;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->severity = severity;
+    record->fullFileName = fullFileName;
+    record->baseFileName = baseFileName;
+    record->line = line;
+    if (tm_time) {
+        record->time = *tm_time;
+    } else {
+        memset(&record->time, 0, sizeof(record->time));
+    }
+    if (length <= kInlineMessageSize) {
+        memcpy(record->message, message, length);
+    } else {
+        record->longMessage.reset(new char[length]);
+        memcpy(record->longMessage.get(), message, length);
+    }
+    record->length = length;
+    record->sequence.store(pos + 1, std::memory_order_release);
+    wakeDrainThread();
+    return PushResult::Ok;
+}
+
+void AsyncLogSink::push(google::LogSeverity severity, const char* fullFileName, const char* baseFileName, int line,
+    const struct ::tm* tm_time, const char* message, size_t length)
+{
+    bool important = severity >= google::GLOG_ERROR;
+    PushResult result = tryPush(severity, fullFileName, baseFileName, line, tm_time, message, length, important);
+    if (result == PushResult::Ok) {
+        return;
+    }
+    if (result == PushResult::SampledOut) {
+        sampledOut_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (options_.overflowPolicy != OverflowPolicy::Block) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    blockedWaits_.fetch_add(1, std::memory_order_relaxed);
+    for (int attempt = 0;; attempt++) {
+        if (stopped_.load(std::memory_order_acquire)) {
+            target_->send(severity, fullFileName, baseFileName, line, tm_time, message, length);
+            return;
+        }
+        if (attempt < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        if (tryPush(severity, fullFileName, baseFileName, line, tm_time, message, length, important) == PushResult::Ok) {
+            return;
+        }
+    }
+}
+
+void AsyncLogSink::wakeDrainThread()
+{
+    // Pairs with the fence in drainThread(): either the drain thread sees the new record
+    // or this thread sees that it is going to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (drainSleeping_.load(std::memory_order_relaxed) && drainSleeping_.exchange(false)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        drainCondition_.notify_one();
+    }
+}
+
+size_t AsyncLogSink::drain()
+{
+    size_t count = 0;
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+        Record& record = records_[pos & mask_];
+        if (record.sequence.load(std::memory_order_acquire) != pos + 1) {
+            break;
+        }
+        const char* message = record.longMessage ? record.longMessage.get() : record.message;
+        target_->send(record.severity, record.fullFileName, record.baseFileName, record.line, &record.time,
+            message, record.length);
+        record.longMessage.reset();
+        record.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        pos++;
+        dequeuePos_.store(pos, std::memory_order_release);
+        count++;
+    }
+    return count;
+}
+
+void AsyncLogSink::drainThread()
+{
+    inDrainThread = true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        lock.unlock();
+        size_t count = drain();
+        lock.lock();
+        if (count) {
+            flushCondition_.notify_all();
+            continue;
+        }
+        if (stop_) {
+            break;
+        }
+        drainSleeping_.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        if (records_[pos & mask_].sequence.load(std::memory_order_acquire) != pos + 1) {
+            // The timeout is a safety net only, producers wake the thread up
+            drainCondition_.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        drainSleeping_.store(false);
+    }
+}
+
+void AsyncLogSink::flush()
+{
+    if (inDrainThread || stopped_.load(std::memory_order_acquire)) {
+        return;
+    }
+    size_t target = enqueuePos_.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(mutex_);
+    drainSleeping_.store(false);
+    drainCondition_.notify_one();
+    flushCondition_.wait(lock, [&] {
+        return stop_ || dequeuePos_.load(std::memory_order_acquire) >= target;
+    });
+}
+
+void AsyncLogSink::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            return;
+        }
+        stop_ = true;
+    }
+    drainCondition_.notify_all();
+    thread_.join();
+    stopped_.store(true, std::memory_order_release);
+    // Records which were published while the drain thread was exiting
+    drain();
+    flushCondition_.notify_all();
+}
+
+AsyncLogSink::Stats AsyncLogSink::stats() const
+{
+    Stats result;
+    result.enqueued = static_cast<int64_t>(enqueuePos_.load(std::memory_order_relaxed));
+    result.written = static_cast<int64_t>(dequeuePos_.load(std::memory_order_relaxed));
+    result.dropped = dropped_.load(std::memory_order_relaxed);
+    result.sampledOut = sampledOut_.load(std::memory_order_relaxed);
+    result.rateLimited = rateLimited_.load(std::memory_order_relaxed);
+    result.blockedWaits = blockedWaits_.load(std::memory_order_relaxed);
+    return result;
+}
@@ -0,0 +1,123 @@
+#ifndef IU_CORE_LOGGING_ASYNCLOGSINK_H
+#define IU_CORE_LOGGING_ASYNCLOGSINK_H
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Core/Utils/CoreTypes.h"
+#include "Core/Logging.h"
+
+/**
+@brief glog sink which puts messages into a lock-free ring buffer and passes them
+to the target sink (e.g. MyLogSink) on a background thread.
+
+Logging threads only copy the message into a preallocated slot (messages longer than
+kInlineMessageSize are copied to the heap). Formatting and locking in the target sink
+happen on the drain thread. Messages from one thread keep their order.
+*/
+class AsyncLogSink: public google::LogSink {
+public:
+    enum class OverflowPolicy {
+        Drop,   // messages are dropped while the buffer is full
+        Block,  // logging thread waits for a free slot
+        Sample  // when the buffer is 3/4 full, only every sampleRate-th message is kept
+    };
+
+    struct Options {
+        size_t capacity = 4096; // rounded up to a power of two
+        OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+        int sampleRate = 10;
+        // Limit for each call site (file and line), 0 - unlimited.
+        // Errors are never sampled or rate limited.
+        int maxMessagesPerSecond = 0;
+    };
+
+    struct Stats {
+        int64_t enqueued = 0;
+        int64_t written = 0;
+        int64_t dropped = 0;
+        int64_t sampledOut = 0;
+        int64_t rateLimited = 0;
+        int64_t blockedWaits = 0;
+    };
+
+    static constexpr size_t kInlineMessageSize = 256;
+
+    explicit AsyncLogSink(google::LogSink* target);
+    AsyncLogSink(google::LogSink* target, const Options& options);
+    ~AsyncLogSink() override;
+
+    void send(google::LogSeverity severity, const char* full_filename,
+        const char* base_filename, int line,
+        const struct ::tm* tm_time,
+        const char* message, size_t message_len) override;
+
+    /**
+     * Waits until messages logged before the call are passed to the target sink
+     */
+    void flush();
+
+    /**
+     * Drains the buffer and stops the background thread,
+     * after that messages are passed to the target sink directly.
+     */
+    void stop();
+
+    Stats stats() const;
+private:
+    struct Record {
+        std::atomic<size_t> sequence;
+        google::LogSeverity severity;
+        const char* fullFileName;
+        const char* baseFileName;
+        int line;
+        struct ::tm time;
+        size_t length;
+        std::unique_ptr<char[]> longMessage;
+        char message[kInlineMessageSize];
+    };
+
+    struct alignas(64) CallSite {
+        std::atomic<uintptr_t> key{ 0 };
+        std::atomic<int64_t> window{ -1 };
+        std::atomic<int> count{ 0 };
+        std::atomic<int> suppressed{ 0 };
+    };
+
+    enum class PushResult { Ok, Full, SampledOut };
+
+    bool rateLimit(google::LogSeverity severity, const char* fullFileName, const char* baseFileName, int line,
+        const struct ::tm* tm_time);
+    PushResult tryPush(google::LogSeverity severity, const char* fullFileName, const char* baseFileName, int line,
+        const struct ::tm* tm_time, const char* message, size_t length, bool important);
+    void push(google::LogSeverity severity, const char* fullFileName, const char* baseFileName, int line,
+        const struct ::tm* tm_time, const char* message, size_t length);
+    void wakeDrainThread();
+    size_t drain();
+    void drainThread();
+
+    google::LogSink* target_;
+    Options options_;
+    size_t mask_;
+    std::unique_ptr<Record[]> records_;
+    std::unique_ptr<CallSite[]> callSites_;
+    alignas(64) std::atomic<size_t> enqueuePos_;
+    alignas(64) std::atomic<size_t> dequeuePos_;
+    std::atomic<bool> drainSleeping_;
+    std::atomic<bool> stopped_;
+    std::atomic<int64_t> sampleCounter_;
+    std::atomic<int64_t> dropped_, sampledOut_, rateLimited_, blockedWaits_;
+    std::mutex mutex_;
+    std::condition_variable drainCondition_, flushCondition_;
+    bool stop_;
+    std::thread thread_;
+    DISALLOW_COPY_AND_ASSIGN(AsyncLogSink);
+};
+
+#endif
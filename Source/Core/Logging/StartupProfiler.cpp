@@ -0,0 +1,73 @@
+#include "StartupProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+int64_t steadyMicroseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+StartupProfiler::StartupProfiler() : origin_(steadyMicroseconds()) {
+    threads_[std::this_thread::get_id()] = 0;
+}
+
+StartupProfiler* StartupProfiler::instance() {
+    static StartupProfiler profiler;
+    return &profiler;
+}
+
+int64_t StartupProfiler::elapsed() const {
+    return steadyMicroseconds() - origin_;
+}
+
+int StartupProfiler::threadIndex(std::thread::id id) {
+    auto it = threads_.find(id);
+    if (it != threads_.end()) {
+        return it->second;
+    }
+    int index = static_cast<int>(threads_.size());
+    threads_[id] = index;
+    return index;
+}
+
+void StartupProfiler::addPhase(std::string name, int64_t start, int64_t duration) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    StartupPhaseInfo phase;
+    phase.name = std::move(name);
+    phase.start = start;
+    phase.duration = duration;
+    phase.threadIndex = threadIndex(std::this_thread::get_id());
+    phases_.push_back(std::move(phase));
+}
+
+std::vector<StartupPhaseInfo> StartupProfiler::phases() const {
+    std::vector<StartupPhaseInfo> result;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        result = phases_;
+    }
+    std::stable_sort(result.begin(), result.end(), [](const StartupPhaseInfo& a, const StartupPhaseInfo& b) {
+        return a.start < b.start;
+    });
+    return result;
+}
+
+std::string StartupProfiler::report() const {
+    std::string result = "Startup profile:\n";
+    char buf[256];
+    snprintf(buf, sizeof(buf), "  %-28s %10s %12s  %s\n", "Phase", "Start, ms", "Duration, ms", "Thread");
+    result += buf;
+    for (const auto& phase : phases()) {
+        snprintf(buf, sizeof(buf), "  %-28s %10.1f %12.1f  %s\n", phase.name.c_str(), phase.start / 1000.0, phase.duration / 1000.0,
+            phase.threadIndex ? ("worker " + std::to_string(phase.threadIndex)).c_str() : "main");
+        result += buf;
+    }
+    snprintf(buf, sizeof(buf), "  %-28s %10.1f\n", "Total", elapsed() / 1000.0);
+    result += buf;
+    return result;
+}
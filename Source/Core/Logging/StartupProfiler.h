@@ -0,0 +1,73 @@
+#ifndef IU_CORE_LOGGING_STARTUPPROFILER_H
+#define IU_CORE_LOGGING_STARTUPPROFILER_H
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Core/Utils/CoreTypes.h"
+
+struct StartupPhaseInfo {
+    std::string name;
+    int64_t start; // microseconds since the profiler was created
+    int64_t duration;
+    int threadIndex; // 0 is the thread which created the profiler
+};
+
+/**
+@brief StartupProfiler collects durations of application startup phases.
+
+There are only a few phases, so they are always recorded and the report is printed on demand.
+The profiler should be created as early as possible (at the beginning of main()),
+its creation time is the origin of the timeline.
+*/
+class StartupProfiler {
+public:
+    static StartupProfiler* instance();
+
+    /**
+     * Returns microseconds elapsed since the profiler was created
+     */
+    int64_t elapsed() const;
+
+    void addPhase(std::string name, int64_t start, int64_t duration);
+    std::vector<StartupPhaseInfo> phases() const;
+
+    /**
+     * Returns human readable table of phases ordered by start time, and the total time of startup
+     */
+    std::string report() const;
+private:
+    StartupProfiler();
+    int threadIndex(std::thread::id id);
+
+    int64_t origin_;
+    mutable std::mutex mutex_;
+    std::vector<StartupPhaseInfo> phases_;
+    std::map<std::thread::id, int> threads_;
+    DISALLOW_COPY_AND_ASSIGN(StartupProfiler);
+};
+
+/**
+ * Records a startup phase covering the lifetime of the object
+ */
+class StartupPhase {
+public:
+    explicit StartupPhase(const char* name) : name_(name), start_(StartupProfiler::instance()->elapsed()) {
+    }
+
+    ~StartupPhase() {
+        StartupProfiler* profiler = StartupProfiler::instance();
+        profiler->addPhase(name_, start_, profiler->elapsed() - start_);
+    }
+private:
+    const char* name_;
+    int64_t start_;
+    DISALLOW_COPY_AND_ASSIGN(StartupPhase);
+};
+
+#endif
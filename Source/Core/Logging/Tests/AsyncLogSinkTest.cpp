@@ -0,0 +1,324 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Core/Logging/AsyncLogSink.h"
+
+namespace {
+
+const char FILE_NAME[] = "AsyncLogSinkTest.cpp";
+
+// Collects messages, can be paused to let the ring buffer fill up
+class CollectingSink: public google::LogSink {
+public:
+    void send(google::LogSeverity, const char*, const char*, int line, const struct ::tm*,
+        const char* message, size_t message_len) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this] { return !paused_; });
+        messages_.emplace_back(message, message_len);
+        lines_.push_back(line);
+    }
+
+    void setPaused(bool paused) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            paused_ = paused;
+        }
+        condition_.notify_all();
+    }
+
+    std::vector<std::string> messages() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return messages_;
+    }
+
+    std::vector<int> lines() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lines_;
+    }
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool paused_ = false;
+    std::vector<std::string> messages_;
+    std::vector<int> lines_;
+};
+
+// Does the same work as MyLogSink and a logger which keeps messages in memory
+class FormattingSink: public google::LogSink {
+public:
+    void send(google::LogSeverity, const char*, const char* base_filename, int line, const struct ::tm*,
+        const char* message, size_t message_len) override {
+        std::string sender = base_filename;
+        sender += ":" + std::to_string(line);
+        std::string msg(message, message_len);
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_ += sender.size() + msg.size();
+        count_++;
+    }
+
+    int64_t count() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+private:
+    std::mutex mutex_;
+    size_t size_ = 0;
+    int64_t count_ = 0;
+};
+
+void log(google::LogSink& sink, int line, const std::string& message, google::LogSeverity severity = google::GLOG_INFO) {
+    struct ::tm time {};
+    sink.send(severity, FILE_NAME, FILE_NAME, line, &time, message.c_str(), message.size());
+}
+
+}
+
+TEST(AsyncLogSinkTest, KeepsOrderOfEachThread)
+{
+    const int threadCount = 4, messageCount = 2000;
+    CollectingSink target;
+    AsyncLogSink::Options options;
+    options.capacity = 64;
+    AsyncLogSink sink(&target, options);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&sink, t] {
+            for (int i = 0; i < messageCount; i++) {
+                log(sink, t, std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    sink.flush();
+
+    auto messages = target.messages();
+    auto lines = target.lines();
+    ASSERT_EQ(static_cast<size_t>(threadCount * messageCount), messages.size());
+    std::vector<int> next(threadCount, 0);
+    for (size_t i = 0; i < messages.size(); i++) {
+        EXPECT_EQ(std::to_string(next[lines[i]]++), messages[i]);
+    }
+    auto stats = sink.stats();
+    EXPECT_EQ(threadCount * messageCount, stats.written);
+    EXPECT_EQ(0, stats.dropped);
+}
+
+TEST(AsyncLogSinkTest, LongMessages)
+{
+    CollectingSink target;
+    AsyncLogSink sink(&target);
+    std::string longMessage(AsyncLogSink::kInlineMessageSize * 20 + 1, 'x');
+    longMessage.back() = 'y';
+    log(sink, 1, longMessage);
+    log(sink, 2, "short");
+    log(sink, 3, std::string(AsyncLogSink::kInlineMessageSize, 'z'));
+    sink.flush();
+    auto messages = target.messages();
+    ASSERT_EQ(3u, messages.size());
+    EXPECT_EQ(longMessage, messages[0]);
+    EXPECT_EQ("short", messages[1]);
+    EXPECT_EQ(std::string(AsyncLogSink::kInlineMessageSize, 'z'), messages[2]);
+}
+
+TEST(AsyncLogSinkTest, DropPolicy)
+{
+    CollectingSink target;
+    AsyncLogSink::Options options;
+    options.capacity = 16;
+    options.overflowPolicy = AsyncLogSink::OverflowPolicy::Drop;
+    AsyncLogSink sink(&target, options);
+    target.setPaused(true);
+    for (int i = 0; i < 100; i++) {
+        log(sink, 1, std::to_string(i));
+    }
+    // The slot is not freed until the paused sink returns
+    auto stats = sink.stats();
+    EXPECT_EQ(16, stats.enqueued);
+    EXPECT_EQ(84, stats.dropped);
+    target.setPaused(false);
+    sink.flush();
+    EXPECT_EQ(stats.enqueued, sink.stats().written);
+    EXPECT_EQ("0", target.messages().front());
+}
+
+TEST(AsyncLogSinkTest, SamplePolicy)
+{
+    CollectingSink target;
+    AsyncLogSink::Options options;
+    options.capacity = 64;
+    options.overflowPolicy = AsyncLogSink::OverflowPolicy::Sample;
+    options.sampleRate = 4;
+    AsyncLogSink sink(&target, options);
+    target.setPaused(true);
+    for (int i = 0; i < 100; i++) {
+        log(sink, 1, std::to_string(i));
+    }
+    log(sink, 2, "error", google::GLOG_ERROR);
+    auto stats = sink.stats();
+    EXPECT_GT(stats.sampledOut, 0);
+    EXPECT_EQ(0, stats.dropped);
+    EXPECT_EQ(101, stats.enqueued + stats.sampledOut);
+    target.setPaused(false);
+    sink.flush();
+    // Errors are not sampled
+    EXPECT_EQ("error", target.messages().back());
+}
+
+TEST(AsyncLogSinkTest, BlockPolicy)
+{
+    CollectingSink target;
+    AsyncLogSink::Options options;
+    options.capacity = 4;
+    AsyncLogSink sink(&target, options);
+    target.setPaused(true);
+    std::thread producer([&sink] {
+        for (int i = 0; i < 20; i++) {
+            log(sink, 1, std::to_string(i));
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_GT(sink.stats().blockedWaits, 0);
+    target.setPaused(false);
+    producer.join();
+    sink.flush();
+    EXPECT_EQ(20u, target.messages().size());
+    EXPECT_EQ(0, sink.stats().dropped);
+}
+
+TEST(AsyncLogSinkTest, RateLimitPerCallSite)
+{
+    CollectingSink target;
+    AsyncLogSink::Options options;
+    options.maxMessagesPerSecond = 5;
+    AsyncLogSink sink(&target, options);
+    for (int i = 0; i < 100; i++) {
+        log(sink, 10, "noisy");
+    }
+    log(sink, 20, "quiet");
+    log(sink, 10, "error", google::GLOG_ERROR);
+    sink.flush();
+
+    auto lines = target.lines();
+    auto noisy = std::count(lines.begin(), lines.end(), 10);
+    // The test may cross the boundary of a second
+    EXPECT_GE(noisy, 5 + 1);
+    EXPECT_LE(noisy, 10 + 2);
+    EXPECT_EQ(1, std::count(lines.begin(), lines.end(), 20));
+    EXPECT_EQ("error", target.messages().back());
+    EXPECT_GE(sink.stats().rateLimited, 100 - 10);
+
+    // Number of suppressed messages is reported when the next window starts
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    log(sink, 10, "noisy");
+    sink.flush();
+    auto messages = target.messages();
+    ASSERT_GE(messages.size(), 2u);
+    EXPECT_NE(std::string::npos, messages[messages.size() - 2].find("suppressed"));
+    EXPECT_EQ("noisy", messages.back());
+}
+
+TEST(AsyncLogSinkTest, WritesDirectlyAfterStop)
+{
+    CollectingSink target;
+    AsyncLogSink sink(&target);
+    log(sink, 1, "first");
+    sink.stop();
+    EXPECT_EQ(1u, target.messages().size());
+    log(sink, 2, "second");
+    EXPECT_EQ(2u, target.messages().size());
+}
+
+TEST(AsyncLogSinkTest, DISABLED_StressBenchmark)
+{
+    const int threadCount = 32, messageCount = 20000;
+
+    struct Scenario {
+        const char* name;
+        bool async;
+        AsyncLogSink::OverflowPolicy policy;
+        int maxMessagesPerSecond;
+    };
+    const Scenario scenarios[] = {
+        { "synchronous", false, AsyncLogSink::OverflowPolicy::Block, 0 },
+        { "async, block", true, AsyncLogSink::OverflowPolicy::Block, 0 },
+        { "async, drop", true, AsyncLogSink::OverflowPolicy::Drop, 0 },
+        { "async, sample", true, AsyncLogSink::OverflowPolicy::Sample, 0 },
+        { "async, drop, 1000/s limit", true, AsyncLogSink::OverflowPolicy::Drop, 1000 },
+    };
+
+    printf("%-26s %8s %8s %8s %9s %10s %9s %9s %9s\n", "", "p50 ns", "p99 ns", "p99.9 ns", "max ns", "total ms",
+        "dropped", "sampled", "limited");
+    for (const auto& scenario : scenarios) {
+        FormattingSink target;
+        AsyncLogSink::Options options;
+        options.overflowPolicy = scenario.policy;
+        options.maxMessagesPerSecond = scenario.maxMessagesPerSecond;
+        std::unique_ptr<AsyncLogSink> asyncSink;
+        google::LogSink* sink = &target;
+        if (scenario.async) {
+            asyncSink = std::make_unique<AsyncLogSink>(&target, options);
+            sink = asyncSink.get();
+        }
+
+        std::vector<std::vector<int64_t>> latencies(threadCount);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t] {
+                std::vector<int64_t>& result = latencies[t];
+                result.reserve(messageCount);
+                struct ::tm time {};
+                char message[128];
+                for (int i = 0; i < messageCount; i++) {
+                    int length = snprintf(message, sizeof(message), "Upload worker %d: chunk %d of %d sent", t, i,
+                        messageCount);
+                    auto callStart = std::chrono::steady_clock::now();
+                    sink->send(google::GLOG_INFO, FILE_NAME, FILE_NAME, 100 + i % 8, &time, message,
+                        static_cast<size_t>(length));
+                    result.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - callStart).count());
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (asyncSink) {
+            asyncSink->flush();
+        }
+        double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<int64_t> all;
+        for (const auto& result : latencies) {
+            all.insert(all.end(), result.begin(), result.end());
+        }
+        std::sort(all.begin(), all.end());
+        auto quantile = [&all](double q) {
+            return all[std::min(all.size() - 1, static_cast<size_t>(q * all.size()))];
+        };
+        AsyncLogSink::Stats stats;
+        if (asyncSink) {
+            stats = asyncSink->stats();
+            EXPECT_EQ(stats.written, target.count());
+            // Summaries of the rate limiter are written in addition to messages
+            EXPECT_LE(threadCount * messageCount, stats.written + stats.dropped + stats.sampledOut + stats.rateLimited);
+        } else {
+            EXPECT_EQ(threadCount * messageCount, target.count());
+        }
+        printf("%-26s %8lld %8lld %8lld %9lld %10.1f %9lld %9lld %9lld\n", scenario.name,
+            static_cast<long long>(quantile(0.5)), static_cast<long long>(quantile(0.99)),
+            static_cast<long long>(quantile(0.999)), static_cast<long long>(all.back()), totalMs,
+            static_cast<long long>(stats.dropped), static_cast<long long>(stats.sampledOut),
+            static_cast<long long>(stats.rateLimited));
+    }
+}
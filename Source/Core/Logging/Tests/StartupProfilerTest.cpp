@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "Core/Logging/StartupProfiler.h"
+
+TEST(StartupProfilerTest, RecordsPhases) {
+    StartupProfiler* profiler = StartupProfiler::instance();
+    {
+        StartupPhase phase("Test phase");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    std::thread worker([] {
+        StartupPhase phase("Test worker phase");
+    });
+    worker.join();
+
+    bool foundMain = false, foundWorker = false;
+    for (const auto& phase : profiler->phases()) {
+        if (phase.name == "Test phase") {
+            foundMain = true;
+            EXPECT_GE(phase.duration, 2000);
+            EXPECT_LE(phase.start + phase.duration, profiler->elapsed());
+        } else if (phase.name == "Test worker phase") {
+            foundWorker = true;
+            EXPECT_NE(0, phase.threadIndex);
+        }
+    }
+    EXPECT_TRUE(foundMain);
+    EXPECT_TRUE(foundWorker);
+
+    std::string report = profiler->report();
+    EXPECT_NE(std::string::npos, report.find("Test phase"));
+    EXPECT_NE(std::string::npos, report.find("Total"));
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <boost/filesystem.hpp>
+#include <json/json.h>
+
+#include "Core/Logging/TraceRecorder.h"
+#include "Core/Utils/CoreUtils.h"
+
+class TraceRecorderTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        TraceRecorder::instance()->stop();
+        TraceRecorder::instance()->clear();
+    }
+};
+
+TEST_F(TraceRecorderTest, DisabledByDefault)
+{
+    {
+        TraceSpan span("test", "span");
+        EXPECT_FALSE(span.isActive());
+    }
+    EXPECT_TRUE(TraceRecorder::instance()->events().empty());
+}
+
+TEST_F(TraceRecorderTest, WritesChromeTraceJson)
+{
+    TraceRecorder* recorder = TraceRecorder::instance();
+    recorder->start();
+    int task = 0;
+    recorder->asyncBegin("queue", "Queue wait", &task);
+    recorder->asyncEnd("queue", "Queue wait", &task);
+    {
+        TraceSpan span("upload", "Upload task");
+        span.addArg("task", "file \"1\".png");
+        span.addArg("size", static_cast<int64_t>(100));
+    }
+    recorder->addCompleteEvent("network", "HTTP request", 10, 5);
+
+    auto events = recorder->events();
+    ASSERT_EQ(4, events.size());
+    // Sorted by timestamp
+    EXPECT_EQ('X', events[0].phase);
+    EXPECT_EQ(5, events[0].duration);
+
+    Json::Value root;
+    Json::Reader reader;
+    ASSERT_TRUE(reader.parse(recorder->toJson(), root));
+    const Json::Value& traceEvents = root["traceEvents"];
+    ASSERT_EQ(4, traceEvents.size());
+    EXPECT_EQ("HTTP request", traceEvents[0]["name"].asString());
+    EXPECT_EQ("b", traceEvents[1]["ph"].asString());
+    EXPECT_EQ(traceEvents[1]["id"].asString(), traceEvents[2]["id"].asString());
+    const Json::Value& span = traceEvents[3];
+    EXPECT_EQ("Upload task", span["name"].asString());
+    EXPECT_EQ("X", span["ph"].asString());
+    EXPECT_EQ("file \"1\".png", span["args"]["task"].asString());
+    EXPECT_EQ(100, span["args"]["size"].asInt());
+}
+
+TEST_F(TraceRecorderTest, EventsPerThreadAreLimited)
+{
+    TraceRecorder* recorder = TraceRecorder::instance();
+    const size_t oldLimit = recorder->maxEventsPerThread();
+    recorder->setMaxEventsPerThread(3);
+    recorder->start();
+    for (int i = 0; i < 5; i++) {
+        recorder->addCompleteEvent("test", "event", i, 1);
+    }
+    std::thread([recorder] {
+        recorder->addCompleteEvent("test", "other thread", 10, 1);
+    }).join();
+    recorder->setMaxEventsPerThread(oldLimit);
+
+    EXPECT_EQ(4, recorder->events().size());
+    EXPECT_EQ(2, recorder->droppedEvents());
+    Json::Value root;
+    Json::Reader reader;
+    ASSERT_TRUE(reader.parse(recorder->toJson(), root));
+    EXPECT_EQ(2, root["otherData"]["droppedEvents"].asInt());
+}
+
+TEST_F(TraceRecorderTest, ExitedThreadsAreReleasedAfterWriting)
+{
+    namespace fs = boost::filesystem;
+    const std::string fileName = (fs::temp_directory_path() / fs::unique_path("iu_trace_%%%%-%%%%.json")).string();
+    TraceRecorder* recorder = TraceRecorder::instance();
+    recorder->start();
+    recorder->addCompleteEvent("test", "main thread", 1, 1);
+    for (int i = 0; i < 3; i++) {
+        std::thread([recorder] {
+            recorder->addCompleteEvent("test", "worker", 2, 1);
+        }).join();
+    }
+    ASSERT_TRUE(recorder->writeToFile(fileName));
+    Json::Value root;
+    Json::Reader reader;
+    ASSERT_TRUE(reader.parse(IuCoreUtils::GetFileContents(fileName), root));
+    EXPECT_EQ(4, root["traceEvents"].size());
+
+    // Events of the running thread are kept, buffers of the workers are gone
+    auto events = recorder->events();
+    ASSERT_EQ(1, events.size());
+    EXPECT_EQ("main thread", events[0].name);
+    boost::system::error_code ec;
+    fs::remove(fileName, ec);
+}
@@ -0,0 +1,263 @@
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+#include "Core/Utils/CoreUtils.h"
+
+namespace {
+
+void writeJsonString(std::ostream& out, const std::string& str) {
+    out << '"';
+    for (char c : str) {
+        switch (c) {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out << buf;
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+}
+
+std::atomic<bool> TraceRecorder::enabled_(false);
+
+TraceRecorder::TraceRecorder() : releasedDropped_(0), nextThreadId_(1), maxEventsPerThread_(200000) {
+}
+
+TraceRecorder* TraceRecorder::instance() {
+    static TraceRecorder recorder;
+    return &recorder;
+}
+
+void TraceRecorder::start() {
+    enabled_ = true;
+}
+
+void TraceRecorder::stop() {
+    enabled_ = false;
+}
+
+void TraceRecorder::setMaxEventsPerThread(size_t count) {
+    maxEventsPerThread_ = count;
+}
+
+size_t TraceRecorder::maxEventsPerThread() const {
+    return maxEventsPerThread_;
+}
+
+int64_t TraceRecorder::droppedEvents() {
+    std::lock_guard<std::mutex> lk(buffersMutex_);
+    int64_t result = releasedDropped_;
+    for (const auto& buffer : buffers_) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        result += buffer->dropped;
+    }
+    return result;
+}
+
+int64_t TraceRecorder::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceRecorder::ThreadBuffer* TraceRecorder::threadBuffer() {
+    // Marks the buffer when the thread exits, so it can be released after its events are written
+    struct Holder {
+        std::shared_ptr<ThreadBuffer> buffer;
+        ~Holder() {
+            if (buffer) {
+                buffer->threadExited = true;
+            }
+        }
+    };
+    thread_local Holder holder;
+    if (!holder.buffer) {
+        holder.buffer = std::make_shared<ThreadBuffer>();
+        holder.buffer->threadId = nextThreadId_++;
+        std::lock_guard<std::mutex> lk(buffersMutex_);
+        buffers_.push_back(holder.buffer);
+    }
+    return holder.buffer.get();
+}
+
+void TraceRecorder::addEvent(TraceEvent&& event) {
+    ThreadBuffer* buffer = threadBuffer();
+    event.threadId = buffer->threadId;
+    std::lock_guard<std::mutex> lk(buffer->mutex);
+    if (buffer->events.size() >= maxEventsPerThread_.load(std::memory_order_relaxed)) {
+        buffer->dropped++;
+        return;
+    }
+    buffer->events.push_back(std::move(event));
+}
+
+void TraceRecorder::addCompleteEvent(const char* category, std::string name, int64_t start, int64_t duration, std::vector<TraceArg> args) {
+    addEvent({ 'X', category, std::move(name), start, duration, 0, 0, std::move(args) });
+}
+
+void TraceRecorder::beginEvent(const char* category, std::string name, std::vector<TraceArg> args) {
+    if (!isEnabled()) {
+        return;
+    }
+    addEvent({ 'B', category, std::move(name), now(), 0, 0, 0, std::move(args) });
+}
+
+void TraceRecorder::endEvent(const char* category, std::string name) {
+    if (!isEnabled()) {
+        return;
+    }
+    addEvent({ 'E', category, std::move(name), now(), 0, 0, 0, {} });
+}
+
+void TraceRecorder::asyncBegin(const char* category, std::string name, const void* id, std::vector<TraceArg> args) {
+    if (!isEnabled()) {
+        return;
+    }
+    addEvent({ 'b', category, std::move(name), now(), 0, 0, reinterpret_cast<uint64_t>(id), std::move(args) });
+}
+
+void TraceRecorder::asyncEnd(const char* category, std::string name, const void* id) {
+    if (!isEnabled()) {
+        return;
+    }
+    addEvent({ 'e', category, std::move(name), now(), 0, 0, reinterpret_cast<uint64_t>(id), {} });
+}
+
+std::vector<TraceEvent> TraceRecorder::events() {
+    std::vector<TraceEvent> result;
+    {
+        std::lock_guard<std::mutex> lk(buffersMutex_);
+        for (const auto& buffer : buffers_) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            result.insert(result.end(), buffer->events.begin(), buffer->events.end());
+        }
+    }
+    std::stable_sort(result.begin(), result.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.timestamp < b.timestamp;
+    });
+    return result;
+}
+
+void TraceRecorder::clear() {
+    std::lock_guard<std::mutex> lk(buffersMutex_);
+    for (const auto& buffer : buffers_) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+    releasedDropped_ = 0;
+    buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(), [](const std::shared_ptr<ThreadBuffer>& buffer) {
+        return buffer->threadExited.load();
+    }), buffers_.end());
+}
+
+std::vector<std::shared_ptr<TraceRecorder::ThreadBuffer>> TraceRecorder::exitedThreadBuffers() {
+    std::vector<std::shared_ptr<ThreadBuffer>> result;
+    std::lock_guard<std::mutex> lk(buffersMutex_);
+    for (const auto& buffer : buffers_) {
+        if (buffer->threadExited) {
+            result.push_back(buffer);
+        }
+    }
+    return result;
+}
+
+void TraceRecorder::releaseBuffers(const std::vector<std::shared_ptr<ThreadBuffer>>& buffers) {
+    std::lock_guard<std::mutex> lk(buffersMutex_);
+    for (const auto& buffer : buffers) {
+        auto it = std::find(buffers_.begin(), buffers_.end(), buffer);
+        if (it != buffers_.end()) {
+            releasedDropped_ += buffer->dropped;
+            buffers_.erase(it);
+        }
+    }
+}
+
+std::string TraceRecorder::toJson() {
+    std::vector<TraceEvent> allEvents = events();
+    std::ostringstream out;
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& ev : allEvents) {
+        if (!first) {
+            out << ",";
+        }
+        first = false;
+        out << "\n{\"name\":";
+        writeJsonString(out, ev.name);
+        out << ",\"cat\":\"" << ev.category << "\",\"ph\":\"" << ev.phase << "\",\"ts\":" << ev.timestamp
+            << ",\"pid\":1,\"tid\":" << ev.threadId;
+        if (ev.phase == 'X') {
+            out << ",\"dur\":" << ev.duration;
+        } else if (ev.phase == 'b' || ev.phase == 'e') {
+            out << ",\"id\":\"0x" << std::hex << ev.id << std::dec << "\"";
+        }
+        if (!ev.args.empty()) {
+            out << ",\"args\":{";
+            for (size_t i = 0; i < ev.args.size(); i++) {
+                if (i) {
+                    out << ",";
+                }
+                writeJsonString(out, ev.args[i].name);
+                out << ":";
+                if (ev.args[i].isString) {
+                    writeJsonString(out, ev.args[i].stringValue);
+                } else {
+                    out << ev.args[i].intValue;
+                }
+            }
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << droppedEvents() << "}}\n";
+    return out.str();
+}
+
+bool TraceRecorder::writeToFile(const std::string& fileName) {
+    // Taken before writing: these threads cannot add events anymore, so all their events get into the file
+    auto exited = exitedThreadBuffers();
+    if (!IuCoreUtils::PutFileContents(fileName, toJson())) {
+        return false;
+    }
+    releaseBuffers(exited);
+    return true;
+}
+
+TraceArg TraceRecorder::arg(std::string name, std::string value) {
+    TraceArg result;
+    result.name = std::move(name);
+    result.stringValue = std::move(value);
+    result.isString = true;
+    return result;
+}
+
+TraceArg TraceRecorder::arg(std::string name, int64_t value) {
+    TraceArg result;
+    result.name = std::move(name);
+    result.intValue = value;
+    return result;
+}
@@ -0,0 +1,154 @@
+#ifndef IU_CORE_LOGGING_TRACERECORDER_H
+#define IU_CORE_LOGGING_TRACERECORDER_H
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "Core/Utils/CoreTypes.h"
+
+struct TraceArg {
+    std::string name;
+    std::string stringValue;
+    int64_t intValue = 0;
+    bool isString = false;
+};
+
+struct TraceEvent {
+    char phase; // 'X' - complete, 'B'/'E' - begin/end, 'b'/'e' - async begin/end
+    const char* category;
+    std::string name;
+    int64_t timestamp; // microseconds
+    int64_t duration;
+    int threadId;
+    uint64_t id; // for async events
+    std::vector<TraceArg> args;
+};
+
+/**
+@brief TraceRecorder collects timeline spans and writes them in Chrome trace-event JSON format
+(can be opened in chrome://tracing or https://ui.perfetto.dev).
+
+Recording is disabled by default, in that case instrumentation costs one relaxed atomic load.
+Events are stored in per-thread buffers, so recording threads do not contend with each other.
+A buffer keeps at most maxEventsPerThread() events, later events of the thread are dropped and counted.
+*/
+class TraceRecorder {
+public:
+    static TraceRecorder* instance();
+
+    static bool isEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void start();
+    void stop();
+
+    /**
+     * Default is 200000 events (tens of megabytes)
+     */
+    void setMaxEventsPerThread(size_t count);
+    size_t maxEventsPerThread() const;
+
+    /**
+     * Returns the number of events dropped because buffers of their threads were full
+     */
+    int64_t droppedEvents();
+
+    /**
+     * Returns current time in microseconds (steady clock)
+     */
+    static int64_t now();
+
+    void addEvent(TraceEvent&& event);
+    void addCompleteEvent(const char* category, std::string name, int64_t start, int64_t duration, std::vector<TraceArg> args = {});
+    void beginEvent(const char* category, std::string name, std::vector<TraceArg> args = {});
+    void endEvent(const char* category, std::string name);
+    void asyncBegin(const char* category, std::string name, const void* id, std::vector<TraceArg> args = {});
+    void asyncEnd(const char* category, std::string name, const void* id);
+
+    /**
+     * Returns all recorded events ordered by time
+     */
+    std::vector<TraceEvent> events();
+
+    /**
+     * Removes all events, buffers of exited threads are released
+     */
+    void clear();
+
+    /**
+     * Writes all events to the file. Buffers of exited threads are released afterwards,
+     * so their events are written only once.
+     */
+    bool writeToFile(const std::string& fileName);
+    std::string toJson();
+
+    static TraceArg arg(std::string name, std::string value);
+    static TraceArg arg(std::string name, int64_t value);
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<TraceEvent> events;
+        int64_t dropped = 0;
+        int threadId;
+        std::atomic<bool> threadExited{ false };
+    };
+    TraceRecorder();
+    ThreadBuffer* threadBuffer();
+    std::vector<std::shared_ptr<ThreadBuffer>> exitedThreadBuffers();
+    void releaseBuffers(const std::vector<std::shared_ptr<ThreadBuffer>>& buffers);
+
+    static std::atomic<bool> enabled_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    std::mutex buffersMutex_;
+    int64_t releasedDropped_; // dropped events of released buffers
+    std::atomic<int> nextThreadId_;
+    std::atomic<size_t> maxEventsPerThread_;
+    DISALLOW_COPY_AND_ASSIGN(TraceRecorder);
+};
+
+/**
+ * Records a complete event covering the lifetime of the object
+ */
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name) : category_(category), name_(name), start_(0) {
+        if (TraceRecorder::isEnabled()) {
+            start_ = TraceRecorder::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (start_) {
+            TraceRecorder::instance()->addCompleteEvent(category_, name_, start_, TraceRecorder::now() - start_, std::move(args_));
+        }
+    }
+
+    bool isActive() const {
+        return start_ != 0;
+    }
+
+    void addArg(std::string name, std::string value) {
+        if (start_) {
+            args_.push_back(TraceRecorder::arg(std::move(name), std::move(value)));
+        }
+    }
+    void addArg(std::string name, int64_t value) {
+        if (start_) {
+            args_.push_back(TraceRecorder::arg(std::move(name), value));
+        }
+    }
+private:
+    const char* category_;
+    const char* name_;
+    int64_t start_;
+    std::vector<TraceArg> args_;
+    DISALLOW_COPY_AND_ASSIGN(TraceSpan);
+};
+
+#endif
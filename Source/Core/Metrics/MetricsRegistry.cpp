@@ -0,0 +1,258 @@
+#include "MetricsRegistry.h"
+
+#include <sstream>
+#include <boost/filesystem.hpp>
+
+#include "Core/Logging.h"
+#include "Core/Utils/CoreUtils.h"
+
+int metricShardIndex() {
+    static std::atomic<int> nextIndex(0);
+    thread_local int index = nextIndex++ % kMetricShards;
+    return index;
+}
+
+int64_t MetricCounter::value() const {
+    int64_t result = 0;
+    for (const auto& shard : shards_) {
+        result += shard.value.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+MetricHistogram::Shard::Shard() : count(0), sum(0) {
+    for (auto& bucket : buckets) {
+        bucket = 0;
+    }
+}
+
+MetricHistogram::MetricHistogram(double exportScale) : shards_(new Shard[kMetricShards]), exportScale_(exportScale) {
+}
+
+int MetricHistogram::bucketIndex(int64_t value) {
+    if (value < kSubBuckets) {
+        return value < 0 ? 0 : static_cast<int>(value);
+    }
+    int exponent = 0; // floor(log2(value))
+    uint64_t v = static_cast<uint64_t>(value);
+    while (v >> (exponent + 1)) {
+        exponent++;
+    }
+    int subBucket = static_cast<int>(v >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + subBucket;
+}
+
+int64_t MetricHistogram::bucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    int exponent = index / kSubBuckets + kSubBucketBits - 1;
+    int subBucket = index % kSubBuckets;
+    int shift = exponent - kSubBucketBits;
+    int64_t lower = static_cast<int64_t>(kSubBuckets + subBucket) << shift;
+    return lower + (int64_t(1) << shift) - 1;
+}
+
+void MetricHistogram::observe(int64_t value) {
+    Shard& shard = shards_[metricShardIndex()];
+    shard.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+int64_t MetricHistogram::count() const {
+    int64_t result = 0;
+    for (int i = 0; i < kMetricShards; i++) {
+        result += shards_[i].count.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+int64_t MetricHistogram::sum() const {
+    int64_t result = 0;
+    for (int i = 0; i < kMetricShards; i++) {
+        result += shards_[i].sum.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+std::vector<int64_t> MetricHistogram::buckets() const {
+    std::vector<int64_t> result(kBucketCount);
+    for (int i = 0; i < kMetricShards; i++) {
+        for (int j = 0; j < kBucketCount; j++) {
+            result[j] += shards_[i].buckets[j].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+int64_t MetricHistogram::quantile(double q) const {
+    std::vector<int64_t> counts = buckets();
+    int64_t total = 0;
+    for (int64_t c : counts) {
+        total += c;
+    }
+    if (!total) {
+        return 0;
+    }
+    auto rank = static_cast<int64_t>(q * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    int64_t accumulated = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        accumulated += counts[i];
+        if (accumulated >= rank) {
+            return bucketUpperBound(i);
+        }
+    }
+    return bucketUpperBound(kBucketCount - 1);
+}
+
+int64_t MetricHistogram::countLessOrEqual(int64_t value) const {
+    std::vector<int64_t> counts = buckets();
+    int64_t result = 0;
+    for (int i = 0; i < kBucketCount && bucketUpperBound(i) <= value; i++) {
+        result += counts[i];
+    }
+    return result;
+}
+
+double MetricHistogram::exportScale() const {
+    return exportScale_;
+}
+
+MetricsRegistry* MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return &registry;
+}
+
+std::string MetricsRegistry::renderLabels(const MetricLabels& labels) {
+    std::string result;
+    for (const auto& label : labels) {
+        if (!result.empty()) {
+            result += ",";
+        }
+        result += label.first + "=\"";
+        for (char c : label.second) {
+            if (c == '\\' || c == '"') {
+                result += '\\';
+                result += c;
+            } else if (c == '\n') {
+                result += "\\n";
+            } else {
+                result += c;
+            }
+        }
+        result += "\"";
+    }
+    return result;
+}
+
+Metric* MetricsRegistry::getOrCreate(const std::string& name, const std::string& help, MetricType type, const MetricLabels& labels, double exportScale) {
+    std::string key = renderLabels(labels);
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = families_.find(name);
+        if (it != families_.end()) {
+            auto seriesIt = it->second.series.find(key);
+            if (seriesIt != it->second.series.end()) {
+                return seriesIt->second.get();
+            }
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        it = families_.emplace(name, Family{ type, help, {} }).first;
+    } else if (it->second.type != type) {
+        LOG(ERROR) << "Metric '" << name << "' is already registered with another type";
+        return nullptr;
+    }
+    auto& series = it->second.series[key];
+    if (!series) {
+        switch (type) {
+            case MetricType::Counter:
+                series = std::make_unique<MetricCounter>();
+                break;
+            case MetricType::Gauge:
+                series = std::make_unique<MetricGauge>();
+                break;
+            case MetricType::Histogram:
+                series = std::make_unique<MetricHistogram>(exportScale);
+                break;
+        }
+    }
+    return series.get();
+}
+
+// Callers never check the result, so a name conflict gets a metric which is not exported
+MetricCounter* MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    static MetricCounter unregistered;
+    Metric* metric = getOrCreate(name, help, MetricType::Counter, labels, 1);
+    return metric ? static_cast<MetricCounter*>(metric) : &unregistered;
+}
+
+MetricGauge* MetricsRegistry::gauge(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    static MetricGauge unregistered;
+    Metric* metric = getOrCreate(name, help, MetricType::Gauge, labels, 1);
+    return metric ? static_cast<MetricGauge*>(metric) : &unregistered;
+}
+
+MetricHistogram* MetricsRegistry::histogram(const std::string& name, const std::string& help, const MetricLabels& labels, double exportScale) {
+    static MetricHistogram unregistered;
+    Metric* metric = getOrCreate(name, help, MetricType::Histogram, labels, exportScale);
+    return metric ? static_cast<MetricHistogram*>(metric) : &unregistered;
+}
+
+std::string MetricsRegistry::toPrometheus() {
+    std::ostringstream out;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& family : families_) {
+        const std::string& name = family.first;
+        const char* typeName = family.second.type == MetricType::Counter ? "counter"
+            : family.second.type == MetricType::Gauge ? "gauge" : "histogram";
+        out << "# HELP " << name << " " << family.second.help << "\n";
+        out << "# TYPE " << name << " " << typeName << "\n";
+        for (const auto& series : family.second.series) {
+            const std::string& labels = series.first;
+            if (family.second.type == MetricType::Counter) {
+                out << name << (labels.empty() ? "" : "{" + labels + "}") << " " << static_cast<MetricCounter*>(series.second.get())->value() << "\n";
+            } else if (family.second.type == MetricType::Gauge) {
+                out << name << (labels.empty() ? "" : "{" + labels + "}") << " " << static_cast<MetricGauge*>(series.second.get())->value() << "\n";
+            } else {
+                auto* histogram = static_cast<MetricHistogram*>(series.second.get());
+                std::string prefix = labels.empty() ? "" : labels + ",";
+                std::vector<int64_t> counts = histogram->buckets();
+                int64_t total = 0;
+                // Buckets are exported only where the next bucket starts at a power of two
+                for (int i = 0; i < MetricHistogram::kBucketCount; i++) {
+                    total += counts[i];
+                    int64_t upper = MetricHistogram::bucketUpperBound(i);
+                    int64_t next = upper + 1;
+                    if ((next & (next - 1)) == 0 && next >= 64 && next <= (int64_t(1) << 36)) {
+                        out << name << "_bucket{" << prefix << "le=\"" << upper / histogram->exportScale() << "\"} " << total << "\n";
+                    }
+                }
+                out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << total << "\n";
+                out << name << "_sum" << (labels.empty() ? "" : "{" + labels + "}") << " " << histogram->sum() / histogram->exportScale() << "\n";
+                out << name << "_count" << (labels.empty() ? "" : "{" + labels + "}") << " " << total << "\n";
+            }
+        }
+    }
+    return out.str();
+}
+
+bool MetricsRegistry::writeToFile(const std::string& fileName) {
+    std::string tempFileName = fileName + ".tmp";
+    if (!IuCoreUtils::PutFileContents(tempFileName, toPrometheus())) {
+        return false;
+    }
+    boost::system::error_code ec;
+    boost::filesystem::rename(tempFileName, fileName, ec);
+    if (ec) {
+        LOG(ERROR) << "Cannot write metrics file: " << ec.message();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,197 @@
+#ifndef IU_CORE_METRICS_METRICSREGISTRY_H
+#define IU_CORE_METRICS_METRICSREGISTRY_H
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <shared_mutex>
+
+#include "Core/Utils/CoreTypes.h"
+
+typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+constexpr int kMetricShards = 8;
+
+/**
+ * Returns index of the shard used by the current thread
+ */
+int metricShardIndex();
+
+class Metric {
+public:
+    virtual ~Metric() = default;
+};
+
+/**
+@brief Monotonic counter. Each thread increments its own cache line, value() sums the shards.
+*/
+class MetricCounter: public Metric {
+public:
+    void inc(int64_t value = 1) {
+        shards_[metricShardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+    int64_t value() const;
+private:
+    struct alignas(64) Shard {
+        std::atomic<int64_t> value{ 0 };
+    };
+    Shard shards_[kMetricShards];
+};
+
+class MetricGauge: public Metric {
+public:
+    void set(int64_t value) {
+        value_.store(value, std::memory_order_relaxed);
+    }
+    void inc(int64_t value = 1) {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+    void dec(int64_t value = 1) {
+        value_.fetch_sub(value, std::memory_order_relaxed);
+    }
+    int64_t value() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+private:
+    std::atomic<int64_t> value_{ 0 };
+};
+
+/**
+@brief HDR-style histogram with log-linear buckets (each power of two is split into kSubBuckets
+linear buckets, so relative error is below 25%). Values are integers (e.g. microseconds).
+*/
+class MetricHistogram: public Metric {
+public:
+    static constexpr int kSubBucketBits = 2;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBucketCount = (64 - kSubBucketBits) * kSubBuckets;
+
+    /**
+     * @param exportScale exported values are divided by this number (1e6 converts microseconds to seconds)
+     */
+    explicit MetricHistogram(double exportScale = 1e6);
+
+    void observe(int64_t value);
+    int64_t count() const;
+    int64_t sum() const;
+
+    /**
+     * Returns upper bound of the bucket containing q-th quantile (0 <= q <= 1)
+     */
+    int64_t quantile(double q) const;
+
+    /**
+     * Returns number of observed values less than or equal to value
+     */
+    int64_t countLessOrEqual(int64_t value) const;
+    double exportScale() const;
+
+    /**
+     * Returns bucket counters merged from all shards
+     */
+    std::vector<int64_t> buckets() const;
+
+    static int bucketIndex(int64_t value);
+    static int64_t bucketUpperBound(int index);
+private:
+    struct alignas(64) Shard {
+        std::atomic<int64_t> buckets[kBucketCount];
+        std::atomic<int64_t> count;
+        std::atomic<int64_t> sum;
+        Shard();
+    };
+    std::unique_ptr<Shard[]> shards_;
+    double exportScale_;
+};
+
+/**
+@brief MetricsRegistry is a global registry of named metrics, exported in Prometheus text format.
+
+Looking up a metric takes a shared lock, so callers on hot paths should keep the returned pointer
+(metrics are never deleted) or use MetricFamily for labelled metrics. Updating the metric itself
+is lock-free. If the name is already registered with another type, the lookup logs an error and
+returns a metric which is not exported.
+*/
+class MetricsRegistry {
+public:
+    static MetricsRegistry* instance();
+
+    MetricCounter* counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    MetricGauge* gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    MetricHistogram* histogram(const std::string& name, const std::string& help, const MetricLabels& labels = {}, double exportScale = 1e6);
+
+    std::string toPrometheus();
+
+    /**
+     * Writes metrics to the file atomically (via temporary file)
+     */
+    bool writeToFile(const std::string& fileName);
+private:
+    enum class MetricType { Counter, Gauge, Histogram };
+    struct Family {
+        MetricType type;
+        std::string help;
+        std::map<std::string, std::unique_ptr<Metric>> series; // key is rendered label set
+    };
+    MetricsRegistry() = default;
+    Metric* getOrCreate(const std::string& name, const std::string& help, MetricType type, const MetricLabels& labels, double exportScale);
+    static std::string renderLabels(const MetricLabels& labels);
+
+    std::map<std::string, Family> families_;
+    std::shared_mutex mutex_;
+    DISALLOW_COPY_AND_ASSIGN(MetricsRegistry);
+};
+
+/**
+@brief MetricFamily keeps pointers to the series of a labelled metric in a thread-local map
+keyed by label values. Only the first update of a series on each thread looks it up in the registry.
+Instances are meant to be static.
+*/
+template <class T>
+class MetricFamily {
+public:
+    MetricFamily(std::string name, std::string help, std::vector<std::string> labelNames, double exportScale = 1e6) :
+        name_(std::move(name)), help_(std::move(help)), labelNames_(std::move(labelNames)), exportScale_(exportScale) {
+    }
+
+    /**
+     * @param labelValues values of the labels in the order of labelNames
+     */
+    T* get(const std::vector<std::string>& labelValues) {
+        thread_local std::map<std::pair<const MetricFamily*, std::vector<std::string>>, T*> cache;
+        auto key = std::make_pair(this, labelValues);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            return it->second;
+        }
+        MetricLabels labels;
+        for (size_t i = 0; i < labelNames_.size() && i < labelValues.size(); i++) {
+            labels.emplace_back(labelNames_[i], labelValues[i]);
+        }
+        T* metric = create(static_cast<T*>(nullptr), labels);
+        cache.emplace(std::move(key), metric);
+        return metric;
+    }
+private:
+    MetricCounter* create(MetricCounter*, const MetricLabels& labels) {
+        return MetricsRegistry::instance()->counter(name_, help_, labels);
+    }
+    MetricGauge* create(MetricGauge*, const MetricLabels& labels) {
+        return MetricsRegistry::instance()->gauge(name_, help_, labels);
+    }
+    MetricHistogram* create(MetricHistogram*, const MetricLabels& labels) {
+        return MetricsRegistry::instance()->histogram(name_, help_, labels, exportScale_);
+    }
+
+    std::string name_;
+    std::string help_;
+    std::vector<std::string> labelNames_;
+    double exportScale_;
+    DISALLOW_COPY_AND_ASSIGN(MetricFamily);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "MetricsServer.h"
+
+#include <thread>
+
+#include "Core/3rdpart/SimpleWebServer/server_http.hpp"
+#include "Core/Logging.h"
+#include "MetricsRegistry.h"
+
+using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
+
+class MetricsServerPrivate {
+public:
+    HttpServer server_;
+    std::thread thread_;
+};
+
+MetricsServer::MetricsServer() : d_(std::make_unique<MetricsServerPrivate>()) {
+    d_->server_.resource["^/metrics$"]["GET"] = [](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> /*request*/) {
+        SimpleWeb::CaseInsensitiveMultimap header;
+        header.emplace("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+        response->write(SimpleWeb::StatusCode::success_ok, MetricsRegistry::instance()->toPrometheus(), header);
+    };
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+unsigned short MetricsServer::start(const std::string& address, unsigned short port) {
+    d_->server_.config.address = address;
+    d_->server_.config.port = port;
+    unsigned short assignedPort = 0;
+    try {
+        assignedPort = d_->server_.bind();
+    } catch (const std::exception& ex) {
+        LOG(ERROR) << "Cannot start metrics server: " << ex.what();
+        return 0;
+    }
+    d_->thread_ = std::thread([this] {
+        d_->server_.accept_and_run();
+    });
+    return assignedPort;
+}
+
+void MetricsServer::stop() {
+    if (d_->thread_.joinable()) {
+        d_->server_.stop();
+        d_->thread_.join();
+    }
+}
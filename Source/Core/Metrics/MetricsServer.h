@@ -0,0 +1,34 @@
+#ifndef IU_CORE_METRICS_METRICSSERVER_H
+#define IU_CORE_METRICS_METRICSSERVER_H
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "Core/Utils/CoreTypes.h"
+
+class MetricsServerPrivate;
+
+/**
+@brief MetricsServer serves MetricsRegistry in Prometheus text format at /metrics endpoint.
+The server runs in a background thread.
+*/
+class MetricsServer {
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    /**
+     * Binds to the address and starts serving requests.
+     * @param port pass 0 to choose a free port
+     * @return assigned port or 0 on error
+     */
+    unsigned short start(const std::string& address, unsigned short port);
+    void stop();
+private:
+    std::unique_ptr<MetricsServerPrivate> d_;
+    DISALLOW_COPY_AND_ASSIGN(MetricsServer);
+};
+
+#endif
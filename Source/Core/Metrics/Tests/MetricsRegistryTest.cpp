@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "Core/Metrics/MetricsRegistry.h"
+
+TEST(MetricsRegistryTest, CounterIsShardedBetweenThreads)
+{
+    MetricCounter* counter = MetricsRegistry::instance()->counter("test_counter_total", "Test counter", { { "server", "a" } });
+    ASSERT_TRUE(counter != nullptr);
+    EXPECT_EQ(counter, MetricsRegistry::instance()->counter("test_counter_total", "Test counter", { { "server", "a" } }));
+    EXPECT_NE(counter, MetricsRegistry::instance()->counter("test_counter_total", "Test counter", { { "server", "b" } }));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([counter] {
+            for (int j = 0; j < 1000; j++) {
+                counter->inc();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(4000, counter->value());
+}
+
+TEST(MetricsRegistryTest, HistogramBuckets)
+{
+    for (int64_t value : { 0, 1, 3, 4, 7, 8, 9, 100, 1000, 123456789 }) {
+        int index = MetricHistogram::bucketIndex(value);
+        EXPECT_LE(value, MetricHistogram::bucketUpperBound(index)) << value;
+        if (index > 0) {
+            EXPECT_GT(value, MetricHistogram::bucketUpperBound(index - 1)) << value;
+        }
+    }
+
+    MetricHistogram histogram;
+    for (int i = 1; i <= 100; i++) {
+        histogram.observe(i * 1000);
+    }
+    EXPECT_EQ(100, histogram.count());
+    EXPECT_EQ(5050000, histogram.sum());
+    int64_t median = histogram.quantile(0.5);
+    EXPECT_GE(median, 50000);
+    EXPECT_LE(median, 50000 * 5 / 4);
+    EXPECT_EQ(100, histogram.countLessOrEqual(200000));
+}
+
+TEST(MetricsRegistryTest, PrometheusExport)
+{
+    MetricsRegistry* registry = MetricsRegistry::instance();
+    registry->gauge("test_queue_depth", "Queue depth")->set(5);
+    registry->histogram("test_latency_seconds", "Latency", { { "host", "example.com" } })->observe(1500);
+    std::string text = registry->toPrometheus();
+    EXPECT_NE(std::string::npos, text.find("# TYPE test_queue_depth gauge\ntest_queue_depth 5\n"));
+    EXPECT_NE(std::string::npos, text.find("# TYPE test_latency_seconds histogram\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_bucket{host=\"example.com\",le=\"0.001023\"} 0\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_bucket{host=\"example.com\",le=\"0.002047\"} 1\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_bucket{host=\"example.com\",le=\"+Inf\"} 1\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_sum{host=\"example.com\"} 0.0015\n"));
+    EXPECT_NE(std::string::npos, text.find("test_latency_seconds_count{host=\"example.com\"} 1\n"));
+}
+
+TEST(MetricsRegistryTest, FamilyCachesSeries)
+{
+    static MetricFamily<MetricCounter> family("test_family_total", "Test family", { "server", "result" });
+    MetricCounter* counter = family.get({ "a", "success" });
+    EXPECT_EQ(counter, MetricsRegistry::instance()->counter("test_family_total", "Test family", { { "server", "a" }, { "result", "success" } }));
+    EXPECT_EQ(counter, family.get({ "a", "success" }));
+    EXPECT_NE(counter, family.get({ "a", "failure" }));
+
+    // Another thread gets the same series from its own cache
+    MetricCounter* otherThreadCounter = nullptr;
+    std::thread([&] { otherThreadCounter = family.get({ "a", "success" }); }).join();
+    EXPECT_EQ(counter, otherThreadCounter);
+}
+
+TEST(MetricsRegistryTest, TypeConflict)
+{
+    MetricsRegistry* registry = MetricsRegistry::instance();
+    registry->counter("test_conflict", "Counter")->inc();
+    // Not registered, but safe to update
+    MetricGauge* gauge = registry->gauge("test_conflict", "Gauge");
+    ASSERT_TRUE(gauge != nullptr);
+    gauge->set(7);
+    EXPECT_EQ(std::string::npos, registry->toPrometheus().find("test_conflict 7"));
+}
@@ -56,13 +56,33 @@ class INetworkClient {
             AbortedException(const AbortedException& ex) = default;
         };
 
+        /**
+         * Source of the request body for doUploadStream()
+         */
+        class UploadStream {
+        public:
+            /**
+             * Copies up to size bytes into buffer. Returns 0 at the end of the stream.
+             */
+            virtual size_t read(char* buffer, size_t size) = 0;
+
+            /**
+             * Restarts the stream from the beginning (curl may need to resend the body,
+             * e.g. after a redirect). Returns false if it is not possible.
+             */
+            virtual bool rewind() = 0;
+            virtual ~UploadStream() = default;
+        };
+
         virtual void addQueryParam(const std::string& name, const std::string& value){}
         virtual void addQueryParamFile(const std::string& name, const std::string& fileName, const std::string& displayName, const std::string& contentType){};
         virtual void addQueryHeader(const std::string& name, const std::string& value) {};
+        virtual bool hasQueryHeader(const std::string& name) { return false; }
         virtual void setUrl(const std::string& url){};
         virtual bool doPost(const std::string& data) { return false; }
         virtual bool doUploadMultipartData(){ return false; }
         virtual bool doUpload(const std::string& fileName, const std::string &data) { return false; }
+        virtual bool doUploadStream(UploadStream* stream, int64_t size) { return false; }
         virtual bool doGet(const std::string &url){ return false; }
         virtual std::string responseBody() { return std::string(); };
         virtual int responseCode(){ return 0; }
@@ -29,10 +29,13 @@
 #include <memory.h>
 #include <cstdio>
 #include <algorithm>
+#include <set>
 
 #include "Core/Utils/CoreUtils.h"
 #include "Core/Utils/StringUtils.h"
 #include "Core/Logging.h"
+#include "Core/Logging/TraceRecorder.h"
+#include "Core/Metrics/MetricsRegistry.h"
 #include "CurlShare.h"
 
 #ifdef USE_OPENSSL
@@ -245,9 +248,11 @@ NetworkClient::NetworkClient()
     chunkSize_ = -1;
     m_uploadingFileReadBytes = 0;
     chunk_ = nullptr;
+    m_formPost = nullptr;
     curlShare_ = nullptr;
     m_CurrentFileSize = -1;
     m_uploadingFile = nullptr;
+    m_uploadStream = nullptr;
     *m_errorBuffer = 0;
     m_progressCallbackFunc = nullptr;
     curl_handle = curl_easy_init(); // Initializing libcurl
@@ -357,11 +362,19 @@ void NetworkClient::closeFileList(std::vector<FILE *>& files)
 }
 
 bool NetworkClient::doUploadMultipartData()
+{
+    if (!prepareUploadMultipartData()) {
+        return false;
+    }
+    return private_perform();
+}
+
+bool NetworkClient::prepareUploadMultipartData()
 {
     private_initTransfer();
-    std::vector<FILE *> openedFiles;
+    std::vector<FILE *>& openedFiles = m_openedFiles;
 
-    struct curl_httppost *formpost=nullptr;
+    struct curl_httppost *&formpost = m_formPost;
     struct curl_httppost *lastptr=nullptr;
 
     {
@@ -377,7 +390,10 @@ bool NetworkClient::doUploadMultipartData()
                     FILE * curFile = IuCoreUtils::FopenUtf8(it->value.c_str(), "rb"); /* open file to upload */
                     if(!curFile) 
                     {
-                        closeFileList(openedFiles);
+                        LOG(ERROR) << "Failed to open file '" << fileName << "'";
+                        // Files, form parts and headers are released like after a finished request
+                        private_release_request_data();
+                        private_cleanup_after();
                         return false; /* can't continue */
                     }
                     openedFiles.push_back(curFile);
@@ -439,14 +455,38 @@ bool NetworkClient::doUploadMultipartData()
 
     curl_easy_setopt(curl_handle, CURLOPT_HTTPPOST, formpost);
     m_currentActionType = ActionType::atUpload;
-    curl_result = curl_easy_perform(curl_handle);
-    closeFileList(openedFiles);
-    curl_formfree(formpost);
+    return true;
+}
+
+bool NetworkClient::private_perform()
+{
+    return finishRequest(curl_easy_perform(curl_handle));
+}
+
+bool NetworkClient::finishRequest(CURLcode result)
+{
+    curl_result = result;
+    private_release_request_data();
     return private_on_finish_request();
 }
 
+void NetworkClient::private_release_request_data()
+{
+    closeFileList(m_openedFiles);
+    if (m_formPost) {
+        curl_formfree(m_formPost);
+        m_formPost = nullptr;
+    }
+    if (m_uploadingFile) {
+        fclose(m_uploadingFile);
+        m_uploadingFile = nullptr;
+    }
+    m_postData.clear();
+}
+
 bool NetworkClient::private_on_finish_request()
 {
+    private_record_request_stats();
     private_checkResponse();
     private_cleanup_after();
     private_parse_headers();
@@ -461,6 +501,98 @@ bool NetworkClient::private_on_finish_request()
     return true;
 }
 
+// Only the first hosts get their own series, the rest share one series,
+// so a session with many distinct hosts cannot grow the metrics without bound
+static std::string hostMetricLabel(const std::string& host)
+{
+    const size_t kMaxHostLabels = 64;
+    static std::mutex hostsMutex;
+    static std::set<std::string> knownHosts;
+    std::lock_guard<std::mutex> lock(hostsMutex);
+    if (knownHosts.count(host) || (knownHosts.size() < kMaxHostLabels && knownHosts.insert(host).second)) {
+        return host;
+    }
+    return "other";
+}
+
+void NetworkClient::private_record_request_stats()
+{
+    curl_off_t nameLookup = 0, connect = 0, appConnect = 0, preTransfer = 0, startTransfer = 0, total = 0;
+    curl_easy_getinfo(curl_handle, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+    curl_easy_getinfo(curl_handle, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl_handle, CURLINFO_APPCONNECT_TIME_T, &appConnect);
+    curl_easy_getinfo(curl_handle, CURLINFO_PRETRANSFER_TIME_T, &preTransfer);
+    curl_easy_getinfo(curl_handle, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+    curl_easy_getinfo(curl_handle, CURLINFO_TOTAL_TIME_T, &total);
+    char* effectiveUrl = nullptr;
+    curl_easy_getinfo(curl_handle, CURLINFO_EFFECTIVE_URL, &effectiveUrl);
+    long code = 0;
+    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &code);
+    std::string url = effectiveUrl ? effectiveUrl : m_url;
+
+    // All curl timings are measured in microseconds from the start of the request
+    std::string host = url;
+    size_t schemeEnd = host.find("://");
+    if (schemeEnd != std::string::npos) {
+        host.erase(0, schemeEnd + 3);
+    }
+    host = IuStringUtils::toLower(host.substr(0, host.find_first_of(":/?")));
+    static MetricFamily<MetricCounter> requestsTotal("iu_http_requests_total", "Number of HTTP requests", { "host" });
+    static MetricFamily<MetricCounter> failuresTotal("iu_http_request_failures_total", "Number of HTTP requests failed on network level", { "host" });
+    static MetricFamily<MetricHistogram> connectSeconds("iu_http_connect_seconds", "TCP connect time (new connections only)", { "host" });
+    static MetricFamily<MetricHistogram> tlsSeconds("iu_http_tls_seconds", "TLS handshake time (new connections only)", { "host" });
+    static MetricFamily<MetricHistogram> ttfbSeconds("iu_http_ttfb_seconds", "Time to first byte of the response", { "host" });
+    static MetricFamily<MetricHistogram> requestSeconds("iu_http_request_seconds", "Total time of HTTP request", { "host" });
+    const std::vector<std::string> labels { hostMetricLabel(host) };
+    requestsTotal.get(labels)->inc();
+    if (curl_result != CURLE_OK) {
+        failuresTotal.get(labels)->inc();
+    }
+    // Connect and TLS times are zero when connection has been reused
+    if (connect > nameLookup) {
+        connectSeconds.get(labels)->observe(connect - nameLookup);
+    }
+    if (appConnect > connect) {
+        tlsSeconds.get(labels)->observe(appConnect - connect);
+    }
+    if (startTransfer) {
+        ttfbSeconds.get(labels)->observe(startTransfer);
+    }
+    requestSeconds.get(labels)->observe(total);
+
+    if (!TraceRecorder::isEnabled()) {
+        return;
+    }
+    TraceRecorder* recorder = TraceRecorder::instance();
+    int64_t start = TraceRecorder::now() - total;
+    std::vector<TraceArg> args {
+        TraceRecorder::arg("url", url),
+        TraceRecorder::arg("method", m_method),
+        TraceRecorder::arg("code", static_cast<int64_t>(code)),
+        TraceRecorder::arg("curl_result", static_cast<int64_t>(curl_result)),
+        TraceRecorder::arg("namelookup_us", static_cast<int64_t>(nameLookup)),
+        TraceRecorder::arg("connect_us", static_cast<int64_t>(connect)),
+        TraceRecorder::arg("appconnect_us", static_cast<int64_t>(appConnect)),
+        TraceRecorder::arg("pretransfer_us", static_cast<int64_t>(preTransfer)),
+        TraceRecorder::arg("starttransfer_us", static_cast<int64_t>(startTransfer)),
+        TraceRecorder::arg("total_us", static_cast<int64_t>(total))
+    };
+    recorder->addCompleteEvent("network", "HTTP request", start, total, std::move(args));
+
+    // Connection phases (zero duration phases are skipped, e.g. reused connection)
+    auto addPhase = [&](const char* name, curl_off_t from, curl_off_t to) {
+        if (to > from) {
+            recorder->addCompleteEvent("network", name, start + from, to - from);
+        }
+    };
+    addPhase("DNS lookup", 0, nameLookup);
+    addPhase("TCP connect", nameLookup, connect);
+    addPhase("TLS handshake", connect, appConnect);
+    // Sending the request (including an uploaded body) and waiting for the first byte of the response
+    addPhase("Request+Wait", std::max(preTransfer, appConnect), startTransfer);
+    addPhase("Response", startTransfer, total);
+}
+
 std::string NetworkClient::responseBody()
 {
     return internalBuffer;
@@ -478,7 +610,21 @@ void NetworkClient::addQueryHeader(const std::string& name, const std::string& v
     m_QueryHeaders.emplace_back(name, value);
 }
 
+bool NetworkClient::hasQueryHeader(const std::string& name)
+{
+    std::string lowerName = IuStringUtils::toLower(name);
+    return std::any_of(m_QueryHeaders.begin(), m_QueryHeaders.end(), [&lowerName](const CustomHeaderItem& item) {
+        return IuStringUtils::toLower(item.name) == lowerName;
+    });
+}
+
 bool NetworkClient::doGet(const std::string & url)
+{
+    prepareGet(url);
+    return private_perform();
+}
+
+bool NetworkClient::prepareGet(const std::string & url)
 {
     if(!url.empty())
         setUrl(url);
@@ -487,17 +633,23 @@ bool NetworkClient::doGet(const std::string & url)
     if(!private_apply_method())
         curl_easy_setopt(curl_handle, CURLOPT_HTTPGET, 1);
     m_currentActionType = ActionType::atGet;
-    curl_result = curl_easy_perform(curl_handle);
-    return private_on_finish_request();
-
+    return true;
 }
 
 bool NetworkClient::doPost(const std::string& data)
+{
+    preparePost(data);
+    return private_perform();
+}
+
+bool NetworkClient::preparePost(const std::string& data)
 {
     private_initTransfer();
     if(!private_apply_method())
    curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
-    std::string postData;
+    // CURLOPT_POSTFIELDS does not copy the data, it should live until the request is finished
+    std::string& postData = m_postData;
+    postData.clear();
     std::vector<QueryParam>::iterator it, end = m_QueryParams.end();
 
         for(it=m_QueryParams.begin(); it!=end; ++it)
@@ -513,13 +665,13 @@ bool NetworkClient::doPost(const std::string& data)
         curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, static_cast<long>(postData.length()));
     }
     else {
-        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, (const char*)data.data());
-        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, (long)data.length());
+        postData = data;
+        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, (const char*)postData.data());
+        curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, (long)postData.length());
     }
 
     m_currentActionType = ActionType::atPost;    
-    curl_result = curl_easy_perform(curl_handle);
-    return private_on_finish_request();
+    return true;
 }
 
 std::string NetworkClient::urlEncode(const std::string& str)
@@ -732,6 +884,7 @@ void NetworkClient::private_cleanup_after()
 
     m_uploadData.clear();
     m_uploadingFile = nullptr;
+    m_uploadStream = nullptr;
     chunkOffset_ = -1;
     chunkSize_ = -1;
     enableResponseCodeChecking_ = true;
@@ -768,12 +921,14 @@ size_t NetworkClient::private_read_callback(void *ptr, size_t size, size_t nmemb
             retcode = std::min<>((int64_t)retcode, chunkOffset_ + m_currentUploadDataSize - pos);
         }
         m_uploadingFileReadBytes += retcode;
+    } else if (m_uploadStream) {
+        retcode = m_uploadStream->read(static_cast<char*>(ptr), size * nmemb);
     } else
     {
         int wantsToRead = size * nmemb;
         // dont even try to remove "<>" brackets!!
         int canRead = std::min<>((int)m_uploadData.size()-m_nUploadDataOffset, (int)wantsToRead);
-        memcpy(ptr, m_uploadData.data(), canRead);
+        memcpy(ptr, m_uploadData.data() + m_nUploadDataOffset, canRead);
         m_nUploadDataOffset += canRead;
         retcode = canRead;
     }
@@ -793,6 +948,11 @@ int NetworkClient::private_seek_callback(void *userp, curl_off_t offset, int ori
             return CURL_SEEKFUNC_CANTSEEK;
         }
         return IuCoreUtils::Fseek64(nc->m_uploadingFile, newOffset, newOrigin);
+    } else if (nc->m_uploadStream) {
+        if (origin == SEEK_SET && offset == 0 && nc->m_uploadStream->rewind()) {
+            return CURL_SEEKFUNC_OK;
+        }
+        return CURL_SEEKFUNC_CANTSEEK;
     } else {
         if (origin == SEEK_SET) {
             if (offset < 0 || offset>= nc->m_uploadData.size()) {
@@ -811,6 +971,14 @@ int NetworkClient::private_seek_callback(void *userp, curl_off_t offset, int ori
 
 
 bool NetworkClient::doUpload(const std::string& fileName, const std::string &data)
+{
+    if (!prepareUpload(fileName, data)) {
+        return false;
+    }
+    return private_perform();
+}
+
+bool NetworkClient::prepareUpload(const std::string& fileName, const std::string &data)
 {
     if(!fileName.empty())
     {
@@ -824,6 +992,7 @@ bool NetworkClient::doUpload(const std::string& fileName, const std::string &dat
         m_currentUploadDataSize = m_CurrentFileSize;
         if(m_CurrentFileSize < 0) {
             fclose(m_uploadingFile);
+            m_uploadingFile = nullptr;
             return false;
         }
             
@@ -858,12 +1027,45 @@ bool NetworkClient::doUpload(const std::string& fileName, const std::string &dat
     private_initTransfer();
 
     curl_easy_setopt(curl_handle, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(m_currentUploadDataSize));
-    
-    curl_result = curl_easy_perform(curl_handle);
-    if(m_uploadingFile)
-         fclose(m_uploadingFile);
-    bool res = private_on_finish_request();
-    return res;
+    return true;
+}
+
+bool NetworkClient::doUploadStream(UploadStream* stream, int64_t size)
+{
+    if (!prepareUploadStream(stream, size)) {
+        return false;
+    }
+    return private_perform();
+}
+
+bool NetworkClient::prepareUploadStream(UploadStream* stream, int64_t size)
+{
+    if (!stream) {
+        return false;
+    }
+    m_uploadStream = stream;
+    m_CurrentFileSize = size;
+    m_currentUploadDataSize = size;
+    m_currentActionType = ActionType::atPost;
+
+    curl_easy_setopt(curl_handle, CURLOPT_READFUNCTION, read_callback);
+    curl_easy_setopt(curl_handle, CURLOPT_SEEKFUNCTION, private_seek_callback);
+    curl_easy_setopt(curl_handle, CURLOPT_SEEKDATA, this);
+    if (!private_apply_method()) {
+        curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
+    }
+    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, NULL);
+    curl_easy_setopt(curl_handle, CURLOPT_READDATA, this);
+
+    if (size < 0) {
+        addQueryHeader("Transfer-Encoding", "chunked");
+    } else if (m_method != "PUT") {
+        addQueryHeader("Content-Length", IuCoreUtils::Int64ToString(size));
+    }
+    private_initTransfer();
+
+    curl_easy_setopt(curl_handle, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(size));
+    return true;
 }
 
 bool NetworkClient::private_apply_method()
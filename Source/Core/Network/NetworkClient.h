@@ -83,6 +83,12 @@ class NetworkClient: public INetworkClient
         */
         void addQueryHeader(const std::string& name, const std::string& value) override;
 
+        /**
+         * Returns true if the header has been set by addQueryHeader() for the next request.
+         * Header names are compared case-insensitively.
+         */
+        bool hasQueryHeader(const std::string& name) override;
+
         /**
          * Sets the URL for the next request.
          */
@@ -118,6 +124,15 @@ class NetworkClient: public INetworkClient
         */
         bool doUpload(const std::string& fileName, const std::string &data) override;
 
+        /*! @cond PRIVATE */
+        /**
+         * Sends the data produced by the stream in the body of a POST request (or with the method set by setMethod()),
+         * without keeping the whole body in memory. If size is negative, the body is sent with chunked transfer encoding.
+         * The stream should stay alive until the request is finished.
+         */
+        bool doUploadStream(UploadStream* stream, int64_t size) override;
+        /*! @endcond */
+
         /**
         Example 1
         @include networkclient_get.nut
@@ -278,13 +293,30 @@ class NetworkClient: public INetworkClient
         void private_cleanup_before();
         void private_cleanup_after();
         bool private_on_finish_request();
+        bool private_perform();
+        void private_record_request_stats();
         void private_initTransfer();
         void private_checkResponse();
+        void private_release_request_data();
         public:
         /*! @cond PRIVATE */
         static void curl_init();
         static void curl_cleanup();
         static void closeFileList(std::vector<FILE *>& files);
+
+        /**
+         * Following functions split doGet(), doPost(), doUploadMultipartData() and doUpload()
+         * into two steps, so the request can be performed by a curl multi handle (see NetworkRequestGroup).
+         * prepare*() set up the easy handle and return false if the request cannot be started.
+         * After the transfer is done, finishRequest() should be called with its result;
+         * it returns the same value as the corresponding do*() function.
+         */
+        bool prepareGet(const std::string& url);
+        bool preparePost(const std::string& data);
+        bool prepareUploadMultipartData();
+        bool prepareUpload(const std::string& fileName, const std::string& data);
+        bool prepareUploadStream(UploadStream* stream, int64_t size);
+        bool finishRequest(CURLcode result);
         /*! @endcond */
         protected:
 
@@ -293,6 +325,7 @@ class NetworkClient: public INetworkClient
         FILE *m_hOutFile;
         std::string m_OutFileName;
         FILE *m_uploadingFile;
+        UploadStream* m_uploadStream;
         int64_t m_uploadingFileReadBytes;
         std::string m_uploadData;
         ActionType m_currentActionType;
@@ -313,6 +346,9 @@ class NetworkClient: public INetworkClient
         std::string errorLogIdString_;
         char m_errorBuffer[CURL_ERROR_SIZE];
         std::string m_method;
+        std::string m_postData;
+        std::vector<FILE*> m_openedFiles;
+        struct curl_httppost* m_formPost;
         struct curl_slist * chunk_;
         bool enableResponseCodeChecking_;
         int64_t chunkOffset_;
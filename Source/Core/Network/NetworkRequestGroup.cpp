@@ -0,0 +1,200 @@
+#include "NetworkRequestGroup.h"
+
+#include "NetworkClient.h"
+#include "Core/Logging.h"
+
+NetworkRequestGroup::NetworkRequestGroup() : nextHandle_(1), failedSinceWaitAll_(false) {
+    NetworkClient::curl_init();
+    multiHandle_ = curl_multi_init();
+}
+
+NetworkRequestGroup::~NetworkRequestGroup() {
+    try {
+        abortAll();
+    } catch (const std::exception& ex) {
+        LOG(ERROR) << ex.what();
+    }
+    curl_multi_cleanup(multiHandle_);
+}
+
+int NetworkRequestGroup::startGet(INetworkClient* client, const std::string& url) {
+    return start(client, [&](NetworkClient* nc) { return nc->prepareGet(url); },
+        [&] { return client->doGet(url); });
+}
+
+int NetworkRequestGroup::startPost(INetworkClient* client, const std::string& data) {
+    return start(client, [&](NetworkClient* nc) { return nc->preparePost(data); },
+        [&] { return client->doPost(data); });
+}
+
+int NetworkRequestGroup::startUploadMultipartData(INetworkClient* client) {
+    return start(client, [&](NetworkClient* nc) { return nc->prepareUploadMultipartData(); },
+        [&] { return client->doUploadMultipartData(); });
+}
+
+int NetworkRequestGroup::startUpload(INetworkClient* client, const std::string& fileName, const std::string& data) {
+    return start(client, [&](NetworkClient* nc) { return nc->prepareUpload(fileName, data); },
+        [&] { return client->doUpload(fileName, data); });
+}
+
+int NetworkRequestGroup::start(INetworkClient* client, const std::function<bool(NetworkClient*)>& prepare, const std::function<bool()>& perform) {
+    if (!client) {
+        return 0;
+    }
+    for (const auto& it : running_) {
+        if (requests_[it.second].client == client) {
+            LOG(ERROR) << "Network client is already performing a request";
+            return 0;
+        }
+    }
+    for (auto it = requests_.begin(); it != requests_.end();) {
+        if (it->second.reported) {
+            it = requests_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    int handle = nextHandle_++;
+    Request& request = requests_[handle];
+    request.client = client;
+    request.curlClient = dynamic_cast<NetworkClient*>(client);
+
+    if (!request.curlClient) {
+        finish(handle, perform());
+        return handle;
+    }
+    if (!prepare(request.curlClient)) {
+        finish(handle, false);
+        return handle;
+    }
+    CURL* easyHandle = request.curlClient->getCurlHandle();
+    CURLMcode code = curl_multi_add_handle(multiHandle_, easyHandle);
+    if (code != CURLM_OK) {
+        LOG(ERROR) << "curl_multi_add_handle failed: " << curl_multi_strerror(code);
+        finish(handle, request.curlClient->finishRequest(CURLE_FAILED_INIT));
+        return handle;
+    }
+    running_[easyHandle] = handle;
+    return handle;
+}
+
+void NetworkRequestGroup::finish(int handle, bool succeeded) {
+    Request& request = requests_[handle];
+    request.finished = true;
+    request.succeeded = succeeded;
+    if (!succeeded) {
+        failedSinceWaitAll_ = true;
+    }
+    finished_.push_back(handle);
+}
+
+bool NetworkRequestGroup::performTransfers() {
+    int stillRunning = 0;
+    CURLMcode code = curl_multi_perform(multiHandle_, &stillRunning);
+    if (code == CURLM_OK) {
+        processMessages();
+        if (finished_.empty() && stillRunning) {
+#if LIBCURL_VERSION_NUM >= 0x074200
+            code = curl_multi_poll(multiHandle_, nullptr, 0, 1000, nullptr);
+#else
+            code = curl_multi_wait(multiHandle_, nullptr, 0, 1000, nullptr);
+#endif
+        }
+    }
+    if (code != CURLM_OK) {
+        LOG(ERROR) << "curl multi interface error: " << curl_multi_strerror(code);
+        for (const auto& it : running_) {
+            curl_multi_remove_handle(multiHandle_, it.first);
+            finish(it.second, requests_[it.second].curlClient->finishRequest(CURLE_FAILED_INIT));
+        }
+        running_.clear();
+        return false;
+    }
+    return true;
+}
+
+void NetworkRequestGroup::processMessages() {
+    CURLMsg* msg;
+    int messagesLeft = 0;
+    while ((msg = curl_multi_info_read(multiHandle_, &messagesLeft)) != nullptr) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+        CURL* easyHandle = msg->easy_handle;
+        CURLcode result = msg->data.result;
+        auto it = running_.find(easyHandle);
+        if (it == running_.end()) {
+            continue;
+        }
+        int handle = it->second;
+        running_.erase(it);
+        curl_multi_remove_handle(multiHandle_, easyHandle);
+        Request& request = requests_[handle];
+        try {
+            finish(handle, request.curlClient->finishRequest(result));
+        } catch (const INetworkClient::AbortedException&) {
+            finish(handle, false);
+            abortAll();
+            throw;
+        }
+    }
+}
+
+void NetworkRequestGroup::abortAll() {
+    auto running = std::move(running_);
+    running_.clear();
+    for (const auto& it : running) {
+        curl_multi_remove_handle(multiHandle_, it.first);
+        try {
+            requests_[it.second].curlClient->finishRequest(CURLE_ABORTED_BY_CALLBACK);
+        } catch (const INetworkClient::AbortedException&) {
+        }
+        finish(it.second, false);
+    }
+}
+
+int NetworkRequestGroup::waitAny() {
+    while (finished_.empty() && !running_.empty()) {
+        if (!performTransfers()) {
+            break;
+        }
+    }
+    if (finished_.empty()) {
+        return 0;
+    }
+    int handle = finished_.front();
+    finished_.pop_front();
+    requests_[handle].reported = true;
+    return handle;
+}
+
+bool NetworkRequestGroup::waitAll() {
+    while (!running_.empty()) {
+        if (!performTransfers()) {
+            break;
+        }
+    }
+    finished_.clear();
+    for (auto& it : requests_) {
+        if (it.second.finished) {
+            it.second.reported = true;
+        }
+    }
+    bool result = !failedSinceWaitAll_;
+    failedSinceWaitAll_ = false;
+    return result;
+}
+
+bool NetworkRequestGroup::isFinished(int handle) const {
+    auto it = requests_.find(handle);
+    return it != requests_.end() && it->second.finished;
+}
+
+bool NetworkRequestGroup::isSucceeded(int handle) const {
+    auto it = requests_.find(handle);
+    return it != requests_.end() && it->second.succeeded;
+}
+
+int NetworkRequestGroup::runningCount() const {
+    return static_cast<int>(running_.size());
+}
@@ -0,0 +1,82 @@
+#ifndef IU_CORE_NETWORK_NETWORKREQUESTGROUP_H
+#define IU_CORE_NETWORK_NETWORKREQUESTGROUP_H
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <curl/curl.h>
+#include "Core/Utils/CoreTypes.h"
+
+class INetworkClient;
+class NetworkClient;
+
+/**
+@brief NetworkRequestGroup performs several requests of different network clients simultaneously
+using a curl multi handle.
+
+Requests are started by start*() functions, which take the same arguments as the corresponding
+do*() functions of NetworkClient and return a handle of the request (a positive number).
+The transfers are driven by waitAny() and waitAll() on the calling thread, there are no additional threads.
+The object and all clients added to it should be used from the same thread.
+A client can run only one request at a time; after the request is finished, its response
+is available as usual (responseBody(), responseCode(), etc.).
+The state of a request (isFinished(), isSucceeded()) is kept until it has been returned by waitAny()
+or waitAll() and the next request is started, so a long-living group does not accumulate requests.
+
+Clients which are not NetworkClient (e.g. mocks) perform their requests synchronously in start*().
+*/
+class NetworkRequestGroup {
+public:
+    NetworkRequestGroup();
+    ~NetworkRequestGroup();
+
+    int startGet(INetworkClient* client, const std::string& url);
+    int startPost(INetworkClient* client, const std::string& data);
+    int startUploadMultipartData(INetworkClient* client);
+    int startUpload(INetworkClient* client, const std::string& fileName, const std::string& data);
+
+    /**
+     * Waits until any of the requests is finished and returns its handle.
+     * Each finished request is returned only once. Returns 0 if there are no more requests.
+     * Throws INetworkClient::AbortedException if a request was aborted by the progress callback,
+     * all other running requests are aborted too in this case.
+     */
+    int waitAny();
+
+    /**
+     * Waits until all running requests are finished.
+     * Returns true if all requests started since the previous waitAll() succeeded.
+     */
+    bool waitAll();
+
+    bool isFinished(int handle) const;
+    bool isSucceeded(int handle) const;
+    int runningCount() const;
+private:
+    struct Request {
+        INetworkClient* client = nullptr;
+        NetworkClient* curlClient = nullptr;
+        bool finished = false;
+        bool succeeded = false;
+        bool reported = false; // returned by waitAny() or waitAll()
+    };
+    int start(INetworkClient* client, const std::function<bool(NetworkClient*)>& prepare, const std::function<bool()>& perform);
+    void finish(int handle, bool succeeded);
+    bool performTransfers();
+    void processMessages();
+    void abortAll();
+
+    CURLM* multiHandle_;
+    int nextHandle_;
+    bool failedSinceWaitAll_;
+    std::map<int, Request> requests_;
+    std::map<CURL*, int> running_;
+    std::deque<int> finished_; // not yet returned by waitAny()
+    DISALLOW_COPY_AND_ASSIGN(NetworkRequestGroup);
+};
+
+#endif
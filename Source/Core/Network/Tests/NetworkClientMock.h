@@ -12,6 +12,8 @@ class MockINetworkClient : public INetworkClient {
       void(const std::string& name, const std::string& fileName, const std::string& displayName, const std::string& contentType));
   MOCK_METHOD2(addQueryHeader,
       void(const std::string& name, const std::string& value));
+  MOCK_METHOD1(hasQueryHeader,
+      bool(const std::string& name));
   MOCK_METHOD1(setUrl,
       void(const std::string& url));
   MOCK_METHOD1(doPost,
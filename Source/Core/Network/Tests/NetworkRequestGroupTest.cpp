@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+#include "Core/Network/NetworkClient.h"
+#include "Core/Network/NetworkRequestGroup.h"
+
+namespace fs = boost::filesystem;
+
+class NetworkRequestGroupTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / fs::unique_path("iu_requestgroup_%%%%%%%%");
+        fs::create_directories(dir_);
+    }
+
+    void TearDown() override {
+        boost::system::error_code ec;
+        fs::remove_all(dir_, ec);
+    }
+
+    std::string createFile(const std::string& name, const std::string& contents) {
+        fs::path path = dir_ / name;
+        std::ofstream f(path.string(), std::ios::binary);
+        f << contents;
+        return "file://" + path.generic_string();
+    }
+
+    fs::path dir_;
+};
+
+TEST_F(NetworkRequestGroupTest, RunsRequestsSimultaneously) {
+    std::string url1 = createFile("a.txt", "first");
+    std::string url2 = createFile("b.txt", std::string(100000, 'b'));
+    NetworkClient client1, client2, client3;
+    client3.enableResponseCodeChecking(false);
+    NetworkRequestGroup group;
+
+    int h1 = group.startGet(&client1, url1);
+    int h2 = group.startGet(&client2, url2);
+    int h3 = group.startGet(&client3, "file://" + (dir_ / "missing.txt").generic_string());
+    EXPECT_GT(h1, 0);
+    EXPECT_NE(h1, h2);
+    EXPECT_EQ(0, group.startGet(&client1, url1)); // client is busy
+    EXPECT_EQ(3, group.runningCount());
+
+    std::vector<int> finished;
+    for (int h = group.waitAny(); h != 0; h = group.waitAny()) {
+        EXPECT_TRUE(group.isFinished(h));
+        finished.push_back(h);
+    }
+    EXPECT_EQ(3u, finished.size());
+    EXPECT_EQ(0, group.runningCount());
+
+    EXPECT_TRUE(group.isSucceeded(h1));
+    EXPECT_TRUE(group.isSucceeded(h2));
+    EXPECT_FALSE(group.isSucceeded(h3));
+    EXPECT_EQ("first", client1.responseBody());
+    EXPECT_EQ(100000u, client2.responseBody().size());
+    EXPECT_FALSE(group.waitAll());
+}
+
+TEST_F(NetworkRequestGroupTest, WaitAllAndReuseClient) {
+    std::string url = createFile("a.txt", "data");
+    NetworkClient client;
+    NetworkRequestGroup group;
+    int h1 = group.startGet(&client, url);
+    EXPECT_TRUE(group.waitAll());
+    EXPECT_TRUE(group.isFinished(h1));
+    EXPECT_EQ(0, group.waitAny());
+
+    // The client can be used for blocking requests again
+    EXPECT_TRUE(client.doGet(url));
+    EXPECT_EQ("data", client.responseBody());
+
+    int h2 = group.startGet(&client, url);
+    EXPECT_NE(h1, h2);
+    EXPECT_EQ(h2, group.waitAny());
+    EXPECT_EQ("data", client.responseBody());
+}
+
+TEST_F(NetworkRequestGroupTest, ReuseAfterFailure) {
+    std::string url = createFile("a.txt", "data");
+    NetworkClient client;
+    client.enableResponseCodeChecking(false);
+    NetworkRequestGroup group;
+    int h1 = group.startGet(&client, "file://" + (dir_ / "missing.txt").generic_string());
+    EXPECT_FALSE(group.waitAll());
+    EXPECT_FALSE(group.isSucceeded(h1));
+
+    // The failed request is not taken into account anymore and is forgotten
+    int h2 = group.startGet(&client, url);
+    EXPECT_TRUE(group.waitAll());
+    EXPECT_TRUE(group.isSucceeded(h2));
+    EXPECT_FALSE(group.isFinished(h1));
+    EXPECT_TRUE(group.waitAll());
+}
+
+TEST_F(NetworkRequestGroupTest, FailedPreparation) {
+    NetworkClient client;
+    NetworkRequestGroup group;
+    int h = group.startUpload(&client, (dir_ / "missing.bin").string(), "");
+    EXPECT_TRUE(group.isFinished(h));
+    EXPECT_FALSE(group.isSucceeded(h));
+    EXPECT_EQ(h, group.waitAny());
+}
+
+TEST_F(NetworkRequestGroupTest, FailedMultipartPreparation) {
+    std::string url = createFile("a.txt", "data");
+    NetworkClient client;
+    NetworkRequestGroup group;
+    client.setUrl("http://127.0.0.1:1/upload");
+    client.addQueryParam("name", "value");
+    client.addQueryParamFile("file1", (dir_ / "a.txt").string(), "a.txt", "");
+    client.addQueryParamFile("file2", (dir_ / "missing.bin").string(), "missing.bin", "");
+    int h = group.startUploadMultipartData(&client);
+    EXPECT_TRUE(group.isFinished(h));
+    EXPECT_FALSE(group.isSucceeded(h));
+
+    // Opened files and form parts have been released, the client can be used again
+    EXPECT_TRUE(client.doGet(url));
+    EXPECT_EQ("data", client.responseBody());
+}
@@ -26,6 +26,9 @@
 #include "Core/Logging.h"
 #include <json/json.h>
 #include "Core/Network/NetworkClient.h"
+#include "Core/Utils/JsonWriter.h"
+#include "JsonSerializer.h"
+#include "Core/Scripting/ScriptProfiler.h"
 #ifdef _WIN32
     #include <windows.h>
     #ifndef IU_CLI
@@ -221,10 +224,24 @@ void WriteLog(const std::string& type, const std::string& message) {
 
 const std::string md5(const std::string& data)
 {
+    ScriptProfiler::NativeCallScope profilerScope("md5");
     return IuCoreUtils::CryptoUtils::CalcMD5HashFromString(data);
 }
 
+const std::string md5_file(const std::string& fileName)
+{
+    ScriptProfiler::NativeCallScope profilerScope("md5_file");
+    return IuCoreUtils::CryptoUtils::CalcMD5HashFromFile(fileName);
+}
+
+const std::string sha1_file(const std::string& fileName)
+{
+    ScriptProfiler::NativeCallScope profilerScope("sha1_file");
+    return IuCoreUtils::CryptoUtils::CalcSHA1HashFromFile(fileName);
+}
+
 void sleep(int msec) {
+    ScriptProfiler::NativeCallScope profilerScope("sleep");
 #ifdef _WIN32
     ::Sleep(msec);
 #else
@@ -233,7 +250,10 @@ void sleep(int msec) {
 }
 
 const std::string JsonEscapeString( const std::string& src) {
-    return Json::valueToQuotedString(src.data());
+    std::string result;
+    result.reserve(src.size() + 2);
+    JsonWriter::appendQuoted(result, src.data(), src.size());
+    return result;
 }
 
 const std::string GetTempDirectory() {
@@ -435,6 +455,7 @@ Sqrat::Object parseJSONObj(const Json::Value& root) {
 }
 
 Sqrat::Object ParseJSON(const std::string& json) {
+    ScriptProfiler::NativeCallScope profilerScope("ParseJSON");
     Json::Value root;
     Json::Reader reader;
     Sqrat::Object sq;
@@ -444,59 +465,10 @@ Sqrat::Object ParseJSON(const std::string& json) {
     return sq;
 }
 
-Json::Value sqValueToJson(const Sqrat::Object& obj ) {
-    switch ( obj.GetType() ) {
-        case OT_NULL:
-            return Json::Value(Json::nullValue);
-
-        case OT_INTEGER:
-            return SQINT_TO_JSON_VALUE(obj.Cast<int>());
-
-        case OT_FLOAT:
-            return obj.Cast<float>();
-
-        case OT_BOOL:
-            return obj.Cast<bool>();
-
-        case OT_STRING:
-            return obj.Cast<std::string>();
-    }
-    return Json::Value(Json::nullValue);
-}
-Json::Value sqObjToJson(const Sqrat::Object& obj ) {
-    HSQUIRRELVM vm = GetCurrentThreadVM();
-    Json::Value res;
-    Sqrat::Object::iterator it;
-
-    switch ( obj.GetType() ) {
-            case OT_NULL:
-            case OT_INTEGER:
-            case OT_FLOAT:
-            case OT_BOOL:
-            case OT_STRING:
-                return sqValueToJson(obj);
-            case OT_TABLE:
-                res = Json::Value(Json::objectValue);
-                while(obj.Next(it) ) {
-                    res[it.getName()] = sqObjToJson(Sqrat::Object(it.getValue(), vm));
-                }
-                return res;
-            case OT_ARRAY:
-                res = Json::Value(Json::arrayValue);
-                while(obj.Next(it) ) {
-                    res[Sqrat::Object(it.getKey(), vm).Cast<int>()] = sqObjToJson(Sqrat::Object(it.getValue(), vm));
-                }
-                return res;            
-    }
-    return Json::Value(Json::nullValue);
-}
-
 const std::string ToJSON(const Sqrat::Object&  obj) {
-    Json::Value root = sqObjToJson(obj);
-    Json::StreamWriterBuilder builder;
-    builder["commentStyle"] = "None";
-    builder["indentation"] = "   ";  
-    return Json::writeString(builder, root);
+    ScriptProfiler::NativeCallScope profilerScope("ToJSON");
+    JsonSerializer serializer(GetCurrentThreadVM(), obj, "   ");
+    return std::move(serializer.writeAll());
 }
 
 int64_t ScriptGetFileSize(const std::string& filename) {
@@ -649,9 +621,9 @@ void RegisterFunctions(Sqrat::SqratVM& vm)
 
     using namespace IuCoreUtils;
     root
-        .Func("md5_file", &CryptoUtils::CalcMD5HashFromFile)
+        .Func("md5_file", md5_file)
         .Func("sha1", &CryptoUtils::CalcSHA1HashFromString)
-        .Func("sha1_file", &CryptoUtils::CalcSHA1HashFromFile)
+        .Func("sha1_file", sha1_file)
         .Func("sha1_file_prefix", &CryptoUtils::CalcSHA1HashFromFileWithPrefix)
         .Func("hmac_sha1", &CryptoUtils::CalcHMACSHA1HashFromString)
         .Func("Base64Decode", &CryptoUtils::Base64Decode)
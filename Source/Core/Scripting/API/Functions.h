@@ -218,7 +218,6 @@ namespace ScriptAPI {
      */
     const std::string md5(const std::string& data);
 
-    // fake functions, just for docs (not implemented)
     /**
      * @brief Calculates the md5 hash of a given file
      * @since 1.2.7.4176
@@ -226,16 +225,17 @@ namespace ScriptAPI {
     const std::string md5_file(const std::string& filename);
 
     /**
-     *  Calculates the sha1-hash of a given string
+     *  Calculates the sha1-hash of a given file
      *  @since 1.2.7.4176
      */
-    const std::string sha1(const std::string& data);
+    const std::string sha1_file(const std::string& filename);
 
+    // fake functions, just for docs (not implemented)
     /**
-     *  Calculates the sha1-hash of a given file
+     *  Calculates the sha1-hash of a given string
      *  @since 1.2.7.4176
      */
-    const std::string sha1_file(const std::string& filename);
+    const std::string sha1(const std::string& data);
 
     /**
      *  Calculates the sha1-hash of a given file, 
@@ -0,0 +1,227 @@
+#include "JsonSerializer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace ScriptAPI {
+
+namespace {
+
+// The string data stays valid while the object is referenced by the serialized value
+bool getString(HSQUIRRELVM vm, const HSQOBJECT& obj, const SQChar*& str, SQInteger& length) {
+    sq_pushobject(vm, obj);
+    bool res = SQ_SUCCEEDED(sq_getstring(vm, -1, &str));
+    length = sq_getsize(vm, -1);
+    sq_pop(vm, 1);
+    return res;
+}
+
+SQInteger getSize(HSQUIRRELVM vm, const HSQOBJECT& obj) {
+    sq_pushobject(vm, obj);
+    SQInteger size = sq_getsize(vm, -1);
+    sq_pop(vm, 1);
+    return size;
+}
+
+}
+
+JsonSerializer::JsonSerializer(HSQUIRRELVM vm, const Sqrat::Object& obj, const std::string& indentation) :
+    vm_(vm), root_(obj), indentation_(indentation), writer_(indentation), started_(false), readOffset_(0) {
+}
+
+std::string& JsonSerializer::writeAll() {
+    fill(SIZE_MAX);
+    return writer_.buffer();
+}
+
+bool JsonSerializer::fill(size_t minSize) {
+    if (!started_) {
+        started_ = true;
+        writeValue(root_.GetObject());
+    }
+
+    std::string& buffer = writer_.buffer();
+    while (!stack_.empty() && buffer.size() < minSize) {
+        Frame& frame = stack_.back();
+        if (frame.isArray) {
+            if (frame.index < frame.size) {
+                writeValue(arrayItem(frame.container, frame.index++));
+                continue;
+            }
+            writer_.endArray();
+        } else {
+            if (frame.index < static_cast<SQInteger>(frame.members.size())) {
+                auto& member = frame.members[frame.index++];
+                writer_.key(member.first);
+                HSQOBJECT value = member.second; // writeValue() may reallocate the stack
+                writeValue(value);
+                continue;
+            }
+            writer_.endObject();
+        }
+        stack_.pop_back();
+    }
+    return !stack_.empty();
+}
+
+size_t JsonSerializer::read(char* buffer, size_t size) {
+    std::string& text = writer_.buffer();
+    if (text.size() - readOffset_ < size) {
+        // Reuse the space of already sent data
+        text.erase(0, readOffset_);
+        readOffset_ = 0;
+        fill(size);
+    }
+    size_t count = std::min(size, text.size() - readOffset_);
+    memcpy(buffer, text.data() + readOffset_, count);
+    readOffset_ += count;
+    return count;
+}
+
+bool JsonSerializer::rewind() {
+    stack_.clear();
+    writer_ = JsonWriter(indentation_);
+    started_ = false;
+    readOffset_ = 0;
+    return true;
+}
+
+void JsonSerializer::writeValue(const HSQOBJECT& obj) {
+    if (writeScalar(writer_, obj)) {
+        return;
+    }
+    if (isOnStack(obj)) {
+        writer_.nullValue();
+        return;
+    }
+    Frame frame;
+    frame.container = obj;
+    frame.isArray = obj._type == OT_ARRAY;
+    frame.size = getSize(vm_, obj);
+    frame.index = 0;
+    if (frame.isArray) {
+        writer_.beginArray(canWriteOnSingleLine(obj, frame.size));
+    } else {
+        collectMembers(frame);
+        if (frame.members.empty()) {
+            writer_.emptyObject();
+            return;
+        }
+        writer_.beginObject();
+    }
+    stack_.push_back(std::move(frame));
+}
+
+bool JsonSerializer::writeScalar(JsonWriter& writer, const HSQOBJECT& obj) {
+    switch (obj._type) {
+        case OT_NULL:
+            writer.nullValue();
+            break;
+        case OT_INTEGER:
+            writer.intValue(sq_objtointeger(&obj));
+            break;
+        case OT_FLOAT:
+            writer.doubleValue(static_cast<double>(sq_objtofloat(&obj)));
+            break;
+        case OT_BOOL:
+            writer.boolValue(sq_objtobool(&obj) != 0);
+            break;
+        case OT_STRING: {
+            const SQChar* str = nullptr;
+            SQInteger length = 0;
+            if (getString(vm_, obj, str, length)) {
+                writer.stringValue(str, static_cast<size_t>(length));
+            } else {
+                writer.nullValue();
+            }
+            break;
+        }
+        case OT_TABLE:
+            if (getSize(vm_, obj)) {
+                return false;
+            }
+            writer.emptyObject();
+            break;
+        case OT_ARRAY:
+            if (getSize(vm_, obj)) {
+                return false;
+            }
+            writer.emptyArray();
+            break;
+        default:
+            writer.nullValue();
+    }
+    return true;
+}
+
+bool JsonSerializer::isNonEmptyContainer(const HSQOBJECT& obj) {
+    return (obj._type == OT_TABLE || obj._type == OT_ARRAY) && getSize(vm_, obj) != 0;
+}
+
+bool JsonSerializer::isOnStack(const HSQOBJECT& obj) const {
+    for (const auto& frame : stack_) {
+        if (frame.container._unVal.pRefCounted == obj._unVal.pRefCounted) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JsonSerializer::canWriteOnSingleLine(const HSQOBJECT& arr, SQInteger size) {
+    if (!writer_.canWriteArrayOnSingleLine(static_cast<size_t>(size))) {
+        return false;
+    }
+    itemLengths_.clear();
+    for (SQInteger i = 0; i < size; i++) {
+        HSQOBJECT item = arrayItem(arr, i);
+        if (isNonEmptyContainer(item)) {
+            return false;
+        }
+        scratch_.clear();
+        writeScalar(scratch_, item);
+        itemLengths_.push_back(scratch_.buffer().size());
+    }
+    return writer_.canWriteArrayOnSingleLine(itemLengths_);
+}
+
+HSQOBJECT JsonSerializer::arrayItem(const HSQOBJECT& arr, SQInteger index) {
+    HSQOBJECT item;
+    sq_resetobject(&item);
+    sq_pushobject(vm_, arr);
+    sq_pushinteger(vm_, index);
+    if (SQ_SUCCEEDED(sq_rawget(vm_, -2))) {
+        sq_getstackobj(vm_, -1, &item);
+    }
+    sq_pop(vm_, 2);
+    return item;
+}
+
+void JsonSerializer::collectMembers(Frame& frame) {
+    frame.members.reserve(static_cast<size_t>(frame.size));
+    sq_pushobject(vm_, frame.container);
+    sq_pushnull(vm_);
+    while (SQ_SUCCEEDED(sq_next(vm_, -2))) {
+        HSQOBJECT key, value;
+        sq_getstackobj(vm_, -2, &key);
+        sq_getstackobj(vm_, -1, &value);
+        if (key._type == OT_STRING) {
+            const SQChar* str = nullptr;
+            SQInteger length = 0;
+            if (getString(vm_, key, str, length)) {
+                frame.members.emplace_back(std::string(str, static_cast<size_t>(length)), value);
+            }
+        } else if (key._type == OT_INTEGER) {
+            std::string name;
+            JsonWriter::appendInt(name, sq_objtointeger(&key));
+            frame.members.emplace_back(std::move(name), value);
+        }
+        sq_pop(vm_, 2);
+    }
+    sq_pop(vm_, 2);
+    std::sort(frame.members.begin(), frame.members.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+}
+
+}
@@ -0,0 +1,81 @@
+#ifndef IU_CORE_SCRIPTAPI_JSONSERIALIZER_H
+#define IU_CORE_SCRIPTAPI_JSONSERIALIZER_H
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Core/Scripting/Squirrelnc.h"
+#include "Core/Network/INetworkClient.h"
+#include "Core/Utils/JsonWriter.h"
+
+namespace ScriptAPI {
+
+/* @cond PRIVATE */
+
+/**
+@brief Writes a squirrel value (tables, arrays, strings, numbers, booleans, null) as JSON text.
+
+Values are written directly into the output buffer, without building an intermediate tree.
+Table members are written in sorted order, values of other types are written as null,
+as well as tables and arrays which contain themselves.
+
+The text can be produced in portions (see fill() and read()), so a large document can be
+sent to the network without keeping the whole text in memory. The value should not be modified
+until the serialization is finished.
+*/
+class JsonSerializer : public INetworkClient::UploadStream {
+public:
+    /**
+     * @param indentation - empty string produces compact output
+     */
+    JsonSerializer(HSQUIRRELVM vm, const Sqrat::Object& obj, const std::string& indentation = std::string());
+
+    /**
+     * Serializes the whole value and returns the text.
+     */
+    std::string& writeAll();
+
+    /**
+     * Serializes the value until the buffer contains at least minSize bytes.
+     * Returns false if the value has been written completely.
+     */
+    bool fill(size_t minSize);
+
+    size_t read(char* buffer, size_t size) override;
+    bool rewind() override;
+private:
+    struct Frame {
+        HSQOBJECT container;
+        bool isArray;
+        SQInteger size;
+        SQInteger index;
+        std::vector<std::pair<std::string, HSQOBJECT>> members;
+    };
+
+    void writeValue(const HSQOBJECT& obj);
+    bool writeScalar(JsonWriter& writer, const HSQOBJECT& obj);
+    bool isNonEmptyContainer(const HSQOBJECT& obj);
+    bool isOnStack(const HSQOBJECT& obj) const;
+    bool canWriteOnSingleLine(const HSQOBJECT& arr, SQInteger size);
+    HSQOBJECT arrayItem(const HSQOBJECT& arr, SQInteger index);
+    void collectMembers(Frame& frame);
+
+    HSQUIRRELVM vm_;
+    Sqrat::Object root_;
+    std::string indentation_;
+    JsonWriter writer_;
+    JsonWriter scratch_;
+    std::vector<Frame> stack_;
+    std::vector<size_t> itemLengths_;
+    bool started_;
+    size_t readOffset_;
+};
+
+/* @endcond */
+
+}
+
+#endif
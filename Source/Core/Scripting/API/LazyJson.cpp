@@ -0,0 +1,128 @@
+#include "LazyJson.h"
+
+#include "ScriptAPI.h"
+#include "Core/Scripting/ScriptProfiler.h"
+
+namespace ScriptAPI {
+
+namespace {
+
+template<class T> Sqrat::Object makeObject(HSQUIRRELVM vm, const T& value) {
+    Sqrat::PushVar(vm, value);
+    HSQOBJECT obj;
+    sq_getstackobj(vm, -1, &obj);
+    Sqrat::Object result(obj, vm);
+    sq_pop(vm, 1);
+    return result;
+}
+
+Sqrat::Object toSquirrelObject(HSQUIRRELVM vm, const LazyJsonValue& value, bool materialize) {
+    switch (value.type()) {
+        case LazyJsonValue::Type::Bool:
+            return makeObject(vm, value.asBool());
+        case LazyJsonValue::Type::Number:
+            if (value.isInteger()) {
+                return makeObject(vm, static_cast<SQInteger>(value.asInt64()));
+            }
+            return makeObject(vm, static_cast<SQFloat>(value.asDouble()));
+        case LazyJsonValue::Type::String:
+            return makeObject(vm, value.asString());
+        case LazyJsonValue::Type::Array:
+            if (materialize) {
+                Sqrat::Array arr(vm, static_cast<SQInteger>(value.size()));
+                int index = 0;
+                value.forEach([&](const std::string&, const LazyJsonValue& element) {
+                    arr.SetValue(index++, toSquirrelObject(vm, element, true));
+                });
+                return Sqrat::Object(arr);
+            }
+            return makeObject(vm, LazyJson(value));
+        case LazyJsonValue::Type::Object:
+            if (materialize) {
+                Sqrat::Table table(vm);
+                value.forEach([&](const std::string& name, const LazyJsonValue& member) {
+                    table.SetValue(name.c_str(), toSquirrelObject(vm, member, true));
+                });
+                return Sqrat::Object(table);
+            }
+            return makeObject(vm, LazyJson(value));
+        default:
+            return Sqrat::Object();
+    }
+}
+
+}
+
+LazyJson::LazyJson() {
+}
+
+LazyJson::LazyJson(LazyJsonValue value) : value_(std::move(value)) {
+}
+
+Sqrat::Object LazyJson::get(const std::string& path) {
+    return toSquirrelObject(GetCurrentThreadVM(), value_.get(path), false);
+}
+
+bool LazyJson::has(const std::string& path) {
+    return value_.get(path).isValid();
+}
+
+std::string LazyJson::type() {
+    switch (value_.type()) {
+        case LazyJsonValue::Type::Object:
+            return "object";
+        case LazyJsonValue::Type::Array:
+            return "array";
+        case LazyJsonValue::Type::String:
+            return "string";
+        case LazyJsonValue::Type::Number:
+            return "number";
+        case LazyJsonValue::Type::Bool:
+            return "bool";
+        default:
+            return "null";
+    }
+}
+
+int LazyJson::size() {
+    return static_cast<int>(value_.size());
+}
+
+Sqrat::Array LazyJson::keys() {
+    std::vector<std::string> names = value_.keys();
+    Sqrat::Array result(GetCurrentThreadVM(), static_cast<SQInteger>(names.size()));
+    for (size_t i = 0; i < names.size(); i++) {
+        result.SetValue(static_cast<int>(i), names[i]);
+    }
+    return result;
+}
+
+Sqrat::Object LazyJson::materialize() {
+    return toSquirrelObject(GetCurrentThreadVM(), value_, true);
+}
+
+std::string LazyJson::rawText() {
+    return value_.rawText();
+}
+
+Sqrat::Object ParseJSONLazy(const std::string& json) {
+    ScriptProfiler::NativeCallScope profilerScope("ParseJSONLazy");
+    return toSquirrelObject(GetCurrentThreadVM(), LazyJsonValue::parse(json), false);
+}
+
+void RegisterLazyJsonClass(Sqrat::SqratVM& vm) {
+    using namespace Sqrat;
+    RootTable& root = vm.GetRootTable();
+    root.Bind("LazyJson", Class<LazyJson>(vm.GetVM(), "LazyJson")
+        .Func("get", &LazyJson::get)
+        .Func("has", &LazyJson::has)
+        .Func("type", &LazyJson::type)
+        .Func("size", &LazyJson::size)
+        .Func("keys", &LazyJson::keys)
+        .Func("materialize", &LazyJson::materialize)
+        .Func("rawText", &LazyJson::rawText)
+    );
+    root.Func("ParseJSONLazy", ParseJSONLazy);
+}
+
+}
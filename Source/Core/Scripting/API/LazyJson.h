@@ -0,0 +1,88 @@
+#ifndef IU_CORE_SCRIPTAPI_LAZYJSON_H
+#define IU_CORE_SCRIPTAPI_LAZYJSON_H
+
+#pragma once
+
+#include <string>
+
+#include "Core/Scripting/Squirrelnc.h"
+#include "Core/Utils/LazyJson.h"
+
+namespace ScriptAPI {
+
+/*!
+@brief Handle to a value of a JSON document returned by ParseJSONLazy().
+
+Unlike ParseJSON(), the document is not converted into tables and arrays, values are decoded
+only when they are accessed. Use it for large responses when only a few fields are needed.
+Example:
+@code
+local json = ParseJSONLazy(nm.responseBody());
+if (json != null) {
+    print(json.get("result.links[1].href"));
+    local items = json.get("items");
+    for (local i = 0; i < items.size(); i++) {
+        print(items.get("[" + i + "].id"));
+    }
+}
+@endcode
+@since 1.3.3
+*/
+class LazyJson {
+public:
+    /*! @cond PRIVATE */
+    LazyJson();
+    explicit LazyJson(LazyJsonValue value);
+    /*! @endcond */
+
+    /**
+     * Returns a value by path like "result.links[1].href". Strings, numbers and booleans are
+     * returned as is, objects and arrays are returned as LazyJson. Returns null if there is no such value.
+     */
+    Sqrat::Object get(const std::string& path);
+
+    /**
+     * Returns true if there is a value with this path
+     */
+    bool has(const std::string& path);
+
+    /**
+     * Returns one of "object", "array", "string", "number", "bool", "null"
+     */
+    std::string type();
+
+    /**
+     * Returns number of members of an object or elements of an array
+     */
+    int size();
+
+    /**
+     * Returns array of member names of an object
+     */
+    Sqrat::Array keys();
+
+    /**
+     * Converts the value into a table or an array, the same way as ParseJSON() does.
+     */
+    Sqrat::Object materialize();
+
+    /**
+     * Returns JSON text of the value
+     */
+    std::string rawText();
+private:
+    LazyJsonValue value_;
+};
+
+/**
+ * Parses the JSON document on demand. Returns LazyJson (for objects and arrays) or null if the document is malformed.
+ * @since 1.3.3
+ */
+Sqrat::Object ParseJSONLazy(const std::string& json);
+
+/* @cond PRIVATE */
+void RegisterLazyJsonClass(Sqrat::SqratVM& vm);
+/* @endcond */
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "NetworkClientPool.h"
+
+#include <algorithm>
+
+#include "Core/Scripting/ScriptProfiler.h"
+
+namespace ScriptAPI {
+
+NetworkClientPool::NetworkClientPool(std::shared_ptr<INetworkClientFactory> factory) : factory_(std::move(factory)) {
+}
+
+NetworkClientPool::~NetworkClientPool() {
+}
+
+void NetworkClientPool::setClientInitializer(ClientInitializer initializer) {
+    initializer_ = std::move(initializer);
+}
+
+INetworkClient* NetworkClientPool::createClient() {
+    if (!idleClients_.empty()) {
+        INetworkClient* client = idleClients_.back();
+        idleClients_.pop_back();
+        return client;
+    }
+    std::unique_ptr<INetworkClient> client = factory_->create();
+    if (initializer_) {
+        initializer_(client.get());
+    }
+    clients_.push_back(std::move(client));
+    return clients_.back().get();
+}
+
+void NetworkClientPool::releaseClient(INetworkClient* client) {
+    auto it = std::find_if(clients_.begin(), clients_.end(), [client](const std::unique_ptr<INetworkClient>& c) {
+        return c.get() == client;
+    });
+    if (it != clients_.end() && std::find(idleClients_.begin(), idleClients_.end(), client) == idleClients_.end()) {
+        idleClients_.push_back(client);
+    }
+}
+
+int NetworkClientPool::startGet(INetworkClient* client, const std::string& url) {
+    return group_.startGet(client, url);
+}
+
+int NetworkClientPool::startPost(INetworkClient* client, const std::string& data) {
+    return group_.startPost(client, data);
+}
+
+int NetworkClientPool::startUploadMultipartData(INetworkClient* client) {
+    return group_.startUploadMultipartData(client);
+}
+
+int NetworkClientPool::startUpload(INetworkClient* client, const std::string& fileName, const std::string& data) {
+    return group_.startUpload(client, fileName, data);
+}
+
+int NetworkClientPool::waitAny() {
+    ScriptProfiler::NativeCallScope profilerScope("nmPool.waitAny");
+    return group_.waitAny();
+}
+
+bool NetworkClientPool::waitAll() {
+    ScriptProfiler::NativeCallScope profilerScope("nmPool.waitAll");
+    return group_.waitAll();
+}
+
+bool NetworkClientPool::isFinished(int handle) const {
+    return group_.isFinished(handle);
+}
+
+bool NetworkClientPool::isSucceeded(int handle) const {
+    return group_.isSucceeded(handle);
+}
+
+void RegisterNetworkClientPoolClass(Sqrat::SqratVM& vm) {
+    using namespace Sqrat;
+    vm.GetRootTable().Bind("NetworkClientPool", Class<NetworkClientPool, NoConstructor<NetworkClientPool>>(vm.GetVM(), "NetworkClientPool")
+        .Func("createClient", &NetworkClientPool::createClient)
+        .Func("releaseClient", &NetworkClientPool::releaseClient)
+        .Func("startGet", &NetworkClientPool::startGet)
+        .Func("startPost", &NetworkClientPool::startPost)
+        .Func("startUploadMultipartData", &NetworkClientPool::startUploadMultipartData)
+        .Func("startUpload", &NetworkClientPool::startUpload)
+        .Func("waitAny", &NetworkClientPool::waitAny)
+        .Func("waitAll", &NetworkClientPool::waitAll)
+        .Func("isFinished", &NetworkClientPool::isFinished)
+        .Func("isSucceeded", &NetworkClientPool::isSucceeded)
+    );
+}
+
+}
@@ -0,0 +1,99 @@
+#ifndef IU_CORE_SCRIPTAPI_NETWORKCLIENTPOOL_H
+#define IU_CORE_SCRIPTAPI_NETWORKCLIENTPOOL_H
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Core/Scripting/Squirrelnc.h"
+#include "Core/Network/INetworkClient.h"
+#include "Core/Network/NetworkRequestGroup.h"
+
+namespace ScriptAPI {
+
+/*!
+@brief Allows a script to perform several HTTP requests simultaneously.
+
+The global instance is available in scripts as <b>nmPool</b>. It creates additional network clients
+and runs their requests in parallel on the current thread. Requests are started by start*() functions,
+which return the handle of the request. Then the script waits for any or all of them.
+Example:
+@code
+local c1 = nmPool.createClient();
+local c2 = nmPool.createClient();
+local h1 = nmPool.startGet(c1, "https://example.com/a");
+c2.setUrl("https://example.com/b");
+c2.addQueryParam("key", "value");
+local h2 = nmPool.startPost(c2, "");
+for (local h = nmPool.waitAny(); h != 0; h = nmPool.waitAny()) {
+    if (h == h1 && nmPool.isSucceeded(h1)) {
+        print(c1.responseBody());
+    }
+}
+nmPool.releaseClient(c1);
+nmPool.releaseClient(c2);
+@endcode
+@since 1.3.3
+*/
+class NetworkClientPool {
+public:
+    typedef std::function<void(INetworkClient*)> ClientInitializer;
+
+    /*! @cond PRIVATE */
+    explicit NetworkClientPool(std::shared_ptr<INetworkClientFactory> factory);
+    ~NetworkClientPool();
+
+    /**
+     * The initializer is called once for every created client (e.g. to set curl share, user agent, progress callback)
+     */
+    void setClientInitializer(ClientInitializer initializer);
+    /*! @endcond */
+
+    /**
+     * Returns an idle client from the pool or creates a new one. The client is owned by the pool.
+     */
+    INetworkClient* createClient();
+
+    /**
+     * Returns the client to the pool, so it can be reused by createClient().
+     */
+    void releaseClient(INetworkClient* client);
+
+    int startGet(INetworkClient* client, const std::string& url);
+    int startPost(INetworkClient* client, const std::string& data);
+    int startUploadMultipartData(INetworkClient* client);
+    int startUpload(INetworkClient* client, const std::string& fileName, const std::string& data);
+
+    /**
+     * Waits until any of the started requests is finished and returns its handle.
+     * Each finished request is returned only once. Returns 0 if there are no more requests.
+     */
+    int waitAny();
+
+    /**
+     * Waits until all started requests are finished.
+     * Returns true if all requests started since the previous waitAll() succeeded.
+     */
+    bool waitAll();
+
+    bool isFinished(int handle) const;
+    bool isSucceeded(int handle) const;
+private:
+    std::shared_ptr<INetworkClientFactory> factory_;
+    ClientInitializer initializer_;
+    std::vector<std::unique_ptr<INetworkClient>> clients_;
+    std::vector<INetworkClient*> idleClients_;
+    // Declared after clients_, so running requests are aborted before their clients are destroyed
+    NetworkRequestGroup group_;
+    DISALLOW_COPY_AND_ASSIGN(NetworkClientPool);
+};
+
+/* @cond PRIVATE */
+void RegisterNetworkClientPoolClass(Sqrat::SqratVM& vm);
+/* @endcond */
+}
+
+#endif
@@ -23,6 +23,7 @@
 #include "Core/Logging.h"
 #include "../Squirrelnc.h"
 #include "ScriptAPI.h"
+#include "Core/Scripting/ScriptProfiler.h"
 
 using namespace pcrepp;
 
@@ -45,6 +46,7 @@ RegularExpression::RegularExpression(const RegularExpression& r)
 */
 Sqrat::Array RegularExpression::split(const std::string& piece)
 {
+    ScriptProfiler::NativeCallScope profilerScope("CRegExp.split");
     try {
         std::vector<std::string> res = pcre_->split(piece);
         Sqrat::Array obj(GetCurrentThreadVM(), res.size());
@@ -118,6 +120,7 @@ std::string RegularExpression::getMatch(int pos) const
 
 bool RegularExpression::search(const std::string& stuff)
 {
+    ScriptProfiler::NativeCallScope profilerScope("CRegExp.search");
     try {
         return pcre_->search(stuff);
     } catch( Pcre::exception& ex ) {
@@ -138,6 +141,7 @@ bool RegularExpression::searchWithOffset(const std::string& stuff, int OffSet)
 
 std::string RegularExpression::replace(const std::string& piece, const std::string& with)
 {
+    ScriptProfiler::NativeCallScope profilerScope("CRegExp.replace");
     try {
         return pcre_->replace(piece, with);
     } catch( Pcre::exception& ex ) {
@@ -211,6 +215,7 @@ bool RegularExpression::match(const std::string& stuff)
 
 Sqrat::Array RegularExpression::findAll(const std::string& str)
 {
+    ScriptProfiler::NativeCallScope profilerScope("CRegExp.findAll");
     try {
         size_t pos = 0;
         Sqrat::Array res(GetCurrentThreadVM(), 0);
@@ -22,6 +22,10 @@
 
 #include "RegularExpression.h"
 #include "Process.h"
+#include "NetworkClientPool.h"
+#include "LazyJson.h"
+#include "JsonSerializer.h"
+#include "Core/Scripting/ScriptProfiler.h"
 #include "GumboBingings/GumboDocument.h"
 #ifdef _WIN32
 //#if defined(IU_WTL) && !defined(IU_NOWEBBROWSER)
@@ -81,14 +85,50 @@ static void printFunc(HSQUIRRELVM v, const SQChar* s, ...)
     delete[] buffer;
 }
 
+namespace NetworkClientExtend
+{
+// Request functions are wrapped to show network time separately in script profiles
+bool DoGet(INetworkClient* pthis, const std::string& url) {
+    ScriptProfiler::NativeCallScope profilerScope("nm.doGet");
+    return pthis->doGet(url);
+}
+
+bool DoPost(INetworkClient* pthis, const std::string& data) {
+    ScriptProfiler::NativeCallScope profilerScope("nm.doPost");
+    return pthis->doPost(data);
+}
+
+bool DoUpload(INetworkClient* pthis, const std::string& fileName, const std::string& data) {
+    ScriptProfiler::NativeCallScope profilerScope("nm.doUpload");
+    return pthis->doUpload(fileName, data);
+}
+
+bool DoUploadMultipartData(INetworkClient* pthis) {
+    ScriptProfiler::NativeCallScope profilerScope("nm.doUploadMultipartData");
+    return pthis->doUploadMultipartData();
+}
+
+// Sends the value as JSON in the body of a POST request, the text is produced while it is being sent.
+// Content-Type is set to application/json unless the script has set its own one.
+bool DoPostJSON(INetworkClient* pthis, const Sqrat::Object& obj) {
+    ScriptProfiler::NativeCallScope profilerScope("nm.doPostJSON");
+    if (!pthis->hasQueryHeader("Content-Type")) {
+        pthis->addQueryHeader("Content-Type", "application/json");
+    }
+    JsonSerializer serializer(GetCurrentThreadVM(), obj);
+    return pthis->doUploadStream(&serializer, -1);
+}
+}
+
 void RegisterNetworkClientClass(Sqrat::SqratVM& vm) {
     using namespace Sqrat;
     vm.GetRootTable().Bind("NetworkClient", Class<INetworkClient>(vm.GetVM(), "NetworkClient").
-        Func("doGet", &INetworkClient::doGet).
+        GlobalFunc("doGet", NetworkClientExtend::DoGet).
         Func("responseBody", &INetworkClient::responseBody).
         Func("responseCode", &INetworkClient::responseCode).
         Func("setUrl", &INetworkClient::setUrl).
-        Func("doPost", &INetworkClient::doPost).
+        GlobalFunc("doPost", NetworkClientExtend::DoPost).
+        GlobalFunc("doPostJSON", NetworkClientExtend::DoPostJSON).
         Func("addQueryHeader", &INetworkClient::addQueryHeader).
         Func("addQueryParam", &INetworkClient::addQueryParam).
         Func("addQueryParamFile", &INetworkClient::addQueryParamFile).
@@ -96,11 +136,11 @@ void RegisterNetworkClientClass(Sqrat::SqratVM& vm) {
         Func("urlEncode", &INetworkClient::urlEncode).
         Func("urlDecode", &INetworkClient::urlDecode).
         Func("errorString", &INetworkClient::errorString).
-        Func("doUpload", &INetworkClient::doUpload).
+        GlobalFunc("doUpload", NetworkClientExtend::DoUpload).
         Func("setMethod", &INetworkClient::setMethod).
         Func("setCurlOption", &INetworkClient::setCurlOption).
         Func("setCurlOptionInt", &INetworkClient::setCurlOptionInt).
-        Func("doUploadMultipartData", &INetworkClient::doUploadMultipartData).
+        GlobalFunc("doUploadMultipartData", NetworkClientExtend::DoUploadMultipartData).
         Func("enableResponseCodeChecking", &INetworkClient::enableResponseCodeChecking).
         Func("setChunkSize", &INetworkClient::setChunkSize).
         Func("setChunkOffset", &INetworkClient::setChunkOffset).
@@ -253,6 +293,8 @@ std::mutex vmServicesMutex;
 void RegisterClasses(Sqrat::SqratVM& vm) {
    // Sqrat::DefaultVM::Set(vm.GetVM());
     RegisterNetworkClientClass(vm);
+    RegisterNetworkClientPoolClass(vm);
+    RegisterLazyJsonClass(vm);
     RegisterRegularExpressionClass(vm);
     RegisterUploadClasses(vm);
     RegisterUploadTaskWrappers(vm);
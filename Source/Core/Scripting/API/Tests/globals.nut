@@ -25,3 +25,12 @@ local expected = "{\n   \"a\" : \n   {\n      \"aa\" : \"test\"\n   },\n   \"b\"
 local actual = ToJSON(t2);
 //expect_eq(expected.len(), actual.len());
 expect_streq(expected, actual);
+
+local t3 = {
+    z = [],
+    y = {},
+    x = [{ id = 1 }, "\"quoted\"\n"],
+    w = 4294967296
+};
+expect_streq("{\n   \"w\" : 4294967296,\n   \"x\" : \n   [\n      {\n         \"id\" : 1\n      },\n      \"\\\"quoted\\\"\\n\"\n   ],\n   \"y\" : {},\n   \"z\" : []\n}", ToJSON(t3));
+expect_streq("\"a\\\\b\\u00e9\"", JsonEscapeString("a\\b\xc3\xa9"));
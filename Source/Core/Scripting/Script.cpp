@@ -21,12 +21,19 @@ limitations under the License.
 #include "Script.h"
 
 #include "API/ScriptAPI.h"
+#include "API/NetworkClientPool.h"
 #include "Core/Upload/ScriptUploadEngine.h"
 #include "Core/Logging.h"
 #include "Core/ThreadSync.h"
+#include "Core/Metrics/MetricsRegistry.h"
+#include "Core/ServiceLocator.h"
+#include "Core/Settings/BasicSettings.h"
+#include "ScriptProfiler.h"
 
 Script::Script(const std::string& fileName, ThreadSync* serverSync, std::shared_ptr<INetworkClientFactory> networkClientFactory, bool doLoad)
 {
+    static MetricCounter* vmCounter = MetricsRegistry::instance()->counter("iu_script_vm_created_total", "Number of created Squirrel VMs");
+    vmCounter->inc();
     m_CreationTime = time(nullptr);
     m_bIsPluginLoaded = false;
     sync_ = serverSync;
@@ -40,6 +47,8 @@ Script::Script(const std::string& fileName, ThreadSync* serverSync, std::shared_
 
 Script::~Script()
 {
+    flushProfile();
+    profiler_.reset();
     ScriptAPI::ClearVmData(vm_);
 }
 
@@ -73,9 +82,38 @@ bool Script::preLoad()
     Sqrat::RootTable& rootTable = vm_.GetRootTable();
     rootTable.SetInstance("Sync", sync_);
     rootTable.SetInstance("nm", networkClient_.get());
+    initNetworkClientPool();
     return true;
 }
 
+void Script::initNetworkClientPool()
+{
+    networkClientPool_ = std::make_unique<ScriptAPI::NetworkClientPool>(networkClientFactory_);
+    networkClientPool_->setClientInitializer(std::bind(&Script::configureNetworkClient, this, std::placeholders::_1));
+    vm_.GetRootTable().SetInstance("nmPool", networkClientPool_.get());
+}
+
+void Script::configureNetworkClient(INetworkClient* client)
+{
+    client->setCurlShare(sync_->getCurlShare());
+}
+
+void Script::initProfiler()
+{
+    BasicSettings* settings = ServiceLocator::instance()->basicSettings();
+    if (settings && !settings->ScriptProfilingFolder.empty()) {
+        profilingFolder_ = settings->ScriptProfilingFolder;
+        profiler_ = std::make_unique<ScriptProfiler>(vm_.GetVM(), fileName_);
+    }
+}
+
+void Script::flushProfile()
+{
+    if (profiler_) {
+        profiler_->flush(profilingFolder_);
+    }
+}
+
 bool Script::postLoad()
 {
     return true;
@@ -94,6 +132,9 @@ time_t Script::getCreationTime() const
 void Script::switchToThisVM()
 {
     ScriptAPI::SetCurrentThreadVM(vm_.GetVM());
+    if (profiler_) {
+        profiler_->activate();
+    }
 }
 
 Sqrat::SqratVM& Script::getVM()
@@ -123,6 +164,7 @@ bool Script::load(const std::string& fileName)
         }
 
         preLoad();
+        initProfiler();
  
         switchToThisVM();
         m_SquirrelScript = std::make_unique<Sqrat::Script>(vm_.GetVM());
@@ -13,6 +13,10 @@
 
 class ServerSync;
 class NetworkClient;
+class ScriptProfiler;
+namespace ScriptAPI {
+    class NetworkClientPool;
+}
 class Script {
     public:
         Script(const std::string& fileName, ThreadSync* serverSync, std::shared_ptr<INetworkClientFactory> networkClientFactory, bool load = true);
@@ -40,6 +44,27 @@ class Script {
         void FlushSquirrelOutput();
         virtual bool preLoad();
         virtual bool postLoad();
+
+        /**
+         * Creates the pool of additional network clients and binds it to the 'nmPool' variable
+         */
+        void initNetworkClientPool();
+
+        /**
+         * Called for each network client created by the pool
+         */
+        virtual void configureNetworkClient(INetworkClient* client);
+
+        /**
+         * Attaches the profiler to the VM if profiling of scripts is enabled in settings
+         */
+        void initProfiler();
+
+        /**
+         * Appends the profile collected since the previous call to the profiling folder.
+         * Called after each processed task, so the profile is not lost if the program is terminated.
+         */
+        void flushProfile();
         std::string fileName_;
         Sqrat::SqratVM vm_;
         std::unique_ptr<Sqrat::Script> m_SquirrelScript;
@@ -49,7 +74,10 @@ class Script {
         ThreadSync* sync_;
         std::string topLevelFileName_;
         std::unique_ptr<INetworkClient> networkClient_;
+        std::unique_ptr<ScriptAPI::NetworkClientPool> networkClientPool_;
         std::shared_ptr<INetworkClientFactory> networkClientFactory_;
+        std::string profilingFolder_;
+        std::unique_ptr<ScriptProfiler> profiler_;
         static void CompilerErrorHandler(HSQUIRRELVM vm, const SQChar * desc, const SQChar * source, SQInteger line, SQInteger column);
     private:
         DISALLOW_COPY_AND_ASSIGN(Script);
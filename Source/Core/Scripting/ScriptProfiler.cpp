@@ -0,0 +1,163 @@
+#include "ScriptProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+
+#include "Core/Logging.h"
+#include "Core/Logging/TraceRecorder.h"
+#include "Core/Utils/CoreUtils.h"
+
+thread_local ScriptProfiler* ScriptProfiler::current_ = nullptr;
+
+namespace {
+
+std::mutex outputMutex;
+
+// ';' separates frames and the last space separates the value in the collapsed format
+std::string sanitizeFrameName(std::string name) {
+    std::replace(name.begin(), name.end(), ';', ':');
+    std::replace(name.begin(), name.end(), '\n', ' ');
+    return name;
+}
+
+}
+
+size_t ScriptProfiler::FrameKeyHash::operator()(const FrameKey& key) const {
+    size_t hash = std::hash<const void*>()(key.name);
+    hash ^= std::hash<const void*>()(key.source) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<SQInteger>()(key.line) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+ScriptProfiler::ScriptProfiler(HSQUIRRELVM vm, std::string scriptName) : vm_(vm), scriptName_(std::move(scriptName)),
+    currentNode_(0), lastTime_(0) {
+    clear();
+    activate();
+    sq_setnativedebughook(vm_, debugHook);
+}
+
+ScriptProfiler::~ScriptProfiler() {
+    sq_setnativedebughook(vm_, nullptr);
+    if (current_ == this) {
+        current_ = nullptr;
+    }
+}
+
+void ScriptProfiler::activate() {
+    current_ = this;
+}
+
+void ScriptProfiler::clear() {
+    // Stacks which are being executed now stay valid, only their time is reset
+    for (auto& node : nodes_) {
+        node.selfTime = 0;
+    }
+    if (nodes_.empty()) {
+        nodes_.push_back({ -1, -1, 0, {} });
+    }
+}
+
+void ScriptProfiler::debugHook(HSQUIRRELVM vm, SQInteger type, const SQChar* sourceName, SQInteger line, const SQChar* funcName) {
+    ScriptProfiler* profiler = current_;
+    if (!profiler || profiler->vm_ != vm) {
+        return;
+    }
+    if (type == 'c') {
+        profiler->enter(funcName, sourceName, line);
+    } else if (type == 'r') {
+        profiler->leave();
+    }
+}
+
+void ScriptProfiler::account() {
+    int64_t now = TraceRecorder::now();
+    // Time between top-level calls is spent outside of the script
+    if (currentNode_ != 0) {
+        nodes_[currentNode_].selfTime += now - lastTime_;
+    }
+    lastTime_ = now;
+}
+
+void ScriptProfiler::enter(const SQChar* name, const SQChar* source, SQInteger line) {
+    account();
+    int frame = frameId(name, source, line);
+    auto it = nodes_[currentNode_].children.find(frame);
+    if (it != nodes_[currentNode_].children.end()) {
+        currentNode_ = it->second;
+        return;
+    }
+    int node = static_cast<int>(nodes_.size());
+    nodes_.push_back({ currentNode_, frame, 0, {} });
+    nodes_[currentNode_].children[frame] = node;
+    currentNode_ = node;
+}
+
+void ScriptProfiler::leave() {
+    account();
+    if (currentNode_ != 0) {
+        currentNode_ = nodes_[currentNode_].parent;
+    }
+}
+
+int ScriptProfiler::frameId(const SQChar* name, const SQChar* source, SQInteger line) {
+    FrameKey key{ name, source, line };
+    auto it = frameIds_.find(key);
+    if (it != frameIds_.end()) {
+        return it->second;
+    }
+    std::string frameName = name ? name : "(anonymous)";
+    if (source) {
+        frameName += " (" + IuCoreUtils::ExtractFileName(source) + ":" + std::to_string(line) + ")";
+    }
+    int id = static_cast<int>(frameNames_.size());
+    frameNames_.push_back(sanitizeFrameName(frameName));
+    frameIds_[key] = id;
+    return id;
+}
+
+std::string ScriptProfiler::collapsedStacks() const {
+    std::string rootName = sanitizeFrameName(IuCoreUtils::ExtractFileName(scriptName_));
+    std::string result;
+    std::vector<int> frames;
+    for (size_t i = 1; i < nodes_.size(); i++) {
+        if (nodes_[i].selfTime <= 0) {
+            continue;
+        }
+        frames.clear();
+        for (int node = static_cast<int>(i); node != 0; node = nodes_[node].parent) {
+            frames.push_back(nodes_[node].frame);
+        }
+        result += rootName;
+        for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+            result += ';';
+            result += frameNames_[*it];
+        }
+        result += ' ';
+        result += std::to_string(nodes_[i].selfTime);
+        result += '\n';
+    }
+    return result;
+}
+
+bool ScriptProfiler::flush(const std::string& directory) {
+    account();
+    std::string stacks = collapsedStacks();
+    clear();
+    if (stacks.empty()) {
+        return true;
+    }
+    std::string fileName = directory + "/" + IuCoreUtils::ExtractFileName(scriptName_) + ".folded";
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    IuCoreUtils::CreateDir(directory);
+    FILE* f = IuCoreUtils::FopenUtf8(fileName.c_str(), "ab");
+    if (!f) {
+        LOG(ERROR) << "Cannot open file '" << fileName << "' for writing script profile";
+        return false;
+    }
+    bool success = fwrite(stacks.data(), 1, stacks.size(), f) == stacks.size();
+    fclose(f);
+    return success;
+}
@@ -0,0 +1,112 @@
+#ifndef IU_CORE_SCRIPTING_SCRIPTPROFILER_H
+#define IU_CORE_SCRIPTING_SCRIPTPROFILER_H
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Squirrelnc.h"
+#include "Core/Utils/CoreTypes.h"
+
+/**
+@brief ScriptProfiler measures where the time of a Squirrel script goes.
+
+Calls and returns of script functions are followed with the native debug hook of the VM,
+slow native functions (network requests, JSON, hashing, regular expressions, sleep)
+are marked with NativeCallScope. Time is accumulated per call stack and written in the
+collapsed stack format (one "script;main;upload;nm.doPost 1234" line per stack, self time
+in microseconds), which can be rendered by flamegraph.pl or https://www.speedscope.app.
+
+The profiler is created only when profiling is enabled, otherwise the VM runs without
+the debug hook and NativeCallScope costs one thread-local pointer check.
+*/
+class ScriptProfiler {
+public:
+    /**
+     * Installs the debug hook and makes the profiler current for the calling thread
+     * (the thread owning the VM).
+     */
+    ScriptProfiler(HSQUIRRELVM vm, std::string scriptName);
+    ~ScriptProfiler();
+
+    /**
+     * Makes the profiler current for the calling thread. Should be called
+     * when the thread switches to the VM.
+     */
+    void activate();
+
+    /**
+     * Returns accumulated stacks in collapsed stack format
+     */
+    std::string collapsedStacks() const;
+
+    /**
+     * Appends accumulated stacks to the file <directory>/<script name>.folded and resets them.
+     * Profiles of all VMs running the same script are collected in one file.
+     */
+    bool flush(const std::string& directory);
+
+    void clear();
+
+    /**
+     * Marks a native function call, so its time is not attributed to the calling script function.
+     */
+    class NativeCallScope {
+    public:
+        explicit NativeCallScope(const char* name) : profiler_(current_) {
+            if (profiler_) {
+                profiler_->enter(name, nullptr, 0);
+            }
+        }
+
+        ~NativeCallScope() {
+            if (profiler_) {
+                profiler_->leave();
+            }
+        }
+    private:
+        ScriptProfiler* profiler_;
+        DISALLOW_COPY_AND_ASSIGN(NativeCallScope);
+    };
+private:
+    struct FrameKey {
+        const SQChar* name;
+        const SQChar* source;
+        SQInteger line;
+
+        bool operator==(const FrameKey& other) const {
+            return name == other.name && source == other.source && line == other.line;
+        }
+    };
+
+    struct FrameKeyHash {
+        size_t operator()(const FrameKey& key) const;
+    };
+
+    struct Node {
+        int parent;
+        int frame;
+        int64_t selfTime;
+        std::unordered_map<int, int> children;
+    };
+
+    static void debugHook(HSQUIRRELVM vm, SQInteger type, const SQChar* sourceName, SQInteger line, const SQChar* funcName);
+    void enter(const SQChar* name, const SQChar* source, SQInteger line);
+    void leave();
+    void account();
+    int frameId(const SQChar* name, const SQChar* source, SQInteger line);
+
+    HSQUIRRELVM vm_;
+    std::string scriptName_;
+    std::vector<Node> nodes_;
+    std::vector<std::string> frameNames_;
+    std::unordered_map<FrameKey, int, FrameKeyHash> frameIds_;
+    int currentNode_;
+    int64_t lastTime_;
+    static thread_local ScriptProfiler* current_;
+    DISALLOW_COPY_AND_ASSIGN(ScriptProfiler);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include "Core/Scripting/ScriptProfiler.h"
+#include "Core/Utils/CoreUtils.h"
+
+namespace {
+
+void nativeWork() {
+    ScriptProfiler::NativeCallScope profilerScope("nativeWork");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+std::string findStack(const std::string& stacks, const std::string& leaf, int64_t& value) {
+    std::istringstream stream(stacks);
+    std::string line;
+    while (std::getline(stream, line)) {
+        size_t space = line.rfind(' ');
+        std::string stack = line.substr(0, space);
+        if (stack.size() >= leaf.size() && stack.compare(stack.size() - leaf.size(), leaf.size(), leaf) == 0) {
+            value = std::stoll(line.substr(space + 1));
+            return stack;
+        }
+    }
+    return std::string();
+}
+
+}
+
+TEST(ScriptProfilerTest, CollapsedStacks) {
+    Sqrat::SqratVM vm;
+    vm.GetRootTable().Func("nativeWork", nativeWork);
+    ScriptProfiler profiler(vm.GetVM(), "/scripts/test.nut");
+
+    Sqrat::Script script(vm.GetVM());
+    script.CompileString("function inner() {\n nativeWork();\n}\nfunction outer() {\n inner();\n}\nouter();\n", "test.nut");
+    script.Run();
+
+    std::string stacks = profiler.collapsedStacks();
+    int64_t value = 0;
+    std::string stack = findStack(stacks, ";nativeWork", value);
+    ASSERT_FALSE(stack.empty()) << stacks;
+    EXPECT_EQ(0, stack.find("test.nut;main (test.nut:"));
+    size_t outerPos = stack.find(";outer (test.nut:");
+    size_t innerPos = stack.find(";inner (test.nut:");
+    ASSERT_NE(std::string::npos, outerPos);
+    ASSERT_NE(std::string::npos, innerPos);
+    EXPECT_LT(outerPos, innerPos);
+    EXPECT_GE(value, 15000);
+
+    // Time of the native function is not attributed to the script function
+    int64_t innerValue = 0;
+    findStack(stacks, stack.substr(0, stack.rfind(';')), innerValue);
+    EXPECT_LT(innerValue, 15000);
+}
+
+TEST(ScriptProfilerTest, NativeCallScopeWithoutProfiler) {
+    // Should not crash or record anything when profiling is off
+    nativeWork();
+}
+
+TEST(ScriptProfilerTest, Flush) {
+    Sqrat::SqratVM vm;
+    vm.GetRootTable().Func("nativeWork", nativeWork);
+    ScriptProfiler profiler(vm.GetVM(), "flush_test.nut");
+    Sqrat::Script script(vm.GetVM());
+    script.CompileString("nativeWork();", "flush_test.nut");
+    script.Run();
+
+    std::string stacks = profiler.collapsedStacks();
+    ASSERT_FALSE(stacks.empty());
+    const std::string directory = "script_profiler_test";
+    const std::string fileName = directory + "/flush_test.nut.folded";
+    IuCoreUtils::RemoveFile(fileName);
+    ASSERT_TRUE(profiler.flush(directory));
+    EXPECT_EQ(stacks, IuCoreUtils::GetFileContents(fileName));
+    EXPECT_TRUE(profiler.collapsedStacks().empty());
+    IuCoreUtils::RemoveFile(fileName);
+}
@@ -23,6 +23,7 @@ limitations under the License.
 #include "Script.h"
 #include "API/ScriptAPI.h"
 #include "API/UploadTaskWrappers.h"
+#include "Core/Utils/CoreUtils.h"
 
 UploadFilterScript::UploadFilterScript(const std::string& fileName, ThreadSync* serverSync, std::shared_ptr<INetworkClientFactory> networkClientFactory) 
     : Script(fileName, serverSync, networkClientFactory)
@@ -32,6 +33,9 @@ UploadFilterScript::UploadFilterScript(const std::string& fileName, ThreadSync*
 bool UploadFilterScript::preUpload(UploadTask* task)
 {
     using namespace Sqrat;
+    defer<void> profileFlusher([this] {
+        flushProfile();
+    });
     try
     {
         checkCallingThread();
@@ -55,6 +59,9 @@ bool UploadFilterScript::preUpload(UploadTask* task)
 bool UploadFilterScript::postUpload(UploadTask* task)
 {
     using namespace Sqrat;
+    defer<void> profileFlusher([this] {
+        flushProfile();
+    });
     try
     {
         checkCallingThread();
@@ -26,7 +26,10 @@ limitations under the License.
 
 #include "EncodedPassword.h"
 
-BasicSettings::BasicSettings()
+const char BasicSettings::SERVERS_PARAMS_SECTION[] = "ServersParams";
+
+BasicSettings::BasicSettings() :
+    persister_(std::bind(&BasicSettings::serializeDocument, this, std::placeholders::_1))
 {
     rootName_ = "ImageUploader";
     LastUpdateTime = 0;
@@ -51,10 +54,14 @@ BasicSettings::BasicSettings()
 }
 
 BasicSettings::~BasicSettings() {
-
+    persister_.stop();
 }
 
 void BasicSettings::setEngineList(CUploadEngineListBase* engineList) {
+    if (engineList_ && engineList_ != engineList) {
+        // Pending server parameters are serialized with the old list
+        persister_.flush();
+    }
     engineList_ = engineList;
 }
 
@@ -104,11 +111,14 @@ bool BasicSettings::LoadAccounts(SimpleXmlNode root)
 
 bool BasicSettings::SaveAccounts(SimpleXmlNode root)
 {
+    std::lock_guard<std::mutex> lock(serverSettingsMutex_);
     ServerSettingsMap::iterator it1;
     for (it1 = ServersSettings.begin(); it1 != ServersSettings.end(); ++it1) {
         std::map <std::string, ServerSettingsStruct>::iterator it;
         for (it = it1->second.begin(); it != it1->second.end(); ++it) {
             ServerSettingsStruct & sss = it->second;
+            // Parameters are changed by upload threads
+            std::lock_guard<std::mutex> paramsLock(*sss.paramsMutex_);
             if (sss.isEmpty()) {
                 continue;
             }
@@ -128,7 +138,7 @@ bool BasicSettings::SaveAccounts(SimpleXmlNode root)
             CEncodedPassword login(sss.authData.Login);
             serverNode.SetAttribute("Login", login.toEncodedData());
 
-            CUploadEngineData* ued = engineList_->byName(it->first);
+            CUploadEngineData* ued = engineList_ ? engineList_->byName(it->first) : nullptr;
             if (!ued || ued->NeedPassword) {
                 CEncodedPassword pass(it->second.authData.Password);
                 serverNode.SetAttribute("Password", pass.toEncodedData());
@@ -170,34 +180,77 @@ bool BasicSettings::LoadSettings(const std::string& szDir, const std::string& fi
     loadFromRegistry_ = LoadFromRegistry;
     fileName_ = !szDir.empty() ? szDir + ((!fileName.empty()) ? fileName : "Settings.xml")
         : SettingsFolder + (!fileName.empty() ? fileName : "Settings.xml");
+    persister_.setFileName(fileName_);
     if (!IuCoreUtils::FileExists(fileName_)) {
         return true;
     }
-    SimpleXml xml;
-    xml.LoadFromFile(fileName_);
-    mgr_.loadFromXmlNode(xml.getRoot(rootName_).GetChild("Settings"));
-    LoadAccounts(xml.getRoot(rootName_).GetChild("Settings").GetChild("ServersParams"));
-    PostLoadSettings(xml);
+    std::unique_ptr<SimpleXml> xml(new SimpleXml());
+    xml->LoadFromFile(fileName_);
+    mgr_.loadFromXmlNode(xml->getRoot(rootName_).GetChild("Settings"));
+    LoadAccounts(xml->getRoot(rootName_).GetChild("Settings").GetChild(SERVERS_PARAMS_SECTION));
+    PostLoadSettings(*xml);
+    {
+        std::lock_guard<std::mutex> lock(documentMutex_);
+        document_ = std::move(xml);
+    }
     notifyChange();
     return true;
 }
 
 bool BasicSettings::SaveSettings()
 {
-    SimpleXml xml;
-    mgr_.saveToXmlNode(xml.getRoot(rootName_).GetChild("Settings"));
-    PostSaveSettings(xml);
-    SaveAccounts(xml.getRoot(rootName_).GetChild("Settings").GetChild("ServersParams"));
-    //std::cerr << "Saving setting to "<< IuCoreUtils::WstringToUtf8((LPCTSTR)fileName_);
-    bool result = true;
-    if (!xml.SaveToFile(fileName_)) {
+    std::unique_ptr<SimpleXml> xml(new SimpleXml());
+    mgr_.saveToXmlNode(xml->getRoot(rootName_).GetChild("Settings"));
+    PostSaveSettings(*xml);
+    SaveAccounts(xml->getRoot(rootName_).GetChild("Settings").GetChild(SERVERS_PARAMS_SECTION));
+    {
+        std::lock_guard<std::mutex> lock(documentMutex_);
+        document_ = std::move(xml);
+    }
+    // Supersedes a pending deferred write
+    bool result = persister_.writeNow();
+    if (!result) {
         LOG(ERROR) << "Could not save settings!" << std::endl << "File: "<< fileName_;
-        result = false;
     }
     notifyChange();
     return result;
 }
 
+void BasicSettings::scheduleSave(const std::string& section)
+{
+    {
+        std::lock_guard<std::mutex> lock(documentMutex_);
+        if (!document_) {
+            // The file did not exist, it will contain only the changed nodes until SaveSettings() is called
+            document_.reset(new SimpleXml());
+        }
+        if (section == SERVERS_PARAMS_SECTION) {
+            SimpleXmlNode serversNode = document_->getRoot(rootName_).GetChild("Settings").GetChild(SERVERS_PARAMS_SECTION);
+            serversNode.DeleteChilds();
+            SaveAccounts(serversNode);
+        } else {
+            // Overwrites bound values in place, nodes added by PostSaveSettings() are kept
+            mgr_[section].saveToXmlNode(document_->getRoot(rootName_).GetChild("Settings"), section);
+        }
+    }
+    persister_.scheduleWrite();
+}
+
+bool BasicSettings::flushPendingChanges()
+{
+    return persister_.flush();
+}
+
+bool BasicSettings::serializeDocument(std::string& contents)
+{
+    std::lock_guard<std::mutex> lock(documentMutex_);
+    if (!document_) {
+        return false;
+    }
+    contents = document_->ToString();
+    return true;
+}
+
 ServerSettingsStruct* BasicSettings::getServerSettings(const ServerProfile& profile, bool create)
 {
     std::lock_guard<std::mutex> lock(serverSettingsMutex_);
@@ -2,9 +2,12 @@
 #define IU_CORE_SETTINGS_BASICSETTINGS_H
 
 #pragma once
+#include <memory>
+#include <mutex>
 #include <boost/signals2.hpp>
 
 #include "Core/SettingsManager.h"
+#include "Core/Settings/SettingsPersister.h"
 #include "Core/Upload/UploadEngine.h"
 #include "EncodedPassword.h"
 
@@ -28,6 +31,16 @@ public:
     void setEngineList(CUploadEngineListBase* engineList);
     bool LoadSettings(const std::string& szDir = "", const std::string& fileName = "", bool LoadFromRegistry = true);
     bool SaveSettings();
+
+    /**
+     * Marks a child node of <Settings> as changed and writes the file on a background thread
+     * after a short delay, so frequent changes (e.g. made by uploads) are coalesced.
+     * The node is serialized immediately on the calling thread, the writer thread only
+     * writes the document. The file is also written by SaveSettings(), flushPendingChanges()
+     * and on destruction.
+     */
+    void scheduleSave(const std::string& section);
+    bool flushPendingChanges();
     void notifyChange();
     boost::signals2::signal<void(BasicSettings*)> onChange;
     unsigned int LastUpdateTime;
@@ -38,6 +51,7 @@ public:
     std::string ScriptFileName;
     bool ExecuteScript;
     bool DeveloperMode;
+    std::string ScriptProfilingFolder; // if not empty, profiles of scripts are written to this folder
 
     int MaxThreads;
     bool AutoShowLog;
@@ -50,6 +64,8 @@ public:
     std::string DeviceId;
 
     ServerSettingsStruct* getServerSettings(const ServerProfile& profile, bool create = false);
+
+    static const char SERVERS_PARAMS_SECTION[];
 protected:
     SettingsManager mgr_;
     std::string fileName_;
@@ -62,5 +78,11 @@ protected:
     void BindToManager();
     virtual bool PostLoadSettings(SimpleXml &xml);
     virtual bool PostSaveSettings(SimpleXml &xml);
+    bool serializeDocument(std::string& contents);
+
+    // Last saved (or loaded) document, background writes update only its dirty nodes
+    std::unique_ptr<SimpleXml> document_;
+    std::mutex documentMutex_;
+    SettingsPersister persister_;
 };
 #endif
\ No newline at end of file
@@ -25,6 +25,8 @@ limitations under the License.
 void ImageUploadParams::bind(SettingsNode& n){
 }
 
+#endif
+
 ThumbCreatingParams ImageUploadParams::getThumb()
 {
     return Thumb;
@@ -34,5 +36,3 @@ ThumbCreatingParams& ImageUploadParams::getThumbRef()
 {
     return Thumb;
 }
-
-#endif
\ No newline at end of file
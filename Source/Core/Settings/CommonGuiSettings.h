@@ -47,6 +47,7 @@ struct VideoSettingsStruct {
     int GapWidth;
     int GapHeight;
     int NumOfFrames;
+    int DecoderCount; // 0 - by the number of CPU cores
     int JPEGQuality;
     BOOL UseAviInfo;
     BOOL ShowMediaInfo;
@@ -0,0 +1,227 @@
+#include "SettingsPersister.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+
+#include "Core/Logging.h"
+#include "Core/Utils/CoreUtils.h"
+
+SettingsPersister::SettingsPersister(Serializer serializer) :
+    serializer_(std::move(serializer)),
+    debounce_(1000),
+    maxDelay_(10000),
+    pending_(false),
+    stop_(false)
+{
+}
+
+SettingsPersister::~SettingsPersister()
+{
+    stop();
+}
+
+void SettingsPersister::setFileName(const std::string& fileName)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    fileName_ = fileName;
+}
+
+std::string SettingsPersister::fileName() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fileName_;
+}
+
+void SettingsPersister::setDebounceInterval(std::chrono::milliseconds debounce, std::chrono::milliseconds maxDelay)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        debounce_ = debounce;
+        maxDelay_ = std::max(debounce, maxDelay);
+    }
+    condition_.notify_all();
+}
+
+void SettingsPersister::scheduleWrite()
+{
+    bool stopped, wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.scheduled++;
+        stopped = stop_;
+        if (!stopped) {
+            auto now = std::chrono::steady_clock::now();
+            if (!pending_) {
+                firstScheduled_ = now;
+                wake = true;
+            }
+            lastScheduled_ = now;
+            // The thread is started by the first deferred write, so the CLI never creates it
+            if (!thread_.joinable()) {
+                thread_ = std::thread(&SettingsPersister::worker, this);
+            }
+        }
+        pending_ = true;
+    }
+    if (stopped) {
+        write(false);
+    } else if (wake) {
+        // While a write is pending the thread wakes up by itself and postpones it
+        condition_.notify_all();
+    }
+}
+
+bool SettingsPersister::writeNow()
+{
+    return write(true);
+}
+
+bool SettingsPersister::flush()
+{
+    return write(false);
+}
+
+void SettingsPersister::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            return;
+        }
+        stop_ = true;
+    }
+    condition_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    write(false);
+}
+
+bool SettingsPersister::hasPendingWrite() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+SettingsPersister::Stats SettingsPersister::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+bool SettingsPersister::write(bool force)
+{
+    // Changes scheduled while the serializer runs are written by the next call,
+    // so a write which started earlier never overwrites newer contents
+    std::lock_guard<std::mutex> writeLock(writeMutex_);
+    std::string fileName;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!pending_ && !force) {
+            return true;
+        }
+        fileName = fileName_;
+        if (fileName.empty()) {
+            // Changes are kept until the file name is known
+            pending_ = true;
+            postponeRetry();
+            return false;
+        }
+        pending_ = false;
+    }
+    std::string contents;
+    if (!serializer_(contents)) {
+        return !force;
+    }
+    bool result = writeFileAtomically(fileName, contents);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (result) {
+        stats_.written++;
+    } else {
+        stats_.failed++;
+        // The contents are serialized again by the next attempt
+        pending_ = true;
+        postponeRetry();
+    }
+    return result;
+}
+
+void SettingsPersister::postponeRetry()
+{
+    // The writer thread tries again after the debounce interval instead of spinning
+    firstScheduled_ = lastScheduled_ = std::chrono::steady_clock::now();
+}
+
+void SettingsPersister::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        if (!pending_) {
+            condition_.wait(lock);
+            continue;
+        }
+        auto due = std::min(lastScheduled_ + debounce_, firstScheduled_ + maxDelay_);
+        if (std::chrono::steady_clock::now() < due) {
+            condition_.wait_until(lock, due);
+            continue;
+        }
+        lock.unlock();
+        write(false);
+        lock.lock();
+    }
+}
+
+bool SettingsPersister::writeFileAtomically(const std::string& fileName, const std::string& contents)
+{
+    std::string tempFileName = fileName + ".tmp";
+    FILE* f = IuCoreUtils::FopenUtf8(tempFileName.c_str(), "wb");
+    if (!f) {
+        LOG(ERROR) << "Cannot create file " << tempFileName;
+        return false;
+    }
+    bool ok = fwrite(contents.data(), 1, contents.size(), f) == contents.size() && fflush(f) == 0;
+    // The data must reach the disk before the rename, otherwise after a power loss
+    // the file may be renamed but empty
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        LOG(ERROR) << "Cannot write file " << tempFileName;
+        IuCoreUtils::RemoveFile(tempFileName);
+        return false;
+    }
+
+    boost::system::error_code ec;
+#ifdef _WIN32
+    boost::filesystem::rename(IuCoreUtils::Utf8ToWstring(tempFileName), IuCoreUtils::Utf8ToWstring(fileName), ec);
+#else
+    boost::filesystem::rename(tempFileName, fileName, ec);
+#endif
+    if (ec) {
+        LOG(ERROR) << "Cannot rename " << tempFileName << " to " << fileName << ": " << ec.message();
+        IuCoreUtils::RemoveFile(tempFileName);
+        return false;
+    }
+#ifndef _WIN32
+    // Makes the rename itself durable
+    std::string directory = boost::filesystem::path(fileName).parent_path().string();
+    int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef IU_CORE_SETTINGS_SETTINGSPERSISTER_H
+#define IU_CORE_SETTINGS_SETTINGSPERSISTER_H
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Core/Utils/CoreTypes.h"
+
+/**
+@brief Writes the settings file atomically (temporary file, fsync, rename) and coalesces
+frequent changes into a single write on a background thread.
+
+scheduleWrite() only marks the file as dirty. The serializer is called by the writer thread
+when no changes have been scheduled for the debounce interval, but not later than maxDelay
+after the first pending change. Writes never run concurrently, so the file always holds
+the result of the latest serializer call.
+*/
+class SettingsPersister {
+public:
+    /**
+     * Produces the contents of the file, returns false if there is nothing to write.
+     */
+    typedef std::function<bool(std::string&)> Serializer;
+
+    struct Stats {
+        int64_t scheduled = 0;
+        int64_t written = 0;
+        int64_t failed = 0;
+    };
+
+    explicit SettingsPersister(Serializer serializer);
+
+    /**
+     * Writes pending changes and stops the writer thread
+     */
+    ~SettingsPersister();
+
+    void setFileName(const std::string& fileName);
+    std::string fileName() const;
+    void setDebounceInterval(std::chrono::milliseconds debounce, std::chrono::milliseconds maxDelay);
+
+    /**
+     * Schedules a deferred write. After stop() the file is written immediately.
+     */
+    void scheduleWrite();
+
+    /**
+     * Writes the file on the calling thread, pending changes are written too
+     */
+    bool writeNow();
+
+    /**
+     * Writes pending changes (if any) on the calling thread. If the file cannot be written
+     * (or the file name is not set yet), the changes stay pending.
+     */
+    bool flush();
+
+    /**
+     * Writes pending changes and stops the writer thread
+     */
+    void stop();
+
+    bool hasPendingWrite() const;
+    Stats stats() const;
+
+    /**
+     * Replaces the file so that it contains either old or new contents even if the process
+     * or the system crashes in the middle of the write.
+     */
+    static bool writeFileAtomically(const std::string& fileName, const std::string& contents);
+private:
+    bool write(bool force);
+    void postponeRetry();
+    void worker();
+
+    Serializer serializer_;
+    std::string fileName_;
+    std::chrono::milliseconds debounce_, maxDelay_;
+    std::chrono::steady_clock::time_point firstScheduled_, lastScheduled_;
+    bool pending_;
+    bool stop_;
+    Stats stats_;
+    mutable std::mutex mutex_;
+    std::mutex writeMutex_;
+    std::condition_variable condition_;
+    std::thread thread_;
+    DISALLOW_COPY_AND_ASSIGN(SettingsPersister);
+};
+
+#endif
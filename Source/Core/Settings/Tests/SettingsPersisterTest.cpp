@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+
+#include "Core/Settings/BasicSettings.h"
+#include "Core/Settings/SettingsPersister.h"
+#include "Core/Utils/CoreUtils.h"
+
+namespace {
+
+std::string readFile(const std::string& fileName) {
+    return IuCoreUtils::GetFileContents(fileName);
+}
+
+class TestSettings: public BasicSettings {
+public:
+    TestSettings() {
+        BindToManager();
+    }
+};
+
+}
+
+class SettingsPersisterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        namespace fs = boost::filesystem;
+        directory_ = (fs::temp_directory_path() / fs::unique_path("iu_settings_%%%%-%%%%")).string();
+        fs::create_directories(directory_);
+        fileName_ = (fs::path(directory_) / "Settings.xml").string();
+    }
+
+    void TearDown() override {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(directory_, ec);
+    }
+
+    std::string directory_;
+    std::string fileName_;
+};
+
+TEST_F(SettingsPersisterTest, FailedWriteKeepsOldFile)
+{
+    ASSERT_TRUE(SettingsPersister::writeFileAtomically(fileName_, "old"));
+    EXPECT_EQ("old", readFile(fileName_));
+    // The temporary file cannot be created
+    boost::filesystem::create_directory(fileName_ + ".tmp");
+    EXPECT_FALSE(SettingsPersister::writeFileAtomically(fileName_, "new"));
+    EXPECT_EQ("old", readFile(fileName_));
+}
+
+TEST_F(SettingsPersisterTest, FailedWriteStaysPending)
+{
+    int serialized = 0;
+    SettingsPersister persister([&](std::string& contents) {
+        contents = "data" + std::to_string(++serialized);
+        return true;
+    });
+    persister.setDebounceInterval(std::chrono::hours(1), std::chrono::hours(1));
+    persister.scheduleWrite();
+    // File name is not set yet
+    EXPECT_FALSE(persister.flush());
+    EXPECT_TRUE(persister.hasPendingWrite());
+    EXPECT_EQ(0, serialized);
+
+    persister.setFileName(fileName_);
+    boost::filesystem::create_directory(fileName_ + ".tmp");
+    EXPECT_FALSE(persister.flush());
+    EXPECT_TRUE(persister.hasPendingWrite());
+    EXPECT_EQ(1, persister.stats().failed);
+
+    boost::filesystem::remove(fileName_ + ".tmp");
+    EXPECT_TRUE(persister.flush());
+    EXPECT_FALSE(persister.hasPendingWrite());
+    EXPECT_EQ("data2", readFile(fileName_));
+    EXPECT_EQ(1, persister.stats().written);
+}
+
+#ifndef _WIN32
+TEST_F(SettingsPersisterTest, KilledInTheMiddleOfWrite)
+{
+    // Large contents make it likely that the process is killed while the file is being written
+    const std::string first(4 * 1024 * 1024, 'a'), second(4 * 1024 * 1024, 'b');
+    ASSERT_TRUE(SettingsPersister::writeFileAtomically(fileName_, first));
+    for (int i = 0; i < 10; i++) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            for (int j = 0;; j++) {
+                SettingsPersister::writeFileAtomically(fileName_, j % 2 ? first : second);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20 + i * 7));
+        kill(pid, SIGKILL);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        std::string contents = readFile(fileName_);
+        EXPECT_TRUE(contents == first || contents == second) << "size " << contents.size();
+    }
+}
+#endif
+
+TEST_F(SettingsPersisterTest, CoalescesWrites)
+{
+    std::atomic<int> value(0), serialized(0);
+    SettingsPersister persister([&](std::string& contents) {
+        serialized++;
+        contents = std::to_string(value.load());
+        return true;
+    });
+    persister.setFileName(fileName_);
+    persister.setDebounceInterval(std::chrono::milliseconds(100), std::chrono::seconds(10));
+    for (int i = 1; i <= 1000; i++) {
+        value = i;
+        persister.scheduleWrite();
+    }
+    EXPECT_TRUE(persister.hasPendingWrite());
+    for (int i = 0; i < 200 && persister.hasPendingWrite(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_FALSE(persister.hasPendingWrite());
+    // The writer thread may still be renaming the file
+    persister.stop();
+    EXPECT_EQ("1000", readFile(fileName_));
+    EXPECT_EQ(1, serialized.load());
+    EXPECT_EQ(1000, persister.stats().scheduled);
+    EXPECT_EQ(1, persister.stats().written);
+}
+
+TEST_F(SettingsPersisterTest, MaxDelay)
+{
+    SettingsPersister persister([](std::string& contents) {
+        contents = "data";
+        return true;
+    });
+    persister.setFileName(fileName_);
+    persister.setDebounceInterval(std::chrono::milliseconds(50), std::chrono::milliseconds(200));
+    auto start = std::chrono::steady_clock::now();
+    // Changes never stop, the file is written anyway
+    while (persister.stats().written == 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+        persister.scheduleWrite();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(1, persister.stats().written);
+}
+
+TEST_F(SettingsPersisterTest, FlushesOnDestruction)
+{
+    {
+        SettingsPersister persister([](std::string& contents) {
+            contents = "data";
+            return true;
+        });
+        persister.setFileName(fileName_);
+        persister.setDebounceInterval(std::chrono::hours(1), std::chrono::hours(1));
+        persister.scheduleWrite();
+        EXPECT_FALSE(IuCoreUtils::FileExists(fileName_));
+    }
+    EXPECT_EQ("data", readFile(fileName_));
+}
+
+TEST_F(SettingsPersisterTest, ServerParametersAreSavedInBackground)
+{
+    {
+        TestSettings settings;
+        settings.LoadSettings(directory_ + "/");
+        settings.MaxThreads = 7;
+        ASSERT_TRUE(settings.SaveSettings());
+
+        ServerProfile profile("test.com");
+        settings.getServerSettings(profile, true)->setParam("token", "secret");
+        settings.scheduleSave(BasicSettings::SERVERS_PARAMS_SECTION);
+        // Only the dirty node is updated, with the values it had when scheduleSave() was called
+        settings.MaxThreads = 8;
+        settings.getServerSettings(profile)->setParam("token", "changed later");
+        EXPECT_TRUE(settings.flushPendingChanges());
+    }
+    TestSettings settings;
+    settings.LoadSettings(directory_ + "/");
+    EXPECT_EQ(7, settings.MaxThreads);
+    ServerProfile profile("test.com");
+    ServerSettingsStruct* serverSettings = settings.getServerSettings(profile);
+    ASSERT_TRUE(serverSettings != nullptr);
+    EXPECT_EQ("secret", serverSettings->getParam("token"));
+}
+
+TEST_F(SettingsPersisterTest, DISABLED_Benchmark)
+{
+    const int mutationCount = 10000;
+    TestSettings settings;
+    settings.LoadSettings(directory_ + "/");
+    for (int i = 0; i < 50; i++) {
+        ServerProfile profile("server" + std::to_string(i) + ".com");
+        settings.getServerSettings(profile, true)->setParam("token", "initial");
+    }
+    ServerProfile profile("server0.com");
+    ServerSettingsStruct* serverSettings = settings.getServerSettings(profile);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < mutationCount; i++) {
+        serverSettings->setParam("token", std::to_string(i));
+        settings.SaveSettings();
+    }
+    double syncMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < mutationCount; i++) {
+        serverSettings->setParam("token", std::to_string(i));
+        settings.scheduleSave(BasicSettings::SERVERS_PARAMS_SECTION);
+    }
+    double scheduleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    settings.flushPendingChanges();
+    double deferredMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%d mutations: SaveSettings() each time %.1f ms, scheduleSave() %.1f ms (%.1f ms including the final write)\n",
+        mutationCount, syncMs, scheduleMs, deferredMs);
+}
@@ -464,6 +464,7 @@ WtlGuiSettings::WtlGuiSettings() :
     VideoSettings.GapWidth = 5;
     VideoSettings.GapHeight = 7;
     VideoSettings.NumOfFrames = 8;
+    VideoSettings.DecoderCount = 1;
     VideoSettings.JPEGQuality = 100;
     VideoSettings.UseAviInfo = TRUE;
     VideoSettings.ShowMediaInfo = TRUE;
@@ -795,6 +796,7 @@ void WtlGuiSettings::BindToManager() {
     video.nm_bind(VideoSettings, GapWidth);
     video.nm_bind(VideoSettings, GapHeight);
     video.nm_bind(VideoSettings, NumOfFrames);
+    video.nm_bind(VideoSettings, DecoderCount);
     video.nm_bind(VideoSettings, JPEGQuality);
     video.nm_bind(VideoSettings, ShowMediaInfo);
     video.nm_bind(VideoSettings, TextColor);
@@ -835,6 +837,7 @@ void WtlGuiSettings::BindToManager() {
     upload.n_bind(ScriptFileName);
     upload.n_bind(ExecuteScript);
     upload.n_bind(DeveloperMode);
+    upload.n_bind(ScriptProfilingFolder);
     upload.n_bind(AutomaticallyCheckUpdates);
 
     imageServer.bind(upload["Server"]);
@@ -0,0 +1,129 @@
+#include "AuthTokenCache.h"
+
+#include <ctime>
+
+#include <json/json.h>
+
+#include "Core/Logging.h"
+#include "Core/Settings/SettingsPersister.h"
+#include "Core/Utils/CoreUtils.h"
+#include "Core/Utils/CryptoUtils.h"
+
+AuthTokenCache::AuthTokenCache(const std::string& fileName, const std::string& keyFileName) :
+    fileName_(fileName),
+    keyFileName_(keyFileName),
+    lifetime_(DEFAULT_LIFETIME)
+{
+}
+
+bool AuthTokenCache::get(const std::string& serverName, const std::string& login, const std::string& password,
+    std::map<std::string, std::string>& vars)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Another process may have logged in since the last call
+    load();
+    auto it = entries_.find(Key(serverName, login));
+    if (it == entries_.end() || it->second.credentialsHash != credentialsHash(login, password)
+        || it->second.expiresAt <= static_cast<int64_t>(time(nullptr))) {
+        return false;
+    }
+    vars = it->second.vars;
+    return true;
+}
+
+bool AuthTokenCache::put(const std::string& serverName, const std::string& login, const std::string& password,
+    const std::map<std::string, std::string>& vars)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    load();
+    Entry& entry = entries_[Key(serverName, login)];
+    entry.vars = vars;
+    entry.credentialsHash = credentialsHash(login, password);
+    entry.expiresAt = static_cast<int64_t>(time(nullptr)) + lifetime_;
+    return save();
+}
+
+bool AuthTokenCache::remove(const std::string& serverName, const std::string& login)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    load();
+    if (!entries_.erase(Key(serverName, login))) {
+        return true;
+    }
+    return save();
+}
+
+void AuthTokenCache::setLifetime(int64_t seconds)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    lifetime_ = seconds;
+}
+
+void AuthTokenCache::load()
+{
+    entries_.clear();
+    if (!IuCoreUtils::FileExists(fileName_)) {
+        return;
+    }
+    std::string json;
+    if (!IuCoreUtils::CryptoUtils::UnprotectData(IuCoreUtils::GetFileContents(fileName_), keyFileName_, json)) {
+        // The file is rewritten by the next login
+        LOG(WARNING) << "Cannot decrypt authentication token cache " << fileName_;
+        return;
+    }
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(json, root, false) || !root.isObject()) {
+        LOG(WARNING) << "Cannot parse authentication token cache " << fileName_;
+        return;
+    }
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    const Json::Value& items = root["entries"];
+    for (Json::ArrayIndex i = 0; i < items.size(); i++) {
+        const Json::Value& item = items[i];
+        Entry entry;
+        entry.expiresAt = item["expires"].asInt64();
+        if (entry.expiresAt <= now) {
+            continue;
+        }
+        entry.credentialsHash = item["credentials"].asString();
+        const Json::Value& vars = item["vars"];
+        for (const auto& name : vars.getMemberNames()) {
+            entry.vars[name] = vars[name].asString();
+        }
+        entries_[Key(item["server"].asString(), item["login"].asString())] = entry;
+    }
+}
+
+bool AuthTokenCache::save()
+{
+    Json::Value root;
+    Json::Value& items = root["entries"];
+    items = Json::Value(Json::arrayValue);
+    for (const auto& it : entries_) {
+        Json::Value item;
+        item["server"] = it.first.first;
+        item["login"] = it.first.second;
+        item["credentials"] = it.second.credentialsHash;
+        item["expires"] = static_cast<Json::Int64>(it.second.expiresAt);
+        Json::Value& vars = item["vars"];
+        vars = Json::Value(Json::objectValue);
+        for (const auto& var : it.second.vars) {
+            vars[var.first] = var.second;
+        }
+        items.append(item);
+    }
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    std::string data;
+    if (!IuCoreUtils::CryptoUtils::ProtectData(Json::writeString(builder, root), keyFileName_, data)) {
+        LOG(WARNING) << "Cannot encrypt authentication token cache";
+        return false;
+    }
+    return SettingsPersister::writeFileAtomically(fileName_, data);
+}
+
+std::string AuthTokenCache::credentialsHash(const std::string& login, const std::string& password)
+{
+    return IuCoreUtils::CryptoUtils::CalcSHA1HashFromString(login + '\n' + password);
+}
@@ -0,0 +1,61 @@
+#ifndef IU_CORE_UPLOAD_AUTHTOKENCACHE_H
+#define IU_CORE_UPLOAD_AUTHTOKENCACHE_H
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "Core/Utils/CoreTypes.h"
+
+/**
+@brief AuthTokenCache keeps variables obtained by logging in (session ids, tokens) between runs,
+so short CLI runs do not log in to every server again.
+
+Entries are keyed by server name and login, are bound to the password and expire after
+the lifetime. The file is encrypted with CryptoUtils::ProtectData(). Entries are not checked
+with the server here: a restored session is validated by the first request which uses it
+and replaced by a fresh login if that fails (see CDefaultUploadEngine::executeActions()).
+*/
+class AuthTokenCache {
+public:
+    static const int64_t DEFAULT_LIFETIME = 12 * 3600; // seconds
+
+    /**
+     * @param keyFileName key used for encryption on systems other than Windows
+     */
+    AuthTokenCache(const std::string& fileName, const std::string& keyFileName);
+
+    /**
+     * @return false if there is no entry, it has expired or it belongs to another password
+     */
+    bool get(const std::string& serverName, const std::string& login, const std::string& password,
+        std::map<std::string, std::string>& vars);
+    bool put(const std::string& serverName, const std::string& login, const std::string& password,
+        const std::map<std::string, std::string>& vars);
+    bool remove(const std::string& serverName, const std::string& login);
+
+    void setLifetime(int64_t seconds);
+private:
+    struct Entry {
+        std::map<std::string, std::string> vars;
+        std::string credentialsHash;
+        int64_t expiresAt = 0;
+    };
+    typedef std::pair<std::string, std::string> Key;
+
+    // Must be called with mutex_ locked
+    void load();
+    bool save();
+    static std::string credentialsHash(const std::string& login, const std::string& password);
+
+    std::string fileName_;
+    std::string keyFileName_;
+    int64_t lifetime_;
+    std::map<Key, Entry> entries_;
+    std::mutex mutex_;
+    DISALLOW_COPY_AND_ASSIGN(AuthTokenCache);
+};
+
+#endif
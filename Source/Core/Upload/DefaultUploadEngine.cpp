@@ -33,6 +33,8 @@ CDefaultUploadEngine::CDefaultUploadEngine(ServerSync* serverSync, ErrorMessageC
 {
     m_CurrentActionIndex = -1;
     fatalError_ = false;
+    usingRestoredAuth_ = false;
+    restoredAuthRejected_ = false;
 }
 
 int CDefaultUploadEngine::processTask(std::shared_ptr<UploadTask> task, UploadParams& params) {
@@ -143,6 +145,26 @@ void CDefaultUploadEngine::prepareUpload(UploadParams& params) {
 }
 
 bool CDefaultUploadEngine::executeActions() {
+    usingRestoredAuth_ = false;
+    restoredAuthRejected_ = false;
+    if (executeActionList()) {
+        return true;
+    }
+    if (!restoredAuthRejected_ || needStop()) {
+        return false;
+    }
+    // The saved session has expired on the server side, log in again.
+    // If another thread has already done it, just repeat the actions.
+    usingRestoredAuth_ = false;
+    restoredAuthRejected_ = false;
+    if (serverSync_->invalidateRestoredAuth(li.Login)) {
+        UploadError(false, "Saved session is not valid, logging in again", nullptr, false);
+    }
+    fatalError_ = false;
+    return executeActionList();
+}
+
+bool CDefaultUploadEngine::executeActionList() {
     m_NetworkClient->setTreatErrorsAsWarnings(true);
     for (size_t i = 0; i < m_UploadData->Actions.size(); i++) {
         int NumOfTries = 0;
@@ -156,6 +178,12 @@ bool CDefaultUploadEngine::executeActions() {
             if (needStop())
                 return false;
 
+            if (!ActionRes && usingRestoredAuth_ && isAuthFailure()) {
+                // Repeating requests with a stale session makes no sense
+                restoredAuthRejected_ = true;
+                break;
+            }
+
             if (!ActionRes ) {
                 // Prepare error string which will be displayed in Log Window
                 std::string ErrorStr = m_ErrorReason; 
@@ -189,6 +217,16 @@ bool CDefaultUploadEngine::executeActions() {
     return true;
 }
 
+bool CDefaultUploadEngine::isAuthFailure() {
+    // Network errors and server errors (5xx) say nothing about the session
+    if (m_NetworkClient->getCurlResult() != CURLE_OK) {
+        return false;
+    }
+    int code = m_NetworkClient->responseCode();
+    // Servers often answer with a login page instead of the expected response
+    return code == 401 || code == 403 || (code >= 200 && code < 400);
+}
+
 void CDefaultUploadEngine::logNetworkError(bool error, const std::string& msg) {
     UploadError(error, msg, nullptr);
 }
@@ -385,13 +423,18 @@ bool CDefaultUploadEngine::DoAction(UploadAction& Action)
         if (m_UploadData->NeedAuthorization && li.DoAuth) {
             serverSync_->beginAuth();
             if (!serverSync_->isAuthPerformed()) {
-                Result = DoUploadAction(Current, false);
-                if (!Action.OnlyOnce)
-                {
-                    serverSync_->setAuthPerformed(Result);
+                if (Action.OnlyOnce || !serverSync_->restoreAuth(li.Login, li.Password)) {
+                    Result = DoUploadAction(Current, false);
+                    if (!Action.OnlyOnce)
+                    {
+                        serverSync_->setAuthPerformed(Result);
+                        if (Result) {
+                            serverSync_->saveAuth(li.Login, li.Password);
+                        }
+                    }
                 }
-                
             }
+            usingRestoredAuth_ = serverSync_->isAuthRestored();
             serverSync_->endAuth();
         }
     }
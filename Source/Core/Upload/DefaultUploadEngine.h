@@ -56,6 +56,8 @@ class CDefaultUploadEngine: public CAbstractUploadEngine, public NetworkClient::
         bool doUploadUrl(std::shared_ptr<UrlShorteningTask> task, UploadParams& params);
         void prepareUpload(UploadParams& params);
         bool executeActions();
+        bool executeActionList();
+        bool isAuthFailure();
 
         static bool reg_single_match(const std::string& pattern, const std::string& text, std::string& res);
 
@@ -63,6 +65,10 @@ class CDefaultUploadEngine: public CAbstractUploadEngine, public NetworkClient::
         std::string m_FileName;
         std::string m_displayFileName;
         bool fatalError_;
+        // The login action has been skipped, because a session from AuthTokenCache is used
+        bool usingRestoredAuth_;
+        // The server has rejected the restored session
+        bool restoredAuthRejected_;
         LoginInfo li;
         ErrorInfo m_LastError;
         std::string m_ErrorBuffer;
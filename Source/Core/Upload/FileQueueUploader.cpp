@@ -23,6 +23,8 @@
 
 #include "Core/Upload/UploadTask.h"
 #include "FileQueueUploaderPrivate.h"
+#include "UploadJournal.h"
+#include "UploadProgressSampler.h"
 /* public CFileQueueUploader class */
 
 CFileQueueUploader::CFileQueueUploader(UploadEngineManager* uploadEngineManager, 
@@ -47,6 +49,8 @@ bool CFileQueueUploader::start()
 
 void CFileQueueUploader::stop()
 {
+    std::lock_guard<std::mutex> lock(_impl->queueMutex_);
+    _impl->abortUploads_ = true;
     _impl->stopSignal_ = true;
 }
 
@@ -103,6 +107,45 @@ void CFileQueueUploader::setOnConfigureNetworkClient(std::function<void(CFileQue
     _impl->onConfigureNetworkClientCallback_ = std::move(cb);
 }
 
+void CFileQueueUploader::setJournal(std::shared_ptr<UploadJournal> journal) {
+    _impl->journal_ = std::move(journal);
+}
+
+std::shared_ptr<UploadJournal> CFileQueueUploader::journal() const {
+    return _impl->journal_;
+}
+
+std::vector<std::shared_ptr<UploadSession>> CFileQueueUploader::restoreSessionsFromJournal(const std::function<void(UploadSession*)>& beforeAdd) {
+    std::vector<std::shared_ptr<UploadSession>> sessions;
+    if (!_impl->journal_) {
+        return sessions;
+    }
+    sessions = _impl->journal_->restoreSessions();
+    for (const auto& session : sessions) {
+        if (beforeAdd) {
+            beforeAdd(session.get());
+        }
+        addSession(session);
+    }
+    return sessions;
+}
+
+void CFileQueueUploader::setProgressUpdateInterval(int intervalMs) {
+    _impl->progressSampler_.setInterval(intervalMs);
+}
+
+UploadProgressSampler* CFileQueueUploader::progressSampler() {
+    return &_impl->progressSampler_;
+}
+
+void CFileQueueUploader::setMaxPreparedTasks(int count) {
+    _impl->setMaxPreparedTasks(count);
+}
+
+TaskPreparationStage::Stats CFileQueueUploader::preparationStats() const {
+    return _impl->preparationStage_->stats();
+}
+
 void CFileQueueUploader::sessionAdded(UploadSession* session)
 {
     if (_impl->onSessionAddedCallback_)
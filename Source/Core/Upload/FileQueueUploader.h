@@ -27,6 +27,7 @@
 #include "Core/Utils/CoreTypes.h"
 #include "Core/Upload/UploadEngine.h"
 #include "UploadSession.h"
+#include "TaskPreparationStage.h"
 
 class IUploadErrorHandler;
 class ScriptsManager;
@@ -35,6 +36,8 @@ class UploadFilter;
 class NetworkClient;
 class INetworkClientFactory;
 class FileQueueUploaderPrivate;
+class UploadJournal;
+class UploadProgressSampler;
 
 class CFileQueueUploader
 {
@@ -62,6 +65,34 @@ class CFileQueueUploader
         void setOnSessionAddedCallback(std::function<void(UploadSession*)> cb);
         void setOnTaskAddedCallback(std::function<void(UploadTask*)> cb);
         void setOnConfigureNetworkClient(std::function<void(CFileQueueUploader*, INetworkClient*)> cb);
+
+        /**
+         * Enables persistent journal of the upload queue (should be called before adding tasks)
+         */
+        void setJournal(std::shared_ptr<UploadJournal> journal);
+        std::shared_ptr<UploadJournal> journal() const;
+
+        /**
+         * Rebuilds sessions which have not been finished in the previous run and adds them to the queue.
+         * @param beforeAdd is called for each restored session before it is added to the queue
+         * (e.g. to set callbacks)
+         */
+        std::vector<std::shared_ptr<UploadSession>> restoreSessionsFromJournal(const std::function<void(UploadSession*)>& beforeAdd = {});
+
+        /**
+         * Sets how often upload progress is delivered to task callbacks and
+         * progressSampler()->onProgress subscribers (default: 250 ms)
+         */
+        void setProgressUpdateInterval(int intervalMs);
+        UploadProgressSampler* progressSampler();
+
+        /**
+         * Limits the number of tasks which have passed PreUpload filters (image conversion, thumbnails)
+         * but have not been uploaded yet. 0 means twice the number of upload threads plus
+         * the number of preparation threads.
+         */
+        void setMaxPreparedTasks(int count);
+        TaskPreparationStage::Stats preparationStats() const;
         friend class FileQueueUploaderPrivate;
     private:
         DISALLOW_COPY_AND_ASSIGN(CFileQueueUploader);
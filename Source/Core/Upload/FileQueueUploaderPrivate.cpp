@@ -9,6 +9,9 @@
 #include "Core/Upload/FileUploadTask.h"
 #include "UploadEngineManager.h"
 #include "Core/Upload/UploadFilter.h"
+#include "Core/Upload/UploadJournal.h"
+#include "Core/Logging/TraceRecorder.h"
+#include "Core/Metrics/MetricsRegistry.h"
 #include "Core/CommonDefs.h"
 #include "Core/i18n/Translator.h"
 
@@ -65,6 +68,7 @@ FileQueueUploaderPrivate::FileQueueUploaderPrivate(CFileQueueUploader* queueUplo
     ScriptsManager* scriptsManager, std::shared_ptr<IUploadErrorHandler> uploadErrorHandler, std::shared_ptr<INetworkClientFactory> networkClientFactory, int maxThreads) {
     threadCount_ = maxThreads;
     stopSignal_ = false;
+    abortUploads_ = false;
     isRunning_ = false;
     queueUploader_ = queueUploader;
     startFromSession_ = 0;
@@ -74,12 +78,25 @@ FileQueueUploaderPrivate::FileQueueUploaderPrivate(CFileQueueUploader* queueUplo
     //autoStart_ = true;
     networkClientFactory_ = networkClientFactory;
     runningThreadsCount_ = 0;
+    maxPreparedTasks_ = 0;
+    using namespace std::placeholders;
+    preparationStage_ = std::make_unique<TaskPreparationStage>(0, 1, std::bind(&FileQueueUploaderPrivate::prepareTask, this, _1), [this] {
+        uploadEngineManager_->clearThreadData();
+        scriptsManager_->clearThreadData();
+    });
+    preparationStage_->setMaxOutstandingTasks(maxPreparedTasks());
     start();
 }
 
 FileQueueUploaderPrivate::~FileQueueUploaderPrivate() {
-    stopSignal_ = true;
-    threadCount_ = 0;
+    progressSampler_.stop();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        abortUploads_ = true;
+        stopSignal_ = true;
+        threadCount_ = 0;
+    }
+    preparationStage_->stop();
     queueCondition_.notify_all();
     for (auto& thread : threads_) {
         thread.join();
@@ -87,11 +104,19 @@ FileQueueUploaderPrivate::~FileQueueUploaderPrivate() {
 }
 
 bool FileQueueUploaderPrivate::onNeedStopHandler() {
-    return stopSignal_;
+    // Threads which quit after setMaxThreadCount() finish their current uploads
+    return abortUploads_;
 }
 
 void FileQueueUploaderPrivate::onErrorMessage(CUploader*, ErrorInfo ei)
 {
+    if (ei.messageType == ErrorInfo::mtError) {
+        static const char* const errorTypeNames[] = { "none", "other", "repeating", "retries_limit_reached", "action_repeating",
+            "action_retries_limit_reached", "regular_expression_error", "network_error", "user_error" };
+        const char* typeName = ei.errorType >= 0 && ei.errorType < static_cast<int>(std::size(errorTypeNames)) ? errorTypeNames[ei.errorType] : "unknown";
+        static MetricFamily<MetricCounter> uploadErrors("iu_upload_errors_total", "Number of upload errors by type", { "server", "type" });
+        uploadErrors.get({ ei.ServerName, typeName })->inc();
+    }
     uploadErrorHandler_->ErrorMessage(ei);
 }
 
@@ -111,6 +136,12 @@ void FileQueueUploaderPrivate::onTaskAdded(UploadSession*, UploadTask* task)
 
 void FileQueueUploaderPrivate::taskAdded(UploadTask* task)
 {
+    if (journal_) {
+        journal_->taskQueued(task);
+    }
+    if (TraceRecorder::isEnabled()) {
+        TraceRecorder::instance()->asyncBegin("queue", "Queue wait", task, { TraceRecorder::arg("task", task->title()) });
+    }
     queueUploader_->taskAdded(task);
 }
 
@@ -121,34 +152,39 @@ void FileQueueUploaderPrivate::OnConfigureNetworkClient(CUploader* uploader, INe
     }
 }
 
-std::shared_ptr<UploadTask> FileQueueUploaderPrivate::getNextJob() {
+std::shared_ptr<UploadTask> FileQueueUploaderPrivate::getNextJob(bool& prepared) {
     std::unique_lock<std::mutex> lck(queueMutex_);
     std::shared_ptr<UploadTask> task;
+    auto takeFrom = [&](std::deque<std::shared_ptr<UploadTask>>& queue) {
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (canAcceptUploadTask(it->get())) {
+                task = *it;
+                queue.erase(it);
+                return true;
+            }
+        }
+        return false;
+    };
     queueCondition_.wait(lck, [&]{
         if (stopSignal_) {
             return true;
         }
-        if (queue_.empty()) {
+        if (preparedTasks_.empty() && readyChildTasks_.empty()) {
             return false;
         }
-
-
-        for (auto it = queue_.begin(); it != queue_.end(); ++it) {
-            if (canAcceptUploadTask(it->get())) {
-                //std::shared_ptr<UploadTask> res = *it;
-                task = *it;
-                queue_.erase(it);
-                //res->setStatus(UploadTask::StatusPostponed);
-
-                //return res;
-                return true;
-            }
+        // Child tasks (thumbnails, url shortening) are dispatched before any new top-level task,
+        // so they are uploaded in parallel with their parent task
+        if (takeFrom(readyChildTasks_)) {
+            prepared = false;
+            return true;
         }
-
-        return false;
-        //return stopSignal_ || !queue_.empty();
+        prepared = takeFrom(preparedTasks_);
+        return prepared;
     });
+    updateQueueDepthMetric();
 
+    // stopSignal_ is changed only under queueMutex_, so a thread which has taken a task
+    // always uploads it and surplus threads quit with empty hands
     if (stopSignal_ && runningThreadsCount_ > threadCount_) {
         --runningThreadsCount_;
         if (runningThreadsCount_ == threadCount_) {
@@ -160,41 +196,49 @@ std::shared_ptr<UploadTask> FileQueueUploaderPrivate::getNextJob() {
 }
 
 void FileQueueUploaderPrivate::AddTaskToQueue(std::shared_ptr<UploadTask> task) {
-    {
-        std::unique_lock<std::mutex> lock(queueMutex_);
-        task->setUploadManager(queueUploader_);
-        queue_.push_back(task);
-    }
+    task->setUploadManager(queueUploader_);
+    progressSampler_.addTask(task);
     taskAdded(task.get());
-    queueCondition_.notify_all();
+    preparationStage_->push(task);
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    updateQueueDepthMetric();
 }
 
 void FileQueueUploaderPrivate::insertTaskAfter(UploadTask* after, std::shared_ptr<UploadTask> task) {
     {
+        // Child task has no other dependencies, so it is ready to run right now
         std::unique_lock<std::mutex> lock(queueMutex_);
-        auto it = std::find_if(queue_.begin(), queue_.end(), [](std::shared_ptr<UploadTask> t) { return t->parentTask() == nullptr; });
-        if (it == queue_.end()) {
-            queue_.push_back(task);
-        } else {
-            queue_.insert(it, task);
-        }  
-        //queue_.push_front(task);
+        readyChildTasks_.push_back(task);
+        updateQueueDepthMetric();
     }
+    progressSampler_.addTask(task);
     taskAdded(task.get());
     queueCondition_.notify_one();
 }
 
 bool FileQueueUploaderPrivate::removeTaskFromQueue(UploadTask* task) {
     std::unique_lock<std::mutex> lock(queueMutex_);
+    if (!task->parentTask() && preparationStage_->remove(task)) {
+        updateQueueDepthMetric();
+        return true;
+    }
 
-    auto it = std::find_if(queue_.begin(), queue_.end(), [task](const std::shared_ptr<UploadTask>& t)
+    auto& queue = task->parentTask() ? readyChildTasks_ : preparedTasks_;
+    auto it = std::find_if(queue.begin(), queue.end(), [task](const std::shared_ptr<UploadTask>& t)
     {
         return t.get() == task;
     });
-    if (it != queue_.end()) {
-        queue_.erase(it);
+    if (it != queue.end()) {
+        std::shared_ptr<UploadTask> removedTask = *it;
+        queue.erase(it);
+        updateQueueDepthMetric();
         lock.unlock();
         //queueCondition_.notify_one();
+        if (!task->parentTask()) {
+            // Prepared task is already running, nobody else would finish it
+            preparationStage_->release();
+            removedTask->finishTask(UploadTask::StatusStopped);
+        }
         return true;
     }
     
@@ -209,6 +253,7 @@ void FileQueueUploaderPrivate::AddSingleTask(std::shared_ptr<UploadTask> task) {
 
 void FileQueueUploaderPrivate::AddSession(std::shared_ptr<UploadSession> uploadSession)
 {
+    progressSampler_.addSession(uploadSession);
     addSessionToQueue(uploadSession);
 
     sessionsMutex_.lock();
@@ -220,19 +265,17 @@ void FileQueueUploaderPrivate::AddSession(std::shared_ptr<UploadSession> uploadS
 void FileQueueUploaderPrivate::addSessionToQueue(std::shared_ptr<UploadSession> uploadSession) {
     //uploadSession->addTaskAddedCallback(UploadSession::TaskAddedCallback(this, &FileQueueUploaderPrivate::onTaskAdded));
     int count = uploadSession->taskCount();
-    {
-        std::unique_lock<std::mutex> lock(queueMutex_);
-
-        for (int i = 0; i < count; i++) {
-            auto task = uploadSession->getTask(i);
-            task->setUploadManager(queueUploader_);
-            if (task->status() == UploadTask::StatusInQueue) {
-                queue_.push_back(task);
-                taskAdded(task.get());
-            }
+    for (int i = 0; i < count; i++) {
+        auto task = uploadSession->getTask(i);
+        task->setUploadManager(queueUploader_);
+        if (task->status() == UploadTask::StatusInQueue) {
+            progressSampler_.addTask(task);
+            taskAdded(task.get());
+            preparationStage_->push(task);
         }
     }
-    queueCondition_.notify_all();
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    updateQueueDepthMetric();
 }
 
 void FileQueueUploaderPrivate::removeSession(std::shared_ptr<UploadSession> uploadSession)
@@ -242,6 +285,9 @@ void FileQueueUploaderPrivate::removeSession(std::shared_ptr<UploadSession> uplo
     if (it != sessions_.end() ) {
         sessions_.erase(it);
     }
+    if (journal_) {
+        journal_->sessionRemoved(uploadSession.get());
+    }
     startFromSession_ = 0;
 }
 
@@ -281,6 +327,7 @@ std::shared_ptr<UploadSession> FileQueueUploaderPrivate::session(int index)
 void FileQueueUploaderPrivate::start() {
     //std::lock_guard<std::recursive_mutex> lock(mutex_);
     stopSignal_ = false;
+    abortUploads_ = false;
    
     startThreads(threadCount_);
 }
@@ -297,24 +344,107 @@ void FileQueueUploaderPrivate::setMaxThreadCount(int threadCount) {
         return;
     }
     int oldThreadCount = threadCount_;
-
-    threadCount_ = threadCount;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        threadCount_ = threadCount;
+        if (threadCount < oldThreadCount) {
+            stopSignal_ = true;
+        }
+    }
 
     if (threadCount > oldThreadCount) {
         startThreads(threadCount - oldThreadCount);
     } else {
-        stopSignal_ = true;
         queueCondition_.notify_all();
     }
+    preparationStage_->setMaxOutstandingTasks(maxPreparedTasks());
+}
+
+void FileQueueUploaderPrivate::setMaxPreparedTasks(int count) {
+    maxPreparedTasks_ = count;
+    preparationStage_->setMaxOutstandingTasks(maxPreparedTasks());
+}
+
+int FileQueueUploaderPrivate::maxPreparedTasks() const {
+    if (maxPreparedTasks_ > 0) {
+        return maxPreparedTasks_;
+    }
+    // Each network thread has one task being uploaded and one ready to be uploaded next
+    return 2 * threadCount_ + preparationStage_->threadCount();
+}
+
+bool FileQueueUploaderPrivate::runPreUploadFilters(UploadTask* task) {
+    for (size_t i = 0; i < filters_.size(); i++) {
+        TraceSpan filterSpan("filters", filters_[i]->name());
+        if (!filters_[i]->PreUpload(task)) { // ServerProfile can be changed in PreUpload filters
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileQueueUploaderPrivate::prepareTask(const std::shared_ptr<UploadTask>& task) {
+    TraceRecorder::instance()->asyncEnd("queue", "Queue wait", task.get());
+    std::shared_ptr<UploadSession> sessionHolder = task->session() ? task->session()->weak_from_this().lock() : nullptr;
+    task->setUploadManager(queueUploader_);
+    task->setStatus(UploadTask::StatusRunning);
+    if (journal_) {
+        journal_->taskStarted(task.get());
+    }
+    std::string initialServerName = task->serverName();
+    if (!runPreUploadFilters(task.get())) {
+        task->deletePostponedChilds(); // delete thumbnail
+        task->finishTask(UploadTask::StatusFailure);
+        return false;
+    }
+    if (task->stopSignal()) {
+        task->finishTask(UploadTask::StatusStopped);
+        return false;
+    }
+    if (initialServerName != task->serverName()) {
+        // Filters are applied again to the original file, with settings of the new server
+        auto fileTask = dynamic_cast<FileUploadTask*>(task.get());
+        if (fileTask) {
+            fileTask->setFileName(fileTask->originalFileName());
+        }
+        task->setStatus(UploadTask::StatusInQueue);
+        AddTaskToQueue(task);
+        return false;
+    }
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        preparedTasks_.push_back(task);
+        updateQueueDepthMetric();
+    }
+    queueCondition_.notify_all();
+    return true;
 }
 void FileQueueUploaderPrivate::run()
 {
     for (;;) {
-        auto it = getNextJob();
+        bool prepared = false;
+        auto it = getNextJob(prepared);
 
         if (!it) {
             break;
         }
+        // Slot of the preparation stage stays occupied until the prepared task leaves the network thread
+        defer<void> preparedSlotGuard([this, prepared] {
+            if (prepared) {
+                preparationStage_->release();
+            }
+        });
+        if (!prepared) {
+            TraceRecorder::instance()->asyncEnd("queue", "Queue wait", it.get());
+        }
+        // Session may be removed from the uploader in its finished callback,
+        // keep it alive until the task is processed
+        std::shared_ptr<UploadSession> sessionHolder = it->session() ? it->session()->weak_from_this().lock() : nullptr;
+        TraceSpan taskSpan("upload", "Upload task");
+        if (taskSpan.isActive()) {
+            taskSpan.addArg("task", it->title());
+            taskSpan.addArg("server", it->serverName());
+        }
 
         CUploader uploader(networkClientFactory_);
         using namespace std::placeholders;
@@ -329,6 +459,9 @@ void FileQueueUploaderPrivate::run()
         auto topLevelFileTask = dynamic_cast<FileUploadTask*>(topLevelTask);
         it->setUploadManager(queueUploader_);
         it->setStatus(UploadTask::StatusRunning);
+        if (journal_ && !prepared) {
+            journal_->taskStarted(it.get());
+        }
         mutex_.lock();
         serverThreads_[it->serverName()].waitingFileCount--;
         std::string initialServerName = it->serverName();
@@ -337,32 +470,29 @@ void FileQueueUploaderPrivate::run()
         mutex_.unlock();
 
         bool res = true;
-        for (size_t i = 0; i < filters_.size(); i++) {
-            res = res && filters_[i]->PreUpload(it.get()); // ServerProfile can be changed in PreUpload filters
-        }
-        if (!res)
-        {
-            it->deletePostponedChilds(); // delete thumbnail
-            it->finishTask(UploadTask::StatusFailure);
-            continue;
-        }
-
-        /*if (it->schedulePostponedChilds()) {
-            startFromSession_ = 0;
-            //start();
-        }*/
-
-        std::string serverName = it->serverName();
+        // Top-level tasks have been prepared by the preparation stage, filters of child tasks are cheap
+        if (!prepared) {
+            res = runPreUploadFilters(it.get());
+            if (!res)
+            {
+                it->deletePostponedChilds(); // delete thumbnail
+                it->finishTask(UploadTask::StatusFailure);
+                decrementThreadCount(initialServerName);
+                continue;
+            }
 
-        if (initialServerName != serverName) {
-            if (fut) {
-                fut->setFileName(fut->originalFileName());
+            if (initialServerName != it->serverName()) {
+                if (fut) {
+                    fut->setFileName(fut->originalFileName());
+                }
+                it->setStatus(UploadTask::StatusInQueue);
+                AddTaskToQueue(it);
+                decrementThreadCount(initialServerName);
+                continue;
             }
-            it->setStatus(UploadTask::StatusInQueue);
-            AddTaskToQueue(it);
-            decrementThreadCount(initialServerName);
-            continue;
         }
+
+        std::string serverName = it->serverName();
         
         std::string  profileName = it->serverProfile().profileName();
 
@@ -390,7 +520,12 @@ void FileQueueUploaderPrivate::run()
         it->setStatusText(tr("Starting upload"));
         bool dec = false;
         try {
-            res = uploader.Upload(it);
+            {
+                static MetricGauge* uploadsInFlight = MetricsRegistry::instance()->gauge("iu_uploads_in_flight", "Number of running uploads");
+                uploadsInFlight->inc();
+                defer<void> inFlightGuard([] { uploadsInFlight->dec(); });
+                res = uploader.Upload(it);
+            }
 
             it->setUploadSuccess(res);
             if (!res && uploader.isFatalError()) {
@@ -425,6 +560,13 @@ void FileQueueUploaderPrivate::run()
             if (it->stopSignal()) {
                 st = UploadTask::StatusStopped;
             }
+            const char* resultName = st == UploadTask::StatusFinished ? "success" : st == UploadTask::StatusStopped ? "stopped" : "failure";
+            static MetricFamily<MetricCounter> uploadsTotal("iu_uploads_total", "Number of finished uploads", { "server", "result" });
+            static MetricFamily<MetricCounter> uploadBytes("iu_upload_bytes_total", "Number of successfully uploaded bytes", { "server" });
+            uploadsTotal.get({ serverName, resultName })->inc();
+            if (res) {
+                uploadBytes.get({ serverName })->inc(it->getDataLength());
+            }
             decrementThreadCount(serverName);
             engine->serverSync()->decrementThreadCount();
             dec = true;
@@ -448,6 +590,11 @@ void FileQueueUploaderPrivate::run()
     scriptsManager_->clearThreadData();
 }
 
+void FileQueueUploaderPrivate::updateQueueDepthMetric() {
+    static MetricGauge* queueDepth = MetricsRegistry::instance()->gauge("iu_queue_depth", "Number of tasks waiting in the upload queue");
+    queueDepth->set(static_cast<int64_t>(preparationStage_->stats().queuedTasks + preparedTasks_.size() + readyChildTasks_.size()));
+}
+
 void FileQueueUploaderPrivate::decrementThreadCount(const std::string& serverName) {
     std::lock_guard<std::recursive_mutex> lk2(serverThreadsMutex_);
     serverThreads_[serverName].runningThreads--;
@@ -459,17 +606,35 @@ void FileQueueUploaderPrivate::stopSession(UploadSession* uploadSession) {
         tasksToRemove.insert(task.get());
     }
 
+    std::vector<std::shared_ptr<UploadTask>> preparedTasksToStop;
     {
         std::unique_lock<std::mutex> lock(queueMutex_);
-        for (auto it = queue_.begin(); it != queue_.end();) {
+        preparationStage_->removeIf([&tasksToRemove](UploadTask* task) {
+            return tasksToRemove.find(task) != tasksToRemove.end();
+        });
+        for (auto it = preparedTasks_.begin(); it != preparedTasks_.end();) {
             if (tasksToRemove.find(it->get()) != tasksToRemove.end()) {
-                it = queue_.erase(it);
+                preparedTasksToStop.push_back(*it);
+                it = preparedTasks_.erase(it);
             }
             else {
                 ++it;
             }
         }
+        for (auto it = readyChildTasks_.begin(); it != readyChildTasks_.end();) {
+            UploadTask* parent = (*it)->parentTask();
+            if (parent && tasksToRemove.find(parent) != tasksToRemove.end()) {
+                it = readyChildTasks_.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 
     uploadSession->stop(false);
+    // Prepared tasks are already running, they are not finished by stop()
+    for (const auto& task : preparedTasksToStop) {
+        preparationStage_->release();
+        task->finishTask(UploadTask::StatusStopped);
+    }
 }
\ No newline at end of file
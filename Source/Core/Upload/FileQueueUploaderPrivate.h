@@ -8,6 +8,8 @@
 #include "UploadTask.h"
 #include "FileQueueUploader.h"
 #include "ServerSync.h"
+#include "UploadProgressSampler.h"
+#include "TaskPreparationStage.h"
 
 #include "Core/Scripting/ScriptsManager.h"
 #include "Core/Upload/UploadErrorHandler.h"
@@ -15,6 +17,7 @@
 class CUploader;
 class CAbstractUploadEngine;
 class CFileQueueUploader;
+class UploadJournal;
 
 struct ServerThreadsInfo {
     //int maxThreads;
@@ -49,7 +52,10 @@ public:
     virtual ~FileQueueUploaderPrivate();
     
     virtual void run();
-    std::shared_ptr<UploadTask> getNextJob();
+    /**
+     * @param prepared is set to true if the task has passed the preparation stage
+     */
+    std::shared_ptr<UploadTask> getNextJob(bool& prepared);
     void AddSingleTask(std::shared_ptr<UploadTask> task);
     void AddSession(std::shared_ptr<UploadSession> uploadSession);
     void AddTaskToQueue(std::shared_ptr<UploadTask> task);
@@ -60,11 +66,14 @@ public:
     void removeUploadFilter(UploadFilter* filter);
     void retrySession(std::shared_ptr<UploadSession> uploadSession);
     void setMaxThreadCount(int threadCount);
+    void setMaxPreparedTasks(int count);
     void stopSession(UploadSession* uploadSession);
     int sessionCount();
     std::shared_ptr<UploadSession> session(int index);
     CFileQueueUploader *queueUploader_;
     volatile bool stopSignal_;
+    // Set when the uploader is stopped, unlike stopSignal_ it is not set when the number of threads is reduced
+    volatile bool abortUploads_;
     bool isRunning_;
     std::vector<std::shared_ptr<UploadSession>> sessions_;
     std::recursive_mutex sessionsMutex_;
@@ -83,19 +92,32 @@ protected:
     void onTaskAdded(UploadSession*, UploadTask*);
     void addSessionToQueue(std::shared_ptr<UploadSession> uploadSession);
     void startThreads(int count);
+    // Runs in the threads of the preparation stage
+    bool prepareTask(const std::shared_ptr<UploadTask>& task);
+    bool runPreUploadFilters(UploadTask* task);
+    int maxPreparedTasks() const;
     std::recursive_mutex mutex_;
     std::recursive_mutex callMutex_;
-    std::deque<std::shared_ptr<UploadTask>> queue_;
+    std::unique_ptr<TaskPreparationStage> preparationStage_;
+    // Top-level tasks which have passed PreUpload filters and wait for a network thread
+    std::deque<std::shared_ptr<UploadTask>> preparedTasks_;
+    int maxPreparedTasks_; // 0 - depends on the number of threads
+    // Child tasks whose parent has already been prepared (all dependencies are satisfied)
+    std::deque<std::shared_ptr<UploadTask>> readyChildTasks_;
     std::mutex queueMutex_;
     std::condition_variable queueCondition_;
     void taskAdded(UploadTask* task);
     void decrementThreadCount(const std::string& serverName);
+    // Should be called with queueMutex_ locked
+    void updateQueueDepthMetric();
     
     int startFromSession_;
     UploadEngineManager* uploadEngineManager_;
     ScriptsManager* scriptsManager_; 
     std::shared_ptr<IUploadErrorHandler> uploadErrorHandler_;
     std::shared_ptr<INetworkClientFactory> networkClientFactory_;
+    std::shared_ptr<UploadJournal> journal_;
+    UploadProgressSampler progressSampler_;
     std::function<void(CFileQueueUploader*)> onQueueFinishedCallback_;
     std::function<void(UploadSession*)> onSessionAddedCallback_;
     std::function<void(UploadTask*)> onTaskAddedCallback_;
@@ -1,12 +1,24 @@
 #include "ImageConverterFilter.h"
 
-#include "Func/IuCommonFunctions.h"
 #include "Core/Logging.h"
 #include "Core/Images/ImageConverter.h"
 #include "Core/Upload/FileUploadTask.h"
 #include "Core/CommonDefs.h"
 #include "Core/i18n/Translator.h"
+#include "Core/Upload/ServerProfile.h"
+#include "Core/Upload/UploadEngine.h"
+#include "Core/Utils/CoreUtils.h"
+#ifdef _WIN32
+#include "Func/IuCommonFunctions.h"
 #include "Core/Settings/WtlGuiSettings.h"
+#else
+#include "Core/Images/ImageCodec.h"
+#endif
+
+void ImageConverterFilter::setImageConvertingParams(const ImageConvertingParams& params)
+{
+    imageConvertingParams_ = params;
+}
 
 bool ImageConverterFilter::PreUpload(UploadTask* task)
 {
@@ -18,13 +30,19 @@ bool ImageConverterFilter::PreUpload(UploadTask* task)
     {
         return true;
     }
+#ifdef _WIN32
     if (!IuCommonFunctions::IsImage(IuCoreUtils::Utf8ToWstring(fileTask->getFileName()).c_str()))
+#else
+    if (ImageCodec::formatFromExtension(fileTask->getFileName()) == ImageCodec::Format::Unknown)
+#endif
     {
         return true;
     }
     ImageConverter imageConverter;
-    Thumbnail thumb;
     ImageUploadParams imageUploadParams = task->serverProfile().getImageUploadParams();
+#ifdef _WIN32
+    // Thumbnail templates are drawn only by the GDI+ converter
+    Thumbnail thumb;
     CString templateName = U2W(imageUploadParams.getThumb().TemplateName);
     if (templateName.IsEmpty()) {
         templateName = _T("default");
@@ -37,14 +55,22 @@ bool ImageConverterFilter::PreUpload(UploadTask* task)
         LOG(ERROR) << TR("Couldn't load thumbnail preset!") + CString(_T("\r\n")) + thumbTemplateFileName;
         return false;
     }
+    imageConverter.setThumbnail(&thumb);
+#endif
     task->setStatusText(_("Preparing image..."));
     imageConverter.setEnableProcessing(imageUploadParams.ProcessImages);
-    auto* settings = ServiceLocator::instance()->settings<WtlGuiSettings>();
-    imageConverter.setImageConvertingParams(settings->ConvertProfiles[U2W(imageUploadParams.ImageProfileName)]);
+    if (imageConvertingParams_) {
+        imageConverter.setImageConvertingParams(*imageConvertingParams_);
+    }
+#ifdef _WIN32
+    else {
+        auto* settings = ServiceLocator::instance()->settings<WtlGuiSettings>();
+        imageConverter.setImageConvertingParams(settings->ConvertProfiles[U2W(imageUploadParams.ImageProfileName)]);
+    }
+#endif
     imageConverter.setThumbCreatingParams(imageUploadParams.getThumb());
     bool genThumbs = imageUploadParams.CreateThumbs &&
         ((!imageUploadParams.UseServerThumbs) || (!task->serverProfile().uploadEngineData()->SupportThumbnails));
-    imageConverter.setThumbnail(&thumb);
     imageConverter.setGenerateThumb(genThumbs);
     if (imageConverter.convert(fileTask->getFileName())) {
         
@@ -1,12 +1,26 @@
 #ifndef IU_CORE_IMAGECONVERTERFILTER_H
 #define IU_CORE_IMAGECONVERTERFILTER_H
 
+#include <optional>
+
 #include "Core/Upload/UploadFilter.h"
+#include "Core/Images/ImageConverter.h"
 
 class ImageConverterFilter : public UploadFilter
 {
 public:
     bool PreUpload(UploadTask* task) override;
     bool PostUpload(UploadTask* task) override;
+    const char* name() const override {
+        return "ImageConverterFilter";
+    }
+
+    /**
+     * Overrides the conversion profile of the server profile (the only source of parameters
+     * when there are no GUI settings, e.g. in the console application).
+     */
+    void setImageConvertingParams(const ImageConvertingParams& params);
+private:
+    std::optional<ImageConvertingParams> imageConvertingParams_;
 };
-#endif
\ No newline at end of file
+#endif
@@ -17,6 +17,9 @@ public:
     explicit SizeExceedFilter(CUploadEngineList* engineList, UploadEngineManager* uploadEngineManager);
     bool PreUpload(UploadTask* task) override;
     bool PostUpload(UploadTask* task) override;
+    const char* name() const override {
+        return "SizeExceedFilter";
+    }
 protected:
     CUploadEngineList* engineList_;
     UploadEngineManager* uploadEngineManager_;
@@ -8,5 +8,8 @@ class UrlShorteningFilter : public UploadFilter
 public:
     bool PreUpload(UploadTask* task) override;
     bool PostUpload(UploadTask* task) override;
+    const char* name() const override {
+        return "UrlShorteningFilter";
+    }
 };
 #endif
\ No newline at end of file
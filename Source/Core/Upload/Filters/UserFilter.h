@@ -10,6 +10,9 @@ public:
     UserFilter(ScriptsManager* scriptsManager);
     bool PreUpload(UploadTask* task) override;
     bool PostUpload(UploadTask* task) override;
+    const char* name() const override {
+        return "UserFilter";
+    }
 protected:
     ScriptsManager* scriptsManager_;
 
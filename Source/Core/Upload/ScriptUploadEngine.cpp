@@ -53,6 +53,9 @@ void CScriptUploadEngine::PrintCallback(const std::string& output)
 }
 
 int CScriptUploadEngine::doProcessTask(std::shared_ptr<UploadTask> task, UploadParams& params) {
+    defer<void> profileFlusher([this] {
+        flushProfile();
+    });
     if (task->type() == UploadTask::TypeAuth) {
         return processAuthTask(task);
     } if (task->type() == UploadTask::TypeTest) {
@@ -226,6 +229,7 @@ bool CScriptUploadEngine::preLoad()
         Sqrat::RootTable& rootTable = vm_.GetRootTable();
         rootTable.SetInstance("ServerParams", par);
         rootTable.SetInstance("Sync", serverSync_);
+        initNetworkClientPool();
     } catch (std::exception& e) {
         Log(ErrorInfo::mtError, "CScriptUploadEngine::preLoad failed\r\n" + std::string("Error: ") + e.what());
         return false;
@@ -493,6 +497,19 @@ void CScriptUploadEngine::setNetworkClient(INetworkClient* nm)
     //BindVariable(m_Object, nm, "nm");
 }
 
+void CScriptUploadEngine::configureNetworkClient(INetworkClient* client)
+{
+    Script::configureNetworkClient(client);
+    if (!m_UploadData->UserAgent.empty()) {
+        client->setUserAgent(m_UploadData->UserAgent);
+    }
+    client->setLogger(this);
+    // Requests of pool clients are aborted together with the upload
+    client->setProgressCallback([this](INetworkClient*, double, double, double, double) {
+        return needStop() ? -1 : 0;
+    });
+}
+
 bool CScriptUploadEngine::supportsSettings()
 {
     using namespace Sqrat;
@@ -75,6 +75,7 @@ class CScriptUploadEngine : public CAdvancedUploadEngine,
         int refreshToken();
         bool preLoad() override;
         bool postLoad() override;
+        void configureNetworkClient(INetworkClient* client) override;
         void logNetworkError(bool error, const std::string & msg) override;
         bool functionExists(const std::string& name);
         int checkAuth();
@@ -1,7 +1,9 @@
 ﻿#include "ServerSync.h"
 
 #include "Core/Logging.h"
+#include "Core/Logging/TraceRecorder.h"
 #include "Core/ThreadSyncPrivate.h"
+#include "AuthTokenCache.h"
 #include <map>
 #include <atomic>
 
@@ -15,34 +17,43 @@ public:
     std::mutex  constVarsMutex_;
     std::mutex  folderMutex_;
     std::mutex refreshTokenMutex_;
+    std::shared_ptr<AuthTokenCache> authTokenCache_;
+    std::string serverName_;
+    std::atomic<bool> authRestored_;
 };
 ServerSync::ServerSync() : ThreadSync(new ServerSyncPrivate())
 {
     MY_D(ServerSync);
     d->authPerformed_ = false;
     d->authPerformedSuccess_ = false;
+    d->authRestored_ = false;
 }
 
 bool ServerSync::beginAuth()
 {
     MY_D(ServerSync);
-    try {
-        d->loginMutex_.lock();
-    } catch (std::exception& ex) {
-        LOG(ERROR) << "ServerSync::beginLogin exception: " << ex.what();
-        return false;
+    {
+        TraceSpan waitSpan("auth", "ServerSync::beginAuth");
+        try {
+            d->loginMutex_.lock();
+        } catch (std::exception& ex) {
+            LOG(ERROR) << "ServerSync::beginLogin exception: " << ex.what();
+            return false;
+        }
     }
     if (d->authPerformed_ && !d->authPerformedSuccess_)
     {
         d->loginMutex_.unlock();
         throw ServerSyncException("Upload aborted: Authentication failed");
     }
+    TraceRecorder::instance()->beginEvent("auth", "Authentication");
     return true;
 }
 
 bool ServerSync::endAuth()
 {
     MY_D(ServerSync);
+    TraceRecorder::instance()->endEvent("auth", "Authentication");
     try
     {
         d->loginMutex_.unlock();
@@ -73,6 +84,7 @@ void ServerSync::resetAuthorization()
     MY_D(ServerSync);
     d->authPerformed_ = false;
     d->authPerformedSuccess_ = false;
+    d->authRestored_ = false;
 }
 
 void ServerSync::resetFailedAuthorization()
@@ -104,6 +116,76 @@ std::string ServerSync::getConstVar(const std::string& name)
     return std::string();
 }
 
+void ServerSync::setAuthTokenCache(std::shared_ptr<AuthTokenCache> cache, const std::string& serverName)
+{
+    MY_D(ServerSync);
+    d->authTokenCache_ = std::move(cache);
+    d->serverName_ = serverName;
+}
+
+bool ServerSync::restoreAuth(const std::string& login, const std::string& password)
+{
+    MY_D(ServerSync);
+    std::map<std::string, std::string> vars;
+    if (!d->authTokenCache_ || !d->authTokenCache_->get(d->serverName_, login, password, vars) || vars.empty()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(d->constVarsMutex_);
+        for (const auto& var : vars) {
+            d->constVars_[var.first] = var.second;
+        }
+    }
+    setAuthPerformed(true);
+    d->authRestored_ = true;
+    return true;
+}
+
+void ServerSync::saveAuth(const std::string& login, const std::string& password)
+{
+    MY_D(ServerSync);
+    d->authRestored_ = false;
+    if (!d->authTokenCache_) {
+        return;
+    }
+    std::map<std::string, std::string> vars;
+    {
+        std::lock_guard<std::mutex> lock(d->constVarsMutex_);
+        vars = d->constVars_;
+    }
+    if (vars.empty()) {
+        return;
+    }
+    if (!d->authTokenCache_->put(d->serverName_, login, password, vars)) {
+        LOG(WARNING) << "Cannot save authentication tokens for " << d->serverName_;
+    }
+}
+
+bool ServerSync::isAuthRestored()
+{
+    MY_D(ServerSync);
+    return d->authRestored_;
+}
+
+bool ServerSync::invalidateRestoredAuth(const std::string& login)
+{
+    MY_D(ServerSync);
+    // Serialized with logins, so a session obtained by a new login is never dropped here
+    std::lock_guard<std::mutex> loginLock(d->loginMutex_);
+    if (!d->authRestored_) {
+        return false;
+    }
+    if (d->authTokenCache_) {
+        d->authTokenCache_->remove(d->serverName_, login);
+    }
+    {
+        std::lock_guard<std::mutex> lock(d->constVarsMutex_);
+        d->constVars_.clear();
+    }
+    resetAuthorization();
+    return true;
+}
+
 std::mutex& ServerSync::folderMutex() {
     MY_D(ServerSync);
     return d->folderMutex_;
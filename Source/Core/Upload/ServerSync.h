@@ -11,6 +11,7 @@
 
 class ServerSyncPrivate;
 class ThreadSyncPrivate;
+class AuthTokenCache;
 
 class ServerSyncException : public std::runtime_error {
 public:
@@ -38,6 +39,26 @@ class ServerSync: public ThreadSync
         void resetFailedAuthorization();
         void setConstVar(const std::string& name, const std::string& value);
         std::string getConstVar(const std::string& name);
+
+        void setAuthTokenCache(std::shared_ptr<AuthTokenCache> cache, const std::string& serverName);
+
+        /**
+        Restores variables saved by a login in a previous run, if found, authentication
+        is considered performed. Must be called between beginAuth() and endAuth().
+        */
+        bool restoreAuth(const std::string& login, const std::string& password);
+
+        /**
+        Saves variables obtained by a successful login. Sessions kept only in cookies are not saved.
+        */
+        void saveAuth(const std::string& login, const std::string& password);
+        bool isAuthRestored();
+
+        /**
+        Forgets the restored session after a request using it has failed.
+        @return false if the session has already been replaced by a new login
+        */
+        bool invalidateRestoredAuth(const std::string& login);
         std::mutex& folderMutex();
         std::mutex& refreshTokenMutex();
         std::mutex& loginMutex();
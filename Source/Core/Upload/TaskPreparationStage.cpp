@@ -0,0 +1,175 @@
+#include "TaskPreparationStage.h"
+
+#include <algorithm>
+
+#include "Core/Metrics/MetricsRegistry.h"
+#include "Core/Upload/UploadTask.h"
+
+TaskPreparationStage::TaskPreparationStage(int threadCount, int maxOutstandingTasks, PrepareCallback callback,
+    std::function<void()> threadExitCallback) :
+    callback_(std::move(callback)),
+    threadExitCallback_(std::move(threadExitCallback)),
+    busyThreads_(0),
+    outstandingTasks_(0),
+    maxOutstandingTasks_(std::max(1, maxOutstandingTasks)),
+    preparedTotal_(0),
+    backpressureWaits_(0),
+    reportedBusyThreads_(0),
+    reportedOutstandingTasks_(0),
+    stop_(false)
+{
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < threadCount; i++) {
+        threads_.emplace_back(&TaskPreparationStage::worker, this);
+    }
+}
+
+TaskPreparationStage::~TaskPreparationStage()
+{
+    stop();
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Slots of tasks which are still being uploaded are not counted anymore
+    busyThreads_ = 0;
+    outstandingTasks_ = 0;
+    updateMetrics();
+}
+
+void TaskPreparationStage::push(std::shared_ptr<UploadTask> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(task));
+    }
+    condition_.notify_one();
+}
+
+bool TaskPreparationStage::remove(UploadTask* task)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(queue_.begin(), queue_.end(), [task](const std::shared_ptr<UploadTask>& t) {
+        return t.get() == task;
+    });
+    if (it == queue_.end()) {
+        return false;
+    }
+    queue_.erase(it);
+    return true;
+}
+
+void TaskPreparationStage::removeIf(const std::function<bool(UploadTask*)>& predicate)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(), [&predicate](const std::shared_ptr<UploadTask>& t) {
+        return predicate(t.get());
+    }), queue_.end());
+}
+
+void TaskPreparationStage::release()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstandingTasks_--;
+        updateMetrics();
+    }
+    condition_.notify_one();
+}
+
+void TaskPreparationStage::setMaxOutstandingTasks(int count)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxOutstandingTasks_ = std::max(1, count);
+    }
+    condition_.notify_all();
+}
+
+int TaskPreparationStage::threadCount() const
+{
+    return static_cast<int>(threads_.size());
+}
+
+TaskPreparationStage::Stats TaskPreparationStage::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats result;
+    result.threadCount = static_cast<int>(threads_.size());
+    result.busyThreads = busyThreads_;
+    result.queuedTasks = static_cast<int>(queue_.size());
+    result.outstandingTasks = outstandingTasks_;
+    result.maxOutstandingTasks = maxOutstandingTasks_;
+    result.preparedTotal = preparedTotal_;
+    result.backpressureWaits = backpressureWaits_;
+    return result;
+}
+
+void TaskPreparationStage::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            return;
+        }
+        stop_ = true;
+    }
+    condition_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void TaskPreparationStage::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        bool stalled = false;
+        while (!stop_ && (queue_.empty() || outstandingTasks_ >= maxOutstandingTasks_)) {
+            if (!queue_.empty() && !stalled) {
+                stalled = true;
+                backpressureWaits_++;
+            }
+            condition_.wait(lock);
+        }
+        if (stop_) {
+            break;
+        }
+        std::shared_ptr<UploadTask> task = std::move(queue_.front());
+        queue_.pop_front();
+        outstandingTasks_++;
+        busyThreads_++;
+        updateMetrics();
+        lock.unlock();
+
+        bool passed = callback_(task);
+        task.reset();
+
+        lock.lock();
+        busyThreads_--;
+        if (passed) {
+            preparedTotal_++;
+        } else {
+            outstandingTasks_--;
+            // Another thread may be waiting for the slot
+            condition_.notify_one();
+        }
+        updateMetrics();
+    }
+    lock.unlock();
+    if (threadExitCallback_) {
+        threadExitCallback_();
+    }
+}
+
+void TaskPreparationStage::updateMetrics()
+{
+    // Gauges are shared by all uploaders of the process, each instance adds its own changes
+    static MetricGauge* busyThreads = MetricsRegistry::instance()->gauge("iu_preparation_busy_threads",
+        "Number of threads running PreUpload filters");
+    static MetricGauge* outstandingTasks = MetricsRegistry::instance()->gauge("iu_preparation_outstanding_tasks",
+        "Number of prepared tasks which have not been uploaded yet");
+    busyThreads->inc(busyThreads_ - reportedBusyThreads_);
+    outstandingTasks->inc(outstandingTasks_ - reportedOutstandingTasks_);
+    reportedBusyThreads_ = busyThreads_;
+    reportedOutstandingTasks_ = outstandingTasks_;
+}
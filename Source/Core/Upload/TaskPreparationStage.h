@@ -0,0 +1,101 @@
+#ifndef IU_CORE_UPLOAD_TASKPREPARATIONSTAGE_H
+#define IU_CORE_UPLOAD_TASKPREPARATIONSTAGE_H
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Core/Utils/CoreTypes.h"
+
+class UploadTask;
+
+/**
+@brief TaskPreparationStage runs CPU-bound preparation of upload tasks (PreUpload filters:
+image conversion, thumbnails) in its own thread pool, ahead of the network threads.
+
+Each task taken for preparation occupies a slot until the network stage calls release().
+The number of slots limits how many prepared tasks (and their temporary files) may exist
+at the same time, a preparation thread waits for a free slot before taking the next task.
+*/
+class TaskPreparationStage {
+public:
+    struct Stats {
+        int threadCount = 0;
+        int busyThreads = 0; // threads running preparation
+        int queuedTasks = 0; // tasks waiting for preparation
+        int outstandingTasks = 0; // occupied slots
+        int maxOutstandingTasks = 0;
+        int64_t preparedTotal = 0;
+        int64_t backpressureWaits = 0; // how many times a thread had to wait for a free slot
+    };
+
+    /**
+     * Prepares the task, called in a preparation thread. Returns true if the task has been
+     * passed to the network stage (the slot stays occupied until release() is called),
+     * false if the task has been finished or re-queued (the slot is freed).
+     */
+    using PrepareCallback = std::function<bool(const std::shared_ptr<UploadTask>&)>;
+
+    /**
+     * @param threadCount 0 means the number of CPU cores
+     * @param threadExitCallback is called in each preparation thread before it exits
+     */
+    TaskPreparationStage(int threadCount, int maxOutstandingTasks, PrepareCallback callback,
+        std::function<void()> threadExitCallback = {});
+    ~TaskPreparationStage();
+
+    void push(std::shared_ptr<UploadTask> task);
+
+    /**
+     * Removes the task from the queue if its preparation has not started yet.
+     */
+    bool remove(UploadTask* task);
+
+    /**
+     * Removes all queued tasks matching the predicate.
+     */
+    void removeIf(const std::function<bool(UploadTask*)>& predicate);
+
+    /**
+     * Frees the slot of a task passed to the network stage.
+     */
+    void release();
+
+    void setMaxOutstandingTasks(int count);
+    int threadCount() const;
+    Stats stats() const;
+
+    /**
+     * Stops threads, tasks which are not being prepared stay in the queue.
+     */
+    void stop();
+private:
+    void worker();
+    void updateMetrics();
+
+    PrepareCallback callback_;
+    std::function<void()> threadExitCallback_;
+    std::deque<std::shared_ptr<UploadTask>> queue_;
+    std::vector<std::thread> threads_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    int busyThreads_;
+    int outstandingTasks_;
+    int maxOutstandingTasks_;
+    int64_t preparedTotal_;
+    int64_t backpressureWaits_;
+    // Values added to the process-wide gauges by this instance
+    int reportedBusyThreads_;
+    int reportedOutstandingTasks_;
+    bool stop_;
+    DISALLOW_COPY_AND_ASSIGN(TaskPreparationStage);
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include "Core/Upload/AuthTokenCache.h"
+#include "Core/Upload/DefaultUploadEngine.h"
+#include "Core/Upload/ServerSync.h"
+#include "Core/Upload/FileUploadTask.h"
+#include "Core/Network/Tests/NetworkClientMock.h"
+#include "Core/Utils/CoreUtils.h"
+#include "Tests/TestHelpers.h"
+
+using namespace ::testing;
+
+namespace {
+
+/**
+ * Answers requests of the mock network client like a server with session ids
+ */
+class FakeServer {
+public:
+    explicit FakeServer(NiceMock<MockINetworkClient>& networkClient) {
+        ON_CALL(networkClient, setUrl(_)).WillByDefault(Invoke([this](const std::string& url) {
+            url_ = url;
+        }));
+        ON_CALL(networkClient, doPost(_)).WillByDefault(Invoke([this](const std::string&) {
+            return request();
+        }));
+        ON_CALL(networkClient, doUploadMultipartData()).WillByDefault(Invoke([this] {
+            return request();
+        }));
+        ON_CALL(networkClient, responseCode()).WillByDefault(Invoke([this] {
+            return responseCode_;
+        }));
+        ON_CALL(networkClient, responseBody()).WillByDefault(Invoke([this] {
+            return responseBody_;
+        }));
+    }
+
+    // Sessions issued before are rejected, like after a server restart
+    void expireSessions() {
+        sessionNumber_++;
+    }
+
+    int loginCount = 0;
+    int uploadCount = 0;
+    // Number of the next upload requests answered with 503
+    int unavailableCount = 0;
+private:
+    bool request() {
+        if (url_ == "https://example.com/login") {
+            loginCount++;
+            responseCode_ = 200;
+            responseBody_ = "<sid>" + sessionId() + "</sid>";
+        } else if (url_.find("https://example.com/upload") == 0 && unavailableCount > 0) {
+            unavailableCount--;
+            responseCode_ = 503;
+            responseBody_ = "Service unavailable";
+        } else if (url_ == "https://example.com/upload?sid=" + sessionId()) {
+            uploadCount++;
+            responseCode_ = 200;
+            responseBody_ = "https://example.com/file_with_const_size.png";
+        } else {
+            responseCode_ = 403;
+            responseBody_ = "Access denied";
+        }
+        return true;
+    }
+
+    std::string sessionId() const {
+        return "session" + std::to_string(sessionNumber_);
+    }
+
+    std::string url_;
+    int sessionNumber_ = 1;
+    int responseCode_ = 0;
+    std::string responseBody_;
+};
+
+}
+
+class AuthTokenCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        namespace fs = boost::filesystem;
+        directory_ = (fs::temp_directory_path() / fs::unique_path("iu_tokens_%%%%-%%%%")).string();
+        fs::create_directories(directory_);
+        fileName_ = (fs::path(directory_) / "AuthTokens.dat").string();
+        keyFileName_ = (fs::path(directory_) / "AuthTokens.key").string();
+
+        UploadAction login;
+        login.Index = 0;
+        login.Type = "login";
+        login.Url = "https://example.com/login";
+        login.PostParams = "login=$(_LOGIN);password=$(_PASSWORD);";
+        ActionRegExp loginRegExp;
+        loginRegExp.Pattern = "<sid>(.+)</sid>";
+        loginRegExp.Required = true;
+        loginRegExp.Variables.push_back(ActionVariable("_SID", 0));
+        login.Regexes.push_back(loginRegExp);
+        ued_.Actions.push_back(login);
+
+        UploadAction upload;
+        upload.Index = 1;
+        upload.Type = "upload";
+        upload.Url = "https://example.com/upload?sid=$(_SID)";
+        upload.RetryLimit = 2;
+        upload.PostParams = "file=%filename%;";
+        ActionRegExp uploadRegExp;
+        uploadRegExp.Pattern = "https://example\\.com/(.+)";
+        uploadRegExp.Required = true;
+        uploadRegExp.Variables.push_back(ActionVariable("fileId", 0));
+        upload.Regexes.push_back(uploadRegExp);
+        ued_.Actions.push_back(upload);
+
+        ued_.Name = "test server";
+        ued_.NeedAuthorization = CUploadEngineData::naAvailable;
+        ued_.TypeMask = CUploadEngineData::TypeImageServer;
+        ued_.ImageUrlTemplate = "https://example.com/$(fileId)";
+
+        serverSettings_.authData.DoAuth = true;
+        serverSettings_.authData.Login = "username";
+        serverSettings_.authData.Password = "qwerty";
+    }
+
+    void TearDown() override {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(directory_, ec);
+    }
+
+    /**
+     * Everything a CLI process creates for one upload; only the files are shared between runs
+     */
+    int run(NiceMock<MockINetworkClient>& networkClient, bool useCache = true) {
+        auto cache = std::make_shared<AuthTokenCache>(fileName_, keyFileName_);
+        ServerSync sync;
+        if (useCache) {
+            sync.setAuthTokenCache(cache, ued_.Name);
+        }
+        CDefaultUploadEngine engine(&sync, CAbstractUploadEngine::ErrorMessageCallback());
+        engine.setNetworkClient(&networkClient);
+        engine.setUploadData(&ued_);
+        engine.setServerSettings(&serverSettings_);
+        std::string fileName = TestHelpers::resolvePath("file_with_const_size.png");
+        auto fileTask = std::make_shared<FileUploadTask>(fileName, IuCoreUtils::ExtractFileName(fileName));
+        UploadParams uploadParams;
+        int res = engine.processTask(fileTask, uploadParams);
+        if (res == 1) {
+            EXPECT_EQ("https://example.com/file_with_const_size.png", uploadParams.getDirectUrl());
+        }
+        return res;
+    }
+
+    std::string directory_;
+    std::string fileName_;
+    std::string keyFileName_;
+    CUploadEngineData ued_;
+    ServerSettingsStruct serverSettings_;
+};
+
+TEST_F(AuthTokenCacheTest, PutGet)
+{
+    std::map<std::string, std::string> vars = { { "_SID", "secret_session_id" } }, restored;
+    {
+        AuthTokenCache cache(fileName_, keyFileName_);
+        EXPECT_FALSE(cache.get("server", "user", "password", restored));
+        ASSERT_TRUE(cache.put("server", "user", "password", vars));
+    }
+    // The file is not readable without the key
+    EXPECT_EQ(std::string::npos, IuCoreUtils::GetFileContents(fileName_).find("secret_session_id"));
+
+    AuthTokenCache cache(fileName_, keyFileName_);
+    ASSERT_TRUE(cache.get("server", "user", "password", restored));
+    EXPECT_EQ(vars, restored);
+    EXPECT_FALSE(cache.get("server", "user", "another password", restored));
+    EXPECT_FALSE(cache.get("server", "another user", "password", restored));
+    EXPECT_FALSE(cache.get("another server", "user", "password", restored));
+
+    ASSERT_TRUE(cache.remove("server", "user"));
+    EXPECT_FALSE(cache.get("server", "user", "password", restored));
+}
+
+TEST_F(AuthTokenCacheTest, Expiration)
+{
+    AuthTokenCache cache(fileName_, keyFileName_);
+    std::map<std::string, std::string> vars = { { "_SID", "1" } }, restored;
+    cache.setLifetime(0);
+    ASSERT_TRUE(cache.put("server", "user", "password", vars));
+    EXPECT_FALSE(cache.get("server", "user", "password", restored));
+}
+
+TEST_F(AuthTokenCacheTest, CorruptedFile)
+{
+    AuthTokenCache cache(fileName_, keyFileName_);
+    std::map<std::string, std::string> vars = { { "_SID", "1" } }, restored;
+    ASSERT_TRUE(cache.put("server", "user", "password", vars));
+    std::string contents = IuCoreUtils::GetFileContents(fileName_);
+    contents[contents.size() / 2] ^= 1;
+    IuCoreUtils::PutFileContents(fileName_, contents);
+    EXPECT_FALSE(cache.get("server", "user", "password", restored));
+    // The next login overwrites the file
+    ASSERT_TRUE(cache.put("server", "user", "password", vars));
+    EXPECT_TRUE(cache.get("server", "user", "password", restored));
+}
+
+TEST_F(AuthTokenCacheTest, SecondRunDoesNotLogIn)
+{
+    NiceMock<MockINetworkClient> networkClient;
+    FakeServer server(networkClient);
+    EXPECT_EQ(1, run(networkClient));
+    EXPECT_EQ(1, run(networkClient));
+    EXPECT_EQ(1, server.loginCount);
+    EXPECT_EQ(2, server.uploadCount);
+}
+
+TEST_F(AuthTokenCacheTest, WithoutCacheEveryRunLogsIn)
+{
+    NiceMock<MockINetworkClient> networkClient;
+    FakeServer server(networkClient);
+    EXPECT_EQ(1, run(networkClient, false));
+    EXPECT_EQ(1, run(networkClient, false));
+    EXPECT_EQ(2, server.loginCount);
+}
+
+TEST_F(AuthTokenCacheTest, RejectedSessionFallsBackToLogin)
+{
+    NiceMock<MockINetworkClient> networkClient;
+    FakeServer server(networkClient);
+    EXPECT_EQ(1, run(networkClient));
+    server.expireSessions();
+    EXPECT_EQ(1, run(networkClient));
+    EXPECT_EQ(2, server.loginCount);
+    // The new session has been saved
+    EXPECT_EQ(1, run(networkClient));
+    EXPECT_EQ(2, server.loginCount);
+    EXPECT_EQ(3, server.uploadCount);
+}
+
+TEST_F(AuthTokenCacheTest, ChangedPasswordLogsIn)
+{
+    NiceMock<MockINetworkClient> networkClient;
+    FakeServer server(networkClient);
+    EXPECT_EQ(1, run(networkClient));
+    serverSettings_.authData.Password = "new password";
+    EXPECT_EQ(1, run(networkClient));
+    EXPECT_EQ(2, server.loginCount);
+}
+
+TEST_F(AuthTokenCacheTest, ServerErrorWithRestoredSessionIsRetried)
+{
+    NiceMock<MockINetworkClient> networkClient;
+    FakeServer server(networkClient);
+    EXPECT_EQ(1, run(networkClient));
+    server.unavailableCount = 1;
+    EXPECT_EQ(1, run(networkClient));
+    EXPECT_EQ(1, server.loginCount);
+    EXPECT_EQ(2, server.uploadCount);
+}
+
+TEST_F(AuthTokenCacheTest, ServerErrorKeepsRestoredSession)
+{
+    NiceMock<MockINetworkClient> networkClient;
+    FakeServer server(networkClient);
+    EXPECT_EQ(1, run(networkClient));
+    server.unavailableCount = 2;
+    EXPECT_NE(1, run(networkClient));
+    EXPECT_EQ(0, server.unavailableCount);
+    EXPECT_EQ(1, server.loginCount);
+    // The session has not been dropped from the cache
+    EXPECT_EQ(1, run(networkClient));
+    EXPECT_EQ(1, server.loginCount);
+    EXPECT_EQ(2, server.uploadCount);
+}
@@ -0,0 +1,288 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "Core/Upload/FileQueueUploader.h"
+#include "Core/Upload/FileUploadTask.h"
+#include "Core/Upload/UploadEngineManager.h"
+#include "Core/Upload/UploadErrorHandler.h"
+#include "Core/Upload/UploadFilter.h"
+#include "Core/Upload/UploadSession.h"
+#include "Core/UploadEngineList.h"
+#include "Core/Scripting/ScriptsManager.h"
+#include "Core/Settings/BasicSettings.h"
+#include "Core/ServiceLocator.h"
+#include "Core/Network/Tests/NetworkClientMock.h"
+#include "Tests/TestHelpers.h"
+
+using namespace ::testing;
+
+namespace {
+
+const char kServerName[] = "slow server";
+
+// Keeps the CPU busy like image conversion does
+class CpuHeavyFilter : public UploadFilter {
+public:
+    explicit CpuHeavyFilter(int durationMs) : durationMs_(durationMs) {}
+
+    bool PreUpload(UploadTask*) override {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(durationMs_);
+        volatile uint64_t sink = 0;
+        while (std::chrono::steady_clock::now() < end) {
+            for (int i = 0; i < 1000; i++) {
+                sink = sink + i;
+            }
+        }
+        return true;
+    }
+
+    bool PostUpload(UploadTask*) override {
+        return true;
+    }
+private:
+    int durationMs_;
+};
+
+/**
+ * Creates network clients which answer every upload request like a slow server
+ */
+class SlowNetworkClientFactory : public INetworkClientFactory {
+public:
+    explicit SlowNetworkClientFactory(int transferMs) : transferMs_(transferMs) {}
+
+    std::unique_ptr<INetworkClient> create() override {
+        auto client = std::make_unique<NiceMock<MockINetworkClient>>();
+        ON_CALL(*client, doUploadMultipartData()).WillByDefault(Invoke([this] {
+            startedUploads++;
+            int active = ++activeUploads;
+            int maxActive = maxActiveUploads;
+            while (active > maxActive && !maxActiveUploads.compare_exchange_weak(maxActive, active)) {
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(transferMs_));
+            activeUploads--;
+            return true;
+        }));
+        ON_CALL(*client, responseCode()).WillByDefault(Return(200));
+        ON_CALL(*client, responseBody()).WillByDefault(Return("https://example.com/file_with_const_size.png"));
+        return client;
+    }
+
+    std::atomic<int> startedUploads{ 0 };
+    std::atomic<int> activeUploads{ 0 };
+    std::atomic<int> maxActiveUploads{ 0 };
+private:
+    int transferMs_;
+};
+
+class CountingErrorHandler : public IUploadErrorHandler {
+public:
+    void ErrorMessage(const ErrorInfo& errorInfo) override {
+        if (errorInfo.messageType == ErrorInfo::mtError) {
+            errors++;
+        }
+    }
+
+    void DebugMessage(const std::string&, bool) override {
+    }
+
+    std::atomic<int> errors{ 0 };
+};
+
+bool waitFor(const std::function<bool()>& predicate, int timeoutMs = 20000) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > end) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+}
+
+/**
+ * Runs the whole upload pipeline: preparation threads with a CPU-heavy filter
+ * and network threads with a slow fake server
+ */
+class FileQueueUploaderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        UploadAction upload;
+        upload.Index = 0;
+        upload.Type = "upload";
+        upload.Url = "https://example.com/upload";
+        upload.PostParams = "file=%filename%;";
+        ActionRegExp uploadRegExp;
+        uploadRegExp.Pattern = "https://example\\.com/(.+)";
+        uploadRegExp.Required = true;
+        uploadRegExp.Variables.push_back(ActionVariable("fileId", 0));
+        upload.Regexes.push_back(uploadRegExp);
+
+        CUploadEngineData ued;
+        ued.Name = kServerName;
+        ued.TypeMask = CUploadEngineData::TypeImageServer | CUploadEngineData::TypeFileServer;
+        ued.ImageUrlTemplate = "https://example.com/$(fileId)";
+        ued.Actions.push_back(upload);
+        engineList_.addServer(ued);
+
+        ServiceLocator::instance()->setEngineList(&engineList_);
+        ServiceLocator::instance()->setSettings(&settings_);
+    }
+
+    void TearDown() override {
+        ServiceLocator::instance()->setSettings(nullptr);
+        ServiceLocator::instance()->setEngineList(nullptr);
+    }
+
+    std::unique_ptr<CFileQueueUploader> createUploader(int threadCount, int transferMs) {
+        networkClientFactory_ = std::make_shared<SlowNetworkClientFactory>(transferMs);
+        errorHandler_ = std::make_shared<CountingErrorHandler>();
+        engineManager_ = std::make_unique<UploadEngineManager>(&engineList_, errorHandler_, networkClientFactory_);
+        scriptsManager_ = std::make_unique<ScriptsManager>(networkClientFactory_);
+        return std::make_unique<CFileQueueUploader>(engineManager_.get(), scriptsManager_.get(), errorHandler_,
+            networkClientFactory_, threadCount);
+    }
+
+    std::shared_ptr<UploadSession> createSession(int taskCount) {
+        auto session = std::make_shared<UploadSession>();
+        std::string fileName = TestHelpers::resolvePath("file_with_const_size.png");
+        for (int i = 0; i < taskCount; i++) {
+            auto task = std::make_shared<FileUploadTask>(fileName, "file_with_const_size.png");
+            task->setServerProfile(ServerProfile(kServerName));
+            session->addTask(task);
+        }
+        return session;
+    }
+
+    static int countTasks(UploadSession* session, UploadTask::Status status) {
+        int count = 0;
+        for (const auto& task : *session) {
+            if (task->status() == status) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    CUploadEngineList engineList_;
+    BasicSettings settings_;
+    std::shared_ptr<SlowNetworkClientFactory> networkClientFactory_;
+    std::shared_ptr<CountingErrorHandler> errorHandler_;
+    std::unique_ptr<UploadEngineManager> engineManager_;
+    std::unique_ptr<ScriptsManager> scriptsManager_;
+};
+
+TEST_F(FileQueueUploaderTest, ReleasesPreparedSlots)
+{
+    const int taskCount = 8;
+    CpuHeavyFilter filter(20);
+    auto uploader = createUploader(2, 30);
+    uploader->addUploadFilter(&filter);
+    // Every slot is reused several times, a slot which is not released by the network thread stops the queue
+    uploader->setMaxPreparedTasks(2);
+
+    auto session = createSession(taskCount);
+    uploader->addSession(session);
+    ASSERT_TRUE(waitFor([&] { return session->isFinished(); }));
+    EXPECT_EQ(taskCount, countTasks(session.get(), UploadTask::StatusFinished));
+    EXPECT_EQ(taskCount, networkClientFactory_->startedUploads);
+    EXPECT_EQ(0, errorHandler_->errors);
+    EXPECT_TRUE(waitFor([&] { return uploader->preparationStats().outstandingTasks == 0; }));
+    EXPECT_EQ(taskCount, uploader->preparationStats().preparedTotal);
+    uploader->removeUploadFilter(&filter);
+}
+
+TEST_F(FileQueueUploaderTest, RemovingPreparedTaskFinishesIt)
+{
+    CpuHeavyFilter filter(5);
+    auto uploader = createUploader(1, 300);
+    uploader->addUploadFilter(&filter);
+    uploader->setMaxPreparedTasks(3);
+
+    auto session = createSession(3);
+    uploader->addSession(session);
+    // The first task is being uploaded, two other tasks are waiting for the network thread
+    ASSERT_TRUE(waitFor([&] {
+        return networkClientFactory_->startedUploads == 1 && uploader->preparationStats().preparedTotal == 3;
+    }));
+    auto removedTask = session->getTask(2);
+    EXPECT_TRUE(uploader->removeTaskFromQueue(removedTask.get()));
+    EXPECT_EQ(UploadTask::StatusStopped, removedTask->status());
+    EXPECT_TRUE(removedTask->isFinished());
+    EXPECT_FALSE(uploader->removeTaskFromQueue(removedTask.get()));
+
+    ASSERT_TRUE(waitFor([&] { return session->isFinished(); }));
+    EXPECT_EQ(2, countTasks(session.get(), UploadTask::StatusFinished));
+    EXPECT_EQ(2, networkClientFactory_->startedUploads);
+    EXPECT_TRUE(waitFor([&] { return uploader->preparationStats().outstandingTasks == 0; }));
+    uploader->removeUploadFilter(&filter);
+}
+
+TEST_F(FileQueueUploaderTest, StoppedSessionFreesSlots)
+{
+    CpuHeavyFilter filter(5);
+    auto uploader = createUploader(1, 300);
+    uploader->addUploadFilter(&filter);
+    uploader->setMaxPreparedTasks(3);
+
+    auto session = createSession(5);
+    uploader->addSession(session);
+    // One task is being uploaded, two are prepared, two are waiting for preparation
+    ASSERT_TRUE(waitFor([&] {
+        return networkClientFactory_->startedUploads == 1 && uploader->preparationStats().preparedTotal == 3;
+    }));
+    uploader->stopSession(session.get());
+    ASSERT_TRUE(waitFor([&] { return session->isFinished(); }));
+    for (int i = 1; i < session->taskCount(); i++) {
+        EXPECT_EQ(UploadTask::StatusStopped, session->getTask(i)->status());
+    }
+    EXPECT_EQ(1, networkClientFactory_->startedUploads);
+    EXPECT_TRUE(waitFor([&] { return uploader->preparationStats().outstandingTasks == 0; }));
+
+    // Nothing has been left in the queue or in the slots of the stopped session
+    auto nextSession = createSession(3);
+    uploader->addSession(nextSession);
+    ASSERT_TRUE(waitFor([&] { return nextSession->isFinished(); }));
+    EXPECT_EQ(3, countTasks(nextSession.get(), UploadTask::StatusFinished));
+    EXPECT_EQ(4, networkClientFactory_->startedUploads);
+    uploader->removeUploadFilter(&filter);
+}
+
+TEST_F(FileQueueUploaderTest, ShrinkingThreadCountKeepsTasks)
+{
+    const int taskCount = 24;
+    CpuHeavyFilter filter(2);
+    auto uploader = createUploader(4, 40);
+    uploader->addUploadFilter(&filter);
+
+    auto session = createSession(taskCount);
+    uploader->addSession(session);
+    ASSERT_TRUE(waitFor([&] { return networkClientFactory_->activeUploads == 4; }));
+    // Surplus network threads finish the tasks they have taken and quit
+    uploader->setMaxThreadCount(1);
+    ASSERT_TRUE(waitFor([&] { return session->isFinished(); }));
+    EXPECT_EQ(taskCount, countTasks(session.get(), UploadTask::StatusFinished));
+    EXPECT_EQ(taskCount, networkClientFactory_->startedUploads);
+    EXPECT_EQ(0, errorHandler_->errors);
+    EXPECT_TRUE(waitFor([&] { return uploader->preparationStats().outstandingTasks == 0; }));
+
+    networkClientFactory_->maxActiveUploads = 0;
+    auto nextSession = createSession(4);
+    uploader->addSession(nextSession);
+    ASSERT_TRUE(waitFor([&] { return nextSession->isFinished(); }));
+    EXPECT_EQ(4, countTasks(nextSession.get(), UploadTask::StatusFinished));
+    EXPECT_EQ(1, networkClientFactory_->maxActiveUploads);
+
+    uploader->setMaxThreadCount(2);
+    networkClientFactory_->maxActiveUploads = 0;
+    nextSession = createSession(4);
+    uploader->addSession(nextSession);
+    ASSERT_TRUE(waitFor([&] { return nextSession->isFinished(); }));
+    EXPECT_EQ(4, countTasks(nextSession.get(), UploadTask::StatusFinished));
+    EXPECT_EQ(2, networkClientFactory_->maxActiveUploads);
+    uploader->removeUploadFilter(&filter);
+}
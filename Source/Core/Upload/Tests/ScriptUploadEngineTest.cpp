@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <boost/filesystem.hpp>
+
 #include "Core/Upload/ServerSync.h"
 #include "Core/Upload/FileUploadTask.h"
 #include "Core/Upload/UrlShorteningTask.h"
@@ -7,6 +9,8 @@
 #include "Tests/TestHelpers.h"
 #include "Core/Upload/ScriptUploadEngine.h"
 #include "Core/Network/NetworkClientFactory.h"
+#include "Core/Settings/BasicSettings.h"
+#include "Core/ServiceLocator.h"
 
 using namespace ::testing;
 
@@ -202,4 +206,43 @@ TEST_F(ScriptUploadEngineTest, shortenUrl)
     EXPECT_EQ(1, res);
     EXPECT_EQ("https://ex.am/plecom", uploadParams.getDirectUrl());
 
-}
\ No newline at end of file
+}
+
+TEST_F(ScriptUploadEngineTest, profileIsWrittenAfterTask)
+{
+    namespace fs = boost::filesystem;
+    fs::path profilingFolder = fs::temp_directory_path() / fs::unique_path("scriptprofile-%%%%-%%%%");
+    BasicSettings settings;
+    settings.ScriptProfilingFolder = profilingFolder.string();
+    ServiceLocator::instance()->setSettings(&settings);
+
+    NiceMock<MockINetworkClient> networkClient;
+    ServerSync sync;
+    std::string scriptFileName = TestHelpers::resolvePath("Scripts/upload_test_1.nut");
+    ServerSettingsStruct serverSettings;
+    {
+        CScriptUploadEngine engine(scriptFileName, &sync,
+            &serverSettings, std::make_shared<NetworkClientFactory>(), CAbstractUploadEngine::ErrorMessageCallback());
+        ServiceLocator::instance()->setSettings(nullptr);
+
+        CUploadEngineData ued;
+        ued.Name = "test server";
+        ued.TypeMask = CUploadEngineData::TypeUrlShorteningServer;
+        engine.setUploadData(&ued);
+        engine.setNetworkClient(&networkClient);
+        engine.setServerSettings(&serverSettings);
+        ON_CALL(networkClient, doPost(_)).WillByDefault(Return(true));
+        ON_CALL(networkClient, responseCode()).WillByDefault(Return(200));
+        ON_CALL(networkClient, responseBody()).WillByDefault(Return("{ \"id\": \"https://ex.am/plecom\"}"));
+
+        // A single call may take less than the profiler resolution
+        for (int i = 0; i < 10; i++) {
+            UploadParams uploadParams;
+            EXPECT_EQ(1, engine.processTask(std::make_shared<UrlShorteningTask>("http://some.site.com/long.html"), uploadParams));
+        }
+        // The profile is written while the engine is still alive
+        std::string profile = IuCoreUtils::GetFileContents((profilingFolder / "upload_test_1.nut.folded").string());
+        EXPECT_NE(std::string::npos, profile.find("upload_test_1.nut;"));
+    }
+    fs::remove_all(profilingFolder);
+}
@@ -0,0 +1,259 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "Core/Metrics/MetricsRegistry.h"
+#include "Core/Upload/TaskPreparationStage.h"
+#include "Core/Upload/UploadFilter.h"
+#include "Core/Upload/UploadTask.h"
+
+namespace {
+
+class DummyUploadTask : public UploadTask {
+public:
+    Type type() const override {
+        return TypeUrl;
+    }
+    std::string getMimeType() const override {
+        return "text/plain";
+    }
+    int64_t getDataLength() const override {
+        return 0;
+    }
+    std::string title() const override {
+        return "dummy";
+    }
+    std::string toString() override {
+        return "dummy";
+    }
+};
+
+// Keeps the CPU busy like image conversion does
+class CpuHeavyFilter : public UploadFilter {
+public:
+    explicit CpuHeavyFilter(int durationMs) : durationMs_(durationMs) {}
+
+    bool PreUpload(UploadTask*) override {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(durationMs_);
+        volatile uint64_t sink = 0;
+        while (std::chrono::steady_clock::now() < end) {
+            for (int i = 0; i < 1000; i++) {
+                sink = sink + i;
+            }
+        }
+        return true;
+    }
+
+    bool PostUpload(UploadTask*) override {
+        return true;
+    }
+private:
+    int durationMs_;
+};
+
+// Network stage: uploads prepared tasks one by one and frees their slots
+class FakeNetwork {
+public:
+    FakeNetwork(TaskPreparationStage* stage, int transferMs) : stage_(stage), transferMs_(transferMs) {
+        thread_ = std::thread([this] {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (;;) {
+                condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    break;
+                }
+                tasks_.pop_front();
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::milliseconds(transferMs_));
+                uploaded_++;
+                stage_->release();
+                lock.lock();
+            }
+        });
+    }
+
+    ~FakeNetwork() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_all();
+        thread_.join();
+    }
+
+    void add(const std::shared_ptr<UploadTask>& task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(task);
+        }
+        condition_.notify_all();
+    }
+
+    int uploaded() const {
+        return uploaded_;
+    }
+private:
+    TaskPreparationStage* stage_;
+    int transferMs_;
+    std::deque<std::shared_ptr<UploadTask>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::thread thread_;
+    std::atomic<int> uploaded_{ 0 };
+    bool stop_ = false;
+};
+
+bool waitFor(const std::function<bool()>& predicate, int timeoutMs = 10000) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > end) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+}
+
+TEST(TaskPreparationStageTest, OverlapsPreparationWithTransfer)
+{
+    const int taskCount = 8, cpuMs = 30, transferMs = 30;
+    CpuHeavyFilter filter(cpuMs);
+    std::unique_ptr<FakeNetwork> network;
+    TaskPreparationStage stage(1, 2, [&](const std::shared_ptr<UploadTask>& task) {
+        filter.PreUpload(task.get());
+        network->add(task);
+        return true;
+    });
+    network = std::make_unique<FakeNetwork>(&stage, transferMs);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < taskCount; i++) {
+        stage.push(std::make_shared<DummyUploadTask>());
+    }
+    ASSERT_TRUE(waitFor([&] { return network->uploaded() == taskCount; }));
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Sequential processing takes taskCount * (cpuMs + transferMs) = 480 ms,
+    // the pipeline approaches taskCount * max(cpuMs, transferMs) = 240 ms
+    EXPECT_LT(elapsedMs, 0.75 * taskCount * (cpuMs + transferMs));
+
+    auto stats = stage.stats();
+    EXPECT_EQ(taskCount, stats.preparedTotal);
+    EXPECT_EQ(0, stats.outstandingTasks);
+    EXPECT_EQ(0, stats.queuedTasks);
+    stage.stop();
+}
+
+TEST(TaskPreparationStageTest, LimitsPreparedTasks)
+{
+    const int taskCount = 6, maxOutstanding = 2;
+    std::atomic<int> maxSeen{ 0 };
+    std::unique_ptr<FakeNetwork> network;
+    TaskPreparationStage* stagePtr = nullptr;
+    TaskPreparationStage stage(3, maxOutstanding, [&](const std::shared_ptr<UploadTask>& task) {
+        int current = stagePtr->stats().outstandingTasks;
+        int seen = maxSeen;
+        while (current > seen && !maxSeen.compare_exchange_weak(seen, current)) {
+        }
+        network->add(task);
+        return true;
+    });
+    stagePtr = &stage;
+    // Slow network, preparation threads have to wait for free slots
+    network = std::make_unique<FakeNetwork>(&stage, 20);
+
+    for (int i = 0; i < taskCount; i++) {
+        stage.push(std::make_shared<DummyUploadTask>());
+    }
+    ASSERT_TRUE(waitFor([&] { return network->uploaded() == taskCount; }));
+    EXPECT_LE(maxSeen.load(), maxOutstanding);
+    auto stats = stage.stats();
+    EXPECT_GT(stats.backpressureWaits, 0);
+    EXPECT_EQ(0, stats.outstandingTasks);
+    EXPECT_EQ(maxOutstanding, stats.maxOutstandingTasks);
+    stage.stop();
+}
+
+TEST(TaskPreparationStageTest, RejectedTaskFreesSlot)
+{
+    std::atomic<int> calls{ 0 };
+    TaskPreparationStage stage(1, 1, [&](const std::shared_ptr<UploadTask>&) {
+        calls++;
+        // Task has failed, it is not passed to the network stage
+        return false;
+    });
+    for (int i = 0; i < 3; i++) {
+        stage.push(std::make_shared<DummyUploadTask>());
+    }
+    ASSERT_TRUE(waitFor([&] { return calls == 3; }));
+    auto stats = stage.stats();
+    EXPECT_EQ(0, stats.outstandingTasks);
+    EXPECT_EQ(0, stats.preparedTotal);
+}
+
+TEST(TaskPreparationStageTest, RemovesQueuedTasks)
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool proceed = false;
+    std::atomic<int> calls{ 0 };
+    TaskPreparationStage stage(1, 1, [&](const std::shared_ptr<UploadTask>&) {
+        calls++;
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&] { return proceed; });
+        return false;
+    });
+    auto first = std::make_shared<DummyUploadTask>();
+    auto second = std::make_shared<DummyUploadTask>();
+    auto third = std::make_shared<DummyUploadTask>();
+    stage.push(first);
+    ASSERT_TRUE(waitFor([&] { return calls == 1; }));
+    stage.push(second);
+    stage.push(third);
+    EXPECT_EQ(2, stage.stats().queuedTasks);
+    EXPECT_EQ(1, stage.stats().busyThreads);
+
+    // Preparation of the first task has already started
+    EXPECT_FALSE(stage.remove(first.get()));
+    EXPECT_TRUE(stage.remove(second.get()));
+    stage.removeIf([&](UploadTask* task) { return task == third.get(); });
+    EXPECT_EQ(0, stage.stats().queuedTasks);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        proceed = true;
+    }
+    condition.notify_all();
+    stage.stop();
+    EXPECT_EQ(1, calls);
+}
+
+TEST(TaskPreparationStageTest, GaugesSumAllStages)
+{
+    MetricGauge* outstandingTasks = MetricsRegistry::instance()->gauge("iu_preparation_outstanding_tasks",
+        "Number of prepared tasks which have not been uploaded yet");
+    int64_t initialValue = outstandingTasks->value();
+    auto passTask = [](const std::shared_ptr<UploadTask>&) {
+        // Slot stays occupied, nobody uploads the task
+        return true;
+    };
+    auto first = std::make_unique<TaskPreparationStage>(1, 2, passTask);
+    TaskPreparationStage second(1, 2, passTask);
+    first->push(std::make_shared<DummyUploadTask>());
+    first->push(std::make_shared<DummyUploadTask>());
+    second.push(std::make_shared<DummyUploadTask>());
+    ASSERT_TRUE(waitFor([&] { return first->stats().preparedTotal == 2 && second.stats().preparedTotal == 1; }));
+    EXPECT_EQ(initialValue + 3, outstandingTasks->value());
+
+    second.release();
+    EXPECT_EQ(initialValue + 2, outstandingTasks->value());
+    first.reset();
+    EXPECT_EQ(initialValue, outstandingTasks->value());
+}
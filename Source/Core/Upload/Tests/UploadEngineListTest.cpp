@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <boost/filesystem.hpp>
+
 #include "Core/UploadEngineList.h"
+#include "Core/Utils/CoreUtils.h"
 #include <Tests/TestHelpers.h>
 
 class UploadEngineListTest : public ::testing::Test {
@@ -116,4 +119,151 @@ TEST_F(UploadEngineListTest, getByIndex)
 
     int index3 = list.getUploadEngineIndex("fastpic.ru");
     EXPECT_TRUE(index3 >= 0 && index3 < list.count());
-}
\ No newline at end of file
+}
+
+TEST_F(UploadEngineListTest, byNameIgnoresCase)
+{
+    CUploadEngineList list;
+    ServerSettingsMap settings;
+    ASSERT_TRUE(list.loadFromFile(fileName, settings));
+    CUploadEngineData* ued = list.byName("FastPic.RU");
+    ASSERT_TRUE(ued != nullptr);
+    EXPECT_EQ("fastpic.ru", ued->Name);
+    EXPECT_TRUE(list.byName("fastpic") == nullptr);
+
+    list.removeServer("fastpic.ru");
+    EXPECT_TRUE(list.byName("fastpic.ru") == nullptr);
+    EXPECT_TRUE(list.byName("8b.kz") != nullptr);
+}
+
+TEST_F(UploadEngineListTest, binaryCache)
+{
+    namespace fs = boost::filesystem;
+    fs::path directory = fs::temp_directory_path() / fs::unique_path("serverlistcache-%%%%-%%%%");
+    fs::create_directories(directory);
+    std::string sourceFile = (directory / "servers.xml").string();
+    fs::copy_file(fileName, sourceFile);
+
+    UploadEngineListCache cache((directory / "Cache").string());
+    std::vector<UploadEngineListEntry> entries;
+    EXPECT_FALSE(cache.load(sourceFile, entries));
+    {
+        CUploadEngineList list;
+        list.setCacheDirectory((directory / "Cache").string());
+        ServerSettingsMap settings;
+        ASSERT_TRUE(list.loadFromFile(sourceFile, settings));
+    }
+    EXPECT_TRUE(IuCoreUtils::FileExists(cache.cacheFileName(sourceFile)));
+    ASSERT_TRUE(cache.load(sourceFile, entries));
+    EXPECT_EQ(3u, entries.size());
+
+    {
+        // The list loaded from cache must be the same as the one loaded from XML
+        CUploadEngineList list;
+        list.setCacheDirectory((directory / "Cache").string());
+        ServerSettingsMap settings;
+        ASSERT_TRUE(list.loadFromFile(sourceFile, settings));
+        ASSERT_EQ(3, list.count());
+        CUploadEngineData* ued = list.byName("fastpic.ru");
+        ASSERT_TRUE(ued != nullptr);
+        EXPECT_EQ(5000000, ued->MaxFileSize);
+        EXPECT_EQ(3, ued->RetryLimit);
+        ASSERT_EQ(1u, ued->Actions.size());
+        EXPECT_EQ("http://fastpic.ru/upload?api=1", ued->Actions[0].Url);
+        EXPECT_EQ(2, ued->Actions[0].RetryLimit);
+        ASSERT_EQ(2u, ued->Actions[0].Regexes.size());
+        EXPECT_EQ(2u, ued->Actions[0].Regexes[0].Variables.size());
+        EXPECT_EQ("fastpic.ru", list.getDefaultServerNameForType(CUploadEngineData::TypeImageServer));
+        EXPECT_EQ("8b.kz", list.getDefaultServerNameForType(CUploadEngineData::TypeUrlShorteningServer));
+    }
+
+    // Touching the file without changes keeps the cache valid
+    fs::last_write_time(sourceFile, fs::last_write_time(sourceFile) + 10);
+    EXPECT_TRUE(cache.load(sourceFile, entries));
+
+    // Changed file invalidates the cache
+    std::string contents = IuCoreUtils::GetFileContents(sourceFile);
+    ASSERT_TRUE(IuCoreUtils::PutFileContents(sourceFile, contents + "\n"));
+    EXPECT_FALSE(cache.load(sourceFile, entries));
+
+    fs::remove_all(directory);
+}
+
+TEST_F(UploadEngineListTest, binaryCacheNoticesChangeInSameSecond)
+{
+    namespace fs = boost::filesystem;
+    fs::path directory = fs::temp_directory_path() / fs::unique_path("serverlistcache-%%%%-%%%%");
+    fs::create_directories(directory);
+    std::string sourceFile = (directory / "servers.xml").string();
+    fs::copy_file(fileName, sourceFile);
+
+    UploadEngineListCache cache((directory / "Cache").string());
+    std::vector<UploadEngineListEntry> entries;
+    ASSERT_TRUE(cache.save(sourceFile, entries));
+    std::time_t modificationTime = fs::last_write_time(sourceFile);
+
+    // Same size and the same modification time in seconds, only the contents differ
+    std::string contents = IuCoreUtils::GetFileContents(sourceFile);
+    size_t pos = contents.find("fastpic.ru");
+    ASSERT_NE(std::string::npos, pos);
+    contents[pos] = 'F';
+    ASSERT_TRUE(IuCoreUtils::PutFileContents(sourceFile, contents));
+    fs::last_write_time(sourceFile, modificationTime);
+    EXPECT_FALSE(cache.load(sourceFile, entries));
+
+    // The file has not been changed since it was cached long after its modification
+    fs::last_write_time(sourceFile, modificationTime - 60);
+    ASSERT_TRUE(cache.save(sourceFile, entries));
+    EXPECT_TRUE(cache.load(sourceFile, entries));
+
+    fs::remove_all(directory);
+}
+
+TEST_F(UploadEngineListTest, binaryCacheRemovesOrphanedFiles)
+{
+    namespace fs = boost::filesystem;
+    fs::path directory = fs::temp_directory_path() / fs::unique_path("serverlistcache-%%%%-%%%%");
+    fs::create_directories(directory);
+    std::string firstFile = (directory / "first.xml").string();
+    std::string secondFile = (directory / "second.xml").string();
+    fs::copy_file(fileName, firstFile);
+    fs::copy_file(fileName, secondFile);
+
+    std::string cacheDirectory = (directory / "Cache").string();
+    UploadEngineListCache cache(cacheDirectory);
+    std::vector<UploadEngineListEntry> entries(1);
+    ASSERT_TRUE(cache.save(firstFile, entries));
+    ASSERT_TRUE(cache.save(secondFile, entries));
+    // File written by another version of the program is left alone
+    std::string foreignFile = (fs::path(cacheDirectory) / "foreign.bin").string();
+    ASSERT_TRUE(IuCoreUtils::PutFileContents(foreignFile, "foreign"));
+
+    fs::remove(secondFile);
+    CUploadEngineList list;
+    list.setCacheDirectory(cacheDirectory);
+    EXPECT_TRUE(IuCoreUtils::FileExists(cache.cacheFileName(firstFile)));
+    EXPECT_FALSE(IuCoreUtils::FileExists(cache.cacheFileName(secondFile)));
+    EXPECT_TRUE(IuCoreUtils::FileExists(foreignFile));
+
+    fs::remove_all(directory);
+}
+
+TEST_F(UploadEngineListTest, corruptedCache)
+{
+    std::vector<UploadEngineListEntry> entries(2);
+    entries[0].data.Name = "example.com";
+    entries[0].data.Actions.resize(1);
+    entries[1].data.Name = "example.org";
+    std::string data = UploadEngineListCache::serialize(entries);
+
+    std::vector<UploadEngineListEntry> result;
+    ASSERT_TRUE(UploadEngineListCache::deserialize(data.data(), data.size(), result));
+    ASSERT_EQ(2u, result.size());
+    EXPECT_EQ("example.org", result[1].data.Name);
+
+    result.clear();
+    EXPECT_FALSE(UploadEngineListCache::deserialize(data.data(), data.size() - 1, result));
+    EXPECT_TRUE(result.empty());
+    data[0] = '\x7f';
+    EXPECT_FALSE(UploadEngineListCache::deserialize(data.data(), data.size(), result));
+}
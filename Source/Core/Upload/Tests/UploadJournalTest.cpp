@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include "Core/Upload/UploadJournal.h"
+#include "Core/Upload/FileUploadTask.h"
+#include "Core/Upload/UploadSession.h"
+#include "Tests/TestHelpers.h"
+
+class UploadJournalTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        namespace fs = boost::filesystem;
+        journalFile_ = (fs::temp_directory_path() / fs::unique_path("iu_journal_%%%%-%%%%.db")).string();
+    }
+
+    void TearDown() override {
+        boost::system::error_code ec;
+        boost::filesystem::remove(journalFile_, ec);
+        boost::filesystem::remove(journalFile_ + "-wal", ec);
+        boost::filesystem::remove(journalFile_ + "-shm", ec);
+    }
+
+    std::shared_ptr<FileUploadTask> createTask(const std::string& fileName) {
+        auto task = std::make_shared<FileUploadTask>(fileName, "");
+        ServerProfile profile("fastpic.ru");
+        profile.setProfileName("user");
+        profile.setFolderId("123");
+        task->setServerProfile(profile);
+        return task;
+    }
+
+    std::string journalFile_;
+};
+
+TEST_F(UploadJournalTest, RestoreUnfinishedTasks)
+{
+    const std::string file1 = TestHelpers::resolvePath("file_with_const_size.png");
+    const std::string file2 = TestHelpers::resolvePath("utf8_text_file.txt");
+    {
+        auto journal = std::make_shared<UploadJournal>(journalFile_);
+        ASSERT_TRUE(journal->open());
+        UploadSession session;
+        auto task1 = createTask(file1);
+        auto task2 = createTask(file2);
+        session.addTask(task1);
+        session.addTask(task2);
+        journal->taskQueued(task1.get());
+        journal->taskQueued(task2.get());
+        journal->taskStarted(task1.get());
+        task1->setUploadSuccess(true);
+        task1->finishTask(UploadTask::StatusFinished);
+        journal->taskStarted(task2.get());
+        // Process is "killed" here, task2 remains unfinished
+        journal->close();
+    }
+
+    auto journal = std::make_shared<UploadJournal>(journalFile_);
+    ASSERT_TRUE(journal->open());
+    auto records = journal->unfinishedRecords();
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ(file2, records[0].fileName);
+    EXPECT_EQ(UploadJournal::StateStarted, records[0].state);
+
+    auto sessions = journal->restoreSessions();
+    ASSERT_EQ(1, sessions.size());
+    ASSERT_EQ(1, sessions[0]->taskCount());
+    auto task = std::dynamic_pointer_cast<FileUploadTask>(sessions[0]->getTask(0));
+    ASSERT_TRUE(task != nullptr);
+    EXPECT_EQ(file2, task->getFileName());
+    EXPECT_EQ("fastpic.ru", task->serverName());
+    EXPECT_EQ("user", task->serverProfile().profileName());
+    EXPECT_EQ("123", task->serverProfile().folderId());
+
+    // Restored task keeps its journal record
+    task->setUploadSuccess(true);
+    task->finishTask(UploadTask::StatusFinished);
+    EXPECT_TRUE(journal->unfinishedRecords().empty());
+    journal->removeFinishedSessions();
+    journal->close();
+}
+
+TEST_F(UploadJournalTest, MissingFileIsRemoved)
+{
+    namespace fs = boost::filesystem;
+    const std::string missingFile = (fs::temp_directory_path() / fs::unique_path("iu_missing_%%%%-%%%%.png")).string();
+    {
+        auto journal = std::make_shared<UploadJournal>(journalFile_);
+        ASSERT_TRUE(journal->open());
+        UploadSession session;
+        auto task = createTask(missingFile);
+        session.addTask(task);
+        journal->taskQueued(task.get());
+        journal->close();
+    }
+    auto journal = std::make_shared<UploadJournal>(journalFile_);
+    ASSERT_TRUE(journal->open());
+    ASSERT_EQ(1, journal->unfinishedRecords().size());
+    EXPECT_TRUE(journal->restoreSessions().empty());
+    // The next resume does not see the file again
+    EXPECT_TRUE(journal->unfinishedRecords().empty());
+    journal->close();
+}
+
+TEST_F(UploadJournalTest, FailedTaskRunsOutOfAttempts)
+{
+    const std::string file = TestHelpers::resolvePath("file_with_const_size.png");
+    {
+        auto journal = std::make_shared<UploadJournal>(journalFile_);
+        ASSERT_TRUE(journal->open());
+        UploadSession session;
+        auto task = createTask(file);
+        session.addTask(task);
+        journal->taskQueued(task.get());
+        journal->taskStarted(task.get());
+        task->finishTask(UploadTask::StatusFailure);
+        // Retry within the same run keeps the number of failed attempts
+        task->restartTask(true);
+        journal->taskQueued(task.get());
+        journal->taskStarted(task.get());
+        task->finishTask(UploadTask::StatusFailure);
+        journal->close();
+    }
+
+    auto journal = std::make_shared<UploadJournal>(journalFile_);
+    ASSERT_TRUE(journal->open());
+    auto records = journal->unfinishedRecords();
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ(UploadJournal::StateFailed, records[0].state);
+    EXPECT_EQ(2, records[0].attempts);
+
+    auto sessions = journal->restoreSessions();
+    ASSERT_EQ(1, sessions.size());
+    ASSERT_EQ(1, sessions[0]->taskCount());
+    auto task = sessions[0]->getTask(0);
+    task->finishTask(UploadTask::StatusFailure);
+
+    // The third failure is the last one
+    EXPECT_TRUE(journal->unfinishedRecords().empty());
+    EXPECT_TRUE(journal->restoreSessions().empty());
+
+    // The session is removed from the journal, not just skipped
+    journal->removeFinishedSessions();
+    journal->setMaxAttempts(10);
+    EXPECT_TRUE(journal->unfinishedRecords().empty());
+    journal->close();
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include "Core/Upload/UploadProgressSampler.h"
+#include "Core/Upload/FileUploadTask.h"
+#include "Core/Upload/UploadSession.h"
+#include "Tests/TestHelpers.h"
+
+class UploadProgressSamplerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        session_ = std::make_shared<UploadSession>(false);
+        task_ = std::make_shared<FileUploadTask>(TestHelpers::resolvePath("file_with_const_size.png"), "");
+        session_->addTask(task_);
+        sampler_.addSession(session_);
+        sampler_.addTask(task_);
+        // Do not let the sampler thread interfere with the test
+        sampler_.stop();
+        sampler_.onProgress.connect([this](const UploadProgressBatch& batch) {
+            batches_.push_back(batch);
+        });
+        task_->setOnUploadProgressCallback([this](UploadTask*) {
+            callbackCount_++;
+        });
+    }
+
+    void transferTick(int64_t uploaded, int64_t total) {
+        InfoProgress info;
+        info.Uploaded = uploaded;
+        info.Total = total;
+        info.IsUploading = true;
+        task_->uploadProgress(info);
+    }
+
+    UploadProgressSampler sampler_;
+    std::shared_ptr<UploadSession> session_;
+    std::shared_ptr<FileUploadTask> task_;
+    std::vector<UploadProgressBatch> batches_;
+    int callbackCount_ = 0;
+};
+
+TEST_F(UploadProgressSamplerTest, BatchesTicks)
+{
+    // Progress is not delivered on the transfer thread
+    transferTick(100, 1000);
+    EXPECT_EQ(0, callbackCount_);
+    EXPECT_EQ(100, session_->uploadedBytes());
+    EXPECT_EQ(1000, session_->totalBytes());
+
+    sampler_.sample(1000);
+    EXPECT_EQ(1, callbackCount_);
+    ASSERT_EQ(1, batches_.size());
+    ASSERT_EQ(1, batches_[0].tasks.size());
+    EXPECT_EQ(task_.get(), batches_[0].tasks[0].task);
+    EXPECT_EQ(100, batches_[0].tasks[0].uploaded);
+    ASSERT_EQ(1, batches_[0].sessions.size());
+    EXPECT_EQ(100, batches_[0].sessions[0].uploaded);
+
+    // Nothing has changed
+    sampler_.sample(1100);
+    EXPECT_EQ(1, batches_.size());
+
+    // Several ticks are delivered as one snapshot
+    transferTick(200, 1000);
+    transferTick(300, 1000);
+    transferTick(600, 1000);
+    EXPECT_EQ(1, callbackCount_);
+    sampler_.sample(2000);
+    ASSERT_EQ(2, batches_.size());
+    ASSERT_EQ(1, batches_[1].tasks.size());
+    EXPECT_EQ(600, batches_[1].tasks[0].uploaded);
+    EXPECT_EQ(1000, batches_[1].tasks[0].total);
+    EXPECT_EQ(500, batches_[1].sessions[0].bytesPerSecond);
+    EXPECT_EQ(2, callbackCount_);
+    EXPECT_EQ("500 bytes/s", task_->progress()->speed());
+    EXPECT_EQ("500 bytes/s", batches_[1].tasks[0].speed);
+}
+
+TEST_F(UploadProgressSamplerTest, SmoothSpeed)
+{
+    EXPECT_EQ(1000, UploadProgressSampler::smoothSpeed(0, 500, 500));
+    EXPECT_EQ(1300, UploadProgressSampler::smoothSpeed(1000, 2000, 1000));
+    EXPECT_EQ(700, UploadProgressSampler::smoothSpeed(700, 100, 0));
+}
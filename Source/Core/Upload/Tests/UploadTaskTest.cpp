@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include "Core/Upload/UploadTask.h"
+
+namespace {
+
+class DummyUploadTask : public UploadTask {
+public:
+    Type type() const override {
+        return TypeUrl;
+    }
+    std::string getMimeType() const override {
+        return "text/plain";
+    }
+    int64_t getDataLength() const override {
+        return 0;
+    }
+    std::string title() const override {
+        return "dummy";
+    }
+    std::string toString() override {
+        return "dummy";
+    }
+};
+
+}
+
+class UploadTaskTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        parent_ = std::make_shared<DummyUploadTask>();
+        parent_->onTaskFinished.connect([this](UploadTask*, bool) {
+            finishedCount_++;
+        });
+    }
+
+    std::shared_ptr<DummyUploadTask> parent_;
+    int finishedCount_ = 0;
+};
+
+TEST_F(UploadTaskTest, ParentWaitsForChildren)
+{
+    auto thumb = std::make_shared<DummyUploadTask>();
+    auto shortening = std::make_shared<DummyUploadTask>();
+    parent_->addChildTask(thumb);
+    parent_->addChildTask(shortening);
+    EXPECT_EQ(2, parent_->pendingChildCount());
+
+    parent_->finishTask(UploadTask::StatusFinished);
+    EXPECT_TRUE(parent_->isFinishedItself());
+    EXPECT_FALSE(parent_->isFinished());
+    EXPECT_EQ(0, finishedCount_);
+
+    thumb->finishTask(UploadTask::StatusFinished);
+    EXPECT_EQ(1, parent_->pendingChildCount());
+    EXPECT_EQ(0, finishedCount_);
+
+    shortening->finishTask(UploadTask::StatusFinished);
+    EXPECT_EQ(0, parent_->pendingChildCount());
+    EXPECT_TRUE(parent_->isFinished());
+    EXPECT_EQ(1, finishedCount_);
+}
+
+TEST_F(UploadTaskTest, ChildrenFinishFirst)
+{
+    auto thumb = std::make_shared<DummyUploadTask>();
+    parent_->addChildTask(thumb);
+    thumb->finishTask(UploadTask::StatusFinished);
+    // Finishing the same child twice must not release the dependency twice
+    thumb->finishTask(UploadTask::StatusFinished);
+    EXPECT_EQ(0, parent_->pendingChildCount());
+    EXPECT_EQ(0, finishedCount_);
+
+    parent_->finishTask(UploadTask::StatusFinished);
+    EXPECT_TRUE(parent_->isFinished());
+    EXPECT_EQ(1, finishedCount_);
+}
+
+TEST_F(UploadTaskTest, DeletePostponedChilds)
+{
+    auto thumb = std::make_shared<DummyUploadTask>();
+    auto running = std::make_shared<DummyUploadTask>();
+    parent_->addChildTask(thumb);
+    parent_->addChildTask(running);
+    running->setStatus(UploadTask::StatusRunning);
+
+    parent_->deletePostponedChilds();
+    EXPECT_EQ(1, parent_->childCount());
+    EXPECT_EQ(1, parent_->pendingChildCount());
+
+    parent_->finishTask(UploadTask::StatusFailure);
+    EXPECT_EQ(0, finishedCount_);
+    running->finishTask(UploadTask::StatusFinished);
+    EXPECT_EQ(1, finishedCount_);
+}
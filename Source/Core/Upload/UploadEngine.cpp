@@ -76,12 +76,18 @@ int CUploadEngineListBase::count() const
 
 CUploadEngineData* CUploadEngineListBase::byName(const std::string& name)
 {
-    for (size_t i = 0; i < m_list.size(); i++)
-    {
-        if (!IuStringUtils::stricmp(m_list[i]->Name.c_str(), name.c_str()))
-            return m_list[i].get();
+    auto it = nameIndex_.find(IuStringUtils::toLower(name));
+    return it != nameIndex_.end() ? it->second : nullptr;
+}
+
+void CUploadEngineListBase::updateNameIndex()
+{
+    nameIndex_.clear();
+    nameIndex_.reserve(m_list.size());
+    for (const auto& ued : m_list) {
+        // Keep the first server if names differ only in case, as linear search did
+        nameIndex_.emplace(IuStringUtils::toLower(ued->Name), ued.get());
     }
-    return nullptr;
 }
 
 CUploadEngineData*  CUploadEngineListBase::firstEngineOfType(CUploadEngineData::ServerType type) {
@@ -155,6 +161,7 @@ std::string CUploadEngineListBase::getDefaultServerNameForType(CUploadEngineData
 void CUploadEngineListBase::removeServer(const std::string& name) {
     m_list.erase(std::remove_if(m_list.begin(), m_list.end(),
         [name](auto& x) { return x->Name == name; }));
+    updateNameIndex();
 }
 
 /* CAbstractUploadEngine */
@@ -26,6 +26,7 @@
 #include <string>
 #include <map>
 #include <random>
+#include <unordered_map>
 
 
 #include "Core/Utils/CoreUtils.h"
@@ -340,7 +341,13 @@ public:
     std::vector< std::unique_ptr<CUploadEngineData>>::const_iterator end() const;
     std::string getDefaultServerNameForType(CUploadEngineData::ServerType serverType) const;
 protected:
+    /**
+     * Must be called after every modification of m_list
+     */
+    void updateNameIndex();
+
     std::vector<std::unique_ptr<CUploadEngineData>> m_list;
+    std::unordered_map<std::string, CUploadEngineData*> nameIndex_; // key is lowercase server name
     std::map<CUploadEngineData::ServerType, std::string> m_defaultServersForType;
     std::mt19937 mt_;
 private:
@@ -211,6 +211,15 @@ void UploadEngineManager::resetFailedAuthorization()
     }
 }
 
+void UploadEngineManager::setAuthTokenCache(std::shared_ptr<AuthTokenCache> cache)
+{
+    std::lock_guard<std::mutex> lock(serverSyncsMutex_);
+    authTokenCache_ = std::move(cache);
+    for (auto& sync : serverSyncs_) {
+        sync.second->setAuthTokenCache(authTokenCache_, sync.first.first);
+    }
+}
+
 ServerSync* UploadEngineManager::getServerSync(const ServerProfile& serverProfile)
 {
     std::lock_guard<std::mutex> lock(serverSyncsMutex_);
@@ -218,6 +227,7 @@ ServerSync* UploadEngineManager::getServerSync(const ServerProfile& serverProfil
     auto it = serverSyncs_.find(key);
     if (it == serverSyncs_.end()) {
         ServerSync *sync = new ServerSync();
+        sync->setAuthTokenCache(authTokenCache_, serverProfile.serverName());
         serverSyncs_[key] = sync;
         return sync;
     }
@@ -12,6 +12,7 @@ class IUploadErrorHandler;
 class CScriptUploadEngine;
 class CUploadEngineList;
 class ServerProfile;
+class AuthTokenCache;
 
 /** UploadEngineManager class manages upload engines (instances of classes derivated from CAbstractUploadEngine).
     and their lifetime
@@ -54,6 +55,11 @@ public:
     Reset failed authorization on ALL servers
     */
     void resetFailedAuthorization();
+
+    /**
+    Sessions obtained by logging in are saved to the cache and reused by the next runs
+    */
+    void setAuthTokenCache(std::shared_ptr<AuthTokenCache> cache);
 protected:
     CScriptUploadEngine* getPlugin(ServerProfile& serverProfile, const std::string& pluginName, bool UseExisting = false);
     ServerSync* getServerSync(const ServerProfile& serverProfile);
@@ -66,6 +72,7 @@ protected:
     std::mutex serverSyncsMutex_;
     std::shared_ptr<IUploadErrorHandler> uploadErrorHandler_;
     std::shared_ptr<INetworkClientFactory> networkClientFactory_;
+    std::shared_ptr<AuthTokenCache> authTokenCache_;
 };
 
 #endif
@@ -11,6 +11,13 @@ public:
     virtual ~UploadFilter() = default;
     virtual bool PreUpload(UploadTask* task) = 0;
     virtual bool PostUpload(UploadTask* task) = 0;    
+
+    /**
+     * Name of the filter in the trace timeline
+     */
+    virtual const char* name() const {
+        return "UploadFilter";
+    }
 };
 
 #endif
\ No newline at end of file
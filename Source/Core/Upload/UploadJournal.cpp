@@ -0,0 +1,394 @@
+#include "UploadJournal.h"
+
+#include <chrono>
+#include <ctime>
+
+#include <sqlite3.h>
+
+#include "Core/Upload/FileUploadTask.h"
+#include "Core/Upload/UploadSession.h"
+#include "Core/Utils/CoreUtils.h"
+#include "Core/Utils/CryptoUtils.h"
+
+namespace {
+
+bool bindString(sqlite3_stmt* stmt, int index, const std::string& val) {
+    return sqlite3_bind_text(stmt, index, val.c_str(), static_cast<int>(val.size()), SQLITE_TRANSIENT) == SQLITE_OK;
+}
+
+std::string columnString(sqlite3_stmt* stmt, int index) {
+    auto text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+    return text ? text : std::string();
+}
+
+}
+
+UploadJournal::UploadJournal(std::string fileName, int flushIntervalMs) :
+    fileName_(std::move(fileName)),
+    flushIntervalMs_(flushIntervalMs),
+    maxAttempts_(3),
+    db_(nullptr),
+    nextId_(1),
+    enqueuedCount_(0),
+    writtenCount_(0),
+    stop_(false),
+    flushRequested_(false)
+{
+}
+
+UploadJournal::~UploadJournal() {
+    close();
+}
+
+bool UploadJournal::open() {
+    if (db_) {
+        return true;
+    }
+    IuCoreUtils::CreateDir(IuCoreUtils::ExtractFilePath(fileName_), 0755);
+    if (sqlite3_open(fileName_.c_str(), &db_) != SQLITE_OK) {
+        LOG(ERROR) << "Unable to open upload journal: " << fileName_;
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+    sqlite3_busy_timeout(db_, 1000);
+    const char* sql = "PRAGMA journal_mode=WAL;"
+        "CREATE TABLE IF NOT EXISTS upload_journal(id INTEGER PRIMARY KEY NOT NULL, session_id TEXT NOT NULL,"
+        "file_name TEXT, display_name TEXT, server_name TEXT, profile_name TEXT, folder_id TEXT, state INTEGER, updated_at INTEGER, "
+        "attempts INTEGER NOT NULL DEFAULT 0)";
+    char* err = nullptr;
+    if (sqlite3_exec(db_, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        LOG(ERROR) << "SQL error: " << err;
+        sqlite3_free(err);
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+    // Journals created by previous versions have no attempts column, it fails if the column already exists
+    sqlite3_exec(db_, "ALTER TABLE upload_journal ADD COLUMN attempts INTEGER NOT NULL DEFAULT 0", nullptr, nullptr, nullptr);
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT MAX(id) FROM upload_journal", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            nextId_ = sqlite3_column_int64(stmt, 0) + 1;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    stop_ = false;
+    thread_ = std::thread(&UploadJournal::worker, this);
+    return true;
+}
+
+void UploadJournal::setMaxAttempts(int count) {
+    maxAttempts_ = count;
+}
+
+int UploadJournal::maxAttempts() const {
+    return maxAttempts_;
+}
+
+void UploadJournal::close() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(pendingMutex_);
+        stop_ = true;
+    }
+    pendingCondition_.notify_one();
+    thread_.join();
+    sqlite3_close(db_);
+    db_ = nullptr;
+}
+
+void UploadJournal::flush() {
+    std::unique_lock<std::mutex> lk(pendingMutex_);
+    if (!thread_.joinable()) {
+        return;
+    }
+    int64_t target = enqueuedCount_;
+    flushRequested_ = true;
+    pendingCondition_.notify_one();
+    flushedCondition_.wait(lk, [&] { return writtenCount_ >= target || stop_; });
+}
+
+std::string UploadJournal::sessionId(UploadSession* session) {
+    auto it = sessionIds_.find(session);
+    if (it != sessionIds_.end()) {
+        return it->second;
+    }
+    auto now = std::chrono::system_clock::now().time_since_epoch().count();
+    std::string id = IuCoreUtils::CryptoUtils::CalcMD5HashFromString(std::to_string(now) + "_" +
+        std::to_string(reinterpret_cast<uintptr_t>(session)) + "_" + std::to_string(nextId_.load())).substr(0, 16);
+    sessionIds_[session] = id;
+    return id;
+}
+
+void UploadJournal::taskQueued(UploadTask* task) {
+    auto* fileTask = dynamic_cast<FileUploadTask*>(task);
+    // Child tasks (thumbnails, url shortening) are recreated by filters, they are not journaled
+    if (!fileTask || task->parentTask() || !task->session()) {
+        return;
+    }
+    Operation op;
+    op.type = OpType::Insert;
+    {
+        std::lock_guard<std::mutex> lk(mapsMutex_);
+        if (taskIds_.find(task) != taskIds_.end()) {
+            // Task has been added to queue again (e.g. server changed in PreUpload filter)
+            return;
+        }
+        op.record.id = nextId_++;
+        op.record.sessionId = sessionId(task->session());
+        taskIds_[task] = op.record.id;
+    }
+    watchTask(task);
+    op.record.fileName = fileTask->originalFileName();
+    op.record.displayName = fileTask->getDisplayName();
+    op.record.serverName = task->serverName();
+    op.record.profileName = task->serverProfile().profileName();
+    op.record.folderId = task->serverProfile().folderId();
+    op.record.state = StateQueued;
+    enqueue(std::move(op));
+}
+
+void UploadJournal::watchTask(UploadTask* task) {
+    std::weak_ptr<UploadJournal> weakThis = shared_from_this();
+    task->onTaskFinished.connect([weakThis](UploadTask* t, bool success) {
+        if (auto journal = weakThis.lock()) {
+            journal->taskFinished(t, success && t->status() == UploadTask::StatusFinished);
+        }
+    });
+}
+
+void UploadJournal::taskStarted(UploadTask* task) {
+    updateState(task, StateStarted);
+}
+
+void UploadJournal::taskFinished(UploadTask* task, bool success) {
+    updateState(task, success ? StateFinished : StateFailed);
+    std::lock_guard<std::mutex> lk(mapsMutex_);
+    taskIds_.erase(task);
+}
+
+void UploadJournal::sessionRemoved(UploadSession* session) {
+    std::lock_guard<std::mutex> lk(mapsMutex_);
+    sessionIds_.erase(session);
+}
+
+void UploadJournal::updateState(UploadTask* task, State state) {
+    int64_t id;
+    {
+        std::lock_guard<std::mutex> lk(mapsMutex_);
+        auto it = taskIds_.find(task);
+        if (it == taskIds_.end()) {
+            return;
+        }
+        id = it->second;
+    }
+    updateStateById(id, state);
+}
+
+void UploadJournal::updateStateById(int64_t id, State state) {
+    Operation op;
+    op.type = OpType::UpdateState;
+    op.record.id = id;
+    op.record.state = state;
+    enqueue(std::move(op));
+}
+
+void UploadJournal::removeRecord(int64_t id) {
+    Operation op;
+    op.type = OpType::Delete;
+    op.record.id = id;
+    enqueue(std::move(op));
+}
+
+void UploadJournal::enqueue(Operation&& op) {
+    std::lock_guard<std::mutex> lk(pendingMutex_);
+    pending_.push_back(std::move(op));
+    enqueuedCount_++;
+}
+
+void UploadJournal::worker() {
+    std::unique_lock<std::mutex> lk(pendingMutex_);
+    for (;;) {
+        pendingCondition_.wait_for(lk, std::chrono::milliseconds(flushIntervalMs_), [this] {
+            return stop_ || flushRequested_;
+        });
+        flushRequested_ = false;
+        if (!pending_.empty()) {
+            std::vector<Operation> ops;
+            ops.swap(pending_);
+            lk.unlock();
+            writeOperations(ops);
+            lk.lock();
+            writtenCount_ += ops.size();
+            flushedCondition_.notify_all();
+        }
+        if (stop_ && pending_.empty()) {
+            break;
+        }
+    }
+    flushedCondition_.notify_all();
+}
+
+bool UploadJournal::writeOperations(const std::vector<Operation>& ops) {
+    std::lock_guard<std::mutex> lk(dbMutex_);
+    sqlite3_exec(db_, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+    sqlite3_stmt* insertStmt = nullptr;
+    sqlite3_stmt* updateStmt = nullptr;
+    sqlite3_stmt* deleteStmt = nullptr;
+    sqlite3_stmt* removeStmt = nullptr;
+    // A retried task inherits the number of failed attempts from its previous record
+    if (sqlite3_prepare_v2(db_, "INSERT OR REPLACE INTO upload_journal(id,session_id,file_name,display_name,server_name,profile_name,folder_id,state,updated_at,attempts) "
+        "VALUES(?1,?2,?3,?4,?5,?6,?7,?8,?9,(SELECT IFNULL(MAX(attempts),0) FROM upload_journal WHERE session_id=?2 AND file_name=?3 AND state=?10))",
+        -1, &insertStmt, nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db_, "UPDATE upload_journal SET state=?,updated_at=?,attempts=attempts+? WHERE id=?", -1, &updateStmt, nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db_, "DELETE FROM upload_journal WHERE session_id=? AND file_name=? AND state=?", -1, &deleteStmt, nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db_, "DELETE FROM upload_journal WHERE id=?", -1, &removeStmt, nullptr) != SQLITE_OK) {
+        LOG(ERROR) << "SQL error: Could not prepare statement." << sqlite3_errmsg(db_);
+        sqlite3_finalize(insertStmt);
+        sqlite3_finalize(updateStmt);
+        sqlite3_finalize(deleteStmt);
+        sqlite3_exec(db_, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+    const int64_t now = time(nullptr);
+    bool result = true;
+    for (const auto& op : ops) {
+        const Record& r = op.record;
+        sqlite3_stmt* stmt;
+        if (op.type == OpType::Insert) {
+            stmt = insertStmt;
+            sqlite3_bind_int64(stmt, 1, r.id);
+            bindString(stmt, 2, r.sessionId);
+            bindString(stmt, 3, r.fileName);
+            bindString(stmt, 4, r.displayName);
+            bindString(stmt, 5, r.serverName);
+            bindString(stmt, 6, r.profileName);
+            bindString(stmt, 7, r.folderId);
+            sqlite3_bind_int(stmt, 8, r.state);
+            sqlite3_bind_int64(stmt, 9, now);
+            sqlite3_bind_int(stmt, 10, StateFailed);
+        } else if (op.type == OpType::Delete) {
+            stmt = removeStmt;
+            sqlite3_bind_int64(stmt, 1, r.id);
+        } else {
+            stmt = updateStmt;
+            sqlite3_bind_int(stmt, 1, r.state);
+            sqlite3_bind_int64(stmt, 2, now);
+            sqlite3_bind_int(stmt, 3, r.state == StateFailed ? 1 : 0);
+            sqlite3_bind_int64(stmt, 4, r.id);
+        }
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            LOG(ERROR) << "SQL error: Could not execute statement: " << sqlite3_errmsg(db_);
+            result = false;
+        }
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+
+        if (op.type == OpType::Insert) {
+            // Failed task which is being retried gets a new record, the old one is not needed anymore
+            bindString(deleteStmt, 1, r.sessionId);
+            bindString(deleteStmt, 2, r.fileName);
+            sqlite3_bind_int(deleteStmt, 3, StateFailed);
+            sqlite3_step(deleteStmt);
+            sqlite3_reset(deleteStmt);
+            sqlite3_clear_bindings(deleteStmt);
+        }
+    }
+    sqlite3_finalize(insertStmt);
+    sqlite3_finalize(updateStmt);
+    sqlite3_finalize(deleteStmt);
+    sqlite3_finalize(removeStmt);
+    sqlite3_exec(db_, "COMMIT", nullptr, nullptr, nullptr);
+    return result;
+}
+
+std::vector<UploadJournal::Record> UploadJournal::unfinishedRecords() {
+    std::vector<Record> result;
+    if (!db_) {
+        return result;
+    }
+    flush();
+    std::lock_guard<std::mutex> lk(dbMutex_);
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = "SELECT id,session_id,file_name,display_name,server_name,profile_name,folder_id,state,attempts FROM upload_journal "
+        "WHERE state<>? AND attempts<? ORDER BY id";
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG(ERROR) << "SQL error: Could not prepare statement." << sqlite3_errmsg(db_);
+        return result;
+    }
+    sqlite3_bind_int(stmt, 1, StateFinished);
+    sqlite3_bind_int(stmt, 2, maxAttempts_);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Record r;
+        r.id = sqlite3_column_int64(stmt, 0);
+        r.sessionId = columnString(stmt, 1);
+        r.fileName = columnString(stmt, 2);
+        r.displayName = columnString(stmt, 3);
+        r.serverName = columnString(stmt, 4);
+        r.profileName = columnString(stmt, 5);
+        r.folderId = columnString(stmt, 6);
+        r.state = static_cast<State>(sqlite3_column_int(stmt, 7));
+        r.attempts = sqlite3_column_int(stmt, 8);
+        result.push_back(r);
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+std::vector<std::shared_ptr<UploadSession>> UploadJournal::restoreSessions() {
+    std::vector<std::shared_ptr<UploadSession>> result;
+    std::map<std::string, std::shared_ptr<UploadSession>> sessions;
+    for (const auto& record : unfinishedRecords()) {
+        if (!IuCoreUtils::FileExists(record.fileName)) {
+            LOG(WARNING) << "Upload journal: file '" << record.fileName << "' doesn't exist anymore, skipping it.";
+            // A failed record would be selected again by the next resume
+            removeRecord(record.id);
+            continue;
+        }
+        auto& session = sessions[record.sessionId];
+        if (!session) {
+            session = std::make_shared<UploadSession>();
+            result.push_back(session);
+            std::lock_guard<std::mutex> lk(mapsMutex_);
+            sessionIds_[session.get()] = record.sessionId;
+        }
+        auto task = std::make_shared<FileUploadTask>(record.fileName, record.displayName);
+        ServerProfile profile(record.serverName);
+        profile.setProfileName(record.profileName);
+        profile.setFolderId(record.folderId);
+        task->setServerProfile(profile);
+        {
+            std::lock_guard<std::mutex> lk(mapsMutex_);
+            taskIds_[task.get()] = record.id;
+        }
+        watchTask(task.get());
+        session->addTask(task);
+    }
+    return result;
+}
+
+void UploadJournal::removeFinishedSessions() {
+    if (!db_) {
+        return;
+    }
+    flush();
+    std::lock_guard<std::mutex> lk(dbMutex_);
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = "DELETE FROM upload_journal WHERE session_id NOT IN "
+        "(SELECT session_id FROM upload_journal WHERE state<>? AND attempts<?)";
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG(ERROR) << "SQL error: Could not prepare statement." << sqlite3_errmsg(db_);
+        return;
+    }
+    sqlite3_bind_int(stmt, 1, StateFinished);
+    sqlite3_bind_int(stmt, 2, maxAttempts_);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        LOG(ERROR) << "SQL error: Could not execute statement: " << sqlite3_errmsg(db_);
+    }
+    sqlite3_finalize(stmt);
+}
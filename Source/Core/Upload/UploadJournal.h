@@ -0,0 +1,136 @@
+#ifndef IU_CORE_UPLOAD_UPLOADJOURNAL_H
+#define IU_CORE_UPLOAD_UPLOADJOURNAL_H
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+#include "Core/Utils/CoreTypes.h"
+
+class UploadTask;
+class UploadSession;
+struct sqlite3;
+
+/**
+@brief UploadJournal is a write-ahead log of the upload queue, stored in sqlite database.
+
+It records queued, started and finished file upload tasks, so after a crash (or killing the process)
+unfinished sessions can be rebuilt with restoreSessions(). Already uploaded files are skipped,
+failed uploads are resumed until they have failed maxAttempts() times.
+Journal writes are accumulated in memory and flushed in batches (in a single transaction)
+by a background thread, so upload threads never wait for disk I/O.
+*/
+class UploadJournal: public std::enable_shared_from_this<UploadJournal>
+{
+public:
+    enum State { StateQueued = 0, StateStarted = 1, StateFinished = 2, StateFailed = 3 };
+
+    struct Record {
+        int64_t id = 0;
+        std::string sessionId;
+        std::string fileName;
+        std::string displayName;
+        std::string serverName;
+        std::string profileName;
+        std::string folderId;
+        State state = StateQueued;
+        int attempts = 0; // number of failed attempts
+    };
+
+    explicit UploadJournal(std::string fileName, int flushIntervalMs = 500);
+    ~UploadJournal();
+
+    bool open();
+
+    /**
+     * Tasks which have failed that many times are not resumed anymore (default is 3)
+     */
+    void setMaxAttempts(int count);
+    int maxAttempts() const;
+
+    /**
+     * Writes all pending records and stops the background thread
+     */
+    void close();
+
+    /**
+     * Forces writing of pending records to disk (blocks until they are written)
+     */
+    void flush();
+
+    /**
+     * Registers top-level file upload task in the journal. Child tasks are ignored,
+     * because they are recreated by upload filters.
+     */
+    void taskQueued(UploadTask* task);
+    void taskStarted(UploadTask* task);
+    void taskFinished(UploadTask* task, bool success);
+
+    /**
+     * Forgets the in-memory id of the session removed from the uploader
+     */
+    void sessionRemoved(UploadSession* session);
+
+    /**
+     * Returns records of all tasks which were not successfully finished
+     * and have not run out of attempts
+     */
+    std::vector<Record> unfinishedRecords();
+
+    /**
+     * Creates upload sessions for unfinished tasks, grouped as they were originally.
+     * Tasks of the restored sessions keep their journal records, records of files
+     * which do not exist anymore are removed.
+     */
+    std::vector<std::shared_ptr<UploadSession>> restoreSessions();
+
+    /**
+     * Removes sessions which have nothing left to resume: all their tasks have been finished
+     * or have run out of attempts
+     */
+    void removeFinishedSessions();
+
+private:
+    enum class OpType { Insert, UpdateState, Delete };
+    struct Operation {
+        OpType type;
+        Record record;
+    };
+
+    void worker();
+    bool writeOperations(const std::vector<Operation>& ops);
+    void enqueue(Operation&& op);
+    void updateState(UploadTask* task, State state);
+    void updateStateById(int64_t id, State state);
+    void removeRecord(int64_t id);
+    void watchTask(UploadTask* task);
+    std::string sessionId(UploadSession* session);
+
+    std::string fileName_;
+    int flushIntervalMs_;
+    std::atomic<int> maxAttempts_;
+    sqlite3* db_;
+    std::mutex dbMutex_;
+    std::atomic<int64_t> nextId_;
+    std::map<UploadTask*, int64_t> taskIds_;
+    std::map<UploadSession*, std::string> sessionIds_;
+    std::mutex mapsMutex_;
+    std::vector<Operation> pending_;
+    std::mutex pendingMutex_;
+    std::condition_variable pendingCondition_;
+    std::condition_variable flushedCondition_;
+    int64_t enqueuedCount_, writtenCount_;
+    bool stop_;
+    bool flushRequested_;
+    std::thread thread_;
+    DISALLOW_COPY_AND_ASSIGN(UploadJournal);
+};
+
+#endif
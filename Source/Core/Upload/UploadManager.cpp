@@ -75,6 +75,12 @@ void UploadManager::onTaskFinished(UploadTask* task, bool ok)
         return ;
     }
 
+    // Scripts may have changed server parameters (tokens, created folders)
+    BasicSettings* settings = ServiceLocator::instance()->basicSettings();
+    if (settings) {
+        settings->scheduleSave(BasicSettings::SERVERS_PARAMS_SECTION);
+    }
+
     TempFileDeleter* tempFileDeleter = fileTask->tempFileDeleter(false);
     if (tempFileDeleter)
     {
@@ -112,6 +118,7 @@ void UploadManager::onTaskFinished(UploadTask* task, bool ok)
 
 void UploadManager::taskAdded(UploadTask* task)
 {
+    CFileQueueUploader::taskAdded(task);
     auto* fileTask = dynamic_cast<FileUploadTask*>(task);
     if (!fileTask) {
         return;
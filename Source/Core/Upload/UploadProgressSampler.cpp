@@ -0,0 +1,150 @@
+#include "UploadProgressSampler.h"
+
+#include <chrono>
+
+#include "UploadTask.h"
+#include "UploadSession.h"
+
+UploadProgressSampler::UploadProgressSampler(int intervalMs) : intervalMs_(intervalMs), stop_(false) {
+}
+
+UploadProgressSampler::~UploadProgressSampler() {
+    stop();
+}
+
+void UploadProgressSampler::setInterval(int intervalMs) {
+    intervalMs_ = intervalMs;
+}
+
+int UploadProgressSampler::interval() const {
+    return intervalMs_;
+}
+
+void UploadProgressSampler::addTask(const std::shared_ptr<UploadTask>& task) {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        tasks_[task.get()] = task;
+        task->progressSampled_ = true;
+    }
+    start();
+}
+
+void UploadProgressSampler::addSession(const std::shared_ptr<UploadSession>& session) {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        auto& entry = sessions_[session.get()];
+        if (entry.session.lock() != session) {
+            entry.session = session;
+            entry.state = std::make_shared<SessionState>();
+        }
+    }
+    start();
+}
+
+void UploadProgressSampler::start() {
+    std::lock_guard<std::mutex> lk(stopMutex_);
+    if (thread_.joinable() || stop_) {
+        return;
+    }
+    thread_ = std::thread(&UploadProgressSampler::worker, this);
+}
+
+void UploadProgressSampler::stop() {
+    {
+        std::lock_guard<std::mutex> lk(stopMutex_);
+        stop_ = true;
+    }
+    stopCondition_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void UploadProgressSampler::worker() {
+    std::unique_lock<std::mutex> lk(stopMutex_);
+    for (;;) {
+        stopCondition_.wait_for(lk, std::chrono::milliseconds(intervalMs_.load()), [this] { return stop_; });
+        if (stop_) {
+            break;
+        }
+        lk.unlock();
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        sample(static_cast<uint64_t>(now));
+        lk.lock();
+    }
+}
+
+void UploadProgressSampler::sample(uint64_t now) {
+    std::lock_guard<std::mutex> sampleLock(sampleMutex_);
+    std::vector<std::shared_ptr<UploadTask>> changedTasks;
+    std::vector<std::pair<std::shared_ptr<UploadSession>, std::shared_ptr<SessionState>>> sessions;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        for (auto it = tasks_.begin(); it != tasks_.end();) {
+            auto task = it->second.lock();
+            if (!task) {
+                it = tasks_.erase(it);
+                continue;
+            }
+            if (task->progress()->changed.exchange(false)) {
+                changedTasks.push_back(task);
+            } else if (task->isFinishedItself()) {
+                // Task is re-added to the sampler when restarted
+                task->progressSampled_ = false;
+                it = tasks_.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        for (auto it = sessions_.begin(); it != sessions_.end();) {
+            auto session = it->second.session.lock();
+            if (!session) {
+                it = sessions_.erase(it);
+                continue;
+            }
+            sessions.emplace_back(session, it->second.state);
+            ++it;
+        }
+    }
+
+    UploadProgressBatch batch;
+    for (const auto& task : changedTasks) {
+        // Invokes task's progress callback
+        task->deliverProgress(now);
+        UploadProgress* progress = task->progress();
+        batch.tasks.push_back({ task.get(), progress->uploaded, progress->totalUpload, progress->bytesPerSecond, progress->speed() });
+    }
+
+    for (const auto& item : sessions) {
+        UploadSession* session = item.first.get();
+        SessionState& state = *item.second;
+        int64_t uploaded = session->uploadedBytes();
+        if (uploaded == state.lastUploaded) {
+            continue;
+        }
+        if (uploaded < state.lastUploaded) {
+            state.bytesPerSecond = 0;
+        } else if (state.lastTime && now > state.lastTime) {
+            state.bytesPerSecond = smoothSpeed(state.bytesPerSecond, uploaded - state.lastUploaded, now - state.lastTime);
+        }
+        state.lastUploaded = uploaded;
+        state.lastTime = now;
+        batch.sessions.push_back({ session, uploaded, session->totalBytes(), state.bytesPerSecond });
+    }
+
+    if (!batch.tasks.empty() || !batch.sessions.empty()) {
+        onProgress(batch);
+    }
+}
+
+int64_t UploadProgressSampler::smoothSpeed(int64_t previousSpeed, int64_t bytes, uint64_t elapsedMs) {
+    if (!elapsedMs) {
+        return previousSpeed;
+    }
+    double speed = static_cast<double>(bytes) * 1000 / elapsedMs;
+    if (!previousSpeed) {
+        return static_cast<int64_t>(speed);
+    }
+    return static_cast<int64_t>(0.3 * speed + 0.7 * previousSpeed);
+}
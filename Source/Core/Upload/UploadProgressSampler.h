@@ -0,0 +1,104 @@
+#ifndef IU_CORE_UPLOAD_UPLOADPROGRESSSAMPLER_H
+#define IU_CORE_UPLOAD_UPLOADPROGRESSSAMPLER_H
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <condition_variable>
+
+#include <boost/signals2.hpp>
+
+#include "Core/Utils/CoreTypes.h"
+
+class UploadTask;
+class UploadSession;
+
+struct TaskProgressSnapshot {
+    UploadTask* task;
+    int64_t uploaded;
+    int64_t total;
+    int64_t bytesPerSecond;
+    std::string speed;
+};
+
+struct SessionProgressSnapshot {
+    UploadSession* session;
+    int64_t uploaded;
+    int64_t total;
+    int64_t bytesPerSecond;
+};
+
+struct UploadProgressBatch {
+    std::vector<TaskProgressSnapshot> tasks;
+    std::vector<SessionProgressSnapshot> sessions;
+};
+
+/**
+@brief UploadProgressSampler periodically collects progress of the upload tasks.
+
+Transfer threads only update atomic counters of the tasks (see UploadTask::uploadProgress()).
+The sampler thread wakes up every interval() milliseconds, calculates smoothed upload speed,
+invokes tasks' progress callbacks and emits onProgress signal with a batch of snapshots
+of all tasks and sessions changed since the previous pass.
+*/
+class UploadProgressSampler {
+public:
+    explicit UploadProgressSampler(int intervalMs = 250);
+    ~UploadProgressSampler();
+
+    void setInterval(int intervalMs);
+    int interval() const;
+
+    /**
+     * Starts tracking of the task. Sampler thread is started on first call.
+     */
+    void addTask(const std::shared_ptr<UploadTask>& task);
+    void addSession(const std::shared_ptr<UploadSession>& session);
+
+    void start();
+    void stop();
+
+    /**
+     * Collects progress of tasks changed since previous call and delivers it.
+     * Normally it is called by the sampler thread.
+     * @param now current time in milliseconds
+     */
+    void sample(uint64_t now);
+
+    /**
+     * Returns exponential moving average of the upload speed
+     */
+    static int64_t smoothSpeed(int64_t previousSpeed, int64_t bytes, uint64_t elapsedMs);
+
+    boost::signals2::signal<void(const UploadProgressBatch&)> onProgress;
+private:
+    struct SessionState {
+        int64_t lastUploaded = 0;
+        int64_t bytesPerSecond = 0;
+        uint64_t lastTime = 0;
+    };
+    struct SessionEntry {
+        std::weak_ptr<UploadSession> session;
+        std::shared_ptr<SessionState> state;
+    };
+    void worker();
+
+    std::map<UploadTask*, std::weak_ptr<UploadTask>> tasks_;
+    std::map<UploadSession*, SessionEntry> sessions_;
+    std::mutex mutex_;
+    std::mutex sampleMutex_;
+    std::atomic<int> intervalMs_;
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+    bool stop_;
+    DISALLOW_COPY_AND_ASSIGN(UploadProgressSampler);
+};
+
+#endif
@@ -10,6 +10,8 @@ UploadSession::UploadSession(bool enableHistory) :
     finishedSignalSent_ = false;
     stopSignal_ = true;
     finishedCount_ = 0;
+    uploadedBytes_ = 0;
+    totalBytes_ = 0;
     isStopped_ = false;
 	userData_ = nullptr;
 }
@@ -96,6 +98,22 @@ bool UploadSession::isFinished()
     return res;
 }*/
 
+int64_t UploadSession::uploadedBytes() const
+{
+    return uploadedBytes_;
+}
+
+int64_t UploadSession::totalBytes() const
+{
+    return totalBytes_;
+}
+
+void UploadSession::addProgress(int64_t uploadedDelta, int64_t totalDelta)
+{
+    uploadedBytes_ += uploadedDelta;
+    totalBytes_ += totalDelta;
+}
+
 int UploadSession::taskCount()
 {
     /*try {
@@ -134,6 +152,8 @@ bool UploadSession::isStopped() const
 
 void UploadSession::addSessionFinishedCallback(const SessionFinishedCallback& callback)
 {
+    // Callbacks may be added while the session is already being uploaded
+    std::lock_guard<std::mutex> lock(finishMutex_);
     sessionFinishedCallbacks_.push_back(callback);
 }
 
@@ -5,11 +5,12 @@
 
 #include <functional>
 #include <atomic>
+#include <memory>
 
 #include "UploadTask.h"
 
 class CHistorySession;
-class UploadSession
+class UploadSession: public std::enable_shared_from_this<UploadSession>
 {
     public:
         explicit UploadSession(bool enableHistory = true);
@@ -27,6 +28,11 @@ class UploadSession
         //int pendingTasksCount(UploadTaskAcceptor* acceptor);
         int taskCount();
         int finishedTaskCount(UploadTask::Status status);
+        /**
+         * Sum of uploaded bytes/total bytes of all tasks (including child tasks) of the session
+         */
+        int64_t uploadedBytes() const;
+        int64_t totalBytes() const;
         bool isStopped() const;
         std::shared_ptr<UploadTask> getTask(int index);
         void addSessionFinishedCallback(const SessionFinishedCallback& callback);
@@ -54,6 +60,9 @@ class UploadSession
         bool finishedSignalSent_;
         bool isStopped_;
         std::atomic<int> finishedCount_;
+        std::atomic<int64_t> uploadedBytes_;
+        std::atomic<int64_t> totalBytes_;
+        void addProgress(int64_t uploadedDelta, int64_t totalDelta);
         void taskFinished(UploadTask* task);
         void childTaskAdded(UploadTask* task);
         bool stopSignal();
@@ -3,6 +3,7 @@
 #include <boost/format.hpp>
 
 #include "UploadSession.h"
+#include "UploadProgressSampler.h"
 #include "Core/Upload/ScriptUploadEngine.h"
 #include "Core/i18n/Translator.h"
 #include "Core/Upload/UploadManager.h"
@@ -33,16 +34,28 @@ void UploadTask::init()
     index_ = 0;
     finishSignalSent_ = false;
     uploadManager_ = nullptr;
+    pendingChildCount_ = 0;
+    parentNotified_ = false;
+    progressSampled_ = false;
 }
 
 void UploadTask::childTaskFinished(UploadTask* child)
 {
-    if (isFinished())
+    // The last finished child completes the parent (if the parent itself has already finished)
+    if (--pendingChildCount_ == 0 && isFinishedItself())
     {
         taskFinished();
     }
 }
 
+void UploadTask::notifyParentFinished()
+{
+    if (parentTask_ && !parentNotified_.exchange(true))
+    {
+        parentTask_->childTaskFinished(this);
+    }
+}
+
 void UploadTask::taskFinished()
 {
     std::lock_guard<std::mutex> lk(finishMutex_);
@@ -146,18 +159,7 @@ UploadSession* UploadTask::session() const
 
 bool UploadTask::isFinished()
 {
-    if (!isFinishedItself()) {
-        return false;
-    }
-    std::lock_guard<std::recursive_mutex> lock(tasksMutex_);
-    for (size_t i = 0; i < childTasks_.size(); i++)
-    {
-        if (!childTasks_[i]->isFinished())
-        {
-            return false;
-        }
-    }
-    return isFinishedItself();
+    return isFinishedItself() && pendingChildCount_ == 0;
 }
 
 bool UploadTask::isFinishedItself()
@@ -169,10 +171,7 @@ void UploadTask::finishTask(Status status)
 {
     setStatus(status);
 
-    if (parentTask_)
-    {
-        parentTask_->childTaskFinished(this);
-    }
+    notifyParentFinished();
 
     if (isFinished())
     {
@@ -191,8 +190,10 @@ void UploadTask::addChildTask(std::shared_ptr<UploadTask> child)
     child->setSession(session_);
     child->setUploadManager(uploadManager_);
     child->parentTask_ = this;
+    child->parentNotified_ = false;
     tasksMutex_.lock();
     childTasks_.push_back(child);
+    ++pendingChildCount_;
     tasksMutex_.unlock();
     if (session_) {
         session_->childTaskAdded(child.get());
@@ -213,6 +214,11 @@ int UploadTask::childCount()
     return childTasks_.size();
 }
 
+int UploadTask::pendingChildCount() const
+{
+    return pendingChildCount_;
+}
+
 int UploadTask::index() const {
     return index_;
 }
@@ -408,43 +414,43 @@ UploadTask::Status UploadTask::status() const
 
 void UploadTask::uploadProgress(InfoProgress progress)
 {
-    progress_.uploaded = progress.Uploaded;
-    progress_.totalUpload = progress.Total;
+    int64_t prevUploaded = progress_.uploaded.exchange(progress.Uploaded);
+    int64_t prevTotal = progress_.totalUpload.exchange(progress.Total);
     progress_.isUploading = progress.IsUploading;
+    if (session_) {
+        session_->addProgress(progress.Uploaded - prevUploaded, progress.Total - prevTotal);
+    }
+
+    if (progressSampled_) {
+        progress_.changed = true;
+        return;
+    }
 
     struct timeval tp;
     gettimeofday(&tp, NULL);
     uint64_t curTime = static_cast<uint64_t>(uint64_t(tp.tv_sec) * 1000 + tp.tv_usec / 1000.0);
     if (curTime - progress_.lastUpdateTime > 250 || progress.Uploaded == progress.Total) {
-        int64_t Current = progress.Uploaded;
+        deliverProgress(curTime);
+    }
+}
 
-        int speed = 0;
-        UploadProgressTimeInfo ti;
-        ti.bytes = Current;
-        ti.ms = curTime;
-        if (progress_.timeBytes.size())
-        {
-            speed = int(((double)(ti.bytes - progress_.timeBytes[0].bytes) / (curTime - progress_.timeBytes[0].ms) * 1000));
-        }
+void UploadTask::deliverProgress(uint64_t now)
+{
+    int64_t uploaded = progress_.uploaded;
+    if (uploaded < progress_.lastSampleBytes) {
+        // Upload has been restarted
+        progress_.bytesPerSecond = 0;
+    } else if (progress_.lastUpdateTime && now > progress_.lastUpdateTime) {
+        progress_.bytesPerSecond = UploadProgressSampler::smoothSpeed(progress_.bytesPerSecond,
+            uploaded - progress_.lastSampleBytes, now - progress_.lastUpdateTime);
+    }
+    progress_.lastSampleBytes = uploaded;
+    progress_.lastUpdateTime = now;
 
-        progress_.timeBytes.push_back(ti);
-        if (progress_.timeBytes.size() > 11)
-        {
-            progress_.timeBytes.pop_front(); //Deleting element at the beginning of the deque
-        }
-        if (speed > 0)
-        {
-            progress_.speed = IuCoreUtils::FileSizeToString(speed) + "/s";
-        }
-        else
-        {
-            progress_.speed.clear();
-        }
-        progress_.lastUpdateTime = curTime;
-        if (onUploadProgress_)
-        {
-            onUploadProgress_(this); // invoke upload progress callback
-        }
+    int64_t bytesPerSecond = progress_.bytesPerSecond;
+    progress_.setSpeed(bytesPerSecond > 0 ? IuCoreUtils::FileSizeToString(bytesPerSecond) + "/s" : std::string());
+    if (onUploadProgress_) {
+        onUploadProgress_(this); // invoke upload progress callback
     }
 }
 
@@ -491,12 +497,19 @@ void UploadTask::addTempFile(const std::string& fileName)
 
 void UploadTask::deletePostponedChilds() {
     std::lock_guard<std::recursive_mutex> guard(tasksMutex_);
-    for ( auto it = childTasks_.begin(); it != childTasks_.end(); ++it ) {
-        if ( it->get()->status() == StatusInQueue ) {
-            childTasks_.erase(it);
+    for ( auto it = childTasks_.begin(); it != childTasks_.end(); ) {
+        UploadTask* child = it->get();
+        if ( child->status() == StatusInQueue ) {
             if (uploadManager_) {
-                uploadManager_->removeTaskFromQueue(it->get());
+                uploadManager_->removeTaskFromQueue(child);
+            }
+            // Removed child will never finish, so release the dependency here
+            if (!child->parentNotified_.exchange(true)) {
+                --pendingChildCount_;
             }
+            it = childTasks_.erase(it);
+        } else {
+            ++it;
         }
     }
 }
@@ -505,9 +518,12 @@ void UploadTask::restartTask(bool fullReset) {
     clearStopFlag();
     finishSignalSent_ = false;
     shorteningStarted_ = false;
+    parentNotified_ = false;
 
     if (fullReset) {
+        std::lock_guard<std::recursive_mutex> guard(tasksMutex_);
         childTasks_.clear();
+        pendingChildCount_ = 0;
         //std::find_if(childTasks_.begin(), childTasks_.end(), [](decltype(childTasks_)::value_type task) {return task->role() == })
         setStatus(StatusInQueue);
     }
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <mutex>
+#include <atomic>
 #include <deque>
 #include <functional>
 
@@ -19,22 +20,23 @@ class CAbstractUploadEngine;
 class UploadTask;
 class UploadSession;
 class CFileQueueUploader;
-struct UploadProgressTimeInfo
-{
-    int64_t ms; //time
-    int64_t bytes;
-};
+
+/**
+Byte counters are updated by the transfer thread without locking,
+speed is calculated later by UploadProgressSampler.
+*/
 class UploadProgress {
 public:
     std::string statusText;
     int stage;
     StatusType statusType;
-    int64_t uploaded;
-    int64_t totalUpload;
+    std::atomic<int64_t> uploaded;
+    std::atomic<int64_t> totalUpload;
     uint64_t lastUpdateTime;
-    bool isUploading;
-    std::string speed;
-    std::deque<UploadProgressTimeInfo> timeBytes;
+    std::atomic<bool> isUploading;
+    std::atomic<bool> changed; // set on each transfer tick, cleared when progress is delivered
+    std::atomic<int64_t> bytesPerSecond; // smoothed upload speed
+    int64_t lastSampleBytes;
     UploadProgress()
     {
         stage = 0;
@@ -42,8 +44,28 @@ public:
         totalUpload = 0;
         lastUpdateTime = 0;
         isUploading = false;
+        changed = false;
+        bytesPerSecond = 0;
+        lastSampleBytes = 0;
         statusType = stNone;
     }
+
+    /**
+     * Formatted upload speed, may be called from any thread
+     */
+    std::string speed() const {
+        std::lock_guard<std::mutex> lk(speedMutex_);
+        return speed_;
+    }
+
+    void setSpeed(const std::string& speed) {
+        std::lock_guard<std::mutex> lk(speedMutex_);
+        speed_ = speed;
+    }
+private:
+    // Written by the sampler thread
+    std::string speed_;
+    mutable std::mutex speedMutex_;
 };
 
 class UploadTaskAcceptor
@@ -83,6 +105,11 @@ class UploadTask {
         //int getNextTask(UploadTaskAcceptor *acceptor, std::shared_ptr<UploadTask>& outTask);
         void addChildTask(std::shared_ptr<UploadTask> child);
         int childCount();
+        /**
+         * Number of child tasks which are not finished yet.
+         * Parent task is considered finished only when this counter reaches zero.
+         */
+        int pendingChildCount() const;
         int index() const;
         void setIndex(int index); // sort index
         UploadResult* uploadResult();
@@ -121,11 +148,21 @@ class UploadTask {
         TempFileDeleter* tempFileDeleter(bool create = true);
         void addTempFile(const std::string& fileName);
         void deletePostponedChilds();
+        /**
+         * Called on the transfer thread on every network tick. It only updates atomic counters
+         * when the task is tracked by UploadProgressSampler; progress is delivered later by the sampler.
+         */
         void uploadProgress(InfoProgress progress);
+        /**
+         * Recalculates upload speed and invokes upload progress callback.
+         * @param now current time in milliseconds
+         */
+        void deliverProgress(uint64_t now);
         void restartTask(bool fullReset = true);
 
         std::function<void(UploadTask*)> onFolderUsed_;
         friend class CUploader;
+        friend class UploadProgressSampler;
 
     protected:
         UploadTask* parentTask_;
@@ -142,6 +179,7 @@ class UploadTask {
         void* userData_;
         void init();
         void childTaskFinished(UploadTask* child);
+        void notifyParentFinished();
         void taskFinished();
         void statusChanged();
         void setCurrentUploadEngine(CAbstractUploadEngine* currentUploadEngine);
@@ -153,7 +191,10 @@ class UploadTask {
         bool shorteningStarted_;
         volatile bool stopSignal_;
         bool uploadSuccess_;
-        Status status_;
+        std::atomic<Status> status_;
+        std::atomic<int> pendingChildCount_;
+        std::atomic<bool> parentNotified_;
+        std::atomic<bool> progressSampled_; // progress is delivered by UploadProgressSampler
         TempFileDeleter* tempFileDeleter_;
         int index_;
         CFileQueueUploader* uploadManager_;
@@ -23,6 +23,8 @@
 #include <cmath>
 
 #include "Core/Upload/FileUploadTask.h"
+#include "Core/Logging/TraceRecorder.h"
+#include "Core/Metrics/MetricsRegistry.h"
 
 CUploader::CUploader(std::shared_ptr<INetworkClientFactory> networkClientFactory)
 {
@@ -101,6 +103,7 @@ bool CUploader::UploadFile(const std::string& FileName, const std::string& displ
 }
 
 bool CUploader::Upload(std::shared_ptr<UploadTask> task) {
+    TraceSpan uploadSpan("upload", "CUploader::Upload");
     isFatalError_ = false;
     if (!m_CurrentEngine) {
         Error(true, "Cannot proceed: m_CurrentEngine is NULL!");
@@ -178,7 +181,15 @@ bool CUploader::Upload(std::shared_ptr<UploadTask> task) {
             Cleanup();
             return false;
         }
-        EngineRes = m_CurrentEngine->processTask(task, uparams);
+        {
+            TraceSpan processSpan("engine", "processTask");
+            if (processSpan.isActive()) {
+                processSpan.addArg("server", task->serverName());
+                processSpan.addArg("attempt", static_cast<int64_t>(i + 1));
+            }
+            EngineRes = m_CurrentEngine->processTask(task, uparams);
+            processSpan.addArg("result", static_cast<int64_t>(EngineRes));
+        }
         task->setCurrentUploadEngine(nullptr);
 
         if ( EngineRes == -1 ) {
@@ -194,6 +205,8 @@ bool CUploader::Upload(std::shared_ptr<UploadTask> task) {
         }
         if (!EngineRes && i != retryLimit)
         {
+            static MetricFamily<MetricCounter> uploadRetries("iu_upload_retries_total", "Number of upload retries", { "server" });
+            uploadRetries.get({ task->serverName() })->inc();
             Error(false, "", etRepeating, i, topLevelFileName);
         }
     }
@@ -21,19 +21,88 @@
 #include "UploadEngineList.h"
 
 #include <algorithm>
+#include <chrono>
 #include <vector>
 
+#include "Core/Logging/TraceRecorder.h"
+#include "Core/Metrics/MetricsRegistry.h"
 #include "Core/Utils/SimpleXml.h"
 #include "Core/Utils/StringUtils.h"
 #include "AppParams.h"
 
+namespace {
+
+bool isServerVersionSupported(const std::string& serverMinVersion) {
+    if (serverMinVersion.empty()) {
+        return true;
+    }
+    std::vector<std::string> tokens;
+    IuStringUtils::Split(serverMinVersion, ".", tokens, 4);
+    if (tokens.size() < 3) {
+        return true;
+    }
+    auto versionInfo = AppParams::instance()->GetAppVersion();
+    int majorVersion = versionInfo->Major;
+    int minorVersion = versionInfo->Minor*100 + versionInfo->Release;
+    int build = versionInfo->Build;
+
+    int serverMajorVersion = (int)IuCoreUtils::StringToInt64(tokens[0]);
+    int serverMinorVersion = (int)IuCoreUtils::StringToInt64(tokens[1]) * 100 + IuCoreUtils::StringToInt64(tokens[2]);
+    int serverBuild = static_cast<int>(tokens.size() > 3 ? IuCoreUtils::StringToInt64(tokens[3]) : 0);
+    return majorVersion > serverMajorVersion || ( majorVersion == serverMajorVersion && minorVersion > serverMinorVersion)
+        || ( majorVersion == serverMajorVersion && minorVersion ==  serverMinorVersion && ( !serverBuild || build >= serverBuild ));
+}
+
+}
+
 CUploadEngineList::CUploadEngineList()
 {
     m_EngineNumOfRetries = 3;
     m_ActionNumOfRetries = 2;
 }
 
+CUploadEngineList::~CUploadEngineList() = default;
+
+void CUploadEngineList::setCacheDirectory(const std::string& directory)
+{
+    if (directory.empty()) {
+        cache_.reset();
+    } else {
+        cache_ = std::make_unique<UploadEngineListCache>(directory);
+        cache_->removeOrphanedFiles();
+    }
+}
+
 bool CUploadEngineList::loadFromFile(const std::string& filename, ServerSettingsMap& serversSettings)
+{
+    static MetricHistogram* xmlLoadTime = MetricsRegistry::instance()->histogram("iu_server_list_load_seconds",
+        "Time of loading a server list file", { { "source", "xml" } });
+    static MetricHistogram* cacheLoadTime = MetricsRegistry::instance()->histogram("iu_server_list_load_seconds",
+        "Time of loading a server list file", { { "source", "cache" } });
+
+    TraceSpan span("startup", "LoadServerList");
+    span.addArg("file", filename);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<UploadEngineListEntry> entries;
+    bool fromCache = cache_ && cache_->load(filename, entries);
+    if (!fromCache) {
+        if (!parseFile(filename, entries)) {
+            return false;
+        }
+        if (cache_) {
+            cache_->save(filename, entries);
+        }
+    }
+    addEntries(entries, serversSettings);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    (fromCache ? cacheLoadTime : xmlLoadTime)->observe(elapsed);
+    span.addArg("cached", fromCache ? 1 : 0);
+    return true;
+}
+
+bool CUploadEngineList::parseFile(const std::string& filename, std::vector<UploadEngineListEntry>& entries)
 {
     SimpleXml xml;
     if(!xml.LoadFromFile(filename))
@@ -46,227 +115,218 @@ bool CUploadEngineList::loadFromFile(const std::string& filename, ServerSettings
     root.GetChilds("Server2", childs);
     root.GetChilds("Server3", childs);
 
-    auto versionInfo = AppParams::instance()->GetAppVersion();
-    int majorVersion = versionInfo->Major;
-    int minorVersion = versionInfo->Minor*100 + versionInfo->Release;
-    int build = versionInfo->Build;
+    entries.reserve(entries.size() + childs.size());
 
     for(size_t i=0; i<childs.size(); i++)
     {
         SimpleXmlNode &cur = childs[i];
-        auto uploadEngineData = std::make_unique<CUploadEngineData>();
-        CUploadEngineData &UE = *uploadEngineData;
+        UploadEngineListEntry entry;
+        CUploadEngineData &UE = entry.data;
         UE.NeedAuthorization = cur.AttributeInt("Authorize");
         std::string needPassword = cur.Attribute("NeedPassword");
         UE.NeedPassword = needPassword.empty() ? true : (IuCoreUtils::StringToInt64(needPassword)!=0);
         UE.LoginLabel = cur.Attribute("LoginLabel");
         UE.PasswordLabel = cur.Attribute("PasswordLabel");
         std::string RetryLimit = cur.Attribute("RetryLimit");
-        if(RetryLimit.empty())
+        // Default value is taken from settings in addEntries()
+        UE.RetryLimit = RetryLimit.empty() ? -1 : atoi(RetryLimit.c_str());
+
+        UE.Name =  cur.Attribute("Name");
+        entry.minVersion = cur.Attribute("MinVersion");
+
+        UE.SupportsFolders = cur.AttributeBool("SupportsFolders");
+        UE.RegistrationUrl = cur.Attribute("RegistrationUrl");
+        UE.UserAgent = cur.Attribute("UserAgent");
+        UE.PluginName = cur.Attribute("Plugin");
+        UE.Engine = cur.Attribute("Engine");
+        std::string MaxThreadsStr = cur.Attribute("MaxThreads");
+        UE.MaxThreads = atoi(MaxThreadsStr.c_str());
+
+        if ((UE.PluginName == "ftp" || UE.PluginName == "directory") && MaxThreadsStr.empty()) {
+            UE.MaxThreads = 1;
+        }
+
+        UE.UsingPlugin = !UE.PluginName.empty();
+        UE.Debug =   cur.AttributeBool("Debug");
+        if (UE.Debug)
         {
-            // load from settings ;;;
-            UE.RetryLimit = m_EngineNumOfRetries;//Settings.FileRetryLimit;
+            UE.MaxThreads = 1;
         }
-            else
-                UE.RetryLimit = atoi(RetryLimit.c_str());
-
-            UE.Name =  cur.Attribute("Name");
-
-            std::string serverMinVersion = cur.Attribute("MinVersion");
-            if ( !serverMinVersion.empty() ) {
-                std::vector<std::string> tokens;
-                IuStringUtils::Split(serverMinVersion,".", tokens, 4);
-                if ( tokens.size() >= 3 ) {
-                    int serverMajorVersion = (int)IuCoreUtils::StringToInt64(tokens[0]);
-                    int serverMinorVersion = (int)IuCoreUtils::StringToInt64(tokens[1]) * 100 + IuCoreUtils::StringToInt64(tokens[2]);
-                    int serverBuild = static_cast<int>(tokens.size() > 3 ? IuCoreUtils::StringToInt64(tokens[3]) : 0);
-                    if ( !( majorVersion > serverMajorVersion || ( majorVersion == serverMajorVersion && minorVersion > serverMinorVersion) 
-                        || ( majorVersion == serverMajorVersion && minorVersion ==  serverMinorVersion && ( !serverBuild || build >= serverBuild ))
-                        ) ) {
-                            continue;
-                    }
-                }
-            }
+        bool fileHost =  cur.AttributeBool("FileHost");
+        UE.MaxFileSize =   cur.AttributeInt("MaxFileSize");
 
-            UE.SupportsFolders = cur.AttributeBool("SupportsFolders");
-            UE.RegistrationUrl = cur.Attribute("RegistrationUrl");
-            UE.UserAgent = cur.Attribute("UserAgent");
-            UE.PluginName = cur.Attribute("Plugin");
-            UE.Engine = cur.Attribute("Engine");
-            std::string MaxThreadsStr = cur.Attribute("MaxThreads");
-            UE.MaxThreads = atoi(MaxThreadsStr.c_str());
-            
-            if ( UE.PluginName == "ftp" ) {
-                if ( serversSettings[UE.Name].size() ) {
-                    std::string hostname = serversSettings[UE.Name].begin()->second.getParam("hostname");
-                    if ( hostname.empty() || hostname == "ftp.example.com" ) {
-                        //LOG(WARNING) << "Skipping server  "<< UE.Name;
-                        continue;
-                    }
-                } else {
-                    continue;
-                }
-                if (MaxThreadsStr.empty())
-                {
-                    UE.MaxThreads = 1;
-                }
-            }
-            if (UE.PluginName == "directory" && MaxThreadsStr.empty() ) {
-                UE.MaxThreads = 1;
-            }
+        std::string typeString =  cur.Attribute("Type");
+
+        UE.TypeMask = 0;
         
-            UE.UsingPlugin = !UE.PluginName.empty();
-            UE.Debug =   cur.AttributeBool("Debug");
-            if (UE.Debug)
-            {
-                UE.MaxThreads = 1;
-            }
-            bool fileHost =  cur.AttributeBool("FileHost");
-            UE.MaxFileSize =   cur.AttributeInt("MaxFileSize");
+        std::vector<std::string> types;
+        
+        std::string typesListString = cur.Attribute("Types");
+        if (!typesListString.empty())
+        {
+            IuStringUtils::Split(typesListString, " ", types, 10);
+        }
+        if (!typeString.empty()) {
+            types.push_back(typeString);
+        }
+        if (types.empty())
+        {
+            types.emplace_back(fileHost ? "file" : "image");
+        }
+        for (auto& it : types)
+        {
+            UE.TypeMask |= CUploadEngineData::ServerTypeFromString(it);
+        }
 
-            std::string typeString =  cur.Attribute("Type");
+        std::string defaultForTypes = cur.Attribute("DefaultForTypes");
 
-            UE.TypeMask = 0;
-            
-            std::vector<std::string> types;
-            
-            std::string typesListString = cur.Attribute("Types");
-            if (!typesListString.empty())
-            {
-                IuStringUtils::Split(typesListString, " ", types, 10);
-            }
-            if (!typeString.empty()) {
-                types.push_back(typeString);
-            }
-            if (types.empty())
-            {
-                types.emplace_back(fileHost ? "file" : "image");
-            }
-            for (auto& it : types)
-            {
-                UE.TypeMask |= CUploadEngineData::ServerTypeFromString(it);
+        if (!defaultForTypes.empty())
+        {
+            std::vector<std::string> serverTypes;
+            IuStringUtils::Split(defaultForTypes, " ", serverTypes, 10);
+            for( const auto& typeStr: serverTypes) {
+                entry.defaultForTypes |= CUploadEngineData::ServerTypeFromString(typeStr);
             }
+        }
 
-            std::string defaultForTypes = cur.Attribute("DefaultForTypes");
+        std::vector<SimpleXmlNode> actions;
+        cur["Actions"].GetChilds("Action", actions);
 
-            if (!defaultForTypes.empty())
+        for(size_t j=0; j<actions.size(); j++)
+        {
+            SimpleXmlNode &actionNode = actions[j];
+            UploadAction UA;
+            UA.Index = j;
+
+            std::string RetryLimit = actionNode.Attribute("RetryLimit");
+            UA.RetryLimit = RetryLimit.empty() ? -1 : atoi(RetryLimit.c_str());
+             
+            UA.IgnoreErrors = actionNode.AttributeBool("IgnoreErrors");
+            UA.Description= actionNode.Attribute("Description");
+
+            UA.Type = actionNode.Attribute("Type");
+            UA.Url = actionNode.Attribute("Url");
+            UA.Referer = actionNode.Attribute("Referer");
+
+            UA.PostParams = actionNode.Attribute("PostParams");
+            UA.CustomHeaders = actionNode.Attribute("CustomHeaders");
+            UA.OnlyOnce = actionNode.AttributeBool("OnlyOnce");
+
+            ActionRegExp regexp;
+            regexp.Pattern = actionNode.Attribute("RegExp");
+            regexp.AssignVars = actionNode.Attribute("AssignVars");
+            regexp.Required = true;
+            UA.Regexes.push_back(regexp);
+
+            std::vector<SimpleXmlNode> regexpNodes;
+            actionNode.GetChilds("RegExp", regexpNodes);
+
+            for (auto& regexpNode : regexpNodes)
             {
-                std::vector<std::string> serverTypes;
-                IuStringUtils::Split(defaultForTypes, " ", serverTypes, 10);
-                for( const auto& typeStr: serverTypes) {
-                    auto serverType = CUploadEngineData::ServerTypeFromString(typeStr);
-                    if (serverType != CUploadEngineData::TypeInvalid) {
-                        m_defaultServersForType[serverType] = UE.Name;
-                    }
-                }
+                ActionRegExp newRegexp;
+                newRegexp.Pattern = regexpNode.Attribute("Pattern");
+                newRegexp.AssignVars = regexpNode.Attribute("AssignVars");
+                newRegexp.Required = regexpNode.AttributeBool("Required");
+                newRegexp.Data = regexpNode.Attribute("Data");
+                UA.Regexes.push_back(newRegexp);
             }
-//            UE.ImageHost = (UE.TypeMask & CUploadEngineData::TypeImageServer);
 
-            std::vector<SimpleXmlNode> actions;
-            cur["Actions"].GetChilds("Action", actions);
-
-            for(size_t j=0; j<actions.size(); j++)
+            for (auto& reg : UA.Regexes)
             {
-                SimpleXmlNode &actionNode = actions[j];
-                UploadAction UA;
-                UA.Index = j;
+                std::vector<std::string> Vars;
+                IuStringUtils::Split(reg.AssignVars, ";", Vars);
 
-                std::string RetryLimit = actionNode.Attribute("RetryLimit");
-                if(RetryLimit.empty())
+                for (auto it = Vars.begin(); it != Vars.end(); ++it)
                 {
-                    UA.RetryLimit = m_ActionNumOfRetries;//Settings.ActionRetryLimit;
-                }
-                else UA.RetryLimit = atoi(RetryLimit.c_str());
-                 
-                UA.IgnoreErrors = actionNode.AttributeBool("IgnoreErrors");
-                UA.Description= actionNode.Attribute("Description");
-
-                UA.Type = actionNode.Attribute("Type");
-                UA.Url = actionNode.Attribute("Url");
-                UA.Referer = actionNode.Attribute("Referer");
-
-                UA.PostParams = actionNode.Attribute("PostParams");
-                UA.CustomHeaders = actionNode.Attribute("CustomHeaders");
-                UA.OnlyOnce = actionNode.AttributeBool("OnlyOnce");
-
-                ActionRegExp regexp;
-                regexp.Pattern = actionNode.Attribute("RegExp");
-                regexp.AssignVars = actionNode.Attribute("AssignVars");
-                regexp.Required = true;
-                UA.Regexes.push_back(regexp);
-
-                std::vector<SimpleXmlNode> regexpNodes;
-                actionNode.GetChilds("RegExp", regexpNodes);
-
-                for (auto& regexpNode : regexpNodes)
-                {
-                    ActionRegExp newRegexp;
-                    newRegexp.Pattern = regexpNode.Attribute("Pattern");
-                    newRegexp.AssignVars = regexpNode.Attribute("AssignVars");
-                    newRegexp.Required = regexpNode.AttributeBool("Required");
-                    newRegexp.Data = regexpNode.Attribute("Data");
-                    UA.Regexes.push_back(newRegexp);
-                }
-
-                for (auto& reg : UA.Regexes)
-                {
-                    std::vector<std::string> Vars;
-                    IuStringUtils::Split(reg.AssignVars, ";", Vars);
-
-                    for (auto it = Vars.begin(); it != Vars.end(); ++it)
+                    std::vector<std::string> NameAndValue;
+                    IuStringUtils::Split(*it, ":", NameAndValue);
+                    if (NameAndValue.size() == 2)
                     {
-                        std::vector<std::string> NameAndValue;
-                        IuStringUtils::Split(*it, ":", NameAndValue);
-                        if (NameAndValue.size() == 2)
-                        {
-                            ActionVariable AV;
-                            AV.Name = NameAndValue[0];
-                            AV.nIndex = atoi(NameAndValue[1].c_str());
-                            reg.Variables.push_back(AV);
-                        }
+                        ActionVariable AV;
+                        AV.Name = NameAndValue[0];
+                        AV.nIndex = atoi(NameAndValue[1].c_str());
+                        reg.Variables.push_back(AV);
                     }
                 }
-                
-                UE.Actions.push_back(UA);
             }
+            
+            UE.Actions.push_back(UA);
+        }
 
-            SimpleXmlNode resultNode = cur["Result"];
+        SimpleXmlNode resultNode = cur["Result"];
+        {
+
+            UE.DownloadUrlTemplate = resultNode.Attribute("DownloadUrlTemplate");
+            if (UE.DownloadUrlTemplate.empty())
+            {
+                UE.DownloadUrlTemplate = resultNode.Attribute("DownloadUrl");
+            }
+            UE.ImageUrlTemplate = resultNode.Attribute("ImageUrlTemplate");
+            if (UE.ImageUrlTemplate.empty())
+            {
+                UE.ImageUrlTemplate = resultNode.Attribute("ImageUrl");
+            }
+            UE.ThumbUrlTemplate = resultNode.Attribute("ThumbUrlTemplate");
+            if (UE.ThumbUrlTemplate.empty())
             {
+                UE.ThumbUrlTemplate = resultNode.Attribute("ThumbUrl");
+            }
+            UE.EditUrlTemplate = resultNode.Attribute("EditUrl");
+            UE.DeleteUrlTemplate = resultNode.Attribute("DeleteUrl");
+            std::string directUrlTemplate = resultNode.Attribute("DirectUrlTemplate"); 
+            if (directUrlTemplate.empty())
+            {
+                directUrlTemplate = resultNode.Attribute("DirectUrl");
+            }
+            if ( !directUrlTemplate.empty() ) {
 
-                UE.DownloadUrlTemplate = resultNode.Attribute("DownloadUrlTemplate");
-                if (UE.DownloadUrlTemplate.empty())
-                {
-                    UE.DownloadUrlTemplate = resultNode.Attribute("DownloadUrl");
-                }
-                UE.ImageUrlTemplate = resultNode.Attribute("ImageUrlTemplate");
-                if (UE.ImageUrlTemplate.empty())
-                {
-                    UE.ImageUrlTemplate = resultNode.Attribute("ImageUrl");
-                }
-                UE.ThumbUrlTemplate = resultNode.Attribute("ThumbUrlTemplate");
-                if (UE.ThumbUrlTemplate.empty())
-                {
-                    UE.ThumbUrlTemplate = resultNode.Attribute("ThumbUrl");
-                }
-                UE.EditUrlTemplate = resultNode.Attribute("EditUrl");
-                UE.DeleteUrlTemplate = resultNode.Attribute("DeleteUrl");
-                std::string directUrlTemplate = resultNode.Attribute("DirectUrlTemplate"); 
-                if (directUrlTemplate.empty())
-                {
-                    directUrlTemplate = resultNode.Attribute("DirectUrl");
-                }
-                if ( !directUrlTemplate.empty() ) {
+                UE.ImageUrlTemplate = directUrlTemplate;
+            }
 
-                    UE.ImageUrlTemplate = directUrlTemplate;
-                }
+        }
+        UE.SupportThumbnails = !UE.ThumbUrlTemplate.empty();
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
 
+void CUploadEngineList::addEntries(const std::vector<UploadEngineListEntry>& entries, ServerSettingsMap& serversSettings)
+{
+    for (const auto& entry : entries) {
+        if (!isServerVersionSupported(entry.minVersion)) {
+            continue;
+        }
+        const std::string& name = entry.data.Name;
+        if (entry.data.PluginName == "ftp") {
+            if ( serversSettings[name].size() ) {
+                std::string hostname = serversSettings[name].begin()->second.getParam("hostname");
+                if ( hostname.empty() || hostname == "ftp.example.com" ) {
+                    //LOG(WARNING) << "Skipping server  "<< name;
+                    continue;
+                }
+            } else {
+                continue;
             }
-            UE.SupportThumbnails = !UE.ThumbUrlTemplate.empty();
-            m_list.push_back(std::move(uploadEngineData));
         }
+        for (int serverType = CUploadEngineData::TypeImageServer; serverType <= CUploadEngineData::TypeTextServer; serverType <<= 1) {
+            if (entry.defaultForTypes & serverType) {
+                m_defaultServersForType[static_cast<CUploadEngineData::ServerType>(serverType)] = name;
+            }
+        }
+        auto uploadEngineData = std::make_unique<CUploadEngineData>(entry.data);
+        if (uploadEngineData->RetryLimit < 0) {
+            uploadEngineData->RetryLimit = m_EngineNumOfRetries;
+        }
+        for (auto& action : uploadEngineData->Actions) {
+            if (action.RetryLimit < 0) {
+                action.RetryLimit = m_ActionNumOfRetries;
+            }
+        }
+        m_list.push_back(std::move(uploadEngineData));
+    }
 
     std::sort(m_list.begin(), m_list.end(), compareEngines );
-    return true;
+    updateNameIndex();
 }
 
 bool CUploadEngineList::compareEngines(const std::unique_ptr<CUploadEngineData>& elem1, std::unique_ptr<CUploadEngineData>& elem2)
@@ -286,5 +346,6 @@ bool CUploadEngineList::addServer(const CUploadEngineData& data)
     *uploadEngineData = data;
     m_list.push_back(std::move(uploadEngineData));
     std::sort(m_list.begin(), m_list.end(), compareEngines );
+    updateNameIndex();
     return true;
 }
@@ -23,21 +23,34 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 #include "Upload/UploadEngine.h"
+#include "UploadEngineListCache.h"
 #include "Core/Utils/CoreTypes.h"
 
 class CUploadEngineList: public CUploadEngineListBase
 {
     public:
         CUploadEngineList();
+        ~CUploadEngineList() override;
         bool loadFromFile(const std::string& filename, ServerSettingsMap&);
+
+        /**
+         * Enables binary cache of parsed server list files, so loadFromFile() does not parse XML
+         * while the file is unchanged. Pass empty string to disable.
+         */
+        void setCacheDirectory(const std::string& directory);
         void setNumOfRetries(int Engine, int Action);
         bool addServer(const CUploadEngineData& data);
     protected:
         int m_EngineNumOfRetries;
         int m_ActionNumOfRetries;
+        std::unique_ptr<UploadEngineListCache> cache_;
     private:
+        static bool parseFile(const std::string& filename, std::vector<UploadEngineListEntry>& entries);
+        void addEntries(const std::vector<UploadEngineListEntry>& entries, ServerSettingsMap& serversSettings);
         DISALLOW_COPY_AND_ASSIGN(CUploadEngineList);
         bool static compareEngines(const std::unique_ptr<CUploadEngineData>& elem1, std::unique_ptr<CUploadEngineData>& elem2);
 };
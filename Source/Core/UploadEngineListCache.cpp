@@ -0,0 +1,459 @@
+#include "UploadEngineListCache.h"
+
+#include <cstring>
+#include <ctime>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "Core/Logging.h"
+#include "Core/Utils/CoreUtils.h"
+#include "Core/Utils/CryptoUtils.h"
+
+namespace {
+
+const char kMagic[8] = { 'I', 'U', 'S', 'R', 'V', 'C', 'H', 'E' };
+const uint32_t kByteOrderMark = 0x01020304;
+// Modification times closer than this to the time of writing the cache are not trusted
+const int64_t kModificationTimeResolution = 2;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t formatVersion;
+    int64_t sourceSize;
+    int64_t sourceModificationTime;
+    int64_t writeTime; // when the cache file has been written
+    char sourceHash[32]; // MD5 of the source file, hex encoded
+    uint64_t sourcePathSize; // UTF-8 path of the source file follows the header
+    uint64_t payloadSize;
+};
+
+/**
+ * Checks the header of a mapped cache file and returns the path of its source file
+ */
+bool readHeader(const char* data, size_t size, CacheHeader& header, std::string& sourcePath) {
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(header.magic)) || header.byteOrder != kByteOrderMark
+        || header.formatVersion != UploadEngineListCache::kFormatVersion
+        || header.sourcePathSize > size - sizeof(header)
+        || header.payloadSize != size - sizeof(header) - header.sourcePathSize) {
+        return false;
+    }
+    sourcePath.assign(data + sizeof(header), static_cast<size_t>(header.sourcePathSize));
+    return true;
+}
+
+class RecordWriter {
+public:
+    explicit RecordWriter(std::string& out) : out_(out) {}
+
+    void writeInt32(int32_t value) {
+        out_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void writeInt64(int64_t value) {
+        out_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void writeBool(bool value) {
+        out_.push_back(value ? 1 : 0);
+    }
+
+    void writeString(const std::string& value) {
+        writeInt32(static_cast<int32_t>(value.size()));
+        out_.append(value);
+    }
+private:
+    std::string& out_;
+};
+
+/**
+ * Reads records with bounds checking; after the first failure all reads return empty values
+ */
+class RecordReader {
+public:
+    RecordReader(const char* data, size_t size) : p_(data), end_(data + size), ok_(true) {}
+
+    int32_t readInt32() {
+        int32_t value = 0;
+        readRaw(&value, sizeof(value));
+        return value;
+    }
+
+    int64_t readInt64() {
+        int64_t value = 0;
+        readRaw(&value, sizeof(value));
+        return value;
+    }
+
+    bool readBool() {
+        char value = 0;
+        readRaw(&value, 1);
+        return value != 0;
+    }
+
+    std::string readString() {
+        size_t size = readCount();
+        std::string result(p_, size);
+        p_ += size;
+        return result;
+    }
+
+    /**
+     * Reads element count of a string or array. Each element takes at least one byte,
+     * so a count larger than the remaining data means corrupted file.
+     */
+    size_t readCount() {
+        int32_t count = readInt32();
+        if (count < 0 || static_cast<size_t>(count) > static_cast<size_t>(end_ - p_)) {
+            ok_ = false;
+            p_ = end_;
+            return 0;
+        }
+        return static_cast<size_t>(count);
+    }
+
+    bool ok() const {
+        return ok_;
+    }
+
+    bool atEnd() const {
+        return p_ == end_;
+    }
+private:
+    void readRaw(void* value, size_t size) {
+        if (static_cast<size_t>(end_ - p_) < size) {
+            ok_ = false;
+            p_ = end_;
+            return;
+        }
+        memcpy(value, p_, size);
+        p_ += size;
+    }
+    const char* p_;
+    const char* end_;
+    bool ok_;
+};
+
+void writeAction(RecordWriter& writer, const UploadAction& action) {
+    writer.writeInt32(action.Index);
+    writer.writeBool(action.IgnoreErrors);
+    writer.writeBool(action.OnlyOnce);
+    writer.writeString(action.Url);
+    writer.writeString(action.Description);
+    writer.writeString(action.Referer);
+    writer.writeString(action.PostParams);
+    writer.writeString(action.CustomHeaders);
+    writer.writeString(action.Type);
+    writer.writeInt32(action.RetryLimit);
+    writer.writeInt32(static_cast<int32_t>(action.Regexes.size()));
+    for (const auto& regexp : action.Regexes) {
+        writer.writeString(regexp.Pattern);
+        writer.writeString(regexp.Data);
+        writer.writeString(regexp.AssignVars);
+        writer.writeBool(regexp.Required);
+        writer.writeInt32(static_cast<int32_t>(regexp.Variables.size()));
+        for (const auto& variable : regexp.Variables) {
+            writer.writeString(variable.Name);
+            writer.writeInt32(variable.nIndex);
+        }
+    }
+}
+
+void readAction(RecordReader& reader, UploadAction& action) {
+    action.Index = reader.readInt32();
+    action.IgnoreErrors = reader.readBool();
+    action.OnlyOnce = reader.readBool();
+    action.Url = reader.readString();
+    action.Description = reader.readString();
+    action.Referer = reader.readString();
+    action.PostParams = reader.readString();
+    action.CustomHeaders = reader.readString();
+    action.Type = reader.readString();
+    action.RetryLimit = reader.readInt32();
+    size_t regexpCount = reader.readCount();
+    action.Regexes.resize(regexpCount);
+    for (auto& regexp : action.Regexes) {
+        regexp.Pattern = reader.readString();
+        regexp.Data = reader.readString();
+        regexp.AssignVars = reader.readString();
+        regexp.Required = reader.readBool();
+        size_t variableCount = reader.readCount();
+        regexp.Variables.resize(variableCount);
+        for (auto& variable : regexp.Variables) {
+            variable.Name = reader.readString();
+            variable.nIndex = reader.readInt32();
+        }
+    }
+}
+
+}
+
+UploadEngineListCache::UploadEngineListCache(std::string directory) : directory_(std::move(directory)) {
+    if (!directory_.empty() && directory_.back() != '/' && directory_.back() != '\\') {
+        directory_ += '/';
+    }
+}
+
+std::string UploadEngineListCache::cacheFileName(const std::string& sourceFileName) const {
+    // Different files may have the same name (e.g. Data/Servers/ and user's Servers/ folder)
+    std::string pathHash = IuCoreUtils::CryptoUtils::CalcMD5HashFromString(sourceFileName).substr(0, 8);
+    return directory_ + IuCoreUtils::ExtractFileNameNoExt(sourceFileName) + "_" + pathHash + ".bin";
+}
+
+bool UploadEngineListCache::getSourceInfo(const std::string& fileName, SourceInfo& info) {
+    boost::system::error_code ec;
+#ifdef _WIN32
+    boost::filesystem::path path(IuCoreUtils::Utf8ToWstring(fileName));
+#else
+    boost::filesystem::path path(fileName);
+#endif
+    auto size = boost::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    auto modificationTime = boost::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    info.size = static_cast<int64_t>(size);
+    info.modificationTime = static_cast<int64_t>(modificationTime);
+    return true;
+}
+
+bool UploadEngineListCache::load(const std::string& sourceFileName, std::vector<UploadEngineListEntry>& entries) {
+    namespace bip = boost::interprocess;
+    SourceInfo info;
+    if (!getSourceInfo(sourceFileName, info)) {
+        return false;
+    }
+    std::string fileName = cacheFileName(sourceFileName);
+    if (!IuCoreUtils::FileExists(fileName)) {
+        return false;
+    }
+    bool touched = false;
+    try {
+#ifdef _WIN32
+        bip::file_mapping mapping(IuCoreUtils::Utf8ToWstring(fileName).c_str(), bip::read_only);
+#else
+        bip::file_mapping mapping(fileName.c_str(), bip::read_only);
+#endif
+        bip::mapped_region region(mapping, bip::read_only);
+        auto data = static_cast<const char*>(region.get_address());
+        size_t size = region.get_size();
+        CacheHeader header;
+        std::string sourcePath;
+        if (!readHeader(data, size, header, sourcePath) || sourcePath != sourceFileName || header.sourceSize != info.size) {
+            return false;
+        }
+        if (header.sourceModificationTime != info.modificationTime
+            || header.writeTime - header.sourceModificationTime < kModificationTimeResolution) {
+            info.hash = IuCoreUtils::CryptoUtils::CalcMD5HashFromFile(sourceFileName);
+            if (info.hash.size() != sizeof(header.sourceHash) || memcmp(info.hash.data(), header.sourceHash, sizeof(header.sourceHash))) {
+                return false;
+            }
+            touched = true;
+        }
+        if (!deserialize(data + sizeof(header) + header.sourcePathSize, static_cast<size_t>(header.payloadSize), entries)) {
+            LOG(WARNING) << "Server list cache file is corrupted: " << fileName;
+            return false;
+        }
+    } catch (const bip::interprocess_exception& ex) {
+        LOG(WARNING) << "Cannot read server list cache file " << fileName << ": " << ex.what();
+        return false;
+    }
+    if (touched && time(nullptr) - info.modificationTime >= kModificationTimeResolution) {
+        // Source file has not been changed, store the new modification time and write time to avoid hashing next time
+        write(sourceFileName, info, entries);
+    }
+    return true;
+}
+
+bool UploadEngineListCache::save(const std::string& sourceFileName, const std::vector<UploadEngineListEntry>& entries) {
+    SourceInfo info;
+    if (!getSourceInfo(sourceFileName, info)) {
+        return false;
+    }
+    info.hash = IuCoreUtils::CryptoUtils::CalcMD5HashFromFile(sourceFileName);
+    return write(sourceFileName, info, entries);
+}
+
+bool UploadEngineListCache::write(const std::string& sourceFileName, const SourceInfo& info, const std::vector<UploadEngineListEntry>& entries) {
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    if (info.hash.size() != sizeof(header.sourceHash)) {
+        return false;
+    }
+    memcpy(header.magic, kMagic, sizeof(header.magic));
+    header.byteOrder = kByteOrderMark;
+    header.formatVersion = kFormatVersion;
+    header.sourceSize = info.size;
+    header.sourceModificationTime = info.modificationTime;
+    header.writeTime = static_cast<int64_t>(time(nullptr));
+    memcpy(header.sourceHash, info.hash.data(), sizeof(header.sourceHash));
+    header.sourcePathSize = sourceFileName.size();
+
+    std::string payload = serialize(entries);
+    header.payloadSize = payload.size();
+    std::string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+    contents += sourceFileName;
+    contents += payload;
+
+    if (!IuCoreUtils::DirectoryExists(directory_) && !IuCoreUtils::CreateDir(directory_, 0755)) {
+        LOG(WARNING) << "Cannot create directory " << directory_;
+        return false;
+    }
+    std::string fileName = cacheFileName(sourceFileName);
+    // Write via temporary file so another process never reads a partially written cache
+    std::string tempFileName = fileName + ".tmp";
+    if (!IuCoreUtils::PutFileContents(tempFileName, contents)) {
+        LOG(WARNING) << "Cannot write server list cache file " << tempFileName;
+        return false;
+    }
+    boost::system::error_code ec;
+#ifdef _WIN32
+    boost::filesystem::rename(IuCoreUtils::Utf8ToWstring(tempFileName), IuCoreUtils::Utf8ToWstring(fileName), ec);
+#else
+    boost::filesystem::rename(tempFileName, fileName, ec);
+#endif
+    if (ec) {
+        LOG(WARNING) << "Cannot write server list cache file " << fileName << ": " << ec.message();
+        IuCoreUtils::RemoveFile(tempFileName);
+        return false;
+    }
+    return true;
+}
+
+void UploadEngineListCache::removeOrphanedFiles() {
+    namespace fs = boost::filesystem;
+    namespace bip = boost::interprocess;
+    boost::system::error_code ec;
+#ifdef _WIN32
+    fs::path directory(IuCoreUtils::Utf8ToWstring(directory_));
+#else
+    fs::path directory(directory_);
+#endif
+    std::vector<fs::path> orphanedFiles;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != ".bin") {
+            continue;
+        }
+        std::string sourcePath;
+        try {
+#ifdef _WIN32
+            bip::file_mapping mapping(it->path().wstring().c_str(), bip::read_only);
+#else
+            bip::file_mapping mapping(it->path().c_str(), bip::read_only);
+#endif
+            bip::mapped_region region(mapping, bip::read_only);
+            CacheHeader header;
+            if (!readHeader(static_cast<const char*>(region.get_address()), region.get_size(), header, sourcePath)) {
+                // Written by another version of the program
+                continue;
+            }
+        } catch (const bip::interprocess_exception& ex) {
+            LOG(WARNING) << "Cannot read server list cache file " << it->path().string() << ": " << ex.what();
+            continue;
+        }
+        if (!IuCoreUtils::FileExists(sourcePath)) {
+            orphanedFiles.push_back(it->path());
+        }
+    }
+    for (const auto& path : orphanedFiles) {
+        fs::remove(path, ec);
+    }
+}
+
+std::string UploadEngineListCache::serialize(const std::vector<UploadEngineListEntry>& entries) {
+    std::string result;
+    RecordWriter writer(result);
+    writer.writeInt32(static_cast<int32_t>(entries.size()));
+    for (const auto& entry : entries) {
+        const CUploadEngineData& ued = entry.data;
+        writer.writeString(entry.minVersion);
+        writer.writeInt32(entry.defaultForTypes);
+        writer.writeString(ued.Name);
+        writer.writeString(ued.PluginName);
+        writer.writeBool(ued.SupportsFolders);
+        writer.writeBool(ued.UsingPlugin);
+        writer.writeBool(ued.Debug);
+        writer.writeBool(ued.SupportThumbnails);
+        writer.writeBool(ued.BeforehandAuthorization);
+        writer.writeInt32(ued.NeedAuthorization);
+        writer.writeBool(ued.NeedPassword);
+        writer.writeInt64(ued.MaxFileSize);
+        writer.writeString(ued.RegistrationUrl);
+        writer.writeString(ued.CodedLogin);
+        writer.writeString(ued.CodedPassword);
+        writer.writeString(ued.ThumbUrlTemplate);
+        writer.writeString(ued.ImageUrlTemplate);
+        writer.writeString(ued.DownloadUrlTemplate);
+        writer.writeString(ued.DeleteUrlTemplate);
+        writer.writeString(ued.EditUrlTemplate);
+        writer.writeString(ued.LoginLabel);
+        writer.writeString(ued.PasswordLabel);
+        writer.writeString(ued.UserAgent);
+        writer.writeString(ued.Engine);
+        writer.writeInt32(ued.RetryLimit);
+        writer.writeInt32(ued.MaxThreads);
+        writer.writeInt32(ued.TypeMask);
+        writer.writeInt32(static_cast<int32_t>(ued.Actions.size()));
+        for (const auto& action : ued.Actions) {
+            writeAction(writer, action);
+        }
+    }
+    return result;
+}
+
+bool UploadEngineListCache::deserialize(const char* data, size_t size, std::vector<UploadEngineListEntry>& entries) {
+    RecordReader reader(data, size);
+    size_t count = reader.readCount();
+    std::vector<UploadEngineListEntry> result(count);
+    for (auto& entry : result) {
+        CUploadEngineData& ued = entry.data;
+        entry.minVersion = reader.readString();
+        entry.defaultForTypes = reader.readInt32();
+        ued.Name = reader.readString();
+        ued.PluginName = reader.readString();
+        ued.SupportsFolders = reader.readBool();
+        ued.UsingPlugin = reader.readBool();
+        ued.Debug = reader.readBool();
+        ued.SupportThumbnails = reader.readBool();
+        ued.BeforehandAuthorization = reader.readBool();
+        ued.NeedAuthorization = reader.readInt32();
+        ued.NeedPassword = reader.readBool();
+        ued.MaxFileSize = reader.readInt64();
+        ued.RegistrationUrl = reader.readString();
+        ued.CodedLogin = reader.readString();
+        ued.CodedPassword = reader.readString();
+        ued.ThumbUrlTemplate = reader.readString();
+        ued.ImageUrlTemplate = reader.readString();
+        ued.DownloadUrlTemplate = reader.readString();
+        ued.DeleteUrlTemplate = reader.readString();
+        ued.EditUrlTemplate = reader.readString();
+        ued.LoginLabel = reader.readString();
+        ued.PasswordLabel = reader.readString();
+        ued.UserAgent = reader.readString();
+        ued.Engine = reader.readString();
+        ued.RetryLimit = reader.readInt32();
+        ued.MaxThreads = reader.readInt32();
+        ued.TypeMask = reader.readInt32();
+        size_t actionCount = reader.readCount();
+        ued.Actions.resize(actionCount);
+        for (auto& action : ued.Actions) {
+            readAction(reader, action);
+        }
+        if (!reader.ok()) {
+            return false;
+        }
+    }
+    if (!reader.ok() || !reader.atEnd()) {
+        return false;
+    }
+    entries = std::move(result);
+    return true;
+}
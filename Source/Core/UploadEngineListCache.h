@@ -0,0 +1,65 @@
+#ifndef IU_CORE_UPLOADENGINELISTCACHE_H
+#define IU_CORE_UPLOADENGINELISTCACHE_H
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Upload/UploadEngine.h"
+
+/**
+ * Server description as it is stored in the server list file,
+ * before filtering by program version and user settings.
+ */
+struct UploadEngineListEntry {
+    CUploadEngineData data; // RetryLimit of the server and its actions is -1 when not specified
+    std::string minVersion;
+    int defaultForTypes = 0; // mask of CUploadEngineData::ServerType
+};
+
+/**
+@brief UploadEngineListCache stores parsed server list files in binary form, so XML parsing
+can be skipped on startup.
+
+The cache file consists of a fixed header, the path of the source file and length-prefixed records
+without any pointers, so it is read directly from a memory mapped file. A cache file is valid while
+the format version matches and the source file has the same size and modification time.
+The MD5 hash of the source file is compared with the stored one if the modification time has changed
+or if it is too close to the time the cache was written: modification times have one second resolution
+on some file systems, so a change made in the same second would not be noticed.
+Increase kFormatVersion after any change of CUploadEngineData or UploadEngineListEntry.
+*/
+class UploadEngineListCache {
+public:
+    static const uint32_t kFormatVersion = 2;
+
+    explicit UploadEngineListCache(std::string directory);
+
+    /**
+     * Returns false if there is no valid cache for the source file
+     */
+    bool load(const std::string& sourceFileName, std::vector<UploadEngineListEntry>& entries);
+    bool save(const std::string& sourceFileName, const std::vector<UploadEngineListEntry>& entries);
+
+    std::string cacheFileName(const std::string& sourceFileName) const;
+
+    /**
+     * Deletes cache files whose source files do not exist anymore
+     */
+    void removeOrphanedFiles();
+
+    static std::string serialize(const std::vector<UploadEngineListEntry>& entries);
+    static bool deserialize(const char* data, size_t size, std::vector<UploadEngineListEntry>& entries);
+private:
+    struct SourceInfo {
+        int64_t size = -1;
+        int64_t modificationTime = 0;
+        std::string hash; // calculated on demand
+    };
+    static bool getSourceInfo(const std::string& fileName, SourceInfo& info);
+    bool write(const std::string& sourceFileName, const SourceInfo& info, const std::vector<UploadEngineListEntry>& entries);
+    std::string directory_;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "AsyncOutputWriter.h"
+
+AsyncOutputWriter::AsyncOutputWriter(FILE* out, size_t maxBufferSize) : out_(out), maxBufferSize_(maxBufferSize),
+    enqueuedBytes_(0), writtenBytes_(0), stop_(false), droppedCount_(0) {
+    thread_ = std::thread(&AsyncOutputWriter::worker, this);
+}
+
+AsyncOutputWriter::~AsyncOutputWriter() {
+    close();
+}
+
+bool AsyncOutputWriter::write(const std::string& data, bool droppable) {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (stop_ || (droppable && buffer_.size() + data.size() > maxBufferSize_)) {
+            ++droppedCount_;
+            return false;
+        }
+        buffer_ += data;
+        enqueuedBytes_ += data.size();
+    }
+    dataCondition_.notify_one();
+    return true;
+}
+
+void AsyncOutputWriter::flush() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    uint64_t target = enqueuedBytes_;
+    writtenCondition_.wait(lk, [&] { return writtenBytes_ >= target; });
+}
+
+void AsyncOutputWriter::close() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+    }
+    dataCondition_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    writtenCondition_.notify_all();
+}
+
+int64_t AsyncOutputWriter::droppedCount() const {
+    return droppedCount_;
+}
+
+void AsyncOutputWriter::worker() {
+    std::string data;
+    std::unique_lock<std::mutex> lk(mutex_);
+    for (;;) {
+        dataCondition_.wait(lk, [this] { return stop_ || !buffer_.empty(); });
+        if (buffer_.empty()) {
+            break;
+        }
+        data.clear();
+        data.swap(buffer_);
+        lk.unlock();
+        fwrite(data.data(), 1, data.size(), out_);
+        fflush(out_);
+        lk.lock();
+        writtenBytes_ += data.size();
+        writtenCondition_.notify_all();
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef IU_CORE_UTILS_ASYNCOUTPUTWRITER_H
+#define IU_CORE_UTILS_ASYNCOUTPUTWRITER_H
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+#include "CoreTypes.h"
+
+/**
+@brief AsyncOutputWriter writes text to a FILE (e.g. stdout) in a background thread.
+
+write() only appends to an in-memory buffer, so the calling thread is never blocked by slow output
+(console, full pipe). Droppable data (e.g. progress samples) is discarded when the buffer exceeds the limit,
+other data is always kept.
+*/
+class AsyncOutputWriter {
+public:
+    explicit AsyncOutputWriter(FILE* out, size_t maxBufferSize = 4 * 1024 * 1024);
+    ~AsyncOutputWriter();
+
+    /**
+     * @return false if data has been dropped
+     */
+    bool write(const std::string& data, bool droppable = false);
+
+    /**
+     * Blocks until all data written before the call is passed to the file
+     */
+    void flush();
+
+    /**
+     * Writes remaining data and stops the background thread
+     */
+    void close();
+
+    int64_t droppedCount() const;
+private:
+    void worker();
+
+    FILE* out_;
+    size_t maxBufferSize_;
+    std::string buffer_;
+    std::mutex mutex_;
+    std::condition_variable dataCondition_;
+    std::condition_variable writtenCondition_;
+    uint64_t enqueuedBytes_;
+    uint64_t writtenBytes_;
+    bool stop_;
+    std::atomic<int64_t> droppedCount_;
+    std::thread thread_;
+    DISALLOW_COPY_AND_ASSIGN(AsyncOutputWriter);
+};
+
+#endif
@@ -40,6 +40,14 @@ namespace CryptoUtils {
     std::string Base64Encode(const std::string& data);
     std::string Base64Decode(const std::string& data);
     bool Base64EncodeFile(const std::string& fileName, std::string& result);
+
+    /**
+     * Encrypts data stored on disk. On Windows it is bound to the current user account (DPAPI),
+     * on other systems AES-256-GCM is used with a random key from keyFileName, which is created
+     * with owner-only permissions on first use (keyFileName is ignored on Windows).
+     */
+    bool ProtectData(const std::string& data, const std::string& keyFileName, std::string& result);
+    bool UnprotectData(const std::string& data, const std::string& keyFileName, std::string& result);
 };
 
 };
@@ -26,6 +26,11 @@
 #include <openssl/md5.h>
 #include <openssl/sha.h>
 #include <openssl/hmac.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "Core/3rdpart/base64.h"
 
 namespace IuCoreUtils {
@@ -188,4 +193,98 @@ std::string CryptoUtils::CalcSHA1HashFromFile(const std::string& filename) {
     return CalcSHA1HashFromFileWithPrefix(filename, "", "");
 }
 
+namespace {
+
+const size_t PROTECT_KEY_SIZE = 32, PROTECT_IV_SIZE = 12, PROTECT_TAG_SIZE = 16;
+
+bool ReadProtectKey(const std::string& keyFileName, bool create, unsigned char* key) {
+    int fd = open(keyFileName.c_str(), O_RDONLY);
+    if (fd < 0 && create) {
+        unsigned char newKey[PROTECT_KEY_SIZE];
+        if (RAND_bytes(newKey, sizeof(newKey)) != 1) {
+            return false;
+        }
+        // O_EXCL: another process may be creating the key at the same time
+        fd = open(keyFileName.c_str(), O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        if (fd >= 0) {
+            bool ok = write(fd, newKey, sizeof(newKey)) == static_cast<ssize_t>(sizeof(newKey)) && fsync(fd) == 0;
+            close(fd);
+            if (!ok) {
+                unlink(keyFileName.c_str());
+                return false;
+            }
+        }
+        fd = open(keyFileName.c_str(), O_RDONLY);
+    }
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t bytesRead = read(fd, key, PROTECT_KEY_SIZE);
+    close(fd);
+    return bytesRead == static_cast<ssize_t>(PROTECT_KEY_SIZE);
+}
+
+}
+
+bool CryptoUtils::ProtectData(const std::string& data, const std::string& keyFileName, std::string& result) {
+    unsigned char key[PROTECT_KEY_SIZE];
+    if (!ReadProtectKey(keyFileName, true, key)) {
+        return false;
+    }
+    std::string output(PROTECT_IV_SIZE + data.size() + PROTECT_TAG_SIZE, '\0');
+    auto* iv = reinterpret_cast<unsigned char*>(&output[0]);
+    auto* cipherText = iv + PROTECT_IV_SIZE;
+    if (RAND_bytes(iv, PROTECT_IV_SIZE) != 1) {
+        return false;
+    }
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        return false;
+    }
+    int len = 0, finalLen = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, iv) == 1
+        && EVP_EncryptUpdate(ctx, cipherText, &len, reinterpret_cast<const unsigned char*>(data.data()),
+            static_cast<int>(data.size())) == 1
+        && EVP_EncryptFinal_ex(ctx, cipherText + len, &finalLen) == 1
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, PROTECT_TAG_SIZE, cipherText + len + finalLen) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok) {
+        return false;
+    }
+    result = std::move(output);
+    return true;
+}
+
+bool CryptoUtils::UnprotectData(const std::string& data, const std::string& keyFileName, std::string& result) {
+    if (data.size() < PROTECT_IV_SIZE + PROTECT_TAG_SIZE) {
+        return false;
+    }
+    unsigned char key[PROTECT_KEY_SIZE];
+    if (!ReadProtectKey(keyFileName, false, key)) {
+        return false;
+    }
+    auto* iv = reinterpret_cast<const unsigned char*>(data.data());
+    const unsigned char* cipherText = iv + PROTECT_IV_SIZE;
+    int cipherTextSize = static_cast<int>(data.size() - PROTECT_IV_SIZE - PROTECT_TAG_SIZE);
+    std::string output(cipherTextSize, '\0');
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        return false;
+    }
+    int len = 0, finalLen = 0;
+    // The tag check fails if the file has been modified or the key has been replaced
+    bool ok = EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, iv) == 1
+        && EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(&output[0]), &len, cipherText, cipherTextSize) == 1
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, PROTECT_TAG_SIZE,
+            const_cast<unsigned char*>(cipherText + cipherTextSize)) == 1
+        && EVP_DecryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(&output[0]) + len, &finalLen) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok) {
+        return false;
+    }
+    output.resize(len + finalLen);
+    result = std::move(output);
+    return true;
+}
+
 }; // end of namespace IuCoreUtils
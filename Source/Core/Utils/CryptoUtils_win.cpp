@@ -379,5 +379,29 @@ std::string CryptoUtils::CalcSHA1HashFromFileWithPrefix(const std::string& filen
     return GetHashTextFromFile(filename, HashSha1, prefix, postfix);
 }
 
+bool CryptoUtils::ProtectData(const std::string& data, const std::string& /*keyFileName*/, std::string& result) {
+    DATA_BLOB input, output;
+    input.pbData = reinterpret_cast<BYTE*>(const_cast<char*>(data.data()));
+    input.cbData = static_cast<DWORD>(data.size());
+    if (!CryptProtectData(&input, L"Image Uploader", nullptr, nullptr, nullptr, CRYPTPROTECT_UI_FORBIDDEN, &output)) {
+        return false;
+    }
+    result.assign(reinterpret_cast<const char*>(output.pbData), output.cbData);
+    LocalFree(output.pbData);
+    return true;
+}
+
+bool CryptoUtils::UnprotectData(const std::string& data, const std::string& /*keyFileName*/, std::string& result) {
+    DATA_BLOB input, output;
+    input.pbData = reinterpret_cast<BYTE*>(const_cast<char*>(data.data()));
+    input.cbData = static_cast<DWORD>(data.size());
+    if (!CryptUnprotectData(&input, nullptr, nullptr, nullptr, nullptr, CRYPTPROTECT_UI_FORBIDDEN, &output)) {
+        return false;
+    }
+    result.assign(reinterpret_cast<const char*>(output.pbData), output.cbData);
+    LocalFree(output.pbData);
+    return true;
+}
+
 
 }; // end of namespace IuCoreUtils
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "FolderWatcher.h"
+
+#include <chrono>
+#include <cstring>
+#include <boost/filesystem.hpp>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <poll.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+#endif
+
+#include "Core/Logging.h"
+#include "CoreUtils.h"
+
+FileWriteDebouncer::FileWriteDebouncer(int intervalMs) : intervalMs_(intervalMs) {
+}
+
+void FileWriteDebouncer::setInterval(int intervalMs) {
+    intervalMs_ = intervalMs;
+}
+
+void FileWriteDebouncer::fileModified(const std::string& name) {
+    // File is being written again, wait for the next close
+    files_[name].closed = false;
+}
+
+void FileWriteDebouncer::fileClosed(const std::string& name, int64_t now) {
+    FileState& state = files_[name];
+    state.closed = true;
+    state.deadline = now + intervalMs_;
+}
+
+void FileWriteDebouncer::fileRemoved(const std::string& name) {
+    files_.erase(name);
+}
+
+std::vector<std::string> FileWriteDebouncer::takeReady(int64_t now) {
+    std::vector<std::string> result;
+    for (auto it = files_.begin(); it != files_.end();) {
+        if (it->second.closed && it->second.deadline <= now) {
+            result.push_back(it->first);
+            it = files_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return result;
+}
+
+int FileWriteDebouncer::timeUntilNextDeadline(int64_t now) const {
+    int64_t nearest = -1;
+    for (const auto& file : files_) {
+        if (file.second.closed && (nearest == -1 || file.second.deadline < nearest)) {
+            nearest = file.second.deadline;
+        }
+    }
+    if (nearest == -1) {
+        return -1;
+    }
+    return nearest > now ? static_cast<int>(nearest - now) : 0;
+}
+
+FolderWatcher::FolderWatcher() : intervalMs_(100), stop_(false) {
+#ifdef __linux__
+    inotifyFd_ = -1;
+    stopPipe_[0] = stopPipe_[1] = -1;
+#endif
+}
+
+FolderWatcher::~FolderWatcher() {
+    stop();
+}
+
+void FolderWatcher::setDebounceInterval(int intervalMs) {
+    intervalMs_ = intervalMs;
+    debouncer_.setInterval(intervalMs);
+}
+
+int64_t FolderWatcher::now() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool FolderWatcher::start(const std::string& directory, FileReadyCallback callback) {
+    stop();
+    directory_ = directory;
+    callback_ = std::move(callback);
+    stop_ = false;
+#ifdef __linux__
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) {
+        LOG(ERROR) << "inotify_init1 failed: " << strerror(errno);
+        return false;
+    }
+    if (inotify_add_watch(inotifyFd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY | IN_DELETE | IN_MOVED_FROM) < 0) {
+        LOG(ERROR) << "Cannot watch directory " << directory << ": " << strerror(errno);
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+        return false;
+    }
+    if (pipe2(stopPipe_, O_CLOEXEC) != 0) {
+        LOG(ERROR) << "pipe2 failed: " << strerror(errno);
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+        return false;
+    }
+#else
+    if (!IuCoreUtils::DirectoryExists(directory)) {
+        LOG(ERROR) << "Cannot watch directory " << directory << ": directory doesn't exist";
+        return false;
+    }
+    scannedFiles_.clear();
+    scanDirectory(true);
+#endif
+    thread_ = std::thread(&FolderWatcher::run, this);
+    return true;
+}
+
+void FolderWatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lk(stopMutex_);
+        stop_ = true;
+    }
+    stopCondition_.notify_one();
+#ifdef __linux__
+    if (stopPipe_[1] != -1) {
+        char c = 0;
+        if (write(stopPipe_[1], &c, 1) < 0) {
+            LOG(ERROR) << "Cannot stop folder watcher: " << strerror(errno);
+        }
+    }
+#endif
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+#ifdef __linux__
+    auto closeDescriptor = [](int& fd) {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
+    };
+    closeDescriptor(inotifyFd_);
+    closeDescriptor(stopPipe_[0]);
+    closeDescriptor(stopPipe_[1]);
+#endif
+}
+
+void FolderWatcher::notifyReadyFiles() {
+    for (const auto& name : debouncer_.takeReady(now())) {
+        callback_(directory_ + "/" + name);
+    }
+}
+
+#ifdef __linux__
+
+void FolderWatcher::run() {
+    for (;;) {
+        pollfd fds[2];
+        fds[0].fd = inotifyFd_;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = stopPipe_[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        int res = poll(fds, 2, debouncer_.timeUntilNextDeadline(now()));
+        if (res < 0 && errno != EINTR) {
+            LOG(ERROR) << "poll failed: " << strerror(errno);
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            readEvents();
+        }
+        notifyReadyFiles();
+    }
+}
+
+void FolderWatcher::readEvents() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t length = read(inotifyFd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        int64_t time = now();
+        for (char* p = buffer; p < buffer + length;) {
+            auto* event = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                LOG(WARNING) << "Folder watcher event queue overflow, some files may be missed";
+                continue;
+            }
+            if (!event->len || (event->mask & IN_ISDIR)) {
+                continue;
+            }
+            std::string name(event->name);
+            if (name.empty() || name[0] == '.') {
+                continue;
+            }
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                debouncer_.fileRemoved(name);
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                debouncer_.fileClosed(name, time);
+            } else if (event->mask & IN_MODIFY) {
+                debouncer_.fileModified(name);
+            }
+        }
+    }
+}
+
+#else
+
+void FolderWatcher::run() {
+    std::unique_lock<std::mutex> lk(stopMutex_);
+    for (;;) {
+        stopCondition_.wait_for(lk, std::chrono::milliseconds(intervalMs_), [this] { return stop_; });
+        if (stop_) {
+            break;
+        }
+        lk.unlock();
+        scanDirectory(false);
+        notifyReadyFiles();
+        lk.lock();
+    }
+}
+
+void FolderWatcher::scanDirectory(bool initial) {
+    namespace fs = boost::filesystem;
+    boost::system::error_code ec;
+#ifdef _WIN32
+    fs::path root(IuCoreUtils::Utf8ToWstring(directory_));
+#else
+    fs::path root(directory_);
+#endif
+    std::map<std::string, ScannedFile> files;
+    int64_t time = now();
+    for (fs::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        boost::system::error_code fileError;
+        if (!fs::is_regular_file(it->status(fileError))) {
+            continue;
+        }
+#ifdef _WIN32
+        std::string name = IuCoreUtils::WstringToUtf8(it->path().filename().wstring());
+#else
+        std::string name = it->path().filename().string();
+#endif
+        if (name.empty() || name[0] == '.') {
+            continue;
+        }
+        ScannedFile file;
+        file.size = static_cast<int64_t>(fs::file_size(it->path(), fileError));
+        file.modificationTime = static_cast<int64_t>(fs::last_write_time(it->path(), fileError));
+        auto previous = scannedFiles_.find(name);
+        if (initial) {
+            file.reported = true;
+        } else if (previous == scannedFiles_.end() || previous->second.size != file.size
+            || previous->second.modificationTime != file.modificationTime) {
+            debouncer_.fileModified(name);
+        } else if (!previous->second.reported) {
+            // Size and modification time have not changed since the previous scan
+            debouncer_.fileClosed(name, time);
+            file.reported = true;
+        } else {
+            file.reported = true;
+        }
+        files[name] = file;
+    }
+    for (const auto& file : scannedFiles_) {
+        if (files.find(file.first) == files.end()) {
+            debouncer_.fileRemoved(file.first);
+        }
+    }
+    scannedFiles_.swap(files);
+}
+
+#endif
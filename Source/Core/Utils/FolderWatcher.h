@@ -0,0 +1,99 @@
+#ifndef IU_CORE_UTILS_FOLDERWATCHER_H
+#define IU_CORE_UTILS_FOLDERWATCHER_H
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CoreTypes.h"
+
+/**
+@brief Tracks files being written. A file is ready when it has been closed after writing
+and has not been modified again during the debounce interval.
+*/
+class FileWriteDebouncer {
+public:
+    explicit FileWriteDebouncer(int intervalMs = 100);
+    void setInterval(int intervalMs);
+
+    void fileModified(const std::string& name);
+    void fileClosed(const std::string& name, int64_t now);
+    void fileRemoved(const std::string& name);
+
+    /**
+     * Returns files which became ready by the time 'now' (and forgets them)
+     */
+    std::vector<std::string> takeReady(int64_t now);
+
+    /**
+     * Returns milliseconds until the nearest file becomes ready, or -1 if there are no closed files
+     */
+    int timeUntilNextDeadline(int64_t now) const;
+private:
+    struct FileState {
+        bool closed = false;
+        int64_t deadline = 0;
+    };
+    std::map<std::string, FileState> files_;
+    int intervalMs_;
+};
+
+/**
+@brief FolderWatcher reports files written to a directory (not recursively).
+
+On Linux it uses inotify (IN_CLOSE_WRITE/IN_MOVED_TO), so a file is reported right after the writer
+closes it and the debounce interval passes. On other platforms the directory is polled and a file is
+reported when its size and modification time stop changing. Files existing before start() and hidden
+files (starting with '.', usually temporary files of editors and downloaders) are ignored.
+The callback is called in the watcher thread.
+*/
+class FolderWatcher {
+public:
+    typedef std::function<void(const std::string&)> FileReadyCallback;
+
+    FolderWatcher();
+    ~FolderWatcher();
+
+    void setDebounceInterval(int intervalMs);
+    bool start(const std::string& directory, FileReadyCallback callback);
+    void stop();
+
+    static int64_t now();
+private:
+    void run();
+#ifdef __linux__
+    void readEvents();
+#else
+    void scanDirectory(bool initial);
+    struct ScannedFile {
+        int64_t size = 0;
+        int64_t modificationTime = 0;
+        bool reported = false;
+    };
+    std::map<std::string, ScannedFile> scannedFiles_;
+#endif
+    void notifyReadyFiles();
+
+    std::string directory_;
+    FileReadyCallback callback_;
+    FileWriteDebouncer debouncer_;
+    int intervalMs_;
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+    bool stop_;
+#ifdef __linux__
+    int inotifyFd_;
+    int stopPipe_[2];
+#endif
+    DISALLOW_COPY_AND_ASSIGN(FolderWatcher);
+};
+
+#endif
@@ -0,0 +1,325 @@
+#include "JsonWriter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// jsoncpp writes arrays of scalars on a single line if it is shorter than this
+const size_t kRightMargin = 74;
+
+struct EscapeTable {
+    bool needsEscape[256];
+
+    EscapeTable() {
+        for (int i = 0; i < 256; i++) {
+            needsEscape[i] = i < 0x20 || i >= 0x80 || i == '"' || i == '\\';
+        }
+    }
+};
+
+const EscapeTable escapeTable;
+
+void appendHex(std::string& out, unsigned int codepoint) {
+    static const char hex[] = "0123456789abcdef";
+    char buf[6] = { '\\', 'u', hex[(codepoint >> 12) & 0xF], hex[(codepoint >> 8) & 0xF], hex[(codepoint >> 4) & 0xF], hex[codepoint & 0xF] };
+    out.append(buf, sizeof(buf));
+}
+
+// Same decoding as in jsoncpp, invalid sequences are replaced by U+FFFD
+unsigned int utf8ToCodepoint(const char*& s, const char* e) {
+    const unsigned int replacementCharacter = 0xFFFD;
+    unsigned int firstByte = static_cast<unsigned char>(*s);
+
+    if (firstByte < 0x80) {
+        return firstByte;
+    }
+    if (firstByte < 0xE0) {
+        if (e - s < 2) {
+            return replacementCharacter;
+        }
+        unsigned int calculated = ((firstByte & 0x1F) << 6) | (static_cast<unsigned int>(s[1]) & 0x3F);
+        s += 1;
+        return calculated < 0x80 ? replacementCharacter : calculated;
+    }
+    if (firstByte < 0xF0) {
+        if (e - s < 3) {
+            return replacementCharacter;
+        }
+        unsigned int calculated = ((firstByte & 0x0F) << 12) | ((static_cast<unsigned int>(s[1]) & 0x3F) << 6)
+            | (static_cast<unsigned int>(s[2]) & 0x3F);
+        s += 2;
+        // Surrogates aren't valid codepoints itself, shouldn't be UTF-8 encoded
+        if (calculated >= 0xD800 && calculated <= 0xDFFF) {
+            return replacementCharacter;
+        }
+        return calculated < 0x800 ? replacementCharacter : calculated;
+    }
+    if (firstByte < 0xF8) {
+        if (e - s < 4) {
+            return replacementCharacter;
+        }
+        unsigned int calculated = ((firstByte & 0x07) << 18) | ((static_cast<unsigned int>(s[1]) & 0x3F) << 12)
+            | ((static_cast<unsigned int>(s[2]) & 0x3F) << 6) | (static_cast<unsigned int>(s[3]) & 0x3F);
+        s += 3;
+        return calculated < 0x10000 ? replacementCharacter : calculated;
+    }
+    return replacementCharacter;
+}
+
+}
+
+JsonWriter::JsonWriter(std::string indentation) : indentation_(std::move(indentation)),
+    colon_(indentation_.empty() ? ":" : " : "), indented_(true) {
+}
+
+std::string& JsonWriter::buffer() {
+    return buffer_;
+}
+
+void JsonWriter::clear() {
+    buffer_.clear();
+}
+
+void JsonWriter::writeIndent() {
+    if (!indentation_.empty()) {
+        buffer_ += '\n';
+        buffer_ += indentString_;
+    }
+}
+
+void JsonWriter::writeWithIndent(const char* str, size_t length) {
+    if (!indented_) {
+        writeIndent();
+    }
+    buffer_.append(str, length);
+    indented_ = false;
+}
+
+void JsonWriter::beforeValue() {
+    if (stack_.empty()) {
+        return;
+    }
+    Frame& frame = stack_.back();
+    if (!frame.isArray) {
+        return; // the separator is written by key()
+    }
+    if (frame.singleLine) {
+        if (frame.count) {
+            buffer_ += indentation_.empty() ? "," : ", ";
+        }
+    } else {
+        if (frame.count) {
+            buffer_ += ',';
+        }
+        if (!indented_) {
+            writeIndent();
+        }
+        indented_ = true;
+    }
+    frame.count++;
+}
+
+void JsonWriter::afterScalar() {
+    indented_ = false;
+}
+
+void JsonWriter::beginObject() {
+    beforeValue();
+    writeWithIndent("{", 1);
+    stack_.push_back({ false, false, 0 });
+    indentString_ += indentation_;
+}
+
+void JsonWriter::endObject() {
+    stack_.pop_back();
+    indentString_.resize(indentString_.size() - indentation_.size());
+    writeWithIndent("}", 1);
+}
+
+void JsonWriter::key(const char* name, size_t length) {
+    Frame& frame = stack_.back();
+    if (frame.count) {
+        buffer_ += ',';
+    }
+    frame.count++;
+    if (!indented_) {
+        writeIndent();
+    }
+    appendQuoted(buffer_, name, length);
+    indented_ = false;
+    buffer_ += colon_;
+}
+
+void JsonWriter::key(const std::string& name) {
+    key(name.data(), name.size());
+}
+
+void JsonWriter::beginArray(bool singleLine) {
+    beforeValue();
+    if (singleLine) {
+        buffer_ += indentation_.empty() ? "[" : "[ ";
+    } else {
+        writeWithIndent("[", 1);
+        indentString_ += indentation_;
+    }
+    stack_.push_back({ true, singleLine, 0 });
+}
+
+void JsonWriter::endArray() {
+    bool singleLine = stack_.back().singleLine;
+    stack_.pop_back();
+    if (singleLine) {
+        buffer_ += indentation_.empty() ? "]" : " ]";
+        afterScalar();
+    } else {
+        indentString_.resize(indentString_.size() - indentation_.size());
+        writeWithIndent("]", 1);
+    }
+}
+
+void JsonWriter::emptyObject() {
+    beforeValue();
+    buffer_ += "{}";
+    afterScalar();
+}
+
+void JsonWriter::emptyArray() {
+    beforeValue();
+    buffer_ += "[]";
+    afterScalar();
+}
+
+void JsonWriter::nullValue() {
+    beforeValue();
+    buffer_ += "null";
+    afterScalar();
+}
+
+void JsonWriter::boolValue(bool value) {
+    beforeValue();
+    buffer_ += value ? "true" : "false";
+    afterScalar();
+}
+
+void JsonWriter::intValue(int64_t value) {
+    beforeValue();
+    appendInt(buffer_, value);
+    afterScalar();
+}
+
+void JsonWriter::doubleValue(double value) {
+    beforeValue();
+    appendDouble(buffer_, value);
+    afterScalar();
+}
+
+void JsonWriter::stringValue(const char* str, size_t length) {
+    beforeValue();
+    appendQuoted(buffer_, str, length);
+    afterScalar();
+}
+
+void JsonWriter::stringValue(const std::string& str) {
+    stringValue(str.data(), str.size());
+}
+
+bool JsonWriter::canWriteArrayOnSingleLine(const std::vector<size_t>& itemLengths) const {
+    if (indentation_.empty()) {
+        return true;
+    }
+    size_t size = itemLengths.size();
+    if (!size || size * 3 >= kRightMargin) {
+        return false;
+    }
+    size_t lineLength = 4 + (size - 1) * 2; // '[ ' + ', '*n + ' ]'
+    for (size_t length : itemLengths) {
+        lineLength += length;
+    }
+    return lineLength < kRightMargin;
+}
+
+bool JsonWriter::canWriteArrayOnSingleLine(size_t itemCount) const {
+    return indentation_.empty() || (itemCount && itemCount * 3 < kRightMargin);
+}
+
+void JsonWriter::appendQuoted(std::string& out, const char* str, size_t length) {
+    const char* end = str + length;
+    out += '"';
+    const char* c = str;
+    while (c != end) {
+        // Copy the run of characters which do not need escaping at once
+        const char* runStart = c;
+        while (c != end && !escapeTable.needsEscape[static_cast<unsigned char>(*c)]) {
+            ++c;
+        }
+        out.append(runStart, c - runStart);
+        if (c == end) {
+            break;
+        }
+        switch (*c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                unsigned int codepoint = utf8ToCodepoint(c, end); // modifies c
+                if (codepoint < 0x10000) {
+                    appendHex(out, codepoint);
+                } else {
+                    codepoint -= 0x10000;
+                    appendHex(out, 0xD800 + ((codepoint >> 10) & 0x3FF));
+                    appendHex(out, 0xDC00 + (codepoint & 0x3FF));
+                }
+                break;
+            }
+        }
+        ++c;
+    }
+    out += '"';
+}
+
+void JsonWriter::appendInt(std::string& out, int64_t value) {
+    char buf[24];
+    char* p = buf + sizeof(buf);
+    uint64_t v = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    do {
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    if (value < 0) {
+        *--p = '-';
+    }
+    out.append(p, buf + sizeof(buf) - p);
+}
+
+void JsonWriter::appendDouble(std::string& out, double value) {
+    if (!std::isfinite(value)) {
+        out += std::isnan(value) ? "null" : (value < 0 ? "-1e+9999" : "1e+9999");
+        return;
+    }
+    char buf[36];
+    int length = snprintf(buf, sizeof(buf), "%.17g", value);
+    if (length <= 0 || length >= static_cast<int>(sizeof(buf))) {
+        out += "null";
+        return;
+    }
+    bool hasPoint = false;
+    for (int i = 0; i < length; i++) {
+        // Decimal separator depends on the current locale
+        if (buf[i] == ',') {
+            buf[i] = '.';
+        }
+        if (buf[i] == '.' || buf[i] == 'e') {
+            hasPoint = true;
+        }
+    }
+    out.append(buf, length);
+    if (!hasPoint) {
+        out += ".0";
+    }
+}
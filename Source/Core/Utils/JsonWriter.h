@@ -0,0 +1,85 @@
+#ifndef IU_CORE_UTILS_JSONWRITER_H
+#define IU_CORE_UTILS_JSONWRITER_H
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+@brief JsonWriter writes JSON text directly into a string buffer, without building a tree of values.
+
+The output is the same as produced by Json::StreamWriterBuilder (jsoncpp) with the same indentation
+and without comments, except that object members are written in the order they are added.
+An empty indentation produces compact output.
+
+Non-empty arrays are written on a single line only if the caller passes singleLine=true to beginArray();
+use canWriteArrayOnSingleLine() to make the same decision as jsoncpp does.
+Empty objects and arrays should be written with emptyObject() and emptyArray().
+
+The buffer can be taken and cleared at any time (e.g. when it is sent to the network),
+the writer keeps the state of the document.
+*/
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string indentation = std::string());
+
+    std::string& buffer();
+    void clear();
+
+    void beginObject();
+    void endObject();
+    void key(const char* name, size_t length);
+    void key(const std::string& name);
+
+    void beginArray(bool singleLine = false);
+    void endArray();
+
+    void emptyObject();
+    void emptyArray();
+    void nullValue();
+    void boolValue(bool value);
+    void intValue(int64_t value);
+    void doubleValue(double value);
+    void stringValue(const char* str, size_t length);
+    void stringValue(const std::string& str);
+
+    /**
+     * Returns true if the array with given items would be written on a single line by jsoncpp.
+     * @param itemLengths - lengths of text of items (all of them should be scalars or empty containers)
+     */
+    bool canWriteArrayOnSingleLine(const std::vector<size_t>& itemLengths) const;
+
+    /**
+     * Returns false if an array with this number of items is never written on a single line,
+     * so there is no need to compute lengths of its items.
+     */
+    bool canWriteArrayOnSingleLine(size_t itemCount) const;
+
+    /**
+     * Appends the string in quotes, escaping special and non-ASCII characters
+     */
+    static void appendQuoted(std::string& out, const char* str, size_t length);
+    static void appendInt(std::string& out, int64_t value);
+    static void appendDouble(std::string& out, double value);
+private:
+    struct Frame {
+        bool isArray;
+        bool singleLine;
+        size_t count;
+    };
+    void beforeValue();
+    void afterScalar();
+    void writeIndent();
+    void writeWithIndent(const char* str, size_t length);
+
+    std::string buffer_;
+    std::string indentation_;
+    std::string indentString_;
+    const char* colon_;
+    bool indented_;
+    std::vector<Frame> stack_;
+};
+
+#endif
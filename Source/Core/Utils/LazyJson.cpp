@@ -0,0 +1,563 @@
+#include "LazyJson.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <locale>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+const size_t npos = std::string::npos;
+
+bool isWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Checks the number syntax according to RFC 8259
+ */
+bool isNumber(const char* s, size_t length) {
+    size_t i = 0;
+    if (i < length && s[i] == '-') {
+        ++i;
+    }
+    if (i >= length) {
+        return false;
+    }
+    if (s[i] == '0') {
+        ++i;
+    } else if (isDigit(s[i])) {
+        while (i < length && isDigit(s[i])) {
+            ++i;
+        }
+    } else {
+        return false;
+    }
+    if (i < length && s[i] == '.') {
+        size_t start = ++i;
+        while (i < length && isDigit(s[i])) {
+            ++i;
+        }
+        if (i == start) {
+            return false;
+        }
+    }
+    if (i < length && (s[i] == 'e' || s[i] == 'E')) {
+        ++i;
+        if (i < length && (s[i] == '+' || s[i] == '-')) {
+            ++i;
+        }
+        size_t start = i;
+        while (i < length && isDigit(s[i])) {
+            ++i;
+        }
+        if (i == start) {
+            return false;
+        }
+    }
+    return i == length;
+}
+
+bool parseHex4(const char* s, uint32_t& result) {
+    result = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        result <<= 4;
+        if (c >= '0' && c <= '9') {
+            result |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            result |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            result |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+class LazyJsonDocument {
+public:
+    struct Child {
+        size_t key; // position of the member name, npos for array elements
+        size_t value;
+    };
+
+    explicit LazyJsonDocument(std::string text) : text_(std::move(text)), root_(npos) {
+    }
+
+    /**
+     * Finds the boundaries of all objects and arrays. Returns false if the document is malformed.
+     */
+    bool index() {
+        const size_t n = text_.size();
+        const char* data = text_.data();
+        std::vector<size_t> stack;
+        for (size_t i = 0; i < n; ++i) {
+            switch (data[i]) {
+                case '"':
+                    i = stringEnd(i);
+                    if (i == npos) {
+                        return false;
+                    }
+                    --i;
+                    break;
+                case '{':
+                case '[':
+                    stack.push_back(spans_.size());
+                    spans_.push_back({ i, npos });
+                    break;
+                case '}':
+                case ']': {
+                    if (stack.empty()) {
+                        return false;
+                    }
+                    Span& span = spans_[stack.back()];
+                    if (data[span.open] != (data[i] == '}' ? '{' : '[')) {
+                        return false;
+                    }
+                    span.close = i;
+                    stack.pop_back();
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        if (!stack.empty()) {
+            return false;
+        }
+        root_ = skipWhitespace(0);
+        if (root_ >= n) {
+            return false;
+        }
+        size_t end = valueEnd(root_);
+        return end != npos && skipWhitespace(end) == n;
+    }
+
+    const std::string& text() const {
+        return text_;
+    }
+
+    size_t root() const {
+        return root_;
+    }
+
+    size_t skipWhitespace(size_t pos) const {
+        while (pos < text_.size() && isWhitespace(text_[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    /**
+     * Returns the position after the closing quote of the string starting at pos
+     */
+    size_t stringEnd(size_t pos) const {
+        const char* data = text_.data();
+        const char* begin = data + pos + 1;
+        const char* end = data + text_.size();
+        const char* p = begin;
+        while (p < end) {
+            auto quote = static_cast<const char*>(memchr(p, '"', end - p));
+            if (!quote) {
+                break;
+            }
+            // The quote is escaped if it is preceded by an odd number of backslashes
+            const char* q = quote;
+            while (q > begin && q[-1] == '\\') {
+                --q;
+            }
+            if ((quote - q) % 2 == 0) {
+                return quote - data + 1;
+            }
+            p = quote + 1;
+        }
+        return npos;
+    }
+
+    size_t containerEnd(size_t pos) const {
+        auto it = std::lower_bound(spans_.begin(), spans_.end(), pos, [](const Span& span, size_t p) {
+            return span.open < p;
+        });
+        if (it == spans_.end() || it->open != pos) {
+            return npos;
+        }
+        return it->close;
+    }
+
+    /**
+     * Returns the position after the value starting at pos
+     */
+    size_t valueEnd(size_t pos) const {
+        if (pos >= text_.size()) {
+            return npos;
+        }
+        char c = text_[pos];
+        if (c == '{' || c == '[') {
+            size_t close = containerEnd(pos);
+            return close == npos ? npos : close + 1;
+        }
+        if (c == '"') {
+            return stringEnd(pos);
+        }
+        size_t i = pos;
+        while (i < text_.size() && !isWhitespace(text_[i]) && text_[i] != ',' && text_[i] != '}' && text_[i] != ']') {
+            ++i;
+        }
+        return i;
+    }
+
+    /**
+     * Returns members of the object or elements of the array starting at pos.
+     * The list is cached, it is used for access by index and repeated iteration.
+     */
+    const std::vector<Child>& children(size_t pos) const {
+        auto it = children_.find(pos);
+        if (it != children_.end()) {
+            return it->second;
+        }
+        std::vector<Child>& result = children_[pos];
+        scanChildren(pos, [&result](const Child& child) {
+            result.push_back(child);
+            return true;
+        });
+        return result;
+    }
+
+    /**
+     * Calls the function for each member of the object or element of the array starting at pos,
+     * until it returns false
+     */
+    template<class Func> void scanChildren(size_t pos, Func&& func) const {
+        bool isObject = text_[pos] == '{';
+        size_t end = containerEnd(pos);
+        size_t p = skipWhitespace(pos + 1);
+        while (p < end) {
+            Child child { npos, npos };
+            if (isObject) {
+                if (text_[p] != '"') {
+                    break;
+                }
+                child.key = p;
+                p = skipWhitespace(stringEnd(p));
+                if (p >= end || text_[p] != ':') {
+                    break;
+                }
+                p = skipWhitespace(p + 1);
+            }
+            size_t valueEndPos = valueEnd(p);
+            if (valueEndPos == npos || valueEndPos > end || valueEndPos == p) {
+                break;
+            }
+            child.value = p;
+            if (!func(child)) {
+                break;
+            }
+            p = skipWhitespace(valueEndPos);
+            if (p >= end || text_[p] != ',') {
+                break;
+            }
+            p = skipWhitespace(p + 1);
+        }
+    }
+
+    /**
+     * Compares the string starting at pos with the given UTF-8 string
+     */
+    bool stringEquals(size_t pos, const std::string& str) const {
+        size_t end = stringEnd(pos);
+        const char* begin = text_.data() + pos + 1;
+        size_t length = end - pos - 2;
+        if (!memchr(begin, '\\', length)) {
+            return length == str.size() && !memcmp(begin, str.data(), length);
+        }
+        return decodeString(pos) == str;
+    }
+
+    std::string decodeString(size_t pos) const {
+        std::string result;
+        size_t end = stringEnd(pos);
+        if (end == npos) {
+            return result;
+        }
+        end--; // closing quote
+        result.reserve(end - pos - 1);
+        const char* data = text_.data();
+        for (size_t i = pos + 1; i < end; ++i) {
+            char c = data[i];
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (++i >= end) {
+                break;
+            }
+            switch (data[i]) {
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case 'u': {
+                    uint32_t cp;
+                    if (i + 4 >= end || !parseHex4(data + i + 1, cp)) {
+                        return result;
+                    }
+                    i += 4;
+                    // Surrogate pair
+                    if (cp >= 0xD800 && cp <= 0xDBFF && i + 6 < end && data[i + 1] == '\\' && data[i + 2] == 'u') {
+                        uint32_t low;
+                        if (parseHex4(data + i + 3, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                            i += 6;
+                        }
+                    }
+                    appendUtf8(result, cp);
+                    break;
+                }
+                default:
+                    result += data[i];
+                    break;
+            }
+        }
+        return result;
+    }
+private:
+    struct Span {
+        size_t open;
+        size_t close;
+    };
+    std::string text_;
+    size_t root_;
+    std::vector<Span> spans_; // ordered by the position of the opening bracket
+    mutable std::unordered_map<size_t, std::vector<Child>> children_;
+};
+
+LazyJsonValue::LazyJsonValue() : pos_(npos) {
+}
+
+LazyJsonValue::LazyJsonValue(std::shared_ptr<const LazyJsonDocument> doc, size_t pos) : doc_(std::move(doc)), pos_(pos) {
+}
+
+LazyJsonValue LazyJsonValue::parse(std::string text) {
+    auto doc = std::make_shared<LazyJsonDocument>(std::move(text));
+    if (!doc->index()) {
+        return LazyJsonValue();
+    }
+    size_t root = doc->root();
+    return LazyJsonValue(std::move(doc), root);
+}
+
+bool LazyJsonValue::isValid() const {
+    return type() != Type::Invalid;
+}
+
+LazyJsonValue::Type LazyJsonValue::type() const {
+    if (!doc_) {
+        return Type::Invalid;
+    }
+    const std::string& text = doc_->text();
+    switch (text[pos_]) {
+        case '{':
+            return Type::Object;
+        case '[':
+            return Type::Array;
+        case '"':
+            return Type::String;
+        case 't':
+        case 'f':
+        case 'n': {
+            size_t length = doc_->valueEnd(pos_) - pos_;
+            if (!text.compare(pos_, length, "true") || !text.compare(pos_, length, "false")) {
+                return Type::Bool;
+            }
+            if (!text.compare(pos_, length, "null")) {
+                return Type::Null;
+            }
+            return Type::Invalid;
+        }
+        default:
+            return isNumber(text.data() + pos_, doc_->valueEnd(pos_) - pos_) ? Type::Number : Type::Invalid;
+    }
+}
+
+LazyJsonValue LazyJsonValue::get(const std::string& path) const {
+    LazyJsonValue current = *this;
+    size_t i = 0;
+    while (i < path.size() && current.doc_) {
+        if (path[i] == '.') {
+            ++i;
+        } else if (path[i] == '[') {
+            size_t close = path.find(']', i);
+            if (close == npos || close == i + 1) {
+                return LazyJsonValue();
+            }
+            size_t index = 0;
+            for (size_t j = i + 1; j < close; ++j) {
+                if (path[j] < '0' || path[j] > '9') {
+                    return LazyJsonValue();
+                }
+                index = index * 10 + (path[j] - '0');
+            }
+            current = current.at(index);
+            i = close + 1;
+        } else {
+            size_t end = path.find_first_of(".[", i);
+            if (end == npos) {
+                end = path.size();
+            }
+            current = current.member(path.substr(i, end - i));
+            i = end;
+        }
+    }
+    return current;
+}
+
+LazyJsonValue LazyJsonValue::member(const std::string& name) const {
+    if (!doc_ || doc_->text()[pos_] != '{') {
+        return LazyJsonValue();
+    }
+    // Objects are usually accessed by a few names only, so the list of members is not cached
+    size_t result = npos;
+    doc_->scanChildren(pos_, [&](const LazyJsonDocument::Child& child) {
+        if (doc_->stringEquals(child.key, name)) {
+            result = child.value;
+            return false;
+        }
+        return true;
+    });
+    return result == npos ? LazyJsonValue() : LazyJsonValue(doc_, result);
+}
+
+LazyJsonValue LazyJsonValue::at(size_t index) const {
+    if (!doc_ || doc_->text()[pos_] != '[') {
+        return LazyJsonValue();
+    }
+    const auto& children = doc_->children(pos_);
+    if (index >= children.size()) {
+        return LazyJsonValue();
+    }
+    return LazyJsonValue(doc_, children[index].value);
+}
+
+size_t LazyJsonValue::size() const {
+    if (!doc_) {
+        return 0;
+    }
+    char c = doc_->text()[pos_];
+    if (c != '{' && c != '[') {
+        return 0;
+    }
+    return doc_->children(pos_).size();
+}
+
+std::vector<std::string> LazyJsonValue::keys() const {
+    std::vector<std::string> result;
+    if (!doc_ || doc_->text()[pos_] != '{') {
+        return result;
+    }
+    for (const auto& child : doc_->children(pos_)) {
+        result.push_back(doc_->decodeString(child.key));
+    }
+    return result;
+}
+
+void LazyJsonValue::forEach(const std::function<void(const std::string&, const LazyJsonValue&)>& func) const {
+    if (!doc_) {
+        return;
+    }
+    char c = doc_->text()[pos_];
+    if (c != '{' && c != '[') {
+        return;
+    }
+    std::string name;
+    for (const auto& child : doc_->children(pos_)) {
+        if (child.key != npos) {
+            name = doc_->decodeString(child.key);
+        }
+        func(name, LazyJsonValue(doc_, child.value));
+    }
+}
+
+bool LazyJsonValue::asBool() const {
+    return doc_ && doc_->text()[pos_] == 't';
+}
+
+bool LazyJsonValue::isInteger() const {
+    if (type() != Type::Number) {
+        return false;
+    }
+    std::string token = rawText();
+    return token.find_first_of(".eE") == npos;
+}
+
+int64_t LazyJsonValue::asInt64() const {
+    if (!isInteger()) {
+        return static_cast<int64_t>(asDouble());
+    }
+    std::string token = rawText();
+    errno = 0;
+    long long result = strtoll(token.c_str(), nullptr, 10);
+    if (errno == ERANGE) {
+        return static_cast<int64_t>(asDouble());
+    }
+    return result;
+}
+
+double LazyJsonValue::asDouble() const {
+    if (type() != Type::Number) {
+        return 0.0;
+    }
+    // strtod depends on the current locale
+    std::istringstream stream(rawText());
+    stream.imbue(std::locale::classic());
+    double result = 0.0;
+    stream >> result;
+    return result;
+}
+
+std::string LazyJsonValue::asString() const {
+    if (!doc_ || doc_->text()[pos_] != '"') {
+        return std::string();
+    }
+    return doc_->decodeString(pos_);
+}
+
+std::string LazyJsonValue::rawText() const {
+    if (!doc_) {
+        return std::string();
+    }
+    size_t end = doc_->valueEnd(pos_);
+    if (end == npos) {
+        return std::string();
+    }
+    return doc_->text().substr(pos_, end - pos_);
+}
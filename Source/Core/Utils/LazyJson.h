@@ -0,0 +1,93 @@
+#ifndef IU_CORE_UTILS_LAZYJSON_H
+#define IU_CORE_UTILS_LAZYJSON_H
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class LazyJsonDocument;
+
+/**
+@brief LazyJsonValue is a lightweight handle to a value inside a JSON document, which is parsed on demand.
+
+LazyJsonValue::parse() makes a single pass over the text, finding the boundaries of strings,
+objects and arrays; no tree is built. Values are decoded only when they are accessed,
+so reading a few fields of a large response is much cheaper than building a Json::Value.
+The list of members of an object or elements of an array is built on the first access to the container
+and then reused, so iterating over an array by index is linear.
+
+Only the structure (matching brackets and terminated strings) is checked by parse(),
+other syntax errors are detected when the broken value is accessed (it is returned as invalid).
+
+Values share ownership of the document text, they can outlive the value returned by parse().
+A document and its values must not be used from different threads simultaneously.
+*/
+class LazyJsonValue {
+public:
+    enum class Type { Invalid, Null, Bool, Number, String, Array, Object };
+
+    /**
+     * Creates an invalid value
+     */
+    LazyJsonValue();
+
+    /**
+     * Returns an invalid value if the document is malformed
+     */
+    static LazyJsonValue parse(std::string text);
+
+    bool isValid() const;
+    Type type() const;
+
+    /**
+     * Returns a value by path like "result.links[1].href", or an invalid value if there is no such value.
+     * An empty path refers to this value.
+     */
+    LazyJsonValue get(const std::string& path) const;
+
+    /**
+     * Returns a member of the object by name
+     */
+    LazyJsonValue member(const std::string& name) const;
+
+    /**
+     * Returns an element of the array by index
+     */
+    LazyJsonValue at(size_t index) const;
+
+    /**
+     * Returns number of members of an object or elements of an array, 0 for other values
+     */
+    size_t size() const;
+
+    /**
+     * Returns member names of an object
+     */
+    std::vector<std::string> keys() const;
+
+    /**
+     * Calls the function for each member of an object (with the member name) or element of an array (with empty name)
+     */
+    void forEach(const std::function<void(const std::string&, const LazyJsonValue&)>& func) const;
+
+    bool asBool() const;
+    bool isInteger() const;
+    int64_t asInt64() const;
+    double asDouble() const;
+    std::string asString() const;
+
+    /**
+     * Returns JSON text of the value as it is in the document
+     */
+    std::string rawText() const;
+private:
+    LazyJsonValue(std::shared_ptr<const LazyJsonDocument> doc, size_t pos);
+    std::shared_ptr<const LazyJsonDocument> doc_;
+    size_t pos_;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "Core/Utils/AsyncOutputWriter.h"
+
+namespace {
+
+std::string readAll(FILE* f) {
+    std::string result;
+    rewind(f);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        result.append(buf, n);
+    }
+    return result;
+}
+
+}
+
+TEST(AsyncOutputWriterTest, WritesInOrder) {
+    FILE* f = tmpfile();
+    ASSERT_TRUE(f != nullptr);
+    {
+        AsyncOutputWriter writer(f);
+        for (int i = 0; i < 1000; i++) {
+            EXPECT_TRUE(writer.write(std::to_string(i) + "\n"));
+        }
+        writer.flush();
+        std::string contents = readAll(f);
+        EXPECT_EQ(0, contents.find("0\n1\n2\n"));
+        EXPECT_NE(std::string::npos, contents.find("\n999\n"));
+    }
+    fclose(f);
+}
+
+TEST(AsyncOutputWriterTest, DropsOnlyDroppableData) {
+    FILE* f = tmpfile();
+    ASSERT_TRUE(f != nullptr);
+    AsyncOutputWriter writer(f, 0);
+    EXPECT_FALSE(writer.write("progress\n", true));
+    EXPECT_TRUE(writer.write("result\n"));
+    writer.close();
+    EXPECT_EQ(1, writer.droppedCount());
+    EXPECT_EQ("result\n", readAll(f));
+    fclose(f);
+}
+
+TEST(AsyncOutputWriterTest, ConcurrentWriters) {
+    FILE* f = tmpfile();
+    ASSERT_TRUE(f != nullptr);
+    AsyncOutputWriter writer(f);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&writer] {
+            for (int i = 0; i < 500; i++) {
+                writer.write("line\n");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    writer.close();
+    EXPECT_EQ(2000u * 5, readAll(f).size());
+    fclose(f);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <boost/filesystem.hpp>
+
+#include "Core/Utils/FolderWatcher.h"
+
+TEST(FileWriteDebouncerTest, ReadyAfterCloseAndInterval) {
+    FileWriteDebouncer debouncer(100);
+    debouncer.fileModified("a.png");
+    EXPECT_EQ(-1, debouncer.timeUntilNextDeadline(1000));
+    debouncer.fileClosed("a.png", 1000);
+    EXPECT_EQ(100, debouncer.timeUntilNextDeadline(1000));
+    EXPECT_TRUE(debouncer.takeReady(1050).empty());
+    auto ready = debouncer.takeReady(1100);
+    ASSERT_EQ(1u, ready.size());
+    EXPECT_EQ("a.png", ready[0]);
+    EXPECT_TRUE(debouncer.takeReady(2000).empty());
+}
+
+TEST(FileWriteDebouncerTest, ReopenedFileIsNotReady) {
+    FileWriteDebouncer debouncer(100);
+    debouncer.fileClosed("a.png", 1000);
+    // The writer opened the file again before the interval passed
+    debouncer.fileModified("a.png");
+    EXPECT_TRUE(debouncer.takeReady(1200).empty());
+    debouncer.fileClosed("a.png", 1300);
+    EXPECT_TRUE(debouncer.takeReady(1350).empty());
+    EXPECT_EQ(1u, debouncer.takeReady(1400).size());
+}
+
+TEST(FileWriteDebouncerTest, RemovedFileIsForgotten) {
+    FileWriteDebouncer debouncer(100);
+    debouncer.fileClosed("a.png", 1000);
+    debouncer.fileRemoved("a.png");
+    EXPECT_TRUE(debouncer.takeReady(2000).empty());
+}
+
+TEST(FolderWatcherTest, ReportsWrittenFiles) {
+    namespace fs = boost::filesystem;
+    fs::path directory = fs::temp_directory_path() / fs::unique_path("folderwatcher-%%%%-%%%%");
+    fs::create_directories(directory);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::string> files;
+
+    FolderWatcher watcher;
+    watcher.setDebounceInterval(20);
+    ASSERT_TRUE(watcher.start(directory.string(), [&](const std::string& fileName) {
+        std::lock_guard<std::mutex> lk(mutex);
+        files.push_back(fileName);
+        condition.notify_all();
+    }));
+
+    {
+        std::ofstream hidden((directory / ".partial").string());
+        hidden << "temporary";
+    }
+    {
+        std::ofstream out((directory / "screenshot.png").string());
+        out << "data";
+    }
+
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        EXPECT_TRUE(condition.wait_for(lk, std::chrono::seconds(5), [&] { return !files.empty(); }));
+        ASSERT_EQ(1u, files.size());
+        EXPECT_EQ((directory / "screenshot.png").string(), files[0]);
+    }
+    watcher.stop();
+    fs::remove_all(directory);
+}
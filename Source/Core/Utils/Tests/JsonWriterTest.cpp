@@ -0,0 +1,241 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <random>
+#include <json/json.h>
+
+#include "Core/Utils/JsonWriter.h"
+
+namespace {
+
+std::string scalarText(const Json::Value& value) {
+    std::string result;
+    switch (value.type()) {
+        case Json::intValue:
+        case Json::uintValue:
+            JsonWriter::appendInt(result, value.asInt64());
+            break;
+        case Json::realValue:
+            JsonWriter::appendDouble(result, value.asDouble());
+            break;
+        case Json::stringValue: {
+            const char* begin, *end;
+            value.getString(&begin, &end);
+            JsonWriter::appendQuoted(result, begin, end - begin);
+            break;
+        }
+        case Json::booleanValue:
+            result = value.asBool() ? "true" : "false";
+            break;
+        case Json::arrayValue:
+            result = "[]";
+            break;
+        case Json::objectValue:
+            result = "{}";
+            break;
+        default:
+            result = "null";
+    }
+    return result;
+}
+
+void writeValue(JsonWriter& writer, const Json::Value& value) {
+    if (value.isObject() && !value.empty()) {
+        writer.beginObject();
+        for (const auto& name : value.getMemberNames()) {
+            writer.key(name);
+            writeValue(writer, value[name]);
+        }
+        writer.endObject();
+    } else if (value.isArray() && !value.empty()) {
+        std::vector<size_t> lengths;
+        bool hasContainers = false;
+        for (const auto& item : value) {
+            hasContainers = hasContainers || ((item.isArray() || item.isObject()) && !item.empty());
+            lengths.push_back(scalarText(item).size());
+        }
+        writer.beginArray(!hasContainers && writer.canWriteArrayOnSingleLine(lengths));
+        for (const auto& item : value) {
+            writeValue(writer, item);
+        }
+        writer.endArray();
+    } else if (value.isObject()) {
+        writer.emptyObject();
+    } else if (value.isArray()) {
+        writer.emptyArray();
+    } else if (value.isNull()) {
+        writer.nullValue();
+    } else if (value.isBool()) {
+        writer.boolValue(value.asBool());
+    } else if (value.isString()) {
+        writer.stringValue(value.asString());
+    } else if (value.type() == Json::realValue) {
+        writer.doubleValue(value.asDouble());
+    } else {
+        writer.intValue(value.asInt64());
+    }
+}
+
+std::string writeWithJsoncpp(const Json::Value& value, const std::string& indentation) {
+    Json::StreamWriterBuilder builder;
+    builder["commentStyle"] = "None";
+    builder["indentation"] = indentation;
+    return Json::writeString(builder, value);
+}
+
+Json::Value randomValue(std::mt19937& rng, int depth) {
+    std::uniform_int_distribution<int> typeDist(0, depth > 3 ? 5 : 7);
+    switch (typeDist(rng)) {
+        case 0:
+            return Json::Value();
+        case 1:
+            return Json::Value(rng() % 2 == 0);
+        case 2:
+            return Json::Value(static_cast<Json::Int64>(rng()) - (static_cast<Json::Int64>(1) << 31));
+        case 3:
+            return Json::Value(static_cast<double>(static_cast<float>(rng() % 100000) / 7.0f));
+        case 4:
+        case 5: {
+            static const char* const parts[] = { "abc", "\"", "\\", "\n", "\t", "/", "\x01", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xFF", "\xC3", " " };
+            std::string str;
+            int count = rng() % 6;
+            for (int i = 0; i < count; i++) {
+                str += parts[rng() % (sizeof(parts) / sizeof(parts[0]))];
+            }
+            return Json::Value(str);
+        }
+        case 6: {
+            Json::Value arr(Json::arrayValue);
+            int count = rng() % 30;
+            for (int i = 0; i < count; i++) {
+                arr.append(randomValue(rng, depth + 1));
+            }
+            return arr;
+        }
+        default: {
+            Json::Value obj(Json::objectValue);
+            int count = rng() % 6;
+            for (int i = 0; i < count; i++) {
+                obj["key" + std::to_string(rng() % 10)] = randomValue(rng, depth + 1);
+            }
+            return obj;
+        }
+    }
+}
+
+}
+
+TEST(JsonWriterTest, Simple) {
+    JsonWriter writer("   ");
+    writer.beginObject();
+    writer.key("a");
+    writer.stringValue("test1");
+    writer.key("b");
+    writer.doubleValue(1.0);
+    writer.key("c");
+    writer.beginArray(true);
+    writer.intValue(1);
+    writer.intValue(-2);
+    writer.endArray();
+    writer.key("d");
+    writer.beginObject();
+    writer.key("e");
+    writer.nullValue();
+    writer.endObject();
+    writer.endObject();
+    EXPECT_EQ("{\n   \"a\" : \"test1\",\n   \"b\" : 1.0,\n   \"c\" : [ 1, -2 ],\n   \"d\" : \n   {\n      \"e\" : null\n   }\n}", writer.buffer());
+
+    JsonWriter compact;
+    compact.beginArray();
+    compact.stringValue("\"\xC3\xA9\n");
+    compact.emptyObject();
+    compact.boolValue(false);
+    compact.endArray();
+    EXPECT_EQ("[\"\\\"\\u00e9\\n\",{},false]", compact.buffer());
+}
+
+TEST(JsonWriterTest, SameOutputAsJsoncpp) {
+    std::mt19937 rng(12345);
+    for (int i = 0; i < 500; i++) {
+        Json::Value value = randomValue(rng, 0);
+        for (const std::string indentation : { "   ", "" }) {
+            JsonWriter writer(indentation);
+            writeValue(writer, value);
+            ASSERT_EQ(writeWithJsoncpp(value, indentation), writer.buffer());
+        }
+    }
+}
+
+TEST(JsonWriterTest, Numbers) {
+    std::string str;
+    JsonWriter::appendInt(str, INT64_MIN);
+    EXPECT_EQ("-9223372036854775808", str);
+    str.clear();
+    JsonWriter::appendDouble(str, 0.5);
+    EXPECT_EQ("0.5", str);
+    str.clear();
+    JsonWriter::appendDouble(str, std::nan(""));
+    EXPECT_EQ("null", str);
+}
+
+TEST(JsonWriterTest, DISABLED_Benchmark) {
+    struct Item {
+        std::string id;
+        std::string title;
+        int64_t size;
+        double ratio;
+    };
+    for (int count : { 10, 1000, 100000 }) {
+        std::vector<Item> items;
+        for (int i = 0; i < count; i++) {
+            items.push_back({ "0B7kD9xLmNq" + std::to_string(i), "Photo \"" + std::to_string(i) + "\" from the trip.jpg", 1000000 + i, i / 3.0 });
+        }
+        const int iterations = std::max(5, 200000 / count);
+        size_t checksum1 = 0, checksum2 = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++) {
+            Json::Value root(Json::objectValue);
+            Json::Value& files = root["files"] = Json::Value(Json::arrayValue);
+            for (const auto& item : items) {
+                Json::Value file(Json::objectValue);
+                file["id"] = item.id;
+                file["title"] = item.title;
+                file["size"] = static_cast<Json::Int64>(item.size);
+                file["ratio"] = item.ratio;
+                files.append(file);
+            }
+            checksum1 += writeWithJsoncpp(root, "").size();
+        }
+        auto middle = std::chrono::steady_clock::now();
+        JsonWriter writer;
+        for (int it = 0; it < iterations; it++) {
+            writer.clear();
+            writer.beginObject();
+            writer.key("files");
+            writer.beginArray();
+            for (const auto& item : items) {
+                writer.beginObject();
+                writer.key("id");
+                writer.stringValue(item.id);
+                writer.key("ratio");
+                writer.doubleValue(item.ratio);
+                writer.key("size");
+                writer.intValue(item.size);
+                writer.key("title");
+                writer.stringValue(item.title);
+                writer.endObject();
+            }
+            writer.endArray();
+            writer.endObject();
+            checksum2 += writer.buffer().size();
+        }
+        auto end = std::chrono::steady_clock::now();
+        EXPECT_EQ(checksum1, checksum2);
+
+        using std::chrono::microseconds;
+        double jsoncppTime = std::chrono::duration_cast<microseconds>(middle - start).count() / double(iterations);
+        double writerTime = std::chrono::duration_cast<microseconds>(end - middle).count() / double(iterations);
+        printf("%6d items: jsoncpp %10.1f us, JsonWriter %10.1f us\n", count, jsoncppTime, writerTime);
+    }
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <json/json.h>
+
+#include "Core/Utils/LazyJson.h"
+
+TEST(LazyJsonTest, PathAccess) {
+    LazyJsonValue root = LazyJsonValue::parse(R"({
+        "result": {
+            "success": true,
+            "links": [
+                { "href": "http://example.com/thumb.jpg" },
+                { "href": "http://example.com/image.jpg", "size": 12345 }
+            ]
+        },
+        "empty": {}, "list": [], "nothing": null
+    })");
+    ASSERT_TRUE(root.isValid());
+    EXPECT_EQ(LazyJsonValue::Type::Object, root.type());
+    EXPECT_EQ("http://example.com/image.jpg", root.get("result.links[1].href").asString());
+    EXPECT_TRUE(root.get("result.success").asBool());
+    EXPECT_EQ(12345, root.get("result.links[1].size").asInt64());
+    EXPECT_EQ(2u, root.get("result.links").size());
+    EXPECT_EQ(LazyJsonValue::Type::Array, root.get("result.links").type());
+    EXPECT_EQ(LazyJsonValue::Type::Null, root.get("nothing").type());
+    EXPECT_EQ(0u, root.get("empty").size());
+    EXPECT_EQ(0u, root.get("list").size());
+
+    EXPECT_FALSE(root.get("result.links[2]").isValid());
+    EXPECT_FALSE(root.get("result.missing").isValid());
+    EXPECT_FALSE(root.get("result.links.href").isValid());
+    EXPECT_FALSE(root.get("result.links[x]").isValid());
+
+    LazyJsonValue links = root.get("result.links");
+    EXPECT_EQ("http://example.com/thumb.jpg", links.get("[0].href").asString());
+    std::vector<std::string> expectedKeys { "result", "empty", "list", "nothing" };
+    EXPECT_EQ(expectedKeys, root.keys());
+    EXPECT_EQ("{ \"href\": \"http://example.com/thumb.jpg\" }", links.at(0).rawText());
+}
+
+TEST(LazyJsonTest, Values) {
+    LazyJsonValue root = LazyJsonValue::parse(R"([-12, 1.5e2, 9223372036854775807, "a\"b\\cé😀\n", false, tru, 01, "x"])");
+    ASSERT_TRUE(root.isValid());
+    EXPECT_TRUE(root.at(0).isInteger());
+    EXPECT_EQ(-12, root.at(0).asInt64());
+    EXPECT_FALSE(root.at(1).isInteger());
+    EXPECT_DOUBLE_EQ(150.0, root.at(1).asDouble());
+    EXPECT_EQ(INT64_MAX, root.at(2).asInt64());
+    EXPECT_EQ("a\"b\\c\xC3\xA9\xF0\x9F\x98\x80\n", root.at(3).asString());
+    EXPECT_EQ(LazyJsonValue::Type::Bool, root.at(4).type());
+    EXPECT_FALSE(root.at(4).asBool());
+    // Syntax errors are detected on access
+    EXPECT_FALSE(root.at(5).isValid());
+    EXPECT_FALSE(root.at(6).isValid());
+    EXPECT_EQ("x", root.at(7).asString());
+}
+
+TEST(LazyJsonTest, EscapedKeysAndForEach) {
+    LazyJsonValue root = LazyJsonValue::parse(R"({"a\"b": 1, "c": 2})");
+    EXPECT_EQ(1, root.member("a\"b").asInt64());
+    EXPECT_EQ(2, root.member("c").asInt64());
+    std::string names;
+    int64_t sum = 0;
+    root.forEach([&](const std::string& name, const LazyJsonValue& value) {
+        names += name;
+        sum += value.asInt64();
+    });
+    EXPECT_EQ("a\"bc", names);
+    EXPECT_EQ(3, sum);
+}
+
+TEST(LazyJsonTest, MalformedDocuments) {
+    EXPECT_FALSE(LazyJsonValue::parse("").isValid());
+    EXPECT_FALSE(LazyJsonValue::parse("   ").isValid());
+    EXPECT_FALSE(LazyJsonValue::parse("{\"a\": [1, 2}").isValid());
+    EXPECT_FALSE(LazyJsonValue::parse("{\"a\": \"unterminated}").isValid());
+    EXPECT_FALSE(LazyJsonValue::parse("[1]]").isValid());
+    EXPECT_FALSE(LazyJsonValue::parse("{} {}").isValid());
+    EXPECT_TRUE(LazyJsonValue::parse(" \"string\" ").isValid());
+    EXPECT_EQ(42, LazyJsonValue::parse("42").asInt64());
+    EXPECT_FALSE(LazyJsonValue().get("a").isValid());
+}
+
+namespace {
+
+// Similar to the response of Google Drive files.list (API v2)
+std::string makeFileListResponse(int count) {
+    std::string result = "{\n \"kind\": \"drive#fileList\",\n \"etag\": \"\\\"abcdef\\\"\",\n \"items\": [\n";
+    for (int i = 0; i < count; i++) {
+        std::string id = "1a2b3c4d5e6f7g8h9i0j" + std::to_string(i);
+        result += std::string(i ? ",\n" : "") + "  {\n   \"kind\": \"drive#file\",\n   \"id\": \"" + id + "\",\n"
+            "   \"etag\": \"\\\"etag" + std::to_string(i) + "\\\"\",\n"
+            "   \"selfLink\": \"https://www.googleapis.com/drive/v2/files/" + id + "\",\n"
+            "   \"alternateLink\": \"https://drive.google.com/file/d/" + id + "/view?usp=drivesdk\",\n"
+            "   \"iconLink\": \"https://drive-thirdparty.googleusercontent.com/16/type/image/png\",\n"
+            "   \"thumbnailLink\": \"https://lh3.googleusercontent.com/" + id + "=s220\",\n"
+            "   \"title\": \"screenshot " + std::to_string(i) + ".png\",\n"
+            "   \"mimeType\": \"" + (i % 10 ? "image/png" : "application/vnd.google-apps.folder") + "\",\n"
+            "   \"labels\": { \"starred\": false, \"hidden\": false, \"trashed\": false, \"restricted\": false, \"viewed\": true },\n"
+            "   \"createdDate\": \"2020-01-01T10:00:00.000Z\",\n   \"modifiedDate\": \"2020-01-01T10:00:00.000Z\",\n"
+            "   \"parents\": [ { \"kind\": \"drive#parentReference\", \"id\": \"0AAbbCC\", \"isRoot\": true } ],\n"
+            "   \"owners\": [ { \"kind\": \"drive#user\", \"displayName\": \"User\", \"isAuthenticatedUser\": true, \"emailAddress\": \"user@example.com\" } ],\n"
+            "   \"fileSize\": \"" + std::to_string(100000 + i) + "\",\n"
+            "   \"imageMediaMetadata\": { \"width\": 1920, \"height\": 1080, \"rotation\": 0 },\n"
+            "   \"md5Checksum\": \"0123456789abcdef0123456789abcdef\",\n   \"version\": \"" + std::to_string(i) + "\"\n  }";
+    }
+    result += "\n ]\n}\n";
+    return result;
+}
+
+}
+
+// Run with --gtest_also_run_disabled_tests --gtest_filter=LazyJsonTest.*
+TEST(LazyJsonTest, DISABLED_Benchmark) {
+    for (int count : { 1, 100, 1000 }) {
+        std::string text = makeFileListResponse(count);
+        const int iterations = std::max(10, 20000 / count);
+        size_t checksum1 = 0, checksum2 = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++) {
+            Json::Value root;
+            Json::Reader reader;
+            ASSERT_TRUE(reader.parse(text, root, false));
+            const Json::Value& items = root["items"];
+            for (Json::ArrayIndex i = 0; i < items.size(); i++) {
+                if (items[i]["mimeType"].asString() == "application/vnd.google-apps.folder") {
+                    checksum1 += items[i]["id"].asString().size() + items[i]["title"].asString().size();
+                }
+            }
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++) {
+            LazyJsonValue root = LazyJsonValue::parse(text);
+            ASSERT_TRUE(root.isValid());
+            LazyJsonValue items = root.member("items");
+            for (size_t i = 0; i < items.size(); i++) {
+                LazyJsonValue item = items.at(i);
+                if (item.member("mimeType").asString() == "application/vnd.google-apps.folder") {
+                    checksum2 += item.member("id").asString().size() + item.member("title").asString().size();
+                }
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        EXPECT_EQ(checksum1, checksum2);
+
+        using std::chrono::microseconds;
+        double jsoncppTime = std::chrono::duration_cast<microseconds>(middle - start).count() / double(iterations);
+        double lazyTime = std::chrono::duration_cast<microseconds>(end - middle).count() / double(iterations);
+        printf("%5d items, %7zu bytes: jsoncpp %9.1f us, lazy %9.1f us\n", count, text.size(), jsoncppTime, lazyTime);
+    }
+}
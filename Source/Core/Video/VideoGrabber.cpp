@@ -20,7 +20,11 @@
 
 #include "VideoGrabber.h"
 
+#include <algorithm>
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <boost/format.hpp>
 
 #include "AbstractFrameGrabber.h"
@@ -35,6 +39,21 @@
 #include "Core/Utils/CoreUtils.h"
 #include "Core/Logging.h"
 
+namespace {
+
+// Every decoder keeps its own demuxer, codec context and frame buffers
+constexpr int MAX_AUTO_DECODER_COUNT = 4;
+
+struct GrabbedFrame {
+    bool done = false;
+    bool success = false;
+    std::string timeStr;
+    int64_t time = 0;
+    std::shared_ptr<AbstractImage> image;
+};
+
+}
+
 class VideoGrabberRunnable {
 public:
     explicit VideoGrabberRunnable(VideoGrabber* videoGrabber)
@@ -42,6 +61,8 @@ public:
         videoGrabber_ = videoGrabber;
         canceled_ = false;
         isRunning_ = false;
+        nextFrame_ = 0;
+        delivering_ = false;
     }
 
     virtual ~VideoGrabberRunnable() = default;
@@ -62,17 +83,8 @@ public:
             isRunning_ = false;
             return;
         }
-        auto grabber = videoGrabber_->createGrabber();
+        auto grabber = openGrabber();
         if ( !grabber ) {
-            return;
-        }
-        try {
-            if (!grabber->open(videoGrabber_->fileName_)) {
-                throw std::runtime_error("Failed to open video file "+ videoGrabber_->fileName_);
-            }
-        } catch (const std::exception& ex) {
-            LOG(ERROR) << ex.what();
-
             if ( videoGrabber_->onFinished_ ) {
                 videoGrabber_->onFinished_();
             }
@@ -80,38 +92,28 @@ public:
             return;
         }
 
+        int frameCount = std::max(videoGrabber_->frameCount_, 0);
         int64_t duration = grabber->duration();
-        int64_t step = duration / ( videoGrabber_->frameCount_ + 1 );
-        for( int i = 0; i < videoGrabber_->frameCount_; i++ ) {
-            if ( canceled_) {
-                break;
-            }
-            int64_t curTime = static_cast<int64_t>(( i + 0.5 ) * static_cast<double>(step));
-            AbstractVideoFrame* frame = nullptr;
-            try {
-                grabber->seek(curTime);
-                frame = grabber->grabCurrentFrame();
-                if (!frame) {
-                    grabber->seek(curTime);
-                    frame = grabber->grabCurrentFrame();
-                }
-            } catch (const std::exception& ex) {
-                LOG(WARNING) << ex.what();
-            }
-            if ( ! frame ) {
-                LOG(WARNING) <<"grabber->grabCurrentFrame returned NULL";
-                continue;
-            }
-            int64_t sampleTime = frame->getTime();
-            int hours = static_cast<int>(sampleTime / 3600);
-            int minutes = static_cast<int>(sampleTime / 60 % 60);
-            int seconds = static_cast<int>(sampleTime % 60);
-            std::string s = str(boost::format("%02d:%02d:%02d") % hours % minutes % seconds);
-
-            if ( /*frame && */videoGrabber_->onFrameGrabbed_ ) {
-                videoGrabber_->onFrameGrabbed_(s, sampleTime, frame->toImage());
-            }
-            delete frame;
+        int64_t step = duration / ( frameCount + 1 );
+        times_.clear();
+        for( int i = 0; i < frameCount; i++ ) {
+            times_.push_back(static_cast<int64_t>(( i + 0.5 ) * static_cast<double>(step)));
+        }
+        frames_.assign(frameCount, GrabbedFrame());
+        nextFrame_ = 0;
+
+        // The timeline is split into contiguous segments, so every decoder seeks only forward
+        int decoderCount = std::max(1, std::min(videoGrabber_->effectiveDecoderCount(), frameCount));
+        std::vector<std::thread> threads;
+        for (int i = 1; i < decoderCount; i++) {
+            threads.emplace_back([this, i, decoderCount, frameCount] {
+                auto segmentGrabber = openGrabber();
+                grabSegment(segmentGrabber.get(), frameCount * i / decoderCount, frameCount * (i + 1) / decoderCount);
+            });
+        }
+        grabSegment(grabber.get(), 0, frameCount / decoderCount);
+        for (auto& thread : threads) {
+            thread.join();
         }
         grabber.reset();
         if ( videoGrabber_->onFinished_ ) {
@@ -126,15 +128,106 @@ public:
     }
 
 protected:
+    std::unique_ptr<AbstractFrameGrabber> openGrabber()
+    {
+        auto grabber = videoGrabber_->createGrabber();
+        if ( !grabber ) {
+            return nullptr;
+        }
+        try {
+            if (!grabber->open(videoGrabber_->fileName_)) {
+                throw std::runtime_error("Failed to open video file "+ videoGrabber_->fileName_);
+            }
+        } catch (const std::exception& ex) {
+            LOG(ERROR) << ex.what();
+            return nullptr;
+        }
+        return grabber;
+    }
+
+    void grabSegment(AbstractFrameGrabber* grabber, int first, int last)
+    {
+        for( int i = first; i < last; i++ ) {
+            GrabbedFrame result;
+            if ( grabber && !canceled_ ) {
+                grabFrame(grabber, times_[i], result);
+            }
+            // Failed frames are marked as done too, otherwise the following frames would never be delivered
+            result.done = true;
+            deliver(i, std::move(result));
+        }
+    }
+
+    void grabFrame(AbstractFrameGrabber* grabber, int64_t curTime, GrabbedFrame& result)
+    {
+        AbstractVideoFrame* frame = nullptr;
+        try {
+            grabber->seek(curTime);
+            frame = grabber->grabCurrentFrame();
+            if (!frame) {
+                grabber->seek(curTime);
+                frame = grabber->grabCurrentFrame();
+            }
+        } catch (const std::exception& ex) {
+            LOG(WARNING) << ex.what();
+        }
+        if ( ! frame ) {
+            LOG(WARNING) <<"grabber->grabCurrentFrame returned NULL";
+            return;
+        }
+        int64_t sampleTime = frame->getTime();
+        int hours = static_cast<int>(sampleTime / 3600);
+        int minutes = static_cast<int>(sampleTime / 60 % 60);
+        int seconds = static_cast<int>(sampleTime % 60);
+        result.timeStr = str(boost::format("%02d:%02d:%02d") % hours % minutes % seconds);
+        result.time = sampleTime;
+        if ( videoGrabber_->onFrameGrabbed_ ) {
+            // Image is copied, the frame buffer is reused by the next seek
+            result.image = frame->toImage();
+        }
+        result.success = true;
+        delete frame;
+    }
+
+    // Frames are reported in timeline order whichever decoder has finished first.
+    // Only one thread at a time runs the callback.
+    void deliver(int index, GrabbedFrame&& result)
+    {
+        std::unique_lock<std::mutex> lock(framesMutex_);
+        frames_[index] = std::move(result);
+        if (delivering_) {
+            // The thread which is delivering now will take this frame too
+            return;
+        }
+        delivering_ = true;
+        while (nextFrame_ < frames_.size() && frames_[nextFrame_].done) {
+            GrabbedFrame frame = std::move(frames_[nextFrame_]);
+            nextFrame_++;
+            if (!frame.success || canceled_ || !videoGrabber_->onFrameGrabbed_) {
+                continue;
+            }
+            lock.unlock();
+            videoGrabber_->onFrameGrabbed_(frame.timeStr, frame.time, frame.image);
+            lock.lock();
+        }
+        delivering_ = false;
+    }
+
     VideoGrabber* videoGrabber_;
     std::atomic<bool> canceled_;
     std::atomic<bool> isRunning_;
+    std::vector<int64_t> times_;
+    std::mutex framesMutex_;
+    std::vector<GrabbedFrame> frames_;
+    size_t nextFrame_;
+    bool delivering_;
 };
 
 VideoGrabber::VideoGrabber()
 {
     videoEngine_ = veAuto;
     frameCount_ = 5;
+    decoderCount_ = 1;
 }
 
 VideoGrabber::~VideoGrabber(){
@@ -172,6 +265,14 @@ void VideoGrabber::setFrameCount(int frameCount) {
     frameCount_ = frameCount;
 }
 
+void VideoGrabber::setDecoderCount(int count) {
+    decoderCount_ = count;
+}
+
+int VideoGrabber::decoderCount() const {
+    return decoderCount_;
+}
+
 void VideoGrabber::setOnFrameGrabbed(FrameGrabbedCallback cb) {
     onFrameGrabbed_ = std::move(cb);
 }
@@ -180,6 +281,24 @@ void VideoGrabber::setOnFinished(VoidCallback cb) {
     onFinished_ = std::move(cb);
 }
 
+int VideoGrabber::effectiveDecoderCount() const {
+    // DirectShow graphs are not meant to be built for the same file from several threads
+    bool avcodec =
+#ifdef _WIN32
+        videoEngine_ == veAvcodec;
+#else
+        true;
+#endif
+    if (!avcodec) {
+        return 1;
+    }
+    if (decoderCount_ <= 0) {
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(1, std::min(cores, MAX_AUTO_DECODER_COUNT));
+    }
+    return decoderCount_;
+}
+
 std::unique_ptr<AbstractFrameGrabber> VideoGrabber::createGrabber() {
     std::unique_ptr<AbstractFrameGrabber> grabber;
 #ifdef _WIN32
@@ -19,6 +19,14 @@ public:
     void abort();
     bool isRunning() const;
     void setFrameCount(int frameCount);
+
+    /**
+     * Number of decoders working on different parts of the video at once.
+     * 1 (default) - frames are grabbed one by one, 0 - choose by the number of CPU cores.
+     * Only FFmpeg engine supports more than one decoder.
+     */
+    void setDecoderCount(int count);
+    int decoderCount() const;
     using FrameGrabbedCallback = std::function<void(const std::string&, int64_t, std::shared_ptr<AbstractImage>)>;
     using VoidCallback = std::function<void()>;
     void setOnFrameGrabbed(FrameGrabbedCallback cb);
@@ -26,8 +34,10 @@ public:
 private:
     std::string fileName_;
     std::unique_ptr<AbstractFrameGrabber> createGrabber();
+    int effectiveDecoderCount() const;
     VideoEngine videoEngine_;
     int frameCount_;
+    int decoderCount_;
     friend class VideoGrabberRunnable;
     std::unique_ptr<VideoGrabberRunnable> worker_;
     FrameGrabbedCallback onFrameGrabbed_;
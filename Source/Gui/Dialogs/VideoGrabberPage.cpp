@@ -447,6 +447,7 @@ int CVideoGrabberPage::GrabBitmaps(const CString& szFile )
 
     videoGrabber_ = std::make_unique<VideoGrabber>();
     videoGrabber_->setFrameCount(NumOfFrames);
+    videoGrabber_->setDecoderCount(settings->VideoSettings.DecoderCount);
     using namespace std::placeholders;
     videoGrabber_->setOnFrameGrabbed(std::bind(&CVideoGrabberPage::OnFrameGrabbed, this, _1, _2, _3));
     videoGrabber_->setOnFinished(std::bind(&CVideoGrabberPage::OnFrameGrabbingFinished, this));
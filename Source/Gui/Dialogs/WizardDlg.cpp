@@ -282,6 +282,7 @@ LRESULT CWizardDlg::OnInitDialog(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL&
     aboutButtonToolTip_ = GuiTools::CreateToolTipForWindow(GetDlgItem(IDC_HELPBUTTON), TR("Help"));
 
     CString ErrorStr;
+    enginelist_->setCacheDirectory(Settings.SettingsFolder + "Cache\\");
     if(!LoadUploadEngines(IuCommonFunctions::GetDataFolder()+_T("servers.xml"), ErrorStr))
     {
         CString ErrBuf;
@@ -333,8 +334,8 @@ LRESULT CWizardDlg::OnInitDialog(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL&
 		}
     }
     auto* historyManager = ServiceLocator::instance()->historyManager();
+    // Database is opened on first use
     historyManager->setHistoryDirectory(Settings.SettingsFolder + "\\History\\");
-    historyManager->openDatabase();
 
     if (isFirstRun_) {
         Settings.HistorySettings.HistoryConverted = true;
@@ -95,7 +95,7 @@ void UploadListModel::onTaskUploadProgress(UploadTask* task) {
         if (progress->totalUpload) {
             percent = static_cast<int>(100 * ((float)progress->uploaded) / progress->totalUpload);
         }
-        CString uploadSpeed = U2W(progress->speed);
+        CString uploadSpeed = U2W(progress->speed());
         CString progressText;
         progressText.Format(TR("%s of %s (%d%%) %s"), (LPCTSTR)U2W(IuCoreUtils::FileSizeToString(progress->uploaded)),
             (LPCTSTR)U2W(IuCoreUtils::FileSizeToString(progress->totalUpload)), percent, uploadSpeed.GetString());
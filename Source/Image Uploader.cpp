@@ -28,6 +28,8 @@
 #include "Func/IuCommonFunctions.h"
 #include "Core/Logging.h"
 #include "Core/Logging/MyLogSink.h"
+#include "Core/Logging/AsyncLogSink.h"
+#include "Core/Logging/StartupProfiler.h"
 #include "Core/Upload/ScriptUploadEngine.h"
 #include "Core/ServiceLocator.h"
 #include "Func/DefaultUploadErrorHandler.h"
@@ -38,6 +40,7 @@
 #include "Func/GdiPlusInitializer.h"
 #include "Gui/Dialogs/LangSelect.h"
 #include "versioninfo.h"
+#include "Core/Network/NetworkClient.h"
 #include "Core/Network/NetworkClientFactory.h"
 #include "Core/Scripting/ScriptsManager.h"
 #include "Core/Upload/Filters/UserFilter.h"
@@ -45,6 +48,7 @@
 #include "Core/Upload/Filters/SizeExceedFilter.h"
 #include "Core/Upload/Filters/UrlShorteningFilter.h"
 #include "Core/Upload/UploadEngineManager.h"
+#include "Core/Upload/AuthTokenCache.h"
 
 #ifndef NDEBUG
 //#include <vld.h>
@@ -60,6 +64,7 @@ class Application {
     std::unique_ptr<ScriptsManager> scriptsManager_;
     std::shared_ptr<DefaultLogger> logger_;
     std::unique_ptr<MyLogSink> myLogSink_;
+    std::unique_ptr<AsyncLogSink> asyncLogSink_;
     std::unique_ptr<UploadEngineManager> uploadEngineManager_;
     std::unique_ptr<UploadManager> uploadManager_;
     std::unique_ptr<CMyEngineList> engineList_;
@@ -78,6 +83,11 @@ public:
     }
 
     ~Application() {
+        // Write pending messages while the log window still exists, then log synchronously
+        google::RemoveLogSink(asyncLogSink_.get());
+        asyncLogSink_.reset();
+        google::AddLogSink(myLogSink_.get());
+
         CScriptUploadEngine::DestroyScriptEngine();
         //ServiceLocator::instance()->setUploadManager(nullptr);
         logWindow_.DestroyWindow();
@@ -114,7 +124,9 @@ public:
         ServiceLocator* serviceLocator = ServiceLocator::instance();
         logger_ = std::make_shared<DefaultLogger>();
         myLogSink_ = std::make_unique<MyLogSink>(logger_.get());
-        google::AddLogSink(myLogSink_.get());
+        // Upload threads and network callbacks should not wait for the logger
+        asyncLogSink_ = std::make_unique<AsyncLogSink>(myLogSink_.get());
+        google::AddLogSink(asyncLogSink_.get());
         serviceLocator->setSettings(&settings_);
         serviceLocator->setNetworkClientFactory(std::make_shared<NetworkClientFactory>());
         logWindow_.Create(nullptr);
@@ -140,6 +152,9 @@ public:
         serviceLocator->setMyEngineList(engineList_.get());
         settings_.setEngineList(engineList_.get());
         uploadEngineManager_ = std::make_unique<UploadEngineManager>(engineList_.get(), uploadErrorHandler, serviceLocator->networkClientFactory());
+        std::string settingsDirectory = AppParams::instance()->settingsDirectory();
+        uploadEngineManager_->setAuthTokenCache(std::make_shared<AuthTokenCache>(settingsDirectory + "AuthTokens.dat",
+            settingsDirectory + "AuthTokens.key"));
         uploadManager_ = std::make_unique<UploadManager>(uploadEngineManager_.get(), engineList_.get(), scriptsManager_.get(),
             uploadErrorHandler, serviceLocator->networkClientFactory(), settings_.MaxThreads);
         serviceLocator->setUploadManager(uploadManager_.get());
@@ -211,10 +226,16 @@ public:
             DeleteFile(WinUtils::GetAppFolder() + file);
         }
 
-        settings_.LoadSettings();
+        {
+            StartupPhase phase("Load settings");
+            settings_.LoadSettings();
+        }
 
         GdiPlusInitializer gdiPlusInitializer;
-        initServices();
+        {
+            StartupPhase phase("Init services");
+            initServices();
+        }
 
         CMessageLoop theLoop;
         _Module.AddMessageLoop(&theLoop);
@@ -289,11 +310,20 @@ public:
         }
 
         dlgMain.setIsFirstRun(isFirstRun);
-        if (dlgMain.Create(0, reinterpret_cast<LPARAM>(&DlgCreationResult)) == NULL) {
+        HWND mainWindow;
+        {
+            // Loads server lists
+            StartupPhase phase("Create main window");
+            mainWindow = dlgMain.Create(0, reinterpret_cast<LPARAM>(&DlgCreationResult));
+        }
+        if (mainWindow == NULL) {
             ATLTRACE(_T("Main dialog creation failed!  :( sorry\n"));
             dlgMain.m_hWnd = 0;
             return 0;
         }
+        if (CmdLine.IsOption(_T("startup-profile"))) {
+            LOG(INFO) << StartupProfiler::instance()->report();
+        }
         if (DlgCreationResult != 0) {
             dlgMain.DestroyWindow();
             dlgMain.m_hWnd = 0;
@@ -343,6 +373,7 @@ int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPTSTR lp
     // Enable memory dump from within VS.
 
 #endif
+    StartupProfiler::instance(); // Origin of the startup timeline
     FLAGS_logtostderr = true;
     google::InitGoogleLogging(WCstringToUtf8(WinUtils::GetAppFileName()).c_str());
     OleInitialize(NULL);
@@ -355,6 +386,11 @@ int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPTSTR lp
     HRESULT hRes = _Module.Init( NULL, hInstance );
     int nRet;
     ATLASSERT( SUCCEEDED( hRes ) );
+    {
+        // curl_global_init() is not thread-safe, run it before the log sink thread is started
+        StartupPhase phase("Network init");
+        NetworkClient::curl_init();
+    }
     {
         Application app;
         nRet = app.Run(lpstrCmdLine, nCmdShow);
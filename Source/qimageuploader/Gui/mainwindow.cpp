@@ -17,6 +17,7 @@
 #include "Core/CommonDefs.h"
 #include "Core/Upload/UploadManager.h"
 #include "Core/Upload/UploadEngineManager.h"
+#include "Core/Upload/AuthTokenCache.h"
 #include "Core/ServiceLocator.h"
 #include "Core/Upload/FileUploadTask.h"
 #include "Core/Scripting/ScriptsManager.h"
@@ -45,6 +46,9 @@ MainWindow::MainWindow(CUploadEngineList* engineList, LogWindow* logWindow, QWid
 
     std::string scriptsDirectory = AppParams::instance()->dataDirectory() + "/Scripts/";
     uploadEngineManager_->setScriptsDirectory(scriptsDirectory);
+    std::string settingsDirectory = AppParams::instance()->settingsDirectory();
+    uploadEngineManager_->setAuthTokenCache(std::make_shared<AuthTokenCache>(settingsDirectory + "AuthTokens.dat",
+        settingsDirectory + "AuthTokens.key"));
 
     uploadTreeModel_ = new UploadTreeModel(this, uploadManager_.get());
 
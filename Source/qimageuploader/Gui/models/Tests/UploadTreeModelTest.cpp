@@ -0,0 +1,203 @@
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QtTest>
+
+#include "Gui/models/uploadtreemodel.h"
+#include "Core/Upload/FileQueueUploader.h"
+#include "Core/Upload/UploadSession.h"
+#include "Core/Upload/UploadTask.h"
+
+namespace {
+
+class DummyUploadTask : public UploadTask {
+public:
+    Type type() const override {
+        return TypeUrl;
+    }
+    std::string getMimeType() const override {
+        return "text/plain";
+    }
+    int64_t getDataLength() const override {
+        return 0;
+    }
+    std::string title() const override {
+        return "dummy";
+    }
+    std::string toString() override {
+        return "dummy";
+    }
+};
+
+// Sends the same notifications as the upload manager, but never uploads anything
+class MockUploadManager : public CFileQueueUploader {
+public:
+    MockUploadManager() : CFileQueueUploader(nullptr, nullptr, nullptr, nullptr, 0) {
+    }
+
+    void announceSession(UploadSession* session) {
+        int count = session->taskCount();
+        for (int i = 0; i < count; i++) {
+            taskAdded(session->getTask(i).get());
+        }
+        sessionAdded(session);
+    }
+
+    void announceTask(UploadTask* task) {
+        taskAdded(task);
+    }
+};
+
+std::shared_ptr<UploadSession> createSession(int taskCount) {
+    auto session = std::make_shared<UploadSession>();
+    for (int i = 0; i < taskCount; i++) {
+        session->addTask(std::make_shared<DummyUploadTask>());
+    }
+    return session;
+}
+
+}
+
+class UploadTreeModelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void addSessionsFromWorkerThread();
+    void addSessionFromModelThread();
+    void addChildTasks();
+    void coalesceProgress();
+};
+
+void UploadTreeModelTest::addSessionsFromWorkerThread()
+{
+    const int sessionCount = 500;
+    const int tasksPerSession = 100;
+    MockUploadManager manager;
+    UploadTreeModel model(nullptr, &manager);
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    std::vector<std::shared_ptr<UploadSession>> sessions;
+
+    QElapsedTimer timer;
+    timer.start();
+    std::thread worker([&] {
+        for (int i = 0; i < sessionCount; i++) {
+            sessions.push_back(createSession(tasksPerSession));
+            manager.announceSession(sessions.back().get());
+        }
+    });
+    worker.join();
+    QTRY_COMPARE(model.rowCount(), sessionCount);
+    qint64 elapsed = timer.elapsed();
+
+    // Everything was queued before the model thread got control, so it is inserted as one range
+    QCOMPARE(inserted.count(), 1);
+    int taskCount = 0;
+    for (int i = 0; i < model.rowCount(); i++) {
+        QModelIndex sessionIndex = model.index(i, 0);
+        QVERIFY(model.getInternalItem(sessionIndex)->session == sessions[i]);
+        QCOMPARE(model.parent(model.index(tasksPerSession - 1, 0, sessionIndex)), sessionIndex);
+        taskCount += model.rowCount(sessionIndex);
+    }
+    QCOMPARE(taskCount, sessionCount * tasksPerSession);
+    QVERIFY2(elapsed < 2000, qPrintable(QString("Adding 50000 tasks took %1 ms").arg(elapsed)));
+}
+
+void UploadTreeModelTest::addSessionFromModelThread()
+{
+    MockUploadManager manager;
+    UploadTreeModel model(nullptr, &manager);
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    auto session = createSession(3);
+    manager.announceSession(session.get());
+
+    // The row is available right after the session has been added
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(model.rowCount(model.index(0, 0)), 3);
+    QCOMPARE(inserted.count(), 1);
+
+    // Queued notifications of its tasks do not insert the rows again
+    QTest::qWait(UploadTreeModel::kFlushInterval * 3);
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(model.rowCount(model.index(0, 0)), 3);
+}
+
+void UploadTreeModelTest::addChildTasks()
+{
+    const int parentCount = 20;
+    const int childrenPerTask = 50;
+    MockUploadManager manager;
+    UploadTreeModel model(nullptr, &manager);
+    auto session = createSession(parentCount);
+    manager.announceSession(session.get());
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+
+    std::thread worker([&] {
+        for (int i = 0; i < parentCount; i++) {
+            auto parent = session->getTask(i);
+            for (int j = 0; j < childrenPerTask; j++) {
+                auto child = std::make_shared<DummyUploadTask>();
+                parent->addChildTask(child);
+                manager.announceTask(child.get());
+            }
+        }
+    });
+    worker.join();
+
+    QModelIndex sessionIndex = model.index(0, 0);
+    QTRY_COMPARE(model.rowCount(model.index(parentCount - 1, 0, sessionIndex)), childrenPerTask);
+    // One range for each parent task
+    QCOMPARE(inserted.count(), parentCount);
+    for (int i = 0; i < parentCount; i++) {
+        QModelIndex parentIndex = model.index(i, 0, sessionIndex);
+        QCOMPARE(model.rowCount(parentIndex), childrenPerTask);
+        QCOMPARE(model.parent(model.index(childrenPerTask - 1, 0, parentIndex)), parentIndex);
+    }
+}
+
+void UploadTreeModelTest::coalesceProgress()
+{
+    const int taskCount = 1000;
+    const int ticks = 50;
+    MockUploadManager manager;
+    UploadTreeModel model(nullptr, &manager);
+    auto session = createSession(taskCount);
+    manager.announceSession(session.get());
+    QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+
+    QElapsedTimer timer;
+    timer.start();
+    std::thread worker([&] {
+        for (int i = 0; i < ticks; i++) {
+            for (int j = 0; j < taskCount; j++) {
+                auto task = session->getTask(j);
+                task->deliverProgress(1000 + i);
+                if (i % 10 == 0) {
+                    task->setStatusText("Uploading");
+                }
+            }
+        }
+    });
+    worker.join();
+    QTRY_COMPARE(changed.count(), 1);
+    qint64 elapsed = timer.elapsed();
+
+    // Adjacent rows are reported with one signal
+    QModelIndex topLeft = changed[0][0].value<QModelIndex>();
+    QModelIndex bottomRight = changed[0][1].value<QModelIndex>();
+    QCOMPARE(topLeft.row(), 0);
+    QCOMPARE(bottomRight.row(), taskCount - 1);
+    QCOMPARE(bottomRight.column(), model.columnCount() - 1);
+    QCOMPARE(model.parent(topLeft), model.index(0, 0));
+
+    QTest::qWait(UploadTreeModel::kFlushInterval * 3);
+    QCOMPARE(changed.count(), 1);
+    QVERIFY2(elapsed < 2000, qPrintable(QString("Delivering progress took %1 ms").arg(elapsed)));
+}
+
+QTEST_GUILESS_MAIN(UploadTreeModelTest)
+
+#include "UploadTreeModelTest.moc"
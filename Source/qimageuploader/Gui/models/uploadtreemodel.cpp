@@ -1,24 +1,35 @@
 #include "uploadtreemodel.h"
 
+#include <algorithm>
+#include <functional>
 #include <QtGui>
 #include <QStringList>
+#include <QThread>
 
 #include "Core/CommonDefs.h"
 
-Q_DECLARE_METATYPE( UploadSession* )
-Q_DECLARE_METATYPE( UploadTask* )
-
-UploadTreeModel::UploadTreeModel(QObject *parent,UploadManager *uploadManager)
+UploadTreeModel::UploadTreeModel(QObject *parent, CFileQueueUploader *uploadManager)
     : QAbstractItemModel(parent)
 {
-    qRegisterMetaType<UploadSession*>("UploadSession*");
-    qRegisterMetaType<UploadTask*>("UploadTask*");
+    m_flushScheduled = false;
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kFlushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &UploadTreeModel::flush);
     setupModelData(uploadManager);
 }  
 
 UploadTreeModel::~UploadTreeModel()
 {
-
+    m_uploadManager->setOnTaskAddedCallback(nullptr);
+    m_uploadManager->setOnSessionAddedCallback(nullptr);
+    for (const auto& it : m_taskMap) {
+        it.first->setOnUploadProgressCallback(nullptr);
+        it.first->setOnStatusChangedCallback(nullptr);
+    }
+    for (UploadTask* task : m_pendingTasks) {
+        task->setOnUploadProgressCallback(nullptr);
+        task->setOnStatusChangedCallback(nullptr);
+    }
 }
 
 int UploadTreeModel::columnCount(const QModelIndex &parent) const
@@ -75,16 +86,17 @@ QVariant UploadTreeModel::data(const QModelIndex &index, int role) const
 			if (progress->uploaded && progress->totalUpload)
 			{
 
-				QString speedText = QString("%1 of %2").arg(progress->uploaded).arg(progress->totalUpload);
+				QString speedText = QString("%1 of %2").arg(progress->uploaded.load()).arg(progress->totalUpload.load());
 				if (progress->totalUpload)
 				{
 					QString perc;
 					perc = QString::number((long)(100 * (double)progress->uploaded / progress->totalUpload)) + "%";
 					speedText += "(" + perc + ")";
 				}
-				if (!progress->speed.empty())
+				std::string speed = progress->speed();
+				if (!speed.empty())
 				{
-					speedText += " [" + QString::fromUtf8(progress->speed.c_str()) +"]";
+					speedText += " [" + QString::fromUtf8(speed.c_str()) +"]";
 				}
 				result = speedText;
 			}
@@ -123,39 +135,15 @@ QVariant UploadTreeModel::headerData(int section, Qt::Orientation orientation,
 
 QModelIndex UploadTreeModel::index(int row, int column, const QModelIndex &parent) const
 {
-	if (!hasIndex(row, column, parent)) {
-		return QModelIndex();
-	}
-
-    InternalItem * internalItem = nullptr;
-
-    if (!parent.isValid()) {
-        auto session = m_uploadManager->session(row);
-		internalItem = reinterpret_cast<InternalItem*>(session->userData());
+    if (!hasIndex(row, column, parent)) {
+        return QModelIndex();
     }
-    else {
-        InternalItem * internalParentItem = reinterpret_cast<InternalItem*> (parent.internalPointer());
-        if ( internalParentItem->task ) {
-            auto task = internalParentItem->task->child(row);
-			if (task) {
-				internalItem = reinterpret_cast<InternalItem*>(task->userData());
-			}
-		}
-		else if (internalParentItem->session) {
-			auto task = internalParentItem->session->getTask(row);
-			if (task) {
-				internalItem = reinterpret_cast<InternalItem*>(task->userData());
-			}
-        }
 
+    if (!parent.isValid()) {
+        return createIndex(row, column, m_sessionItems[row]);
     }
-
-	if (internalItem) {
-		return createIndex(row, column, internalItem);
-	}
-	else {
-		return QModelIndex();
-	}
+    InternalItem* internalParentItem = reinterpret_cast<InternalItem*>(parent.internalPointer());
+    return createIndex(row, column, internalParentItem->children[row]);
 }
 
 QModelIndex UploadTreeModel::parent(const QModelIndex &index) const
@@ -163,35 +151,8 @@ QModelIndex UploadTreeModel::parent(const QModelIndex &index) const
     if (!index.isValid())
         return QModelIndex();
 
-    /*if ( index.column() == 0 )*/ {
-        InternalItem * internalItem = reinterpret_cast<InternalItem*>(index.internalPointer());
-
-        if (internalItem->task ) {
-            UploadTask* parent = internalItem->task->parentTask();
-            if(!parent) {
-                UploadSession* session = internalItem->task->session();
-				InternalItem* item = reinterpret_cast<InternalItem*>(session->userData());
-                /*auto it = sessionsMap_.find(session);
-                if ( it == sessionsMap_.end() ) {
-                    return QModelIndex();
-                }*/
-                return createIndex(item->index, 0, session->userData());
-            }
-            UploadTask* parentTask = internalItem->task->parentTask();
-			InternalItem* item = reinterpret_cast<InternalItem*>(parentTask->userData());
-            /*auto it = m_objMap.find(parentTask);
-            if ( it == m_objMap.end() ) {
-                return QModelIndex();
-            }*/
-            return createIndex(item->index, 0, parentTask->userData());
-        } else {
-            //UploadSession* has no parent
-            return QModelIndex();
-        }
-        // return createIndex(upload->childCount(), 0, parent);
-    }
-    return QModelIndex();
-
+    InternalItem* internalItem = reinterpret_cast<InternalItem*>(index.internalPointer());
+    return indexOf(internalItem->parent);
 }
 
 int UploadTreeModel::rowCount(const QModelIndex &parent) const
@@ -202,178 +163,220 @@ int UploadTreeModel::rowCount(const QModelIndex &parent) const
             return 0;
         }
         InternalItem * internalParentItem = reinterpret_cast<InternalItem*>(parent.internalPointer());
-
-        if ( internalParentItem->task ) {
-            return internalParentItem->task->childCount();
-        } else {
-            return internalParentItem->session->taskCount();
-        }
-        return 0;
+        return static_cast<int>(internalParentItem->children.size());
     }
 
-    //return  0;
-    return m_uploadManager->sessionCount();
+    return static_cast<int>(m_sessionItems.size());
+}
+
+QModelIndex UploadTreeModel::indexOf(InternalItem* item) const
+{
+    if (!item) {
+        return QModelIndex();
+    }
+    return createIndex(item->index, 0, item);
 }
 
-void UploadTreeModel::setupModelData(UploadManager *uploadManager)
+void UploadTreeModel::setupModelData(CFileQueueUploader *uploadManager)
 {
     m_uploadManager = uploadManager;
     using namespace std::placeholders;
     m_uploadManager->setOnTaskAddedCallback(std::bind(&UploadTreeModel::data_OnChildAdded, this, _1));
-    //m_uploadManager->OnChildAdded.bind(this, &UploadTreeModel::data_OnChildAdded);
-    m_uploadManager->setOnSessionAddedCallback(std::bind(&UploadTreeModel::OnSessionAdded, this, _1));
-    //m_uploadManager->OnU.bind(this,  &UploadTreeModel::data_OnUploadProgress);
-     
-    /*connect(uploadManager, SIGNAL(OnChildAdded(UploadTask*,UploadTask*)), this, SLOT(data_OnChildAdded(UploadTask*,UploadTask*))/, Qt::BlockingQueuedConnection*);
-    connect(uploadManager, SIGNAL(OnUploadProgress(UploadTask*,InfoProgress)), this, SLOT(data_OnUploadProgress(UploadTask*,InfoProgress)));
-    connect(uploadManager, SIGNAL(OnStatusChanged(UploadTask*,QString)), this, SLOT(data_OnStatusChanged(UploadTask*,QString)));
-    */
-    //emit dataChanged();
+    m_uploadManager->setOnSessionAddedCallback(std::bind(&UploadTreeModel::data_OnSessionAdded, this, _1));
 }
 
+void UploadTreeModel::setTaskCallbacks(UploadTask* task)
+{
+    using namespace std::placeholders;
+    task->setOnUploadProgressCallback(std::bind(&UploadTreeModel::data_OnUploadProgress, this, _1));
+    task->setOnStatusChangedCallback(std::bind(&UploadTreeModel::data_OnStatusChanged, this, _1));
+}
+
+// Notifications below may be called from any thread
+
 void UploadTreeModel::data_OnChildAdded(UploadTask* child)
 {
-    QMetaObject::invokeMethod( this, "onChildAdded", Qt::BlockingQueuedConnection,
-                               Q_ARG( UploadTask*, child ) );
+    setTaskCallbacks(child);
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    m_pendingTasks.push_back(child);
+    if (child->session()) {
+        m_pendingTaskSessions.push_back(child->session()->shared_from_this());
+    }
+    scheduleFlush();
 }
 
 void UploadTreeModel::data_OnUploadProgress(UploadTask* task)
 {
-    QMetaObject::invokeMethod( this, "onUploadProgress", Qt::BlockingQueuedConnection,
-                               Q_ARG( UploadTask*, task ) );
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    m_pendingChanges.insert(task);
+    scheduleFlush();
 }
 
 void UploadTreeModel::data_OnSessionAdded(UploadSession *session) {
-    QMetaObject::invokeMethod( this, "OnSessionAdded", Qt::BlockingQueuedConnection,
-                               Q_ARG( UploadSession*, session ) );
+    int taskCount = session->taskCount();
+    for (int i = 0; i < taskCount; i++) {
+        setTaskCallbacks(session->getTask(i).get());
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pendingSessions.push_back(session->shared_from_this());
+        if (QThread::currentThread() != thread()) {
+            scheduleFlush();
+            return;
+        }
+    }
+    // Callers expect the row to exist when UploadManager::addSession() returns
+    flush();
 }
 
-int UploadTreeModel::byUploadTask(UploadTask* obj) const
+void UploadTreeModel::data_OnStatusChanged(UploadTask* it)
 {
-	InternalItem* item = reinterpret_cast<InternalItem*>(obj->userData());
-	if (item) {
-		return item->index;
-	}
-  
-    return -1;
+    data_OnUploadProgress(it);
 }
 
-int UploadTreeModel::byUploadSession(UploadSession *obj) const
+void UploadTreeModel::scheduleFlush()
 {
-	InternalItem* item = reinterpret_cast<InternalItem*>(obj->userData());
-	if (item) {
-		return item->index;
-	}
-    return -1;
+    // m_pendingMutex should be locked
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        QMetaObject::invokeMethod(this, "startFlushTimer", Qt::QueuedConnection);
+    }
 }
 
-void UploadTreeModel::data_OnStatusChanged(UploadTask* it)
+void UploadTreeModel::startFlushTimer()
 {
-    QMetaObject::invokeMethod( this, "onStatusChanged", Qt::BlockingQueuedConnection,
-                               Q_ARG( UploadTask*, it ) );
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
 }
 
-void UploadTreeModel::onChildAdded(UploadTask *child)
+void UploadTreeModel::flush()
 {
-    recalcObjMap();
-    if(!child->parentTask())
+    std::vector<std::shared_ptr<UploadSession>> sessions, taskSessions;
+    std::vector<UploadTask*> tasks;
+    std::unordered_set<UploadTask*> changes;
     {
-		UploadSession* session = child->session();
-		/*auto it = sessionsMap_[session];
-		auto it2 = m_objMap[child];*/
-        insertRow(createIndex(byUploadSession(session), 0, session->userData()), reinterpret_cast<InternalItem*>(child->userData()));
-        //insertRow(QModelIndex());
-
-    }
-    else
-    {
-        //insertRow(QModelIndex());
-        UploadTask * parent = child->parentTask();
-		//auto parentData = m_objMap[parent];
-        //InternalItem* it = m_objMap[child];
-		InternalItem* it = reinterpret_cast<InternalItem*>(child->userData());
-        insertRow(createIndex(byUploadTask(parent), 0, parent->userData()), it);
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        sessions.swap(m_pendingSessions);
+        tasks.swap(m_pendingTasks);
+        taskSessions.swap(m_pendingTaskSessions);
+        changes.swap(m_pendingChanges);
+        m_flushScheduled = false;
     }
+    insertSessions(sessions);
+    insertTasks(tasks);
+    emitDataChanged(changes);
 }
 
-void UploadTreeModel::onUploadProgress(UploadTask *task)
+UploadTreeModel::InternalItem* UploadTreeModel::createItem(InternalItem* parent, std::shared_ptr<UploadTask> task, std::shared_ptr<UploadSession> session)
 {
-	int row = byUploadTask(task);
-	auto it = reinterpret_cast<InternalItem*>(task->userData());
-	emit dataChanged(createIndex(row,2,it), createIndex(row,2,it));
+    m_items.emplace_back(new InternalItem());
+    InternalItem* item = m_items.back().get();
+    item->parent = parent;
+    item->task = std::move(task);
+    item->session = std::move(session);
+    if (parent) {
+        item->index = static_cast<int>(parent->children.size());
+        parent->children.push_back(item);
+    } else {
+        item->index = static_cast<int>(m_sessionItems.size());
+        m_sessionItems.push_back(item);
+    }
+    if (item->task) {
+        m_taskMap[item->task.get()] = item;
+    } else {
+        m_sessionMap[item->session.get()] = item;
+    }
+    return item;
 }
 
-void UploadTreeModel::onStatusChanged(UploadTask *task)
+void UploadTreeModel::appendChildRows(InternalItem* item, bool notify)
 {
-    int row = byUploadTask(task);
-	auto it = reinterpret_cast<InternalItem*>(task->userData());
-    emit dataChanged(createIndex(row,1,it), createIndex(row,1,it));
-}
-
-void UploadTreeModel::OnSessionAdded(UploadSession *session) {
-    recalcObjMap();
-	auto it = reinterpret_cast<InternalItem*>(session->userData());
-    insertRow(/*createIndex(byUploadSession(session), 0, it)*/QModelIndex(), it);
-	int taskCount = session->taskCount();
-	for (int i = 0; i < taskCount; i++) {
-		auto task = session->getTask(i);
-		using namespace std::placeholders;
-		task->setOnUploadProgressCallback(std::bind(&UploadTreeModel::data_OnUploadProgress, this, _1));
-		task->setOnStatusChangedCallback(std::bind(&UploadTreeModel::data_OnStatusChanged, this, _1));
-
-	}
+    int first = static_cast<int>(item->children.size());
+    int count = item->task ? item->task->childCount() : item->session->taskCount();
+    if (count <= first) {
+        return;
+    }
+    if (notify) {
+        beginInsertRows(indexOf(item), first, count - 1);
+    }
+    for (int i = first; i < count; i++) {
+        auto task = item->task ? item->task->child(i) : item->session->getTask(i);
+        // Children of a new row are inserted together with it
+        appendChildRows(createItem(item, task, nullptr), false);
+    }
+    if (notify) {
+        endInsertRows();
+    }
 }
 
-bool UploadTreeModel::insertRow( const QModelIndex &parent, InternalItem* internalItem) {
-    //InternalItem* internalItem = reinterpret_cast<InternalItem*>(parent.internalPointer());
-
-    int pos = 0;
-    if ( internalItem->task ) {
-		pos = internalItem->session->taskCount();
-        //pos = internalItem->task->childCount();
-    } else if ( internalItem->session ) {
-		pos = m_uploadManager->sessionCount();
-        //pos = internalItem->session->taskCount();
-    } else {
-        
+void UploadTreeModel::insertSessions(const std::vector<std::shared_ptr<UploadSession>>& sessions)
+{
+    std::vector<std::shared_ptr<UploadSession>> newSessions;
+    for (const auto& session : sessions) {
+        if (!m_sessionMap.count(session.get()) && std::find(newSessions.begin(), newSessions.end(), session) == newSessions.end()) {
+            newSessions.push_back(session);
+        }
+    }
+    if (newSessions.empty()) {
+        return;
+    }
+    int first = static_cast<int>(m_sessionItems.size());
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(newSessions.size()) - 1);
+    for (const auto& session : newSessions) {
+        appendChildRows(createItem(nullptr, nullptr, session), false);
     }
-
-    beginInsertRows(parent,pos, pos);
     endInsertRows();
-    return true;
 }
 
-void UploadTreeModel::recalcObjMap()
+void UploadTreeModel::insertTasks(const std::vector<UploadTask*>& tasks)
 {
-    /*sessionsMap_.clear();
-    m_objMap.clear();*/
-    int k = 0;
-    int sessionCount = m_uploadManager->sessionCount();
-    for( int i = 0; i < sessionCount; i++ ) {
-        std::shared_ptr<UploadSession> session = m_uploadManager->session(i);
-
-		InternalItem * item = reinterpret_cast<InternalItem*>(session->userData());
-		if (!item) {
-			item = new InternalItem();
-		}
-        item->session = session;
-        item->index = i;
-		session->setUserData(item);
-        //sessionsMap_[session.get()] = item;
-
-        int childCount = session->taskCount();
-        for ( int j = 0; j < childCount; j++ ) {
-			auto task = session->getTask(j);
-			InternalItem * item = reinterpret_cast<InternalItem*>(task->userData());
-			if (!item) {
-				item = new InternalItem();
-			}
-            item->index = j;
-			item->task = task;
-			item->task->setUserData(item);
-            //m_objMap[item->task.get()] = item;
+    for (UploadTask* task : tasks) {
+        if (m_taskMap.count(task)) {
+            // Already inserted with its parent or with a previous task
+            continue;
         }
+        InternalItem* parentItem = nullptr;
+        if (task->parentTask()) {
+            auto it = m_taskMap.find(task->parentTask());
+            parentItem = it != m_taskMap.end() ? it->second : nullptr;
+        } else {
+            auto it = m_sessionMap.find(task->session());
+            parentItem = it != m_sessionMap.end() ? it->second : nullptr;
+        }
+        // If the parent is not shown yet, the task will be inserted together with it
+        if (parentItem) {
+            appendChildRows(parentItem, true);
+            if (parentItem->session) {
+                // Session title contains the number of files
+                emit dataChanged(indexOf(parentItem), indexOf(parentItem));
+            }
+        }
+    }
+}
 
+void UploadTreeModel::emitDataChanged(const std::unordered_set<UploadTask*>& tasks)
+{
+    std::vector<InternalItem*> items;
+    items.reserve(tasks.size());
+    for (UploadTask* task : tasks) {
+        auto it = m_taskMap.find(task);
+        if (it != m_taskMap.end()) {
+            items.push_back(it->second);
+        }
+    }
+    std::sort(items.begin(), items.end(), [](InternalItem* a, InternalItem* b) {
+        return a->parent != b->parent ? std::less<InternalItem*>()(a->parent, b->parent) : a->index < b->index;
+    });
+    // One signal for each run of adjacent rows
+    int lastColumn = columnCount() - 1;
+    for (size_t i = 0; i < items.size();) {
+        size_t j = i + 1;
+        while (j < items.size() && items[j]->parent == items[i]->parent && items[j]->index == items[j - 1]->index + 1) {
+            j++;
+        }
+        emit dataChanged(createIndex(items[i]->index, 0, items[i]), createIndex(items[j - 1]->index, lastColumn, items[j - 1]));
+        i = j;
     }
 }
 
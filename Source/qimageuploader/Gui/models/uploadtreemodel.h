@@ -1,29 +1,50 @@
 #ifndef QIMAGEUPLOADER_GUI_MODELS_UPLOADTREEMODEL_H
 #define QIMAGEUPLOADER_GUI_MODELS_UPLOADTREEMODEL_H
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include <QAbstractItemModel>
 #include <QModelIndex>
+#include <QTimer>
 #include <QVariant>
-#include "Core/Upload/UploadManager.h"
+#include "Core/Upload/FileQueueUploader.h"
 #include "Core/Upload/UploadTask.h"
 
+/**
+ * Tree of upload sessions and their tasks.
+ *
+ * Notifications of the upload manager may come from any thread. They are queued and applied
+ * on the model's thread once per frame: new rows of the same parent are inserted as one range,
+ * progress and status changes of adjacent rows are reported with one dataChanged() signal.
+ * Sessions added from the model's thread are inserted immediately.
+ */
 class UploadTreeModel : public QAbstractItemModel
 {
     Q_OBJECT
 
 public:
 
-	struct InternalItem {
-		int index;
-		std::shared_ptr<UploadTask> task;
-		std::shared_ptr<UploadSession> session;
-		InternalItem() {
-			index = 0;
-		}
-	};
+    struct InternalItem {
+        int index; // row within the parent
+        InternalItem* parent;
+        std::vector<InternalItem*> children; // rows which have been announced to views
+        std::shared_ptr<UploadTask> task;
+        std::shared_ptr<UploadSession> session;
+        InternalItem() {
+            index = 0;
+            parent = nullptr;
+        }
+    };
+
+    // Milliseconds between applying of queued changes (about one frame)
+    static const int kFlushInterval = 16;
 
-    UploadTreeModel(QObject *parent, UploadManager *uploadManager);
-	 ~UploadTreeModel();
+    UploadTreeModel(QObject *parent, CFileQueueUploader *uploadManager);
+    ~UploadTreeModel();
 
     QVariant data(const QModelIndex &index, int role) const;
     Qt::ItemFlags flags(const QModelIndex &index) const;
@@ -34,27 +55,44 @@ public:
     QModelIndex parent(const QModelIndex &index) const;
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
     int columnCount(const QModelIndex &parent = QModelIndex()) const;
-	InternalItem* getInternalItem(const QModelIndex &index);
+    InternalItem* getInternalItem(const QModelIndex &index);
+
+    /**
+     * Applies queued changes right away, without waiting for the timer.
+     */
+    void flush();
 private:
-    void setupModelData(UploadManager *uploadManager);
-    
-    UploadManager *m_uploadManager;
-    /*std::map<UploadTask*, InternalItem*> m_objMap;
-    std::map<UploadSession*, InternalItem*> sessionsMap_;*/
-    int byUploadTask(UploadTask* obj) const;
-    int byUploadSession(UploadSession* obj) const;
-    bool insertRow(const QModelIndex &parent, InternalItem* internalItem);
-    void recalcObjMap();
+    void setupModelData(CFileQueueUploader *uploadManager);
+
+    CFileQueueUploader *m_uploadManager;
+    QModelIndex indexOf(InternalItem* item) const;
+    InternalItem* createItem(InternalItem* parent, std::shared_ptr<UploadTask> task, std::shared_ptr<UploadSession> session);
+    void appendChildRows(InternalItem* item, bool notify);
+    void insertSessions(const std::vector<std::shared_ptr<UploadSession>>& sessions);
+    void insertTasks(const std::vector<UploadTask*>& tasks);
+    void emitDataChanged(const std::unordered_set<UploadTask*>& tasks);
+    void setTaskCallbacks(UploadTask* task);
+    void scheduleFlush();
     void data_OnChildAdded(UploadTask* child);
     void data_OnUploadProgress(UploadTask* task);
-    void data_OnSessionAdded(UploadSession* task);
+    void data_OnSessionAdded(UploadSession* session);
     void data_OnStatusChanged(UploadTask* it);
-	
-    //public slots:
-    Q_INVOKABLE  void onChildAdded(UploadTask* child);
-    Q_INVOKABLE  void onUploadProgress(UploadTask* task);
-    Q_INVOKABLE  void onStatusChanged(UploadTask* it);
-    Q_INVOKABLE  void OnSessionAdded(UploadSession* session);
+
+    Q_INVOKABLE void startFlushTimer();
+
+    std::vector<std::unique_ptr<InternalItem>> m_items;
+    std::vector<InternalItem*> m_sessionItems;
+    std::unordered_map<UploadSession*, InternalItem*> m_sessionMap;
+    std::unordered_map<UploadTask*, InternalItem*> m_taskMap;
+    QTimer m_flushTimer;
+
+    // Changes which have not been applied yet, guarded by m_pendingMutex
+    std::mutex m_pendingMutex;
+    std::vector<std::shared_ptr<UploadSession>> m_pendingSessions;
+    std::vector<UploadTask*> m_pendingTasks;
+    std::vector<std::shared_ptr<UploadSession>> m_pendingTaskSessions; // keep the added tasks alive
+    std::unordered_set<UploadTask*> m_pendingChanges;
+    bool m_flushScheduled;
  };
 
 
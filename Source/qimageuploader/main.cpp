@@ -124,6 +124,7 @@ settingsDir.mkpath(settingsFolder);
 
 	Settings.LoadSettings(AppParams::instance()->settingsDirectory());
 	auto engineList = std::make_unique<CUploadEngineList>();
+	engineList->setCacheDirectory(AppParams::instance()->settingsDirectory() + "Cache/");
 	if (!engineList->loadFromFile(AppParams::instance()->dataDirectory() + "servers.xml", Settings.ServersSettings)) {
 		QMessageBox::warning(nullptr, "Failure", "Unable to load servers.xml");
 	}